@@ -45,15 +45,15 @@ const PropertyName MARK_COUNT("marks");
 
 PropertyName getMarkPropertyName(int markNo)
 {
-    static std::vector<PropertyName> firstFive;
-
-    if (firstFive.empty()) {
-        firstFive.push_back(PropertyName("mark1"));
-        firstFive.push_back(PropertyName("mark2"));
-        firstFive.push_back(PropertyName("mark3"));
-        firstFive.push_back(PropertyName("mark4"));
-        firstFive.push_back(PropertyName("mark5"));
-    }
+    // Initialised in one go, so that it is safe to call from several
+    // threads (the notation layout scans staffs at once).
+    static const std::vector<PropertyName> firstFive = {
+        PropertyName("mark1"),
+        PropertyName("mark2"),
+        PropertyName("mark3"),
+        PropertyName("mark4"),
+        PropertyName("mark5")
+    };
 
     if (markNo < 5) return firstFive[markNo];
 
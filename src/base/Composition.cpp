@@ -50,7 +50,7 @@ namespace Rosegarden
 const PropertyName Composition::NoAbsoluteTimeProperty("NoAbsoluteTime");
 const PropertyName Composition::BarNumberProperty("BarNumber");
 
-const std::string Composition::TempoEventType("tempo");
+const std::string &Composition::TempoEventType = Event::internType("tempo");
 const PropertyName Composition::TempoProperty("Tempo");
 const PropertyName Composition::TargetTempoProperty("TargetTempo");
 const PropertyName Composition::TempoTimestampProperty("TimestampSec");
@@ -214,7 +214,8 @@ Composition::ReferenceSegment::findAtOrBefore(RealTime t)
         return end();
 
     // Find the Event at or after t.
-    Event tempEvent("dummy", 0, 0, MIN_SUBORDERING);
+    static const std::string &dummyType = Event::internType("dummy");
+    Event tempEvent(dummyType, 0, 0, MIN_SUBORDERING);
     tempEvent.set<Bool>(NoAbsoluteTimeProperty, true);
     setTempoTimestamp(&tempEvent, t);
     // Use std::lower_bound() which does a binary search.
@@ -727,6 +728,8 @@ Composition::setEndMarker(const timeT &endMarker)
 
     m_endMarker = endMarker;
 
+    // A ramp from the last tempo change ends at the end marker.
+    m_tempoTimestampsNeedCalculating = true;
     clearVoiceCaches();
     updateRefreshStatuses();
     notifyEndMarkerChange(shorten);
@@ -746,6 +749,7 @@ Composition::clear()
     m_timeSigSegment.clear();
     m_tempoSegment.clear();
     m_defaultTempo = getTempoForQpm(120.0);
+    m_tempoTimestampsNeedCalculating = true;
     m_minTempo = 0;
     m_maxTempo = 0;
     m_loopMode = LoopOff;
@@ -1294,36 +1298,10 @@ Composition::getElapsedRealTime(timeT t) const
 {
     calculateTempoTimestamps();
 
-    ReferenceSegment::iterator i = m_tempoSegment.findAtOrBefore(t);
-    if (i == m_tempoSegment.end()) {
-        i = m_tempoSegment.begin();
-        if (t >= 0 ||
-            (i == m_tempoSegment.end() || (*i)->getAbsoluteTime() > 0)) {
-            return time2RealTime(t, m_defaultTempo);
-        }
-    }
-
-    RealTime elapsed;
-
-    tempoT target = -1;
-    timeT nextTempoTime = t;
-
-    if (!getTempoTarget(i, target, nextTempoTime)) target = -1;
-
-    if (target > 0) {
-        elapsed = getTempoTimestamp(*i) +
-            time2RealTime(t - (*i)->getAbsoluteTime(),
-                          tempoT((*i)->get<Int>(TempoProperty)),
-                          nextTempoTime - (*i)->getAbsoluteTime(),
-                          target);
-    } else {
-        elapsed = getTempoTimestamp(*i) +
-            time2RealTime(t - (*i)->getAbsoluteTime(),
-                          tempoT((*i)->get<Int>(TempoProperty)));
-    }
+    RealTime elapsed = m_tempoMap->getElapsedRealTime(t);
 
 #ifdef DEBUG_TEMPO_STUFF
-    RG_DEBUG << "getElapsedRealTime(): " << t << " -> " << elapsed << " (last tempo change at " << (*i)->getAbsoluteTime() << ")";
+    RG_DEBUG << "getElapsedRealTime(): " << t << " -> " << elapsed;
 #endif
 
     return elapsed;
@@ -1339,7 +1317,7 @@ Composition::getElapsedRealTime(timeT t) const
     // In case we have an anacrusis, make sure we have the proper
     // start time which could be negative.
     const timeT start = getStartMarker();
-    const RealTime realStart = time2RealTime(start, m_defaultTempo);
+    const RealTime realStart = TempoMap::time2RealTime(start, m_defaultTempo);
 
     // Elapsed time is dependent on tempo changes.  Find the previous one.
     ReferenceSegment::iterator tempoIter = m_tempoSegment.findAtOrBefore(t);
@@ -1372,7 +1350,7 @@ Composition::getElapsedRealTime(timeT t) const
                  (*tempoIter)->getAbsoluteTime() > start)) {  // tempo change is after composition start?
             // Perform a simple pulses to seconds conversion using the
             // default tempo.
-            RealTime rt = time2RealTime(t, m_defaultTempo);
+            RealTime rt = TempoMap::time2RealTime(t, m_defaultTempo);
             rt = rt - realStart;
             RG_DEBUG << "getElapsedRealTime 1" << t << rt;
             return rt;
@@ -1417,14 +1395,14 @@ Composition::getElapsedRealTime(timeT t) const
 
     if (target > 0) {
         elapsed = getTempoTimestamp(*tempoIter) +
-            time2RealTime(t - (*tempoIter)->getAbsoluteTime(),
-                          tempoT((*tempoIter)->get<Int>(TempoProperty)),
-                          nextTempoTime - (*tempoIter)->getAbsoluteTime(),
-                          target);
+            TempoMap::time2RealTime(t - (*tempoIter)->getAbsoluteTime(),
+                                    tempoT((*tempoIter)->get<Int>(TempoProperty)),
+                                    nextTempoTime - (*tempoIter)->getAbsoluteTime(),
+                                    target);
     } else {
         elapsed = getTempoTimestamp(*tempoIter) +
-            time2RealTime(t - (*tempoIter)->getAbsoluteTime(),
-                          tempoT((*tempoIter)->get<Int>(TempoProperty)));
+            TempoMap::time2RealTime(t - (*tempoIter)->getAbsoluteTime(),
+                                    tempoT((*tempoIter)->get<Int>(TempoProperty)));
     }
 
 #ifdef DEBUG_TEMPO_STUFF
@@ -1445,32 +1423,7 @@ Composition::getElapsedTimeForRealTime(RealTime t) const
 {
     calculateTempoTimestamps();
 
-    ReferenceSegment::iterator i = m_tempoSegment.findAtOrBefore(t);
-    if (i == m_tempoSegment.end()) {
-        i = m_tempoSegment.begin();
-        if (t >= RealTime::zero()  ||
-            (i == m_tempoSegment.end() || (*i)->getAbsoluteTime() > 0)) {
-            return realTime2Time(t, m_defaultTempo);
-        }
-    }
-
-    timeT elapsed;
-
-    tempoT target = -1;
-    timeT nextTempoTime = 0;
-    if (!getTempoTarget(i, target, nextTempoTime)) target = -1;
-
-    if (target > 0) {
-        elapsed = (*i)->getAbsoluteTime() +
-            realTime2Time(t - getTempoTimestamp(*i),
-                          (tempoT)((*i)->get<Int>(TempoProperty)),
-                          nextTempoTime - (*i)->getAbsoluteTime(),
-                          target);
-    } else {
-        elapsed = (*i)->getAbsoluteTime() +
-            realTime2Time(t - getTempoTimestamp(*i),
-                          (tempoT)((*i)->get<Int>(TempoProperty)));
-    }
+    timeT elapsed = m_tempoMap->getElapsedTimeForRealTime(t);
 
 #ifdef DEBUG_TEMPO_STUFF
     static int doError = true;
@@ -1481,9 +1434,7 @@ Composition::getElapsedTimeForRealTime(RealTime t) const
         doError = true;
         RG_DEBUG << "getElapsedTimeForRealTime(): " << t << " -> "
              << elapsed << " (error " << (cfReal - t)
-             << " or " << (cfTimeT - elapsed) << ", tempo "
-             << (*i)->getAbsoluteTime() << ":"
-             << (tempoT)((*i)->get<Int>(TempoProperty)) << ")";
+             << " or " << (cfTimeT - elapsed) << ")";
     }
 #endif
     return elapsed;
@@ -1499,7 +1450,7 @@ Composition::getElapsedTimeForRealTime(RealTime t) const
     // if the composition does not start at bar 1 we must add the
     // start time here
     timeT start = getStartMarker();
-    RealTime realStart = time2RealTime(start, m_defaultTempo);
+    RealTime realStart = TempoMap::time2RealTime(start, m_defaultTempo);
     t = t + realStart;
 
     ReferenceSegment::iterator i = m_tempoSegment.findAtOrBefore(t);
@@ -1507,7 +1458,7 @@ Composition::getElapsedTimeForRealTime(RealTime t) const
         i = m_tempoSegment.begin();
         if (t >= realStart ||
             (i == m_tempoSegment.end() || (*i)->getAbsoluteTime() > 0)) {
-            return realTime2Time(t, m_defaultTempo);
+            return TempoMap::realTime2Time(t, m_defaultTempo);
         }
     }
 
@@ -1519,14 +1470,14 @@ Composition::getElapsedTimeForRealTime(RealTime t) const
 
     if (target > 0) {
         elapsed = (*i)->getAbsoluteTime() +
-            realTime2Time(t - getTempoTimestamp(*i),
-                          (tempoT)((*i)->get<Int>(TempoProperty)),
-                          nextTempoTime - (*i)->getAbsoluteTime(),
-                          target);
+            TempoMap::realTime2Time(t - getTempoTimestamp(*i),
+                                    (tempoT)((*i)->get<Int>(TempoProperty)),
+                                    nextTempoTime - (*i)->getAbsoluteTime(),
+                                    target);
     } else {
         elapsed = (*i)->getAbsoluteTime() +
-            realTime2Time(t - getTempoTimestamp(*i),
-                          (tempoT)((*i)->get<Int>(TempoProperty)));
+            TempoMap::realTime2Time(t - getTempoTimestamp(*i),
+                                    (tempoT)((*i)->get<Int>(TempoProperty)));
     }
 
 #ifdef DEBUG_TEMPO_STUFF
@@ -1552,11 +1503,7 @@ Composition::calculateTempoTimestamps() const
 {
     if (!m_tempoTimestampsNeedCalculating) return;
 
-    timeT lastTimeT = 0;
-    RealTime lastRealTime;
-
-    tempoT tempo = m_defaultTempo;
-    tempoT target = -1;
+    QSharedPointer<TempoMap> tempoMap(new TempoMap(m_defaultTempo));
 
 #ifdef DEBUG_TEMPO_STUFF
     RG_DEBUG << "calculateTempoTimestamps(): Tempo events are:";
@@ -1565,209 +1512,31 @@ Composition::calculateTempoTimestamps() const
     for (ReferenceSegment::iterator i = m_tempoSegment.begin();
          i != m_tempoSegment.end(); ++i) {
 
-        RealTime myTime;
+        tempoT target = -1;
+        timeT targetTime = 0;
+        if (!getTempoTarget(i, target, targetTime)) target = -1;
 
-        if (target > 0) {
-            myTime = lastRealTime +
-                time2RealTime((*i)->getAbsoluteTime() - lastTimeT, tempo,
-                              (*i)->getAbsoluteTime() - lastTimeT, target);
-        } else {
-            myTime = lastRealTime +
-                time2RealTime((*i)->getAbsoluteTime() - lastTimeT, tempo);
-        }
+        tempoMap->addTempoChange((*i)->getAbsoluteTime(),
+                                 tempoT((*i)->get<Int>(TempoProperty)),
+                                 target, targetTime);
 
-        setTempoTimestamp(*i, myTime);
+        setTempoTimestamp(*i, tempoMap->getTempoChangeRealTime(
+                                  tempoMap->size() - 1));
 
 #ifdef DEBUG_TEMPO_STUFF
         RG_DEBUG << (*i);
 #endif
-
-        lastRealTime = myTime;
-        lastTimeT = (*i)->getAbsoluteTime();
-        tempo = tempoT((*i)->get<Int>(TempoProperty));
-
-        target = -1;
-        timeT nextTempoTime = 0;
-        if (!getTempoTarget(i, target, nextTempoTime)) target = -1;
     }
 
+    m_tempoMap = tempoMap;
     m_tempoTimestampsNeedCalculating = false;
 }
 
-#ifdef DEBUG_TEMPO_STUFF
-static int DEBUG_silence_recursive_tempo_printout = 0;
-#endif
-
-RealTime
-Composition::time2RealTime(timeT t, tempoT tempo)
-{
-    static timeT cdur = Note(Note::Crotchet).getDuration();
-
-    double dt = (double(t) * 100000 * 60) / (double(tempo) * cdur);
-
-    int sec = int(dt);
-    int nsec = int((dt - sec) * 1000000000);
-
-    RealTime rt(sec, nsec);
-
-#ifdef DEBUG_TEMPO_STUFF
-    if (!DEBUG_silence_recursive_tempo_printout) {
-        RG_DEBUG << "time2RealTime(): t " << t << ", sec " << sec << ", nsec "
-             << nsec << ", tempo " << tempo
-             << ", cdur " << cdur << ", dt " << dt << ", rt " << rt;
-        DEBUG_silence_recursive_tempo_printout = 1;
-        timeT ct = realTime2Time(rt, tempo);
-        timeT et = t - ct;
-        RealTime ert = time2RealTime(et, tempo);
-        RG_DEBUG << "cf. realTime2Time(" << rt << ") -> " << ct << " [err " << et << " (" << ert << "?)]";
-        DEBUG_silence_recursive_tempo_printout=0;
-    }
-#endif
-
-    return rt;
-}
-
-RealTime
-Composition::time2RealTime(timeT time, tempoT tempo,
-                           timeT targetTime, tempoT targetTempo)
-{
-    static timeT cdur = Note(Note::Crotchet).getDuration();
-
-    // The real time elapsed at musical time t, in seconds, during a
-    // smooth tempo change from "tempo" at musical time zero to
-    // "targetTempo" at musical time "targetTime", is
-    //
-    //           2
-    //     at + t (b - a)
-    //          ---------
-    //             2n
-    // where
-    //
-    // a is the initial tempo in seconds per tick
-    // b is the target tempo in seconds per tick
-    // n is targetTime in ticks
-
-    if (targetTime == 0 || targetTempo == tempo) {
-        return time2RealTime(time, targetTempo);
-    }
-
-    double a = (100000 * 60) / (double(tempo) * cdur);
-    double b = (100000 * 60) / (double(targetTempo) * cdur);
-    double t = time;
-    double n = targetTime;
-    double result = (a * t) + (t * t * (b - a)) / (2 * n);
-
-    int sec = int(result);
-    int nsec = int((result - sec) * 1000000000);
-
-    RealTime rt(sec, nsec);
-
-#ifdef DEBUG_TEMPO_STUFF
-    if (!DEBUG_silence_recursive_tempo_printout) {
-        RG_DEBUG << "time2RealTime(): [2] time " << time << ", tempo "
-             << tempo << ", targetTime " << targetTime << ", targetTempo "
-             << targetTempo << ": rt " << rt;
-        DEBUG_silence_recursive_tempo_printout = 1;
-//        RealTime nextRt = time2RealTime(targetTime, tempo, targetTime, targetTempo);
-        timeT ct = realTime2Time(rt, tempo, targetTime, targetTempo);
-        RG_DEBUG << "cf. realTime2Time: rt " << rt << " -> " << ct;
-        DEBUG_silence_recursive_tempo_printout=0;
-    }
-#endif
-
-    return rt;
-}
-
-timeT
-Composition::realTime2Time(RealTime rt, tempoT tempo)
-{
-    static timeT cdur = Note(Note::Crotchet).getDuration();
-
-    double tsec = (double(rt.sec) * cdur) * (tempo / (60.0 * 100000.0));
-    double tnsec = (double(rt.nsec) * cdur) * (tempo / 100000.0);
-
-    double dt = tsec + (tnsec / 60000000000.0);
-    timeT t = (timeT)(dt + (dt < 0 ? -1e-6 : 1e-6));
-
-#ifdef DEBUG_TEMPO_STUFF
-    if (!DEBUG_silence_recursive_tempo_printout) {
-        RG_DEBUG << "realTime2Time(): rt.sec " << rt.sec << ", rt.nsec "
-             << rt.nsec << ", tempo " << tempo
-             << ", cdur " << cdur << ", tsec " << tsec << ", tnsec " << tnsec << ", dt " << dt << ", t " << t;
-        DEBUG_silence_recursive_tempo_printout = 1;
-        RealTime crt = time2RealTime(t, tempo);
-        RealTime ert = rt - crt;
-        timeT et = realTime2Time(ert, tempo);
-        RG_DEBUG << "cf. time2RealTime(" << t << ") -> " << crt << " [err " << ert << " (" << et << "?)]";
-        DEBUG_silence_recursive_tempo_printout = 0;
-    }
-#endif
-
-    return t;
-}
-
-timeT
-Composition::realTime2Time(RealTime rt, tempoT tempo,
-                           timeT targetTime, tempoT targetTempo)
+QSharedPointer<const TempoMap>
+Composition::getTempoMap() const
 {
-    static timeT cdur = Note(Note::Crotchet).getDuration();
-
-    // Inverse of the expression in time2RealTime above.
-    //
-    // The musical time elapsed at real time t, in ticks, during a
-    // smooth tempo change from "tempo" at real time zero to
-    // "targetTempo" at real time "targetTime", is
-    //
-    //          2na (+/-) sqrt((2nb)^2 + 8(b-a)tn)
-    //       -  ----------------------------------
-    //                       2(b-a)
-    // where
-    //
-    // a is the initial tempo in seconds per tick
-    // b is the target tempo in seconds per tick
-    // n is target real time in ticks
-
-    if (targetTempo == tempo) return realTime2Time(rt, tempo);
-
-    double a = (100000 * 60) / (double(tempo) * cdur);
-    double b = (100000 * 60) / (double(targetTempo) * cdur);
-    double t = double(rt.sec) + double(rt.nsec) / 1e9;
-    double n = targetTime;
-
-    double term1 = 2.0 * n * a;
-    double term2 = (2.0 * n * a) * (2.0 * n * a) + 8 * (b - a) * t * n;
-
-    if (term2 < 0) {
-        // We're screwed, but at least let's not crash
-        RG_WARNING << "realTime2Time(): ERROR: term2 < 0 (it's " << term2 << ")";
-#ifdef DEBUG_TEMPO_STUFF
-        RG_DEBUG << "rt = " << rt << ", tempo = " << tempo << ", targetTime = " << targetTime << ", targetTempo = " << targetTempo;
-        RG_DEBUG << "n = " << n << ", b = " << b << ", a = " << a << ", t = " << t;
-        RG_DEBUG << "that's sqrt( (" << ((2.0*n*a*2.0*n*a)) << ") + "
-                  << (8*(b-a)*t*n) << " )";
-
-        RG_DEBUG << "so our original expression was " << rt << " = "
-                  << a << "t + (t^2 * (" << b << " - " << a << ")) / " << 2*n;
-#endif
-
-        return realTime2Time(rt, tempo);
-    }
-
-    double term3 = std::sqrt(term2);
-
-    // We only want the positive root
-    if (term3 > 0) term3 = -term3;
-
-    double result = - (term1 + term3) / (2 * (b - a));
-
-#ifdef DEBUG_TEMPO_STUFF
-    RG_DEBUG << "realTime2Time():";
-    RG_DEBUG << "n = " << n << ", b = " << b << ", a = " << a << ", t = " << t;
-    RG_DEBUG << "+/-sqrt(term2) = " << term3;
-    RG_DEBUG << "result = " << result;
-#endif
-
-    return long(result + 0.1);
+    calculateTempoTimestamps();
+    return m_tempoMap;
 }
 
 // @param A RealTime
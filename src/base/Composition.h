@@ -28,8 +28,10 @@
 #include "TriggerSegment.h"
 #include "TimeSignature.h"
 #include "Marker.h"
+#include "TempoMap.h"
 
 // Qt
+#include <QtCore/QSharedPointer>
 #include <QtCore/QWeakPointer>
 
 // System
@@ -38,13 +40,6 @@
 
 namespace Rosegarden
 {
-// We store tempo in quarter-notes per minute * 10^5 (hundred
-// thousandths of a quarter-note per minute).  This means the maximum
-// tempo in a 32-bit integer is about 21400 qpm.  We use a signed int
-// for compatibility with the Event integer type -- but note that we
-// use 0 (rather than -1) to indicate "tempo not set", by convention
-// (though see usage of target tempo in e.g. addTempoAtTime).
-typedef int tempoT;
 
 class Quantizer;
 class BasicQuantizer;
@@ -590,7 +585,10 @@ public:
      * Set a default tempo for the composition.  This will be
      * overridden by any tempo events encountered during playback.
      */
-    void setCompositionDefaultTempo(tempoT tempo) { m_defaultTempo = tempo; }
+    void setCompositionDefaultTempo(tempoT tempo) {
+        m_defaultTempo = tempo;
+        m_tempoTimestampsNeedCalculating = true;
+    }
     tempoT getCompositionDefaultTempo() const { return m_defaultTempo; }
 
     /**
@@ -688,6 +686,15 @@ public:
      */
     timeT getElapsedTimeForRealTime(RealTime t) const;
 
+    /**
+     * Return a snapshot of the tempo changes, for converting many
+     * times at once or for use away from the GUI thread.  It does not
+     * change after it has been returned; a new one is made the next
+     * time this is called after the tempos (or the default tempo, or
+     * the end marker) have changed.
+     */
+    QSharedPointer<const TempoMap> getTempoMap() const;
+
     /**
      * Return the number of microseconds elapsed between
      * the two given timeT indices into the composition, taking
@@ -934,7 +941,7 @@ public:
 
 protected:
 
-    static const std::string TempoEventType;
+    static const std::string &TempoEventType;
     static const PropertyName TempoProperty;
     static const PropertyName TargetTempoProperty;
 
@@ -1064,12 +1071,8 @@ protected:
     /// affects m_tempoSegment
     void calculateTempoTimestamps() const;
     mutable bool m_tempoTimestampsNeedCalculating;
-    static RealTime time2RealTime(timeT t, tempoT tempo);
-    static RealTime time2RealTime(timeT time, tempoT tempo,
-                                  timeT targetTime, tempoT targetTempo);
-    static timeT realTime2Time(RealTime rt, tempoT tempo);
-    static timeT realTime2Time(RealTime rt, tempoT tempo,
-                               timeT targetTime, tempoT targetTempo);
+    /// Rebuilt by calculateTempoTimestamps().
+    mutable QSharedPointer<const TempoMap> m_tempoMap;
     bool getTempoTarget(ReferenceSegment::const_iterator i,
                         tempoT &target,
                         timeT &targetTime) const;
@@ -32,15 +32,9 @@ namespace Rosegarden
 {
 
 Configuration::Configuration(const Configuration &conf) :
-    PropertyMap(),
+    PropertyMap(conf),
     XmlExportable()
 {
-    clear();
-
-    // Copy everything
-    //
-    for (const_iterator i = conf.begin(); i != conf.end(); ++i)
-        insert(PropertyPair(i->first, i->second->clone()));
 }
 
 Configuration::~Configuration()
@@ -94,12 +88,7 @@ Configuration::toXmlString() const
 Configuration&
 Configuration::operator=(const Configuration &conf)
 {
-    clear();
-
-    // Copy everything
-    //
-    for (const_iterator i = conf.begin(); i != conf.end(); ++i)
-        insert(PropertyPair(i->first, i->second->clone()));
+    PropertyMap::operator=(conf);
 
     return (*this);
 }
@@ -160,10 +149,8 @@ DocumentConfiguration::DocumentConfiguration()
 }
     
 DocumentConfiguration::DocumentConfiguration(const DocumentConfiguration &conf):
-    Configuration()
+    Configuration(conf)
 {
-    for (const_iterator i = conf.begin(); i != conf.end(); ++i)
-        insert(PropertyPair(i->first, i->second->clone()));
 }
 
 DocumentConfiguration::~DocumentConfiguration()
@@ -175,10 +162,7 @@ DocumentConfiguration::~DocumentConfiguration()
 DocumentConfiguration&
 DocumentConfiguration::operator=(const DocumentConfiguration &conf)
 {
-    clear();
-
-    for (const_iterator i = conf.begin(); i != conf.end(); ++i)
-        insert(PropertyPair(i->first, i->second->clone()));
+    Configuration::operator=(conf);
 
     return *this;
 }
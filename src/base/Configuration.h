@@ -151,13 +151,11 @@ Configuration::set(const PropertyName &name,
 
         // A property with the same name has
         // already been set - recycle it, just change the data
-        PropertyStoreBase *sb = i->second;
-        (static_cast<PropertyStore<P> *>(sb))->setData(value);
+        i->second.setData<P>(value);
 
     } else {
 
-        PropertyStoreBase *p = new PropertyStore<P>(value);
-        insert(PropertyPair(name, p));
+        insert(PropertyPair(name, PropertyValue::create<P>(value)));
 
     }
 
@@ -173,12 +171,12 @@ Configuration::get(const PropertyName &name,
 
     if (i == end()) return defaultVal;
 
-    PropertyStoreBase *sb = i->second;
-    if (sb->getType() == P) {
-        return (static_cast<PropertyStore<P> *>(sb))->getData();
+    const PropertyValue &value = i->second;
+    if (value.getType() == P) {
+        return value.getData<P>();
     } else {
         throw BadType(name.getName(),
-                      PropertyDefn<P>::typeName(), sb->getTypeName(),
+                      PropertyDefn<P>::typeName(), value.getTypeName(),
                       __FILE__, __LINE__);
     }
 }
@@ -192,12 +190,12 @@ Configuration::get(const PropertyName &name) const
 
     if (i == end()) throw NoData(name.getName(), __FILE__, __LINE__);
 
-    PropertyStoreBase *sb = i->second;
-    if (sb->getType() == P) {
-        return (static_cast<PropertyStore<P> *>(sb))->getData();
+    const PropertyValue &value = i->second;
+    if (value.getType() == P) {
+        return value.getData<P>();
     } else {
         throw BadType(name.getName(),
-                      PropertyDefn<P>::typeName(), sb->getTypeName(),
+                      PropertyDefn<P>::typeName(), value.getTypeName(),
                       __FILE__, __LINE__);
     }
 }
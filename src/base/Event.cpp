@@ -20,9 +20,13 @@
 #include "XmlExportable.h"
 #include "NotationTypes.h"
 #include "BaseProperties.h"
+#include "FixedSizePool.h"
 #include "misc/Debug.h"
 
+#include <mutex>
+#include <new>
 #include <sstream>
+#include <unordered_map>
 
 namespace Rosegarden
 {
@@ -32,11 +36,66 @@ using std::ostream;
 PropertyName Event::EventData::NotationTime("!notationtime");
 PropertyName Event::EventData::NotationDuration("!notationduration");
 
+alignas(std::string)
+char Event::EventData::TypeStorage[MaxTypes * sizeof(std::string)];
+
+namespace
+{
+    // Interned Event types, by name.  The first MaxTypes are made in
+    // EventData::TypeStorage, any after that on the heap.  They are
+    // never moved or deleted.
+    typedef std::unordered_map<std::string, const std::string *> TypeMap;
+    // Pointer for create on first use to avoid static init order fiasco.
+    // Note: This is a deliberate memory leak since we cannot be sure
+    //       who might access this as we are going down.
+    TypeMap *a_typeMap = nullptr;
+    size_t a_typeCount = 0;
+
+    // Events are created on more than one thread (e.g. file import).
+    // std::mutex is constant-initialised, so this is ready for the
+    // type constants, which are interned during static init.
+    std::mutex a_typeMutex;
+}
+
+const std::string &
+Event::internType(const std::string &type)
+{
+    std::lock_guard<std::mutex> lock(a_typeMutex);
+
+    if (!a_typeMap)
+        a_typeMap = new TypeMap;
+
+    TypeMap::const_iterator i = a_typeMap->find(type);
+    if (i != a_typeMap->end())
+        return *i->second;
+
+    const std::string *interned;
+    if (a_typeCount < EventData::MaxTypes) {
+        std::string *storage =
+                reinterpret_cast<std::string *>(EventData::TypeStorage);
+        interned = new (storage + a_typeCount) std::string(type);
+        ++a_typeCount;
+    } else {
+        interned = new std::string(type);
+    }
+
+    a_typeMap->insert(TypeMap::value_type(type, interned));
+    return *interned;
+}
+
+const std::string &
+Event::EventData::EmptyType()
+{
+    // Create on first use to avoid static init order fiasco.
+    static const std::string &empty = internType("");
+    return empty;
+}
+
 
 Event::EventData::EventData(const std::string &type, timeT absoluteTime,
                             timeT duration, short subOrdering) :
     m_refCount(1),
-    m_type(type),
+    m_type(getInterned(type)),
     m_absoluteTime(absoluteTime),
     m_duration(duration),
     m_subOrdering(subOrdering),
@@ -45,7 +104,7 @@ Event::EventData::EventData(const std::string &type, timeT absoluteTime,
     // empty
 }
 
-Event::EventData::EventData(const std::string &type, timeT absoluteTime,
+Event::EventData::EventData(const std::string *type, timeT absoluteTime,
                             timeT duration, short subOrdering,
                             const PropertyMap *properties) :
     m_refCount(1),
@@ -60,11 +119,14 @@ Event::EventData::EventData(const std::string &type, timeT absoluteTime,
 
 Event::EventData *Event::EventData::unshare()
 {
-    --m_refCount;
-
     EventData *newData = new EventData
         (m_type, m_absoluteTime, m_duration, m_subOrdering, m_properties);
 
+    // Only let go once the copy is made, in case the other owners are
+    // doing the same on other threads.
+    if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+
     return newData;
 }
 
@@ -76,13 +138,58 @@ Event::EventData::~EventData()
     }
 }
 
+namespace
+{
+    FixedSizePool &a_poolFor(size_t size)
+    {
+        // Cache the common cases.
+        static FixedSizePool &eventPool =
+                FixedSizePool::get(sizeof(Event));
+        static FixedSizePool &eventDataPool =
+                FixedSizePool::get(Event::getEventDataSize());
+
+        if (size == sizeof(Event))
+            return eventPool;
+        if (size == Event::getEventDataSize())
+            return eventDataPool;
+
+        // Subclasses that add members get their own pool, which is fine
+        // as long as they are deleted through their own type.
+        return FixedSizePool::get(size);
+    }
+}
+
+void *
+Event::EventData::operator new(size_t size)
+{
+    return a_poolFor(size).allocate();
+}
+
+void
+Event::EventData::operator delete(void *p, size_t size)
+{
+    a_poolFor(size).deallocate(p);
+}
+
+void *
+Event::operator new(size_t size)
+{
+    return a_poolFor(size).allocate();
+}
+
+void
+Event::operator delete(void *p, size_t size)
+{
+    a_poolFor(size).deallocate(p);
+}
+
 timeT
 Event::EventData::getNotationTime() const
 {
     if (!m_properties) return m_absoluteTime;
     PropertyMap::const_iterator i = m_properties->find(NotationTime);
     if (i == m_properties->end()) return m_absoluteTime;
-    else return static_cast<PropertyStore<Int> *>(i->second)->getData();
+    else return i->second.getData<Int>();
 }
 
 timeT
@@ -91,7 +198,7 @@ Event::EventData::getNotationDuration() const
     if (!m_properties) return m_duration;
     PropertyMap::const_iterator i = m_properties->find(NotationDuration);
     if (i == m_properties->end()) return m_duration;
-    else return static_cast<PropertyStore<Int> *>(i->second)->getData();
+    else return i->second.getData<Int>();
 }
 
 timeT
@@ -111,12 +218,12 @@ Event::EventData::setTime(const PropertyName &name, timeT t, timeT deft)
 
     if (t != deft) {
         if (i == m_properties->end()) {
-            m_properties->insert(PropertyPair(name, new PropertyStore<Int>(t)));
+            m_properties->insert(
+                    PropertyPair(name, PropertyValue::create<Int>(t)));
         } else {
-            static_cast<PropertyStore<Int> *>(i->second)->setData(t);
+            i->second.setData<Int>(t);
         }
     } else if (i != m_properties->end()) {
-        delete i->second;
         m_properties->erase(i);
     }
 }
@@ -162,7 +269,6 @@ Event::unset(const PropertyName &name)
     PropertyMap::iterator i;
     PropertyMap *map = find(name, i);
     if (map) {
-        delete i->second;
         map->erase(i);
     }
 }
@@ -175,7 +281,7 @@ Event::getPropertyType(const PropertyName &name) const
     PropertyMap::const_iterator i;
     const PropertyMap *map = find(name, i);
     if (map) {
-        return i->second->getType();
+        return i->second.getType();
     } else {
         throw NoData(name.getName(), __FILE__, __LINE__);
     }
@@ -189,7 +295,7 @@ Event::getPropertyTypeAsString(const PropertyName &name) const
     PropertyMap::const_iterator i;
     const PropertyMap *map = find(name, i);
     if (map) {
-        return i->second->getTypeName();
+        return i->second.getTypeName();
     } else {
         throw NoData(name.getName(), __FILE__, __LINE__);
     }
@@ -203,7 +309,7 @@ Event::getAsString(const PropertyName &name) const
     PropertyMap::const_iterator i;
     const PropertyMap *map = find(name, i);
     if (map) {
-        return i->second->unparse();
+        return i->second.unparse();
     } else {
         throw NoData(name.getName(), __FILE__, __LINE__);
     }
@@ -387,19 +493,19 @@ Event::unsafeChangeTime(timeT offset)
 size_t
 Event::getStorageSize() const
 {
-    size_t s = sizeof(Event) + sizeof(EventData) + m_data->m_type.size();
+    size_t s = sizeof(Event) + sizeof(EventData);
     if (m_data->m_properties) {
         for (PropertyMap::const_iterator i = m_data->m_properties->begin();
              i != m_data->m_properties->end(); ++i) {
             s += sizeof(i->first);
-            s += i->second->getStorageSize();
+            s += i->second.getStorageSize();
         }
     }
     if (m_nonPersistentProperties) {
         for (PropertyMap::const_iterator i = m_nonPersistentProperties->begin();
              i != m_nonPersistentProperties->end(); ++i) {
             s += sizeof(i->first);
-            s += i->second->getStorageSize();
+            s += i->second.getStorageSize();
         }
     }
     return s;
@@ -417,6 +523,31 @@ Event::isCopyOf(const Event &e) const
     return false;
 }
 
+bool
+Event::isEquivalentTo(const Event &e) const
+{
+    if (isCopyOf(e))
+        return true;
+
+    const EventData &a = *m_data;
+    const EventData &b = *e.m_data;
+
+    // Types are interned, so comparing pointers will do.
+    if (a.m_type != b.m_type  ||
+        a.m_absoluteTime != b.m_absoluteTime  ||
+        a.m_duration != b.m_duration  ||
+        a.m_subOrdering != b.m_subOrdering)
+        return false;
+
+    // Notation time and duration are among the properties.
+    const bool aEmpty = !a.m_properties  ||  a.m_properties->empty();
+    const bool bEmpty = !b.m_properties  ||  b.m_properties->empty();
+    if (aEmpty  ||  bEmpty)
+        return aEmpty  &&  bEmpty;
+
+    return *a.m_properties == *b.m_properties;
+}
+
 bool
 // cppcheck-suppress unusedFunction
 operator<(const Event &a, const Event &b)
@@ -430,7 +561,7 @@ operator<(const Event &a, const Event &b)
 // cppcheck-suppress unusedFunction
 QDebug operator<<(QDebug dbg, const Event &event)
 {
-    dbg << "Event type :" << event.m_data->m_type << "\n";
+    dbg << "Event type :" << *event.m_data->m_type << "\n";
     dbg << "  Absolute Time :" << event.m_data->m_absoluteTime << "\n";
     dbg << "  Duration :" << event.m_data->m_duration << "\n";
     dbg << "  Sub-ordering :" << event.m_data->m_subOrdering << "\n";
@@ -440,7 +571,7 @@ QDebug operator<<(QDebug dbg, const Event &event)
         for (const PropertyMap::value_type &property :
                  *(event.m_data->m_properties)) {
             dbg << "    " << property.first.getName() << "[" <<
-                   property.first.getId() << "] :" << *(property.second) <<
+                   property.first.getId() << "] :" << property.second <<
                    "\n";
         }
     }
@@ -450,7 +581,7 @@ QDebug operator<<(QDebug dbg, const Event &event)
         for (const PropertyMap::value_type &property :
                  *(event.m_nonPersistentProperties)) {
             dbg << "    " << property.first.getName() << "[" <<
-                   property.first.getId() << "] :" << *(property.second) <<
+                   property.first.getId() << "] :" << property.second <<
                    "\n";
         }
     }
@@ -24,6 +24,8 @@
 
 #include <rosegardenprivate_export.h>
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -182,6 +184,15 @@ public:
 
     ~Event()  { lose(); }
 
+    // *** Allocation
+
+    /// Events are allocated from a FixedSizePool.
+    static void *operator new(size_t size);
+    static void operator delete(void *p, size_t size);
+
+    /// For the allocator.  EventData is private.
+    static size_t getEventDataSize()  { return sizeof(EventData); }
+
     Event(const Event &e) :
         m_nonPersistentProperties(nullptr)
     {
@@ -212,23 +223,64 @@ public:
     // check if the events are copies
     bool isCopyOf(const Event &e) const;
 
+    /// Same type, times, sub-ordering and persistent properties as e.
+    /**
+     * Unlike isCopyOf(), this looks at the contents, so it is true for
+     * an Event built independently with the same values.
+     * Non-persistent properties are ignored.
+     */
+    bool isEquivalentTo(const Event &e) const;
+
     friend bool operator<(const Event&, const Event&);
 
     /// Type of the Event (E.g. Note, Accidental, Key, etc...)
     /**
      * See NotationTypes.h and MidiTypes.h for more examples.
+     *
+     * The returned reference is to the interned copy of the type string
+     * and remains valid for the lifetime of the program.
      */
-    std::string getType() const
+    const std::string &getType() const
     {
         if (!m_data) {
             // cppcheck-suppress ConfigurationNotChecked
             RG_DEBUG << "Event::getType(): FATAL: m_data == nullptr.  Crash likely.";
-            return "";
+            return EventData::EmptyType();
         }
-        return m_data->m_type;
+        return *m_data->m_type;
     }
     /// Check Event type.
-    bool isa(const std::string &type) const  { return (m_data->m_type == type); }
+    /**
+     * Types are interned, so when passed an interned type (the type
+     * constants such as Note::EventType, or anything from getType() or
+     * internType()) this is a pointer compare, or three on a mismatch.
+     * Only for other strings do we fall back on a string compare.
+     */
+    bool isa(const std::string &type) const
+    {
+        if (m_data->m_type == &type)
+            return true;
+        // Each type is interned once, so two interned types that
+        // aren't the same string aren't equal.
+        if (EventData::isInterned(&type))
+            return false;
+        return *m_data->m_type == type;
+    }
+
+    /// Get the shared copy of a type string.
+    /**
+     * Much like PropertyName, each distinct type string is stored once
+     * for the lifetime of the program and every Event of that type
+     * points to it.  This saves a std::string per event, makes copying
+     * a type free, and lets isa() compare pointers.
+     *
+     * This takes a lock, so make constants of the result (as
+     * Note::EventType and the rest are) rather than interning for every
+     * Event.  An Event constructed from an interned type doesn't
+     * intern it again.  Thread-safe, and safe to use during static
+     * initialisation.
+     */
+    static const std::string &internType(const std::string &type);
 
     timeT getAbsoluteTime() const  { return m_data->m_absoluteTime; }
     timeT getNotationAbsoluteTime() const  { return m_data->getNotationTime(); }
@@ -388,7 +440,8 @@ protected:
         m_nonPersistentProperties(nullptr)
     { }
 
-    void setType(const std::string &t) { unshare(); m_data->m_type = t; }
+    void setType(const std::string &t)
+            { unshare(); m_data->m_type = EventData::getInterned(t); }
     void setAbsoluteTime(timeT t)      { unshare(); m_data->m_absoluteTime = t; }
     void setDuration(timeT d)          { unshare(); m_data->m_duration = d; }
     void setSubOrdering(short o)       { unshare(); m_data->m_subOrdering = o; }
@@ -403,15 +456,27 @@ private:
     {
         EventData(const std::string &type,
                   timeT absoluteTime, timeT duration, short subOrdering);
-        EventData(const std::string &type,
+        /// Used by unshare().  type must already be interned.
+        EventData(const std::string *type,
                   timeT absoluteTime, timeT duration, short subOrdering,
                   const PropertyMap *properties);
-        /// Make a unique copy.  Used for Copy On Write.
+        /// Make a unique copy and let go of this one.  Used for Copy
+        /// On Write.
+        /**
+         * Deletes this if every other owner let go while we copied.
+         */
         EventData *unshare();
         ~EventData();
-        unsigned int m_refCount;
 
-        std::string m_type;
+        static void *operator new(size_t size);
+        static void operator delete(void *p, size_t size);
+
+        /// Atomic, since copies of one event may be in segments that
+        /// are laid out on different threads (see NotationScene).
+        std::atomic<unsigned int> m_refCount;
+
+        /// Interned type string.  See internType().
+        const std::string *m_type;
         timeT m_absoluteTime;
         timeT m_duration;
         short m_subOrdering;
@@ -428,6 +493,35 @@ private:
             { setTime(NotationDuration, d, m_duration); }
         timeT getNotationDuration() const;
 
+        /// Whether type is one of the first MaxTypes interned types.
+        /**
+         * Those live in TypeStorage, so this can tell by the address
+         * alone, without taking internType()'s lock.  Types interned
+         * after those are only found by internType().
+         */
+        static bool isInterned(const std::string *type)
+        {
+            const std::string *first =
+                    reinterpret_cast<const std::string *>(TypeStorage);
+            return !std::less<const std::string *>()(type, first)  &&
+                   std::less<const std::string *>()(type, first + MaxTypes);
+        }
+
+        /// type, if interned, or else internType(type).
+        static const std::string *getInterned(const std::string &type)
+        {
+            return isInterned(&type) ? &type : &internType(type);
+        }
+
+        static const std::string &EmptyType();
+
+        /// Room for more types than the application has.
+        static const size_t MaxTypes = 256;
+        /// The first MaxTypes interned types.  Raw storage, so that it
+        /// is ready (zeroed) before any static constructor runs.
+        alignas(std::string)
+        static char TypeStorage[MaxTypes * sizeof(std::string)];
+
     private:
         EventData(const EventData &);
         EventData &operator=(const EventData &);
@@ -452,7 +546,7 @@ private:
     void share(const Event &e)
     {
         m_data = e.m_data;
-        m_data->m_refCount++;
+        m_data->m_refCount.fetch_add(1, std::memory_order_relaxed);
     }
 
     /// Makes a copy.  Used for Copy On Write.
@@ -461,7 +555,7 @@ private:
      */
     bool unshare()
     {
-        if (m_data->m_refCount > 1) {
+        if (m_data->m_refCount.load(std::memory_order_acquire) > 1) {
             m_data = m_data->unshare();
             return true;
         } else {
@@ -472,7 +566,7 @@ private:
     /// Dereference and delete.
     void lose()
     {
-        if (--m_data->m_refCount == 0) {
+        if (m_data->m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
             delete m_data;
             m_data = nullptr;
         }
@@ -548,14 +642,14 @@ Event::get(const PropertyName &name,
     if (!map)
         return false;
 
-    PropertyStoreBase *sb = i->second;
-    if (sb->getType() == P) {
-        val = (static_cast<PropertyStore<P> *>(sb))->getData();
+    const PropertyValue &value = i->second;
+    if (value.getType() == P) {
+        val = value.getData<P>();
         return true;
     } else {
 #ifndef NDEBUG
         // cppcheck-suppress ConfigurationNotChecked
-        RG_DEBUG << "get() Error: Attempt to get property \"" << name.getName() << "\" as" << PropertyDefn<P>::typeName() <<", actual type is" << sb->getTypeName();
+        RG_DEBUG << "get() Error: Attempt to get property \"" << name.getName() << "\" as" << PropertyDefn<P>::typeName() <<", actual type is" << value.getTypeName();
 #endif
         return false;
     }
@@ -575,12 +669,12 @@ Event::get(const PropertyName &name) const
 
     if (map) {
 
-        PropertyStoreBase *sb = i->second;
-        if (sb->getType() == P)
-            return (static_cast<PropertyStore<P> *>(sb))->getData();
+        const PropertyValue &value = i->second;
+        if (value.getType() == P)
+            return value.getData<P>();
         else {
             throw BadType(name.getName(),
-                          PropertyDefn<P>::typeName(), sb->getTypeName(),
+                          PropertyDefn<P>::typeName(), value.getTypeName(),
                           __FILE__, __LINE__);
         }
 
@@ -634,22 +728,26 @@ Event::set(const PropertyName &name, typename PropertyDefn<P>::basic_type value,
     if (map) {
         bool persistentBefore = (map == m_data->m_properties);
         if (persistentBefore != persistent) {
-            i = insert(*i, persistent);
-            map->erase(name);
+            // Moving to the other map.  The insertion can't disturb i
+            // since it is in a different map.
+            PropertyMap::iterator j = insert(*i, persistent);
+            map->erase(i);
+            i = j;
         }
 
-        PropertyStoreBase *sb = i->second;
-        if (sb->getType() == P) {
-            (static_cast<PropertyStore<P> *>(sb))->setData(value);
+        PropertyValue &storedValue = i->second;
+        if (storedValue.getType() == P) {
+            storedValue.setData<P>(value);
         } else {
             throw BadType(name.getName(),
-                          PropertyDefn<P>::typeName(), sb->getTypeName(),
+                          PropertyDefn<P>::typeName(),
+                          storedValue.getTypeName(),
                           __FILE__, __LINE__);
         }
 
     } else {  // Create
-        PropertyStoreBase *p = new PropertyStore<P>(value);
-        insert(PropertyPair(name, p), persistent);
+        insert(PropertyPair(name, PropertyValue::create<P>(value)),
+               persistent);
     }
 }
 
@@ -679,18 +777,18 @@ Event::setMaybe(const PropertyName &name, typename PropertyDefn<P>::basic_type v
         if (map == m_data->m_properties)
             return;
 
-        PropertyStoreBase *sb = i->second;
+        PropertyValue &storedValue = i->second;
 
-        if (sb->getType() == P) {
-            (static_cast<PropertyStore<P> *>(sb))->setData(value);
+        if (storedValue.getType() == P) {
+            storedValue.setData<P>(value);
         } else {
             throw BadType(name.getName(),
-                          PropertyDefn<P>::typeName(), sb->getTypeName(),
+                          PropertyDefn<P>::typeName(),
+                          storedValue.getTypeName(),
                           __FILE__, __LINE__);
         }
     } else {  // Create
-        PropertyStoreBase *p = new PropertyStore<P>(value);
-        insert(PropertyPair(name, p),
+        insert(PropertyPair(name, PropertyValue::create<P>(value)),
                false);  // persistent
     }
 }
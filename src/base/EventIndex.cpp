@@ -0,0 +1,148 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EventIndex.h"
+
+#include <stdint.h>
+
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+    const size_t minCapacity = 16;
+}
+
+EventIndex::EventIndex() :
+    m_size(0),
+    m_shift(64)
+{
+}
+
+size_t
+EventIndex::home(const Event *e) const
+{
+    // Fibonacci hashing: the multiply mixes the low bits, which are
+    // always zero for aligned pointers, into the high ones we keep.
+    return size_t((uint64_t(uintptr_t(e)) * 0x9E3779B97F4A7C15ull) >> m_shift);
+}
+
+size_t
+EventIndex::find(const Event *e) const
+{
+    const size_t mask = m_slots.size() - 1;
+    size_t i = home(e);
+    while (m_slots[i] && m_slots[i] != e) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+bool
+EventIndex::insert(const Event *e)
+{
+    if ((m_size + 1) * 2 > m_slots.size())
+        reserve(m_size + 1);
+
+    const size_t i = find(e);
+    if (m_slots[i])
+        return false;
+
+    m_slots[i] = e;
+    ++m_size;
+    return true;
+}
+
+bool
+EventIndex::erase(const Event *e)
+{
+    if (m_size == 0)
+        return false;
+
+    size_t i = find(e);
+    if (!m_slots[i])
+        return false;
+
+    // Close the gap: move back any later entry in this run whose home
+    // slot is not between the gap and where it is now.
+    const size_t mask = m_slots.size() - 1;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!m_slots[j])
+            break;
+        const size_t k = home(m_slots[j]);
+        const bool stays = (i < j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (!stays) {
+            m_slots[i] = m_slots[j];
+            i = j;
+        }
+    }
+
+    m_slots[i] = nullptr;
+    --m_size;
+    return true;
+}
+
+bool
+EventIndex::contains(const Event *e) const
+{
+    if (m_size == 0)
+        return false;
+    return m_slots[find(e)] == e;
+}
+
+void
+EventIndex::clear()
+{
+    m_slots.clear();
+    m_size = 0;
+    m_shift = 64;
+}
+
+void
+EventIndex::reserve(size_t n)
+{
+    size_t capacity = m_slots.empty() ? minCapacity : m_slots.size();
+    while (capacity < n * 2) {
+        capacity *= 2;
+    }
+    if (capacity != m_slots.size())
+        rehash(capacity);
+}
+
+void
+EventIndex::rehash(size_t capacity)
+{
+    std::vector<const Event *> old(capacity, nullptr);
+    old.swap(m_slots);
+
+    m_shift = 64;
+    for (size_t c = capacity; c > 1; c /= 2) {
+        --m_shift;
+    }
+
+    for (const Event *e : old) {
+        if (e)
+            m_slots[find(e)] = e;
+    }
+}
+
+
+}
@@ -0,0 +1,84 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_EVENTINDEX_H
+#define RG_EVENTINDEX_H
+
+#include <rosegardenprivate_export.h>
+
+#include <stddef.h>
+#include <vector>
+
+namespace Rosegarden
+{
+
+
+class Event;
+
+/// A set of Event pointers, for quick membership tests.
+/**
+ * An open-addressed hash table with linear probing.  Unlike an
+ * EventContainer, which is ordered by time and so has to compare
+ * Events to find one, this only looks at the pointer, so insert(),
+ * erase() and contains() take constant time however many Events
+ * there are.  It has no order, so it is kept alongside an ordered
+ * container rather than in place of one (see EventSelection).
+ *
+ * The table is at most half full, and erase() moves later entries
+ * back into the gap instead of leaving a marker, so lookups never
+ * have to walk far.
+ */
+class ROSEGARDENPRIVATE_EXPORT EventIndex
+{
+public:
+    EventIndex();
+
+    /// Returns false if the Event was already there.
+    bool insert(const Event *e);
+
+    /// Returns false if the Event wasn't there.
+    bool erase(const Event *e);
+
+    bool contains(const Event *e) const;
+
+    size_t size() const  { return m_size; }
+    bool empty() const  { return m_size == 0; }
+
+    void clear();
+
+    /// Make room for n Events without growing again.
+    void reserve(size_t n);
+
+private:
+    /// Slot at which the search for e starts.
+    size_t home(const Event *e) const;
+
+    /// Slot holding e, or the empty slot where it would go.
+    size_t find(const Event *e) const;
+
+    void rehash(size_t capacity);
+
+    std::vector<const Event *> m_slots;
+    size_t m_size;
+    /// 64 less log2 of the number of slots.
+    int m_shift;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,186 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "FixedSizePool.h"
+
+#include <cstdlib>
+
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+    // Blocks per slab.  At the sizes we deal with (tens of bytes) this
+    // gives slabs of a few tens of KB.
+    const size_t a_blocksPerSlab = 1024;
+
+    // Blocks are aligned to at least this.  Enough for the pointers and
+    // integers that make up Event, EventData and container nodes.
+    const size_t a_alignment = sizeof(void *);
+
+    size_t a_roundUp(size_t blockSize)
+    {
+        if (blockSize < sizeof(void *))
+            blockSize = sizeof(void *);
+        return (blockSize + a_alignment - 1) / a_alignment * a_alignment;
+    }
+
+    // All pools, for get() and dumpStats().
+    // Note: This is a deliberate memory leak since we cannot be sure
+    //       who might access this as we are going down.
+    std::vector<FixedSizePool *> *a_pools = nullptr;
+    QMutex a_poolsMutex;
+}
+
+
+FixedSizePool &
+FixedSizePool::get(size_t blockSize)
+{
+    blockSize = a_roundUp(blockSize);
+
+    QMutexLocker locker(&a_poolsMutex);
+
+    if (!a_pools)
+        a_pools = new std::vector<FixedSizePool *>;
+
+    for (FixedSizePool *pool : *a_pools) {
+        if (pool->m_blockSize == blockSize)
+            return *pool;
+    }
+
+    FixedSizePool *pool = new FixedSizePool(blockSize);
+    a_pools->push_back(pool);
+    return *pool;
+}
+
+FixedSizePool::FixedSizePool(size_t blockSize) :
+    m_blockSize(blockSize),
+    m_freeList(nullptr)
+{
+}
+
+FixedSizePool::~FixedSizePool()
+{
+    for (char *slab : m_slabs) {
+        ::operator delete(slab);
+    }
+}
+
+bool
+FixedSizePool::isEnabled()
+{
+    static const bool enabled = (getenv("ROSEGARDEN_NO_POOL") == nullptr);
+    return enabled;
+}
+
+void *
+FixedSizePool::allocate()
+{
+    if (!isEnabled()) {
+        {
+            QMutexLocker locker(&m_mutex);
+            ++m_stats.allocations;
+        }
+        return ::operator new(m_blockSize);
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_freeList)
+        addSlab();
+
+    FreeBlock *block = m_freeList;
+    m_freeList = block->next;
+
+    ++m_stats.allocations;
+
+    return block;
+}
+
+void
+FixedSizePool::deallocate(void *block)
+{
+    if (!block)
+        return;
+
+    if (!isEnabled()) {
+        {
+            QMutexLocker locker(&m_mutex);
+            ++m_stats.deallocations;
+        }
+        ::operator delete(block);
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    FreeBlock *freeBlock = static_cast<FreeBlock *>(block);
+    freeBlock->next = m_freeList;
+    m_freeList = freeBlock;
+
+    ++m_stats.deallocations;
+}
+
+void
+FixedSizePool::addSlab()
+{
+    char *slab = static_cast<char *>(
+            ::operator new(m_blockSize * a_blocksPerSlab));
+    m_slabs.push_back(slab);
+    ++m_stats.slabs;
+
+    // Thread the blocks onto the free list in address order so that
+    // consecutive allocations are adjacent in memory.
+    for (size_t i = a_blocksPerSlab; i > 0; --i) {
+        FreeBlock *block =
+                reinterpret_cast<FreeBlock *>(slab + (i - 1) * m_blockSize);
+        block->next = m_freeList;
+        m_freeList = block;
+    }
+}
+
+FixedSizePool::Stats
+FixedSizePool::getStats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+void
+FixedSizePool::dumpStats(std::ostream &out)
+{
+    QMutexLocker locker(&a_poolsMutex);
+
+    out << "FixedSizePool stats (" <<
+           (isEnabled() ? "pooled" : "ROSEGARDEN_NO_POOL") << "):" <<
+           std::endl;
+
+    if (!a_pools)
+        return;
+
+    for (const FixedSizePool *pool : *a_pools) {
+        const Stats stats = pool->getStats();
+        out << "  " << pool->m_blockSize << "-byte blocks: " <<
+               stats.allocations << " allocations, " <<
+               stats.deallocations << " deallocations, " <<
+               stats.live() << " live, " <<
+               stats.slabs << " slabs" << std::endl;
+    }
+}
+
+
+}
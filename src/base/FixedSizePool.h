@@ -0,0 +1,174 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_FIXED_SIZE_POOL_H
+#define RG_FIXED_SIZE_POOL_H
+
+#include <QMutex>
+
+#include <rosegardenprivate_export.h>
+
+#include <cstddef>
+#include <iostream>
+#include <new>
+#include <vector>
+
+namespace Rosegarden
+{
+
+
+/// Slab allocator for many small objects of one size.
+/**
+ * Event, EventData and the nodes of the EventContainer multiset that
+ * underlies Segment are allocated in very large numbers when loading
+ * or pasting.  This pool carves them out of large slabs and recycles
+ * freed blocks through a free list, so the global allocator is only
+ * called once per slab.
+ *
+ * Slabs are kept until the program exits.  Freed blocks are reused by
+ * the next allocation of the same size, so memory released when a
+ * Segment is destroyed goes straight back into the pool.
+ *
+ * Setting the environment variable ROSEGARDEN_NO_POOL before startup
+ * makes every pool pass straight through to ::operator new.  This is
+ * for comparing against the global allocator (see test/eventpool.cpp).
+ *
+ * Thread-safe.
+ */
+class ROSEGARDENPRIVATE_EXPORT FixedSizePool
+{
+public:
+    /// Get the pool for blocks of the given size, creating it if needed.
+    /**
+     * Objects of the same size share a pool.  Pools are deliberately
+     * leaked since objects may still be freed while we are going down.
+     */
+    static FixedSizePool &get(size_t blockSize);
+
+    void *allocate();
+    void deallocate(void *block);
+
+    struct Stats
+    {
+        Stats() :
+            allocations(0),
+            deallocations(0),
+            slabs(0)
+        { }
+
+        /// Total calls to allocate().
+        size_t allocations;
+        /// Total calls to deallocate().
+        size_t deallocations;
+        /// Number of slabs obtained from the global allocator.
+        size_t slabs;
+
+        size_t live() const  { return allocations - deallocations; }
+    };
+
+    Stats getStats() const;
+    size_t getBlockSize() const  { return m_blockSize; }
+
+    /// Whether pooling is in effect (see ROSEGARDEN_NO_POOL).
+    static bool isEnabled();
+
+    /// Write the Stats for every pool that has been created.
+    static void dumpStats(std::ostream &out);
+
+private:
+    explicit FixedSizePool(size_t blockSize);
+    ~FixedSizePool();
+
+    // Not copyable.
+    FixedSizePool(const FixedSizePool &);
+    FixedSizePool &operator=(const FixedSizePool &);
+
+    /// Get a new slab and thread its blocks onto the free list.
+    void addSlab();
+
+    const size_t m_blockSize;
+
+    mutable QMutex m_mutex;
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+    FreeBlock *m_freeList;
+
+    std::vector<char *> m_slabs;
+
+    Stats m_stats;
+};
+
+
+/// Standard allocator drawing single objects from a FixedSizePool.
+/**
+ * Node-based containers (std::set, std::multiset, std::map, std::list)
+ * only ever allocate one node at a time, so they get all the benefit of
+ * the pool.  Multi-object requests go to the global allocator.
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    PoolAllocator()  { }
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &)  { }
+
+    T *allocate(size_t n)
+    {
+        if (n == 1)
+            return static_cast<T *>(pool().allocate());
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (n == 1)
+            pool().deallocate(p);
+        else
+            ::operator delete(p);
+    }
+
+    template <typename U>
+    struct rebind
+    {
+        typedef PoolAllocator<U> other;
+    };
+
+private:
+    static FixedSizePool &pool()
+    {
+        // Cache the lookup.  This may be instantiated in more than one
+        // library, but FixedSizePool::get() always returns the same pool.
+        static FixedSizePool &thePool = FixedSizePool::get(sizeof(T));
+        return thePool;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &)
+        { return true; }
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &)
+        { return false; }
+
+
+}
+
+#endif
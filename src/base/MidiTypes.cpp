@@ -26,7 +26,7 @@ namespace Rosegarden
 // PitchBend
 //////////////////////////////////////////////////////////////////////
 
-const std::string PitchBend::EventType = "pitchbend";
+const std::string &PitchBend::EventType = Event::internType("pitchbend");
 
 const PropertyName PitchBend::MSB("msb");
 const PropertyName PitchBend::LSB("lsb");
@@ -45,7 +45,7 @@ Event *PitchBend::makeEvent(timeT absoluteTime, MidiByte msb, MidiByte lsb)
 // Controller
 //////////////////////////////////////////////////////////////////////
 
-const std::string Controller::EventType = "controller";
+const std::string &Controller::EventType = Event::internType("controller");
 
 const PropertyName Controller::NUMBER("number");
 const PropertyName Controller::VALUE("value");
@@ -65,7 +65,7 @@ Controller::makeEvent(timeT absoluteTime, MidiByte number, MidiByte value)
 // Key Pressure
 //////////////////////////////////////////////////////////////////////
 
-const std::string KeyPressure::EventType = "keypressure";
+const std::string &KeyPressure::EventType = Event::internType("keypressure");
 
 const PropertyName KeyPressure::PITCH("pitch");
 const PropertyName KeyPressure::PRESSURE("pressure");
@@ -85,7 +85,7 @@ KeyPressure::makeEvent(timeT absoluteTime, MidiByte pitch, MidiByte pressure)
 // Channel Pressure
 //////////////////////////////////////////////////////////////////////
 
-const std::string ChannelPressure::EventType = "channelpressure";
+const std::string &ChannelPressure::EventType = Event::internType("channelpressure");
 
 const PropertyName ChannelPressure::PRESSURE("pressure");
 
@@ -103,7 +103,7 @@ ChannelPressure::makeEvent(timeT absoluteTime, MidiByte pressure)
 // ProgramChange
 //////////////////////////////////////////////////////////////////////
 
-const std::string ProgramChange::EventType = "programchange";
+const std::string &ProgramChange::EventType = Event::internType("programchange");
 
 const PropertyName ProgramChange::PROGRAM("program");
 
@@ -142,7 +142,7 @@ namespace
 
 }
 
-const std::string SystemExclusive::EventType = "systemexclusive";
+const std::string &SystemExclusive::EventType = Event::internType("systemexclusive");
 
 const PropertyName SystemExclusive::DATABLOCK("datablock");
 
@@ -311,7 +311,7 @@ using namespace Marks;
 // Clef
 //////////////////////////////////////////////////////////////////////
 
-const string Clef::EventType = "clefchange";
+const std::string &Clef::EventType = Event::internType("clefchange");
 const int Clef::EventSubOrdering = -250;
 const PropertyName Clef::ClefPropertyName("clef");
 const PropertyName Clef::OctaveOffsetPropertyName("octaveoffset");
@@ -468,7 +468,7 @@ Event *Clef::getAsEvent(timeT absoluteTime) const
 
 Key::KeyDetailMap Key::m_keyDetailMap = Key::KeyDetailMap();
 
-const string Key::EventType = "keychange";
+const std::string &Key::EventType = Event::internType("keychange");
 const int Key::EventSubOrdering = -200;
 const PropertyName Key::KeyPropertyName("key");
 const Key Key::DefaultKey = Key("C major");
@@ -773,7 +773,7 @@ Key::KeyDetails& Key::KeyDetails::operator=(const Key::KeyDetails &d)
 // Indication
 //////////////////////////////////////////////////////////////////////
 
-const std::string Indication::EventType = "indication";
+const std::string &Indication::EventType = Event::internType("indication");
 const int Indication::EventSubOrdering = -50;
 const PropertyName Indication::IndicationTypePropertyName("indicationtype");
 //const PropertyName Indication::IndicationDurationPropertyName = "indicationduration";
@@ -862,7 +862,7 @@ Indication::isValid(const std::string &s)
 // Text
 //////////////////////////////////////////////////////////////////////
 
-const std::string Text::EventType = "text";
+const std::string &Text::EventType = Event::internType("text");
 const int Text::EventSubOrdering = -70;
 const PropertyName Text::TextPropertyName("text");
 const PropertyName Text::TextTypePropertyName("type");
@@ -1912,8 +1912,8 @@ Pitch Pitch::transpose(const Key &key, int pitchDelta, int heightDelta) const
 // Note
 //////////////////////////////////////////////////////////////////////
 
-const string Note::EventType = "note";
-const string Note::EventRestType = "rest";
+const std::string &Note::EventType = Event::internType("note");
+const std::string &Note::EventRestType = Event::internType("rest");
 const int Note::EventRestSubOrdering = 10;
 
 const timeT Note::m_shortestTime = basePPQ / 16;
@@ -2180,7 +2180,7 @@ AccidentalTable::newClef(const Clef &clef)
 // Symbol
 //////////////////////////////////////////////////////////////////////
 
-const std::string Symbol::EventType = "symbol";
+const std::string &Symbol::EventType = Event::internType("symbol");
 const int Symbol::EventSubOrdering = -70;
 const PropertyName Symbol::SymbolTypePropertyName("type");
 
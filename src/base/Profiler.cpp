@@ -24,10 +24,11 @@
 
 // C++
 #include <algorithm>
-#include <set>
+#include <map>
+#include <vector>
 
 // C
-#include <math.h>
+#include <string.h>
 
 
 namespace Rosegarden {
@@ -51,200 +52,146 @@ Profiles::~Profiles()
     dump();
 }
 
-void Profiles::accumulate(
-#ifndef NO_TIMING
-    const char* id, clock_t time, RealTime rt
-#else
-    const char*, clock_t, RealTime
-#endif
-)
+namespace
 {
-#ifndef NO_TIMING
-    ProfilePair &pair(m_profiles[id]);
-    ++pair.first;
-    pair.second.first += time;
-    pair.second.second = pair.second.second + rt;
-
-    TimePair &lastPair(m_lastCalls[id]);
-    lastPair.first = time;
-    lastPair.second = rt;
-
-    TimePair &worstPair(m_worstCalls[id]);
-    if (time > worstPair.first) {
-        worstPair.first = time;
-    }
-    if (rt > worstPair.second) {
-        worstPair.second = rt;
-    }
-#endif
+    struct Totals
+    {
+        Totals() : calls(0), totalNs(0), worstNs(0) { }
+
+        uint64_t calls;
+        uint64_t totalNs;
+        uint64_t worstNs;
+    };
+
+    struct NameLess
+    {
+        bool operator()(const char *a, const char *b) const
+            { return strcmp(a, b) < 0; }
+    };
+
+    double ms(uint64_t ns)  { return double(ns) / 1000000.0; }
 }
 
 void Profiles::dump() const
 {
-#ifndef NO_TIMING
+    // The same name may have more than one TracePoint, if it is used in
+    // more than one place.
+    typedef std::map<const char *, Totals, NameLess> TotalsMap;
+    TotalsMap totals;
+
+    for (const TracePoint *point : Trace::getPoints()) {
+        Totals &t = totals[point->getName()];
+        t.calls += point->getCount();
+        t.totalNs += point->getTotalNs();
+        t.worstNs = std::max(t.worstNs, point->getWorstNs());
+    }
+
+    // Counters count whether or not tracing is on, so only show those
+    // that have something to say.
+    std::vector<const TraceCounter *> counters;
+    for (const TraceCounter *counter : Trace::getCounters()) {
+        if (counter->get() > 0) counters.push_back(counter);
+    }
+
+    if (totals.empty() && counters.empty()) return;
 
     qDebug("----------------------------------------------------");
     qDebug("Profiling points:");
     qDebug(" ");
     qDebug("By name:");
 
-    typedef std::set<const char *, std::less<std::string> > StringSet;
-
-    StringSet profileNames;
-    for (ProfileMap::const_iterator i = m_profiles.begin();
-         i != m_profiles.end(); ++i) {
-        profileNames.insert(i->first);
-    }
-
-    for (StringSet::const_iterator i = profileNames.begin();
-         i != profileNames.end(); ++i) {
+    for (TotalsMap::const_iterator i = totals.begin();
+         i != totals.end(); ++i) {
 
-        ProfileMap::const_iterator j = m_profiles.find(*i);
+        const Totals &t(i->second);
+        if (t.calls == 0) continue;
 
-        if (j == m_profiles.end()) continue;
+        qDebug("%s(%llu):", i->first, (unsigned long long)t.calls);
 
-        const ProfilePair &pp(j->second);
+        qDebug("    Real:   %.6f ms  (%.3f ms total)",
+                ms(t.totalNs) / t.calls, ms(t.totalNs));
 
-        qDebug("%s(%d):", *i, pp.first);
-
-        qDebug("    CPU:    %.9f ms/call  (%ld ms total)",
-                (((double)pp.second.first * 1000.0 / (double)pp.first) / CLOCKS_PER_SEC),
-                lround((pp.second.first * 1000.0) / CLOCKS_PER_SEC));
-
-        qDebug("    Real:   %s ms  (%s ms total)",
-                (pp.second.second / pp.first * 1000).toString().c_str(),
-                (pp.second.second * 1000).toString().c_str());
-
-        WorstCallMap::const_iterator k = m_worstCalls.find(*i);
-        if (k == m_worstCalls.end()) continue;
-
-        const TimePair &wc(k->second);
-
-        qDebug("    Worst:  %s ms/call  (%d ms CPU)",
-                (wc.second * 1000).toString().c_str(),
-                int((wc.first * 1000.0) / CLOCKS_PER_SEC));
+        qDebug("    Worst:  %.6f ms/call", ms(t.worstNs));
     }
 
-    typedef std::multimap<RealTime, const char *> TimeRMap;
-    typedef std::multimap<int, const char *> IntRMap;
+    typedef std::multimap<uint64_t, const char *> RMap;
 
-    TimeRMap totmap, avgmap, worstmap;
-    IntRMap ncallmap;
+    RMap totmap, avgmap, worstmap, ncallmap;
 
-    for (ProfileMap::const_iterator i = m_profiles.begin();
-         i != m_profiles.end(); ++i) {
-        totmap.insert(TimeRMap::value_type(i->second.second.second, i->first));
-        avgmap.insert(TimeRMap::value_type(i->second.second.second /
-                                           i->second.first, i->first));
-        ncallmap.insert(IntRMap::value_type(i->second.first, i->first));
-    }
-
-    for (WorstCallMap::const_iterator i = m_worstCalls.begin();
-         i != m_worstCalls.end(); ++i) {
-        worstmap.insert(TimeRMap::value_type(i->second.second,
-                                             i->first));
+    for (TotalsMap::const_iterator i = totals.begin();
+         i != totals.end(); ++i) {
+        if (i->second.calls == 0) continue;
+        totmap.insert(RMap::value_type(i->second.totalNs, i->first));
+        avgmap.insert(RMap::value_type(i->second.totalNs / i->second.calls,
+                                       i->first));
+        worstmap.insert(RMap::value_type(i->second.worstNs, i->first));
+        ncallmap.insert(RMap::value_type(i->second.calls, i->first));
     }
 
     // By Total
     qDebug(" ");
     qDebug("By total:");
 
-    for (TimeRMap::const_iterator i = totmap.end(); i != totmap.begin(); ) {
-        --i;
-        qDebug("    %-40s  %s ms",
-                i->second,
-                (i->first * 1000).toString().c_str());
+    for (RMap::const_reverse_iterator i = totmap.rbegin();
+         i != totmap.rend(); ++i) {
+        qDebug("    %-40s  %.3f ms", i->second, ms(i->first));
     }
 
     // By Average
     qDebug(" ");
     qDebug("By average:");
 
-    for (TimeRMap::const_iterator i = avgmap.end(); i != avgmap.begin(); ) {
-        --i;
-        qDebug("    %-40s  %s ms",
-                i->second,
-                (i->first * 1000).toString().c_str());
+    for (RMap::const_reverse_iterator i = avgmap.rbegin();
+         i != avgmap.rend(); ++i) {
+        qDebug("    %-40s  %.6f ms", i->second, ms(i->first));
     }
 
     // By Worst Case
     qDebug(" ");
     qDebug("By worst case:");
 
-    for (TimeRMap::const_iterator i = worstmap.end(); i != worstmap.begin(); ) {
-        --i;
-        qDebug("    %-40s  %s ms",
-                i->second,
-                (i->first * 1000).toString().c_str());
+    for (RMap::const_reverse_iterator i = worstmap.rbegin();
+         i != worstmap.rend(); ++i) {
+        qDebug("    %-40s  %.6f ms", i->second, ms(i->first));
     }
 
     // By Number of Calls
     qDebug(" ");
     qDebug("By number of calls:");
 
-    for (IntRMap::const_iterator i = ncallmap.end(); i != ncallmap.begin(); ) {
-        --i;
-        qDebug("    %-40s  %d", i->second, i->first);
+    for (RMap::const_reverse_iterator i = ncallmap.rbegin();
+         i != ncallmap.rend(); ++i) {
+        qDebug("    %-40s  %llu", i->second, (unsigned long long)i->first);
     }
 
-#endif
-}
-
-#ifndef NO_TIMING
+    // Counters
+    if (!counters.empty()) {
+        qDebug(" ");
+        qDebug("Counters:");
 
-Profiler::Profiler(const char* name, bool showOnDestruct) :
-    m_c(name),
-    m_showOnDestruct(showOnDestruct),
-    m_ended(false)
-{
-    m_startCPU = clock();
-
-    struct timeval tv;
-    (void)gettimeofday(&tv, nullptr);
-    m_startTime = RealTime::fromTimeval(tv);
-}
-
-#if 0
-void
-Profiler::update() const
-{
-    clock_t elapsedCPU = clock() - m_startCPU;
-
-    struct timeval tv;
-    (void)gettimeofday(&tv, nullptr);
-    RealTime elapsedTime = RealTime::fromTimeval(tv) - m_startTime;
-
-    RG_DEBUG << "update() : id = " << m_c
-        << " - elapsed so far = " << ((elapsedCPU * 1000) / CLOCKS_PER_SEC)
-        << "ms CPU, " << elapsedTime << " real";
-}
-#endif
-
-Profiler::~Profiler()
-{
-    if (!m_ended)
-        end();
+        for (const TraceCounter *counter : counters) {
+            qDebug("    %-40s  %llu", counter->getName(),
+                   (unsigned long long)counter->get());
+        }
+    }
 }
 
 void
 Profiler::end()
 {
-    clock_t elapsedCPU = clock() - m_startCPU;
+    if (m_ended) return;
+    m_ended = true;
 
-    struct timeval tv;
-    (void)gettimeofday(&tv, nullptr);
-    RealTime elapsedTime = RealTime::fromTimeval(tv) - m_startTime;
+    if (!m_start) return;
 
-    Profiles::getInstance()->accumulate(m_c, elapsedCPU, elapsedTime);
+    const uint64_t endTime = Trace::now();
+
+    if (Trace::isEnabled())
+        Trace::record(Trace::getPoint(m_c), m_start, endTime);
 
     if (m_showOnDestruct)
         RG_DEBUG << "end() : id = " << m_c
-             << " - elapsed = " << ((elapsedCPU * 1000) / CLOCKS_PER_SEC)
-             << "ms CPU, " << elapsedTime << " real";
-
-    m_ended = true;
+             << " - elapsed = " << ms(endTime - m_start) << "ms real";
 }
 
-#endif
-
 }
@@ -18,21 +18,8 @@
 #ifndef RG_PROFILER_H
 #define RG_PROFILER_H
 
-#include <ctime>
-#include <sys/time.h>
-#include <map>
-
 #include "RealTime.h"
-
-//#define NO_TIMING 1
-
-//#define WANT_TIMING 1
-
-#ifdef NDEBUG
-#ifndef WANT_TIMING
-#define NO_TIMING 1
-#endif
-#endif
+#include "Trace.h"
 
 namespace Rosegarden {
 
@@ -41,7 +28,7 @@ namespace Rosegarden {
  */
 
 /**
- * The class holding all profiling data
+ * Reports the totals kept by Trace for each profiling point.
  *
  * This class is a singleton
  */
@@ -51,76 +38,61 @@ public:
     static Profiles* getInstance();
     ~Profiles();
 
-    // cppcheck-suppress functionStatic
-    void accumulate(const char* id, clock_t time, RealTime rt);
+    /**
+     * Print the number of calls and the total, mean and worst-case
+     * times for each point, followed by the TraceCounters.  Nothing
+     * is recorded unless tracing is enabled (see Trace).
+     */
     // cppcheck-suppress functionStatic
     void dump() const;
 
 protected:
     Profiles();
 
-    typedef std::pair<clock_t, RealTime> TimePair;
-    typedef std::pair<int, TimePair> ProfilePair;
-    typedef std::map<const char *, ProfilePair> ProfileMap;
-    typedef std::map<const char *, TimePair> LastCallMap;
-    typedef std::map<const char *, TimePair> WorstCallMap;
-    ProfileMap m_profiles;
-    LastCallMap m_lastCalls;
-    WorstCallMap m_worstCalls;
-
     static Profiles* m_instance;
 };
 
-#ifndef NO_TIMING
-
 /**
  * Profile point instance class.  Construct one of these on the stack
  * at the start of a function, in order to record the time consumed
- * within that function.  The profiler object should be effectively
- * optimised out if NO_TIMING is defined, so any overhead in a release
- * build should be negligible so long as you remember to define that.
+ * within that function.  This is a Trace section named after the
+ * point, so it only costs an atomic load unless tracing is enabled, and
+ * may be used on any thread.
  */
 class Profiler
 {
 public:
     /**
      * Create a profile point instance that records time consumed
-     * against the given profiling point name.  If showOnDestruct is
-     * true, the time consumed will be printed to stderr when the
-     * object is destroyed; otherwise, only the accumulated, mean and
+     * against the given profiling point name, which should be a string
+     * literal.  If showOnDestruct is true, the time consumed will be
+     * printed to stderr when the object is destroyed, whether or not
+     * tracing is enabled; otherwise, only the accumulated, mean and
      * worst-case times will be shown when the program exits or
      * Profiles::dump() is called.
      */
-    Profiler(const char *name, bool showOnDestruct = false);
-    ~Profiler();
+    Profiler(const char *name, bool showOnDestruct = false) :
+        m_c(name),
+        m_start((showOnDestruct || Trace::isEnabled()) ? Trace::now() : 0),
+        m_showOnDestruct(showOnDestruct),
+        m_ended(false)
+    { }
+
+    ~Profiler()
+    {
+        if (!m_ended && m_start)
+            end();
+    }
 
-    //void update() const;
     void end(); // same action as dtor
 
 protected:
     const char* m_c;
-    clock_t m_startCPU;
-    RealTime m_startTime;
+    uint64_t m_start;
     bool m_showOnDestruct;
     bool m_ended;
 };
 
-#else
-
-class Profiler
-{
-public:
-    Profiler(const char *, bool = false) { }
-    ~Profiler() { }
-
-    // cppcheck-suppress functionStatic
-    //void update() const { }
-    // cppcheck-suppress functionStatic
-    void end() { }
-};
-
-#endif
-
 }
 
 #endif
@@ -100,37 +100,117 @@ PropertyDefn<RealTimeT>::unparse(PropertyDefn<RealTimeT>::basic_type i)
     return buffer;
 }
 
-PropertyStoreBase::~PropertyStoreBase()
+PropertyValue::PropertyValue(const PropertyValue &other) :
+    m_type(other.m_type),
+    m_data(other.m_data)
 {
+    if (m_type == String)
+        m_data.stringValue = new std::string(*other.m_data.stringValue);
 }
 
-template <>
-size_t
-PropertyStore<Int>::getStorageSize() const
+PropertyValue::PropertyValue(PropertyValue &&other) noexcept :
+    m_type(other.m_type),
+    m_data(other.m_data)
 {
-    return sizeof(*this);
+    // Steal the string, if any.
+    other.m_type = Int;
 }
 
-template <>
-size_t
-PropertyStore<String>::getStorageSize() const
+PropertyValue &
+PropertyValue::operator=(const PropertyValue &other)
 {
-    return sizeof(*this) + m_data.size();
+    if (&other == this)
+        return *this;
+
+    if (other.m_type == String) {
+        setData<String>(*other.m_data.stringValue);
+    } else {
+        releaseString();
+        m_type = other.m_type;
+        m_data = other.m_data;
+    }
+
+    return *this;
 }
 
-template <>
-size_t
-PropertyStore<Bool>::getStorageSize() const
+PropertyValue &
+PropertyValue::operator=(PropertyValue &&other) noexcept
 {
-    return sizeof(*this);
+    if (&other == this)
+        return *this;
+
+    releaseString();
+    m_type = other.m_type;
+    m_data = other.m_data;
+    // Steal the string, if any.
+    other.m_type = Int;
+
+    return *this;
+}
+
+string
+PropertyValue::getTypeName() const
+{
+    switch (m_type) {
+    case Int:
+        return PropertyDefn<Int>::typeName();
+    case String:
+        return PropertyDefn<String>::typeName();
+    case Bool:
+        return PropertyDefn<Bool>::typeName();
+    case RealTimeT:
+        return PropertyDefn<RealTimeT>::typeName();
+    }
+
+    return "Undefined";
+}
+
+string
+PropertyValue::unparse() const
+{
+    switch (m_type) {
+    case Int:
+        return PropertyDefn<Int>::unparse(getData<Int>());
+    case String:
+        return PropertyDefn<String>::unparse(getData<String>());
+    case Bool:
+        return PropertyDefn<Bool>::unparse(getData<Bool>());
+    case RealTimeT:
+        return PropertyDefn<RealTimeT>::unparse(getData<RealTimeT>());
+    }
+
+    return "";
+}
+
+bool
+PropertyValue::operator==(const PropertyValue &other) const
+{
+    if (m_type != other.m_type)
+        return false;
+
+    switch (m_type) {
+    case Int:
+        return m_data.intValue == other.m_data.intValue;
+    case String:
+        return *m_data.stringValue == *other.m_data.stringValue;
+    case Bool:
+        return m_data.boolValue == other.m_data.boolValue;
+    case RealTimeT:
+        return m_data.realTimeValue.sec == other.m_data.realTimeValue.sec  &&
+               m_data.realTimeValue.nsec == other.m_data.realTimeValue.nsec;
+    }
+
+    return false;
 }
 
-template <>
 size_t
-PropertyStore<RealTimeT>::getStorageSize() const
+PropertyValue::getStorageSize() const
 {
+    if (m_type == String)
+        return sizeof(*this) + sizeof(std::string) + m_data.stringValue->size();
+
     return sizeof(*this);
 }
- 
+
 }
 
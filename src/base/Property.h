@@ -107,110 +107,152 @@ public:
 };
 
 
-class ROSEGARDENPRIVATE_EXPORT PropertyStoreBase {
+/// A property value of any PropertyType, stored in place.
+/**
+ * PropertyMap stores these by value in contiguous storage, so there is
+ * no per-property heap allocation or virtual dispatch for the common
+ * Int, Bool and RealTimeT cases.  String values are comparatively rare,
+ * so they are held by pointer to keep every other value small.
+ */
+class ROSEGARDENPRIVATE_EXPORT PropertyValue
+{
 public:
-    virtual ~PropertyStoreBase();
-
-    virtual PropertyType getType() const = 0;
-    virtual std::string getTypeName() const = 0;
-    virtual PropertyStoreBase *clone() = 0;
-    virtual std::string unparse() const = 0;
+    PropertyValue() : m_type(Int)  { m_data.intValue = 0; }
+    PropertyValue(const PropertyValue &other);
+    PropertyValue(PropertyValue &&other) noexcept;
+    ~PropertyValue()  { releaseString(); }
+
+    PropertyValue &operator=(const PropertyValue &other);
+    PropertyValue &operator=(PropertyValue &&other) noexcept;
+
+    template <PropertyType P>
+    static PropertyValue create(typename PropertyDefn<P>::basic_type data)
+    {
+        PropertyValue value;
+        value.setData<P>(data);
+        return value;
+    }
 
-    virtual size_t getStorageSize() const = 0; // for debugging
+    PropertyType getType() const  { return m_type; }
+    std::string getTypeName() const;
 
-#ifndef NDEBUG
-    virtual void dump(std::ostream&) const = 0;
-#else
-    virtual void dump(std::ostream&) const { }
-#endif
-};
+    /// Get the data.  Caller must check getType() first.
+    template <PropertyType P>
+    typename PropertyDefn<P>::basic_type getData() const;
 
-#ifndef NDEBUG
-inline std::ostream& operator<<(std::ostream &out, PropertyStoreBase &e)
-{ e.dump(out); return out; }
-#endif
+    /// Set the data.  Changes the type to P if necessary.
+    template <PropertyType P>
+    void setData(typename PropertyDefn<P>::basic_type data);
 
-inline QDebug operator<<(QDebug dbg, const PropertyStoreBase &psb)
-{
-    dbg << psb.getTypeName().c_str() << "-" << psb.unparse().c_str();
-    return dbg;
-}
+    std::string unparse() const;
 
-template <PropertyType P>
-class ROSEGARDENPRIVATE_EXPORT PropertyStore : public PropertyStoreBase
-{
-public:
-    explicit PropertyStore(typename PropertyDefn<P>::basic_type d) :
-        m_data(d) { }
-    PropertyStore(const PropertyStore<P> &p) :
-        PropertyStoreBase(p), m_data(p.m_data) { }
-    PropertyStore &operator=(const PropertyStore<P> &p);
+    bool operator==(const PropertyValue &other) const;
+    bool operator!=(const PropertyValue &other) const
+            { return !operator==(other); }
 
-    PropertyType getType() const override;
-    std::string getTypeName() const override;
+    size_t getStorageSize() const; // for debugging
 
-    PropertyStoreBase* clone() override;
+private:
+    void releaseString()
+    {
+        if (m_type == String) {
+            delete m_data.stringValue;
+            m_type = Int;
+        }
+    }
 
-    std::string unparse() const override;
+    PropertyType m_type;
+
+    union Data {
+        long intValue;
+        bool boolValue;
+        struct {
+            int sec;
+            int nsec;
+        } realTimeValue;
+        std::string *stringValue;
+    } m_data;
+};
 
-    typename PropertyDefn<P>::basic_type getData() const { return m_data; }
-    void setData(typename PropertyDefn<P>::basic_type data) { m_data = data; }
+template <>
+inline PropertyDefn<Int>::basic_type
+PropertyValue::getData<Int>() const
+{
+    return m_data.intValue;
+}
 
-    size_t getStorageSize() const override;
+template <>
+inline PropertyDefn<String>::basic_type
+PropertyValue::getData<String>() const
+{
+    return *m_data.stringValue;
+}
 
-#ifndef NDEBUG
-    void dump(std::ostream&) const override;
-#endif
+template <>
+inline PropertyDefn<Bool>::basic_type
+PropertyValue::getData<Bool>() const
+{
+    return m_data.boolValue;
+}
 
-private:
-    typename PropertyDefn<P>::basic_type m_data;
-};
+template <>
+inline PropertyDefn<RealTimeT>::basic_type
+PropertyValue::getData<RealTimeT>() const
+{
+    return RealTime(m_data.realTimeValue.sec, m_data.realTimeValue.nsec);
+}
 
-template <PropertyType P>
-PropertyStore<P>&
-PropertyStore<P>::operator=(const PropertyStore<P> &p) {
-    if (this != &p) {
-        m_data = p.m_data;
-    }
-    return *this;
+template <>
+inline void
+PropertyValue::setData<Int>(PropertyDefn<Int>::basic_type data)
+{
+    releaseString();
+    m_type = Int;
+    m_data.intValue = data;
 }
 
-template <PropertyType P>
-PropertyType
-PropertyStore<P>::getType() const
+template <>
+inline void
+PropertyValue::setData<String>(PropertyDefn<String>::basic_type data)
 {
-    return P;
+    if (m_type == String) {
+        *m_data.stringValue = data;
+    } else {
+        m_data.stringValue = new std::string(data);
+        m_type = String;
+    }
 }
 
-template <PropertyType P>
-std::string
-PropertyStore<P>::getTypeName() const
+template <>
+inline void
+PropertyValue::setData<Bool>(PropertyDefn<Bool>::basic_type data)
 {
-    return PropertyDefn<P>::typeName();
+    releaseString();
+    m_type = Bool;
+    m_data.boolValue = data;
 }
 
-template <PropertyType P>
-PropertyStoreBase*
-PropertyStore<P>::clone()
+template <>
+inline void
+PropertyValue::setData<RealTimeT>(PropertyDefn<RealTimeT>::basic_type data)
 {
-    return new PropertyStore<P>(*this);
+    releaseString();
+    m_type = RealTimeT;
+    m_data.realTimeValue.sec = data.sec;
+    m_data.realTimeValue.nsec = data.nsec;
 }
 
-template <PropertyType P>
-std::string
-PropertyStore<P>::unparse() const
+inline std::ostream &operator<<(std::ostream &out, const PropertyValue &v)
 {
-    return PropertyDefn<P>::unparse(m_data);
+    out << v.getTypeName() << " - " << v.unparse();
+    return out;
 }
 
-#ifndef NDEBUG
-template <PropertyType P>
-void
-PropertyStore<P>::dump(std::ostream &out) const
+inline QDebug operator<<(QDebug dbg, const PropertyValue &v)
 {
-    out << getTypeName() << " - " << unparse();
+    dbg << v.getTypeName().c_str() << "-" << v.unparse().c_str();
+    return dbg;
 }
-#endif
 
 }
 
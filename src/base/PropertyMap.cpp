@@ -16,6 +16,7 @@
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <algorithm>
 #include "PropertyMap.h"
 #include "XmlExportable.h"
 
@@ -23,47 +24,134 @@ namespace Rosegarden
 {
 using std::string;
 
-#ifdef PROPERTY_MAP_IS_HASH_MAP
+namespace
+{
+    bool pairNameLess(const PropertyPair &pair, const PropertyName &name)
+    {
+        return pair.first < name;
+    }
+}
+
 PropertyMap::PropertyMap() :
-    __HASH_NS::hash_map<PropertyName,
-			PropertyStoreBase *,
-			PropertyNameHash,
-			PropertyNamesEqual>(50, PropertyNameHash())
+    m_pairs(m_inline),
+    m_size(0),
+    m_capacity(InlineCapacity)
 {
-    // nothing
 }
-#endif
 
 PropertyMap::PropertyMap(const PropertyMap &pm) :
+    m_pairs(m_inline),
+    m_size(0),
+    m_capacity(InlineCapacity)
+{
+    operator=(pm);
+}
 
-#ifdef PROPERTY_MAP_IS_HASH_MAP
+PropertyMap &
+PropertyMap::operator=(const PropertyMap &pm)
+{
+    if (&pm == this)
+        return *this;
 
-    __HASH_NS::hash_map<PropertyName,
-			PropertyStoreBase *,
-			PropertyNameHash,
-			PropertyNamesEqual>(50, PropertyNameHash())
-#else
+    clear();
 
-    std::map<PropertyName, PropertyStoreBase *>()
+    if (pm.m_size > m_capacity) {
+        m_pairs = new value_type[pm.m_size];
+        m_capacity = pm.m_size;
+    }
 
-#endif
+    std::copy(pm.begin(), pm.end(), m_pairs);
+    m_size = pm.m_size;
 
-{
-    for (const_iterator i = pm.begin(); i != pm.end(); ++i) {
-	insert(PropertyPair(i->first, i->second->clone()));
-    }
+    return *this;
 }
 
 PropertyMap::~PropertyMap()
 {
-    for (iterator i = begin(); i != end(); ++i) delete i->second;
+    if (m_pairs != m_inline)
+        delete[] m_pairs;
 }    
 
+PropertyMap::iterator
+PropertyMap::find(const PropertyName &name)
+{
+    iterator i = std::lower_bound(begin(), end(), name, pairNameLess);
+    if (i != end()  &&  i->first == name)
+        return i;
+    return end();
+}
+
+std::pair<PropertyMap::iterator, bool>
+PropertyMap::insert(const value_type &pair)
+{
+    size_t index =
+        std::lower_bound(begin(), end(), pair.first, pairNameLess) - begin();
+
+    // Already present?
+    if (index < m_size  &&  m_pairs[index].first == pair.first)
+        return std::pair<iterator, bool>(m_pairs + index, false);
+
+    if (m_size == m_capacity)
+        grow();
+
+    // Open a gap and drop the new pair into it.
+    std::move_backward(m_pairs + index, m_pairs + m_size,
+                       m_pairs + m_size + 1);
+    m_pairs[index] = pair;
+    ++m_size;
+
+    return std::pair<iterator, bool>(m_pairs + index, true);
+}
+
+void
+PropertyMap::erase(iterator i)
+{
+    std::move(i + 1, end(), i);
+    --m_size;
+    // The last slot is now unused.  Release any string it still holds.
+    m_pairs[m_size].second = PropertyValue();
+}
+
+size_t
+PropertyMap::erase(const PropertyName &name)
+{
+    iterator i = find(name);
+    if (i == end())
+        return 0;
+
+    erase(i);
+    return 1;
+}
+
 void
 PropertyMap::clear()
 {
-    for (iterator i = begin(); i != end(); ++i) delete i->second;
-    erase(begin(), end());
+    if (m_pairs != m_inline) {
+        delete[] m_pairs;
+        m_pairs = m_inline;
+        m_capacity = InlineCapacity;
+    } else {
+        for (iterator i = begin(); i != end(); ++i)
+            i->second = PropertyValue();
+    }
+
+    m_size = 0;
+}
+
+void
+PropertyMap::grow()
+{
+    const unsigned newCapacity = m_capacity * 2;
+    value_type *newPairs = new value_type[newCapacity];
+
+    // Moving leaves no strings behind in the old array.
+    std::move(begin(), end(), newPairs);
+
+    if (m_pairs != m_inline)
+        delete[] m_pairs;
+
+    m_pairs = newPairs;
+    m_capacity = newCapacity;
 }
 
 
@@ -82,8 +170,8 @@ PropertyMap::toXmlString() const
 	
 	xml +=
 	    "<property name=\"" + XmlExportable::encode(i->first.getName()) +
-	    "\" " + i->second->getTypeName() +
-	    "=\"" + XmlExportable::encode(i->second->unparse()) +
+	    "\" " + i->second.getTypeName() +
+	    "=\"" + XmlExportable::encode(i->second.unparse()) +
 	    "\"/>";
 
     }
@@ -91,19 +179,11 @@ PropertyMap::toXmlString() const
     return xml;
 }
 
-static bool propertyPairEqual(const PropertyPair &p1, const PropertyPair &p2)
-{
-    return p1.first == p2.first &&
-            p1.second->getTypeName() == p2.second->getTypeName()
-            && p1.second->unparse() == p2.second->unparse();
-}
-
 bool PropertyMap::operator==(const PropertyMap &other) const
 {
-    // The default std::map::operator== would compare pointers, provide our own predicate
+    // Both are sorted by name, so a pairwise compare does the job.
     return size() == other.size()
-       && std::equal(begin(), end(), other.begin(), propertyPairEqual);
+       && std::equal(begin(), end(), other.begin());
 }
 
 }
-
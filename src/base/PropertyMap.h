@@ -19,7 +19,7 @@
 
 #include <rosegardenprivate_export.h>
 
-#include <map>
+#include <utility>
 
 namespace Rosegarden {
 
@@ -30,15 +30,52 @@ namespace Rosegarden {
  * need a time (Event::m_absoluteTime) and (usually) a duration
  * (Event::m_duration) but not all Event objects need a pitch
  * (BaseProperties::PITCH).  E.g a control change Event does not need a pitch.
+ *
+ * The pairs are kept in a contiguous array sorted by PropertyName.  Most
+ * Events have only a handful of properties, so the first InlineCapacity
+ * pairs are stored inside the PropertyMap itself and the heap is only
+ * used beyond that.  Values are stored in place (see PropertyValue).
+ *
+ * The interface is a subset of std::map's.  Note that, unlike std::map,
+ * insert() and erase() invalidate all iterators into the map.
  */
-class ROSEGARDENPRIVATE_EXPORT PropertyMap : public std::map<PropertyName, PropertyStoreBase *>
+class ROSEGARDENPRIVATE_EXPORT PropertyMap
 {
 public:
-    PropertyMap() { }
+    typedef PropertyName key_type;
+    typedef PropertyValue mapped_type;
+    typedef std::pair<PropertyName, PropertyValue> value_type;
+    typedef value_type *iterator;
+    typedef const value_type *const_iterator;
+
+    PropertyMap();
     PropertyMap(const PropertyMap &pm);
+    PropertyMap &operator=(const PropertyMap &pm);
 
     ~PropertyMap();
-    
+
+    iterator begin()  { return m_pairs; }
+    const_iterator begin() const  { return m_pairs; }
+    iterator end()  { return m_pairs + m_size; }
+    const_iterator end() const  { return m_pairs + m_size; }
+
+    size_t size() const  { return m_size; }
+    bool empty() const  { return m_size == 0; }
+
+    iterator find(const PropertyName &name);
+    const_iterator find(const PropertyName &name) const
+            { return const_cast<PropertyMap *>(this)->find(name); }
+
+    /// Insert the pair unless the name is already present.
+    /**
+     * Returns an iterator to the pair with the name and whether the
+     * insertion took place.
+     */
+    std::pair<iterator, bool> insert(const value_type &pair);
+
+    void erase(iterator i);
+    size_t erase(const PropertyName &name);
+
     void clear();
     
     std::string toXmlString() const;
@@ -47,7 +84,17 @@ public:
     bool operator!=(const PropertyMap &other) const { return !operator==(other); }
 
 private:
-    PropertyMap &operator=(const PropertyMap &); // not provided
+    static const unsigned InlineCapacity = 6;
+
+    /// Make room for at least one more pair.
+    void grow();
+
+    /// Points to either m_inline or a heap array.
+    value_type *m_pairs;
+    unsigned m_size;
+    unsigned m_capacity;
+
+    value_type m_inline[InlineCapacity];
 };
 
 typedef PropertyMap::value_type PropertyPair;
@@ -16,10 +16,9 @@
 #include "base/PropertyName.h"
 #include "base/Exception.h"
 
-#include <QtGlobal>  // For Q_ASSERT()
-
-#include <iostream>
+#include <atomic>
 #include <map>
+#include <mutex>
 
 
 namespace Rosegarden 
@@ -34,24 +33,37 @@ namespace
     //       who might access this as we are going down.
     NameToIDMap *a_nameToIDMap = nullptr;
 
-    typedef std::map<int, std::string> IDToNameMap;
-    // This map allows us to save space by not storing the name in every
-    // copy of a PropertyName.  Used by getName().
-    // Pointer for create on first use to avoid static init order fiasco.
-    // Note: This is a deliberate memory leak since we cannot be sure
-    //       who might access this as we are going down.
-    IDToNameMap *a_idToNameMap = nullptr;
+    // The names by ID, for getName(), which takes no lock.  This allows
+    // us to save space by not storing the name in every copy of a
+    // PropertyName.
+    //
+    // Names are only ever added, in blocks that are allocated as needed
+    // and never move or go away, so each block and each name can be
+    // published with a release store and read with an acquire load.
+    // The names themselves are the keys in a_nameToIDMap, which stay
+    // put too.  (Zero-initialised, so this is ready before any static
+    // PropertyName is constructed.)
+    typedef std::atomic<const std::string *> NameSlot;
+    const int a_blockSize = 1024;
+    const int a_maxBlocks = 4096;
+    std::atomic<NameSlot *> a_idToName[a_maxBlocks];
 
     int a_nextId = 0;
 
+    // Guards a_nameToIDMap and adding names.  Names are interned from the
+    // notation layout threads too.  (std::mutex is constant-initialised,
+    // so this is ready before any static PropertyName is constructed.)
+    std::mutex a_mutex;
+
     // Get the existing ID for a name, or if not found, create
     // a new ID and add to the map.
     int a_getId(const std::string &name)
     {
+        std::lock_guard<std::mutex> lock(a_mutex);
+
         if (!a_nameToIDMap) {
             // Create on first use to avoid static init order fiasco.
             a_nameToIDMap = new NameToIDMap;
-            a_idToNameMap = new IDToNameMap;
         }
 
         NameToIDMap::iterator idIter(a_nameToIDMap->find(name));
@@ -61,9 +73,26 @@ namespace
 
         // Not found.  Create a new ID.
 
-        const int newId = ++a_nextId;
-        a_nameToIDMap->insert(NameToIDMap::value_type(name, newId));
-        a_idToNameMap->insert(IDToNameMap::value_type(newId, name));
+        const int newId = a_nextId + 1;
+        const int block = newId / a_blockSize;
+        if (block >= a_maxBlocks)
+            throw Exception("Too many property names");
+
+        NameSlot *slots = a_idToName[block].load(std::memory_order_relaxed);
+        if (!slots) {
+            // Deliberately leaked, like the map.
+            slots = new NameSlot[a_blockSize];
+            for (int i = 0; i < a_blockSize; ++i) {
+                slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+            a_idToName[block].store(slots, std::memory_order_release);
+        }
+
+        a_nextId = newId;
+        idIter = a_nameToIDMap->insert(
+                NameToIDMap::value_type(name, newId)).first;
+        slots[newId % a_blockSize].store(&idIter->first,
+                                         std::memory_order_release);
         return newId;
     }
 }
@@ -95,40 +124,21 @@ PropertyName &PropertyName::operator=(const std::string &name)
 
 std::string PropertyName::getName() const
 {
-    IDToNameMap::iterator i(a_idToNameMap->find(m_id));
     // Not found?  Return the empty string.
-    if (i == a_idToNameMap->end())
+    if (m_id <= 0  ||  m_id / a_blockSize >= a_maxBlocks)
         return "";
 
-    return i->second;
-
-#if 0
-    // dump some informative data, even if we aren't in debug mode,
-    // because this really shouldn't be happening
-    std::cerr << "ERROR: PropertyName::getName: ID corrupted!\n";
-    std::cerr << "PropertyName's internal ID is " << m_id << std::endl;
-    std::cerr << "Reverse interns are ";
-
-    i = a_idToNameMap->begin();
-    if (i == a_idToNameMap->end()) {
-        std::cerr << "(none)";
-    } else {
-        while (i != a_idToNameMap->end()) {
-            if (i != a_idToNameMap->begin()) {
-                std::cerr << ", ";
-            }
-            std::cerr << i->first << "=" << i->second;
-            ++i;
-        }
-    }
+    const NameSlot *slots =
+            a_idToName[m_id / a_blockSize].load(std::memory_order_acquire);
+    if (!slots)
+        return "";
 
-    std::cerr << std::endl;
+    const std::string *name =
+            slots[m_id % a_blockSize].load(std::memory_order_acquire);
+    if (!name)
+        return "";
 
-    Q_ASSERT(0); // exit if debug is on
-    throw Exception(
-            "Serious problem in PropertyName::getName(): property "
-            "name's internal ID is corrupted -- see stderr for details");
-#endif
+    return *name;
 }
 
 
@@ -24,6 +24,7 @@
 
 #include "Track.h"
 #include "Event.h"
+#include "FixedSizePool.h"
 #include "base/NotationTypes.h"
 #include "RefreshStatus.h"
 #include "RealTime.h"
@@ -64,8 +65,11 @@ class BasicCommand;
  * EventContainer is a precursor to Segment, used in code that needs
  * to store events but doesn't need all the ancillary data and
  * behaviors that Segment provides.
+ *
+ * The tree nodes come from a FixedSizePool, like the Events themselves.
  */
-typedef std::multiset<Event *, Event::EventCmp> EventContainer;
+typedef std::multiset<Event *, Event::EventCmp, PoolAllocator<Event *> >
+        EventContainer;
 
 /// Container of Event objects.
 /**
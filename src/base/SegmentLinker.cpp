@@ -24,6 +24,7 @@
 #include "misc/Debug.h"
 
 #include <algorithm>
+#include <vector>
 
 namespace Rosegarden
 {
@@ -192,15 +193,22 @@ void
 SegmentLinker::linkedSegmentChanged(Segment *s, const timeT from,
                                                 const timeT to)
 {
-    //go through the other linked segments which aren't s, and copy the events
-    //in the range [from,to] to them, accounting for time and pitch shifts
+    //go through the other linked segments which aren't s, and bring the
+    //events in the range [from,to] up to date with s, accounting for time
+    //and pitch shifts
 
     const timeT sourceSegStartTime = s->getStartTime();
     const timeT refFrom = from - sourceSegStartTime;
     const timeT refTo = to - sourceSegStartTime;
 
-    // Used to memorize a possible change in lyrics
-    bool lyricsChanged = false;
+    // The events to copy are the same for every linked segment.
+    std::vector<const Event *> sourceEvents;
+    const Segment::const_iterator sourceEnd = s->findTime(to);
+    for (Segment::const_iterator itr = s->findTime(from);
+         itr != sourceEnd; ++itr) {
+        if (!isIgnored(*itr))
+            sourceEvents.push_back(*itr);
+    }
 
     LinkedSegmentParamsList::iterator itr;
     for(itr = m_linkedSegmentParamsList.begin();
@@ -222,33 +230,19 @@ SegmentLinker::linkedSegmentChanged(Segment *s, const timeT from,
         timeT segStartTime = linkedSegToUpdate->getStartTime();
         timeT segFrom = segStartTime + refFrom;
         timeT segTo = segStartTime + refTo;
-        Segment::iterator itrFrom = linkedSegToUpdate->findTime(segFrom);
-        Segment::iterator itrTo = linkedSegToUpdate->findTime(segTo);
-        lyricsChanged = eraseNonIgnored(linkedSegToUpdate,
-                                        itrFrom, itrTo, lyricsChanged);
-
-        //now go through s from 'from' to 'to', inserting the equivalent
-        //event in linkedSegToUpdate
-        for(Segment::const_iterator itr = s->findTime(from);
-                                    itr != s->findTime(to); ++itr) {
-            const Event *e = *itr;
-
-            timeT eventT = (e->getAbsoluteTime() - sourceSegStartTime)
-                           + segStartTime;
-
-            timeT eventNotationT = (e->getNotationAbsoluteTime() - sourceSegStartTime)
-                                   + segStartTime;
-
-            int semitones =
-                    linkedSegToUpdate->getLinkTransposeParams().m_semitones -
-                                    s->getLinkTransposeParams().m_semitones;
-            int steps = linkedSegToUpdate->getLinkTransposeParams().m_steps -
-                                        s->getLinkTransposeParams().m_steps;
-
-            lyricsChanged = insertMappedEvent(linkedSegToUpdate, e, eventT,
-                                              eventNotationT, semitones, steps,
-                                              lyricsChanged);
-        }
+
+        int semitones =
+                linkedSegToUpdate->getLinkTransposeParams().m_semitones -
+                                s->getLinkTransposeParams().m_semitones;
+        int steps = linkedSegToUpdate->getLinkTransposeParams().m_steps -
+                                    s->getLinkTransposeParams().m_steps;
+
+        bool lyricsChanged = updateRange(linkedSegToUpdate,
+                                         linkedSegToUpdate->findTime(segFrom),
+                                         linkedSegToUpdate->findTime(segTo),
+                                         sourceEvents,
+                                         segStartTime - sourceSegStartTime,
+                                         semitones, steps);
 
         // Fix verses count if lyrics have been modified
         if (lyricsChanged) linkedSegToUpdate->invalidateVerseCount();
@@ -261,17 +255,90 @@ SegmentLinker::linkedSegmentChanged(Segment *s, const timeT from,
 }
 
 bool
-SegmentLinker::insertMappedEvent(Segment *seg,
-                                 const Event *e, timeT t, timeT nt,
-                                 int semitones, int steps,
-                                 bool lyricsAlreadyInserted)
+SegmentLinker::updateRange(Segment *seg,
+                           Segment::iterator itrFrom, Segment::iterator itrTo,
+                           const std::vector<const Event *> &sourceEvents,
+                           timeT offset, int semitones, int steps)
 {
-    bool lyricInserted = lyricsAlreadyInserted;
+    bool lyricsChanged = false;
 
-    bool ignore;
-    if (e->get<Bool>(BaseProperties::LINKED_SEGMENT_IGNORE_UPDATE, ignore)
-        && ignore) {
-        return lyricInserted;
+    std::vector<Segment::iterator> targets;
+    for (Segment::iterator itr = itrFrom;
+         itr != seg->end() && itr != itrTo; ++itr) {
+        if (!isIgnored(*itr))
+            targets.push_back(itr);
+    }
+
+    // Both lists are in time order, so take them a time at a time.  At
+    // most times nothing has changed and the segment is left alone, so
+    // only the edited events are erased, inserted and notified.
+    std::vector<Event *> mapped;
+    size_t source = 0;
+    size_t target = 0;
+
+    while (source < sourceEvents.size() || target < targets.size()) {
+
+        timeT t;
+        if (target == targets.size()) {
+            t = sourceEvents[source]->getAbsoluteTime() + offset;
+        } else if (source == sourceEvents.size()) {
+            t = (*targets[target])->getAbsoluteTime();
+        } else {
+            t = std::min(sourceEvents[source]->getAbsoluteTime() + offset,
+                         (*targets[target])->getAbsoluteTime());
+        }
+
+        mapped.clear();
+        while (source < sourceEvents.size() &&
+               sourceEvents[source]->getAbsoluteTime() + offset == t) {
+            const Event *e = sourceEvents[source++];
+            mapped.push_back(mapEvent(e, t,
+                                      e->getNotationAbsoluteTime() + offset,
+                                      semitones, steps));
+        }
+
+        size_t targetEnd = target;
+        while (targetEnd < targets.size() &&
+               (*targets[targetEnd])->getAbsoluteTime() == t) {
+            ++targetEnd;
+        }
+
+        bool same = (mapped.size() == targetEnd - target);
+        for (size_t i = 0; same && i < mapped.size(); ++i) {
+            same = mapped[i]->isEquivalentTo(**targets[target + i]);
+        }
+
+        if (same) {
+            for (Event *e : mapped) {
+                delete e;
+            }
+        } else {
+            // Replace all of them, so that they end up in the same order
+            // as in the source.
+            for (size_t i = target; i < targetEnd; ++i) {
+                if (isLyric(*targets[i])) lyricsChanged = true;
+                seg->erase(targets[i]);
+            }
+            for (Event *e : mapped) {
+                if (isLyric(e)) lyricsChanged = true;
+                seg->insert(e);
+            }
+        }
+
+        target = targetEnd;
+    }
+
+    return lyricsChanged;
+}
+
+/*static*/ Event *
+SegmentLinker::mapEvent(const Event *e, timeT t, timeT nt,
+                        int semitones, int steps)
+{
+    if (semitones != 0 && e->isa(Rosegarden::Key::EventType)) {
+        Rosegarden::Key trKey = (Rosegarden::Key (*e)).transpose(semitones,
+                                                                     steps);
+        return trKey.getAsEvent(t);
     }
 
     Event *refSegEvent = new Event(*e,
@@ -281,43 +348,49 @@ SegmentLinker::insertMappedEvent(Segment *seg,
                                    nt,
                                    e->getNotationDuration());
 
-    bool needsInsertion = true;
-
     //correct for temporal (and pitch shift??) here eventually...
-    if (semitones!=0) {
-        if (e->isa(Note::EventType)) {
-            long oldPitch = 0;
-            if (e->get<Int>(BaseProperties::PITCH, oldPitch)) {
-                long newPitch = oldPitch + semitones;
-                refSegEvent->set<Int>(BaseProperties::PITCH, newPitch);
-            }
-        } else if (e->isa(Rosegarden::Key::EventType)) {
-            Rosegarden::Key trKey = (Rosegarden::Key (*e)).transpose(semitones,
-                                                                         steps);
-            delete refSegEvent;
-            refSegEvent = nullptr;
-            SegmentNotationHelper helper(*seg);
-            helper.insertKey(t,trKey);
-            needsInsertion = false;
+    if (semitones!=0 && e->isa(Note::EventType)) {
+        long oldPitch = 0;
+        if (e->get<Int>(BaseProperties::PITCH, oldPitch)) {
+            long newPitch = oldPitch + semitones;
+            refSegEvent->set<Int>(BaseProperties::PITCH, newPitch);
         }
     }
 
-    if (needsInsertion) {
+    return refSegEvent;
+}
 
-        if (! lyricInserted) {
-            // Is the inserted event a lyric?
-            if (e->isa(Text::EventType)) {
-                std::string textType;
-                lyricInserted =
-                    e->get<String>(Text::TextTypePropertyName, textType)
-                    && (textType == Text::Lyric);
-                }
-        }
+/*static*/ bool
+SegmentLinker::isIgnored(const Event *e)
+{
+    bool ignore = false;
+    e->get<Bool>(BaseProperties::LINKED_SEGMENT_IGNORE_UPDATE, ignore);
+    return ignore;
+}
 
-        seg->insert(refSegEvent);
-    }
+/*static*/ bool
+SegmentLinker::isLyric(const Event *e)
+{
+    if (!e->isa(Text::EventType))
+        return false;
+
+    std::string textType;
+    return e->get<String>(Text::TextTypePropertyName, textType)
+           && (textType == Text::Lyric);
+}
+
+bool
+SegmentLinker::insertMappedEvent(Segment *seg,
+                                 const Event *e, timeT t, timeT nt,
+                                 int semitones, int steps,
+                                 bool lyricsAlreadyInserted)
+{
+    if (isIgnored(e))
+        return lyricsAlreadyInserted;
+
+    seg->insert(mapEvent(e, t, nt, semitones, steps));
 
-    return lyricInserted;
+    return lyricsAlreadyInserted || isLyric(e);
 }
 
 bool
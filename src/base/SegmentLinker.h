@@ -20,6 +20,8 @@
 #include "Segment.h"
 #include <QObject>
 
+#include <vector>
+
 namespace Rosegarden
 {
 
@@ -82,6 +84,25 @@ private:
 
     void linkedSegmentChanged(Segment* s, const timeT from, const timeT to);
 
+    /**
+     * Make the non-ignored events of seg in [itrFrom, itrTo) match
+     * sourceEvents, moved by offset and transposed.  Events that
+     * already match are left in place.  Return true if a lyric has
+     * been erased or inserted.
+     */
+    bool updateRange(Segment *seg,
+                     Segment::iterator itrFrom, Segment::iterator itrTo,
+                     const std::vector<const Event *> &sourceEvents,
+                     timeT offset, int semitones, int steps);
+
+    /// The event to put in a linked segment at t for e.
+    static Event *mapEvent(const Event *e, timeT t, timeT nt,
+                           int semitones, int steps);
+
+    /// Is e excluded from link updates?
+    static bool isIgnored(const Event *e);
+    static bool isLyric(const Event *e);
+
     /**
      * Return true if lyricsAlreadyErased is true or if some
      * lyrics have been erased
@@ -26,6 +26,7 @@
 namespace Rosegarden {
 
 EventSelection::EventSelection(Segment& t) :
+    m_batchDepth(0),
     m_originalSegment(t),
     m_beginTime(0),
     m_endTime(0),
@@ -36,6 +37,7 @@ EventSelection::EventSelection(Segment& t) :
 }
 
 EventSelection::EventSelection(Segment& t, timeT beginTime, timeT endTime, bool overlap) :
+    m_batchDepth(0),
     m_originalSegment(t),
     m_beginTime(0),
     m_endTime(0),
@@ -51,7 +53,8 @@ EventSelection::EventSelection(Segment& t, timeT beginTime, timeT endTime, bool
 	m_beginTime = (*i)->getAbsoluteTime();
 	while (i != j) {
 	    m_endTime = (*i)->getAbsoluteTime() + (*i)->getGreaterDuration();
-	    m_segmentEvents.insert(*i);
+	    m_segmentEvents.insert(m_segmentEvents.end(), *i);
+	    m_index.insert(*i);
 	    ++i;
 	}
 	m_haveRealStartTime = true;
@@ -66,7 +69,8 @@ EventSelection::EventSelection(Segment& t, timeT beginTime, timeT endTime, bool
 
             if ((*i)->getAbsoluteTime() + (*i)->getGreaterDuration() > beginTime)
             {
-                m_segmentEvents.insert(*i); // duplicates are filtered automatically
+                if (m_index.insert(*i))
+                    m_segmentEvents.insert(*i);
                 m_beginTime = (*i)->getAbsoluteTime();
             }
             else
@@ -81,8 +85,10 @@ EventSelection::EventSelection(Segment& t, timeT beginTime, timeT endTime, bool
 
 EventSelection::EventSelection(const EventSelection &sel) :
     SegmentObserver(),
+    m_batchDepth(0),
     m_originalSegment(sel.m_originalSegment),
     m_segmentEvents(sel.m_segmentEvents),
+    m_index(sel.m_index),
     m_beginTime(sel.m_beginTime),
     m_endTime(sel.m_endTime),
     m_haveRealStartTime(sel.m_haveRealStartTime)
@@ -117,7 +123,7 @@ EventSelection::operator==(const EventSelection &s) const
 void
 EventSelection::insertThisEvent(Event *e)
 {
-    if (contains(e)) return;
+    if (!m_index.insert(e)) return;
 
     if (e->getAbsoluteTime() < m_beginTime || !m_haveRealStartTime) {
 	m_beginTime = e->getAbsoluteTime();
@@ -132,7 +138,13 @@ EventSelection::insertThisEvent(Event *e)
 	m_endTime = eventEndTime;
     }
 
-    m_segmentEvents.insert(e);
+    // Events usually arrive in time order, so try the end first.
+    m_segmentEvents.insert(m_segmentEvents.end(), e);
+
+    if (m_batchDepth > 0) {
+        if (!m_observers.empty()) m_batchSelected.push_back(e);
+        return;
+    }
 
     // Notify observers of new selected event
     for (ObserverSet::const_iterator i = m_observers.begin(); i != m_observers.end(); ++i) {
@@ -143,10 +155,8 @@ EventSelection::insertThisEvent(Event *e)
 void
 EventSelection::eraseThisEvent(Event *event)
 {
-    // This is probably not needed?  After all, the code below will do nothing
-    // if the event isn't found.
-//    if (!contains(event))
-//        return;
+    if (!m_index.erase(event))
+        return;
 
     // There might be multiple Event objects at the same time.  This will
     // get the range of those.
@@ -162,6 +172,11 @@ EventSelection::eraseThisEvent(Event *event)
 
             eventIter = m_segmentEvents.erase(eventIter);
 
+            if (m_batchDepth > 0) {
+                if (!m_observers.empty()) m_batchDeselected.push_back(event);
+                break;
+            }
+
             // Notify observers
             for (ObserverSet::const_iterator observerIter = m_observers.begin();
                  observerIter != m_observers.end();
@@ -298,6 +313,29 @@ EventSelection::addRemoveEvent(Event *e, EventFuncPtr insertEraseFn,
     return counter;
 }
 
+void
+EventSelection::beginBatch()
+{
+    ++m_batchDepth;
+}
+
+void
+EventSelection::endBatch()
+{
+    if (--m_batchDepth > 0) return;
+
+    // Take them first, in case an observer changes the selection.
+    std::vector<Event *> selected;
+    std::vector<Event *> deselected;
+    selected.swap(m_batchSelected);
+    deselected.swap(m_batchDeselected);
+
+    for (ObserverSet::const_iterator i = m_observers.begin(); i != m_observers.end(); ++i) {
+        if (!deselected.empty()) (*i)->eventsDeselected(this, deselected);
+        if (!selected.empty()) (*i)->eventsSelected(this, selected);
+    }
+}
+
 void
 EventSelection::addObserver(EventSelectionObserver *obs) {
     m_observers.push_back(obs);
@@ -318,11 +356,95 @@ EventSelection::addEvent(Event *e, bool ties, bool forward)
 void
 EventSelection::addFromSelection(EventSelection *sel)
 {
+    beginBatch();
     for (EventContainer::iterator i = sel->getSegmentEvents().begin();
 	 i != sel->getSegmentEvents().end(); ++i) {
         // contains() checked a bit deeper now
         addEvent(*i);
     }
+    endBatch();
+}
+
+void
+EventSelection::addEvents(const std::vector<Event *> &events, bool ties)
+{
+    m_index.reserve(m_index.size() + events.size());
+
+    beginBatch();
+    for (Event *e : events) {
+        // A tied note may already have come in with an earlier one.
+        if (ties && contains(e)) continue;
+        addEvent(e, ties);
+    }
+    endBatch();
+}
+
+void
+EventSelection::selectRange(timeT beginTime, timeT endTime)
+{
+    Segment::iterator i = m_originalSegment.findTime(beginTime);
+    Segment::iterator j = m_originalSegment.findTime(endTime);
+
+    beginBatch();
+    for ( ; i != j; ++i) {
+        insertThisEvent(*i);
+    }
+    endBatch();
+}
+
+void
+EventSelection::invert()
+{
+    std::vector<Event *> unselected;
+    for (Segment::iterator i = m_originalSegment.begin();
+         i != m_originalSegment.end(); ++i) {
+        if (!contains(*i)) unselected.push_back(*i);
+    }
+
+    beginBatch();
+
+    if (!m_observers.empty()) {
+        m_batchDeselected.insert(m_batchDeselected.end(),
+                                 m_segmentEvents.begin(),
+                                 m_segmentEvents.end());
+    }
+    m_segmentEvents.clear();
+    m_index.clear();
+    m_beginTime = 0;
+    m_endTime = 0;
+    m_haveRealStartTime = false;
+
+    m_index.reserve(unselected.size());
+    for (Event *e : unselected) {
+        insertThisEvent(e);
+    }
+
+    endBatch();
+}
+
+void
+EventSelection::filter(const std::function<bool(const Event *)> &keep)
+{
+    std::vector<Event *> rejected;
+    for (EventContainer::const_iterator i = m_segmentEvents.begin();
+         i != m_segmentEvents.end(); ++i) {
+        if (!keep(*i)) rejected.push_back(*i);
+    }
+
+    beginBatch();
+    for (Event *e : rejected) {
+        eraseThisEvent(e);
+    }
+    endBatch();
+}
+
+void
+EventSelection::forEach(const std::function<void(Event *)> &fn) const
+{
+    for (EventContainer::const_iterator i = m_segmentEvents.begin();
+         i != m_segmentEvents.end(); ++i) {
+        fn(*i);
+    }
 }
 
 int
@@ -334,16 +456,7 @@ EventSelection::removeEvent(Event *e, bool ties, bool forward)
 bool
 EventSelection::contains(Event *e) const
 {
-    std::pair<EventContainer::const_iterator, EventContainer::const_iterator>
-	interval = m_segmentEvents.equal_range(e);
-
-    for (EventContainer::const_iterator it = interval.first;
-         it != interval.second; ++it)
-    {
-        if (*it == e) return true;
-    }
-
-    return false;
+    return m_index.contains(e);
 }
 
 bool
@@ -460,8 +573,9 @@ EventSelection::getRangeTimes() const
 void
 EventSelection::eventRemoved(const Segment *s, Event *e)
 {
-    // contains() checked a bit deeper now.
-    if (s == &m_originalSegment) {
+    // Most of the Events a Segment loses aren't selected, and looking
+    // for their ties would be a waste.
+    if (s == &m_originalSegment && contains(e)) {
         removeEvent(e);
     }
 }
@@ -685,4 +799,22 @@ EventSelectionObserver::~EventSelectionObserver()
 {
 }
 
+void
+EventSelectionObserver::eventsSelected(EventSelection *e,
+                                       const std::vector<Event *> &events)
+{
+    for (Event *event : events) {
+        eventSelected(e, event);
+    }
+}
+
+void
+EventSelectionObserver::eventsDeselected(EventSelection *e,
+                                         const std::vector<Event *> &events)
+{
+    for (Event *event : events) {
+        eventDeselected(e, event);
+    }
+}
+
 }
@@ -16,8 +16,11 @@
 #ifndef SELECTION_H
 #define SELECTION_H
 
+#include <functional>
 #include <set>
+#include <vector>
 #include "Event.h"
+#include "EventIndex.h"
 #include "base/Segment.h"
 #include "base/NotationTypes.h"
 #include "Composition.h"
@@ -32,6 +35,17 @@ public:
     virtual void eventSelected(EventSelection *e,Event *)=0;
     virtual void eventDeselected(EventSelection *e,Event *)=0;
     virtual void eventSelectionDestroyed(EventSelection *e)=0;
+
+    /**
+     * Called once for all the events selected or deselected by one of
+     * the bulk EventSelection methods, such as addEvents() or invert().
+     * These call eventSelected() and eventDeselected() for each event
+     * unless overridden.
+     */
+    virtual void eventsSelected(EventSelection *e,
+                                const std::vector<Event *> &events);
+    virtual void eventsDeselected(EventSelection *e,
+                                  const std::vector<Event *> &events);
 };
 
 /**
@@ -85,6 +99,35 @@ public:
      */
     void addFromSelection(EventSelection *sel);
 
+    /**
+     * Add each of the given Events, as addEvent() does, telling the
+     * observers about them all at once.
+     */
+    void addEvents(const std::vector<Event *> &events, bool ties = true);
+
+    /**
+     * Add all the Events in the Segment that start at or after
+     * beginTime and before endTime.
+     */
+    void selectRange(timeT beginTime, timeT endTime);
+
+    /**
+     * Select every Event in the Segment that is not selected, and
+     * deselect every one that is.
+     */
+    void invert();
+
+    /**
+     * Deselect each Event for which keep returns false.
+     */
+    void filter(const std::function<bool(const Event *)> &keep);
+
+    /**
+     * Call fn for each selected Event, in time order.  fn may modify
+     * the Events' properties but must not change the selection.
+     */
+    void forEach(const std::function<void(Event *)> &fn) const;
+
     /**
      * If the given Event is in the selection, take it out.
      *
@@ -95,7 +138,7 @@ public:
 
     /**
      * Test whether a given Event (in the Segment) is part of
-     * this selection.
+     * this selection.  Takes constant time.
      */
     bool contains(Event *e) const;
 
@@ -159,6 +202,11 @@ public:
     unsigned int getAddedEvents() const { return m_segmentEvents.size(); }
     bool empty() const  { return m_segmentEvents.empty(); }
 
+    /**
+     * The selected Events in time order.  Don't insert into or erase
+     * from this: use addEvent() and removeEvent(), which keep the
+     * index that contains() uses up to date.
+     */
     const EventContainer &getSegmentEvents() const { return m_segmentEvents; }
     EventContainer &getSegmentEvents()             { return m_segmentEvents; }
 
@@ -202,9 +250,21 @@ private:
     int addRemoveEvent(Event *e, EventFuncPtr insertEraseFn,
                        bool ties, bool forward);
 
+    /**
+     * Between beginBatch() and endBatch(), insertThisEvent() and
+     * eraseThisEvent() collect the Events they change instead of
+     * telling the observers.  endBatch() tells them about the lot.
+     */
+    void beginBatch();
+    void endBatch();
+
     typedef std::list<EventSelectionObserver *> ObserverSet;
     ObserverSet m_observers;
 
+    int m_batchDepth;
+    std::vector<Event *> m_batchSelected;
+    std::vector<Event *> m_batchDeselected;
+
 protected:
     //--------------- Data members ---------------------------------
 
@@ -213,6 +273,9 @@ protected:
     /// pointers to Events in the original Segment
     EventContainer m_segmentEvents;
 
+    /// The same pointers, for contains().
+    EventIndex m_index;
+
     timeT m_beginTime;
     timeT m_endTime;
     bool m_haveRealStartTime;
@@ -0,0 +1,348 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[TempoMap]"
+#define RG_NO_DEBUG_PRINT
+
+#include "TempoMap.h"
+
+#include "NotationTypes.h"
+#include "misc/Debug.h"
+
+#include <algorithm>
+#include <cmath>
+
+//#define DEBUG_TEMPO_STUFF 1
+
+
+namespace Rosegarden
+{
+
+
+TempoMap::TempoMap(tempoT defaultTempo) :
+    m_defaultTempo(defaultTempo)
+{
+}
+
+void
+TempoMap::addTempoChange(timeT time, tempoT tempo,
+                         tempoT rampTarget, timeT rampEndTime)
+{
+    // Before the first change we are at the default tempo from zero.
+    timeT lastTime = 0;
+    RealTime lastRealTime = RealTime::zero();
+    tempoT lastTempo = m_defaultTempo;
+    tempoT lastTarget = -1;
+
+    if (!m_times.empty()) {
+        lastTime = m_times.back();
+        lastRealTime = m_realTimes.back();
+        lastTempo = m_tempos.back();
+        lastTarget = m_rampTargets.back();
+    }
+
+    RealTime realTime;
+    if (lastTarget > 0) {
+        realTime = lastRealTime +
+            time2RealTime(time - lastTime, lastTempo,
+                          time - lastTime, lastTarget);
+    } else {
+        realTime = lastRealTime + time2RealTime(time - lastTime, lastTempo);
+    }
+
+    m_times.push_back(time);
+    m_realTimes.push_back(realTime);
+    m_tempos.push_back(tempo);
+    m_rampTargets.push_back(rampTarget > 0 ? rampTarget : -1);
+    m_rampEndTimes.push_back(rampEndTime);
+}
+
+int
+TempoMap::changeAtOrBefore(timeT t) const
+{
+    std::vector<timeT>::const_iterator i =
+            std::upper_bound(m_times.begin(), m_times.end(), t);
+    return int(i - m_times.begin()) - 1;
+}
+
+int
+TempoMap::changeAtOrBefore(RealTime t) const
+{
+    std::vector<RealTime>::const_iterator i =
+            std::upper_bound(m_realTimes.begin(), m_realTimes.end(), t);
+    return int(i - m_realTimes.begin()) - 1;
+}
+
+RealTime
+TempoMap::elapsedRealTime(int change, timeT t) const
+{
+    if (change < 0) {
+        // Before the first change.  Only a negative time before a
+        // change at or before zero is measured from that change.
+        if (t >= 0  ||  m_times.empty()  ||  m_times[0] > 0)
+            return time2RealTime(t, m_defaultTempo);
+        change = 0;
+    }
+
+    const timeT changeTime = m_times[change];
+
+    if (m_rampTargets[change] > 0) {
+        return m_realTimes[change] +
+            time2RealTime(t - changeTime, m_tempos[change],
+                          m_rampEndTimes[change] - changeTime,
+                          m_rampTargets[change]);
+    }
+
+    return m_realTimes[change] +
+        time2RealTime(t - changeTime, m_tempos[change]);
+}
+
+timeT
+TempoMap::elapsedTime(int change, RealTime t) const
+{
+    if (change < 0) {
+        if (t >= RealTime::zero()  ||  m_times.empty()  ||  m_times[0] > 0)
+            return realTime2Time(t, m_defaultTempo);
+        change = 0;
+    }
+
+    const timeT changeTime = m_times[change];
+
+    if (m_rampTargets[change] > 0) {
+        return changeTime +
+            realTime2Time(t - m_realTimes[change], m_tempos[change],
+                          m_rampEndTimes[change] - changeTime,
+                          m_rampTargets[change]);
+    }
+
+    return changeTime +
+        realTime2Time(t - m_realTimes[change], m_tempos[change]);
+}
+
+void
+TempoMap::getElapsedRealTimes(const timeT *times, RealTime *realTimes,
+                              size_t count) const
+{
+    if (count == 0)
+        return;
+
+    // One search for the first, then walk forward through the changes.
+    int change = changeAtOrBefore(times[0]);
+    const int last = int(m_times.size()) - 1;
+
+    for (size_t n = 0; n < count; ++n) {
+        while (change < last  &&  m_times[change + 1] <= times[n])
+            ++change;
+        realTimes[n] = elapsedRealTime(change, times[n]);
+    }
+}
+
+void
+TempoMap::getElapsedTimesForRealTimes(const RealTime *realTimes, timeT *times,
+                                      size_t count) const
+{
+    if (count == 0)
+        return;
+
+    int change = changeAtOrBefore(realTimes[0]);
+    const int last = int(m_realTimes.size()) - 1;
+
+    for (size_t n = 0; n < count; ++n) {
+        while (change < last  &&  m_realTimes[change + 1] <= realTimes[n])
+            ++change;
+        times[n] = elapsedTime(change, realTimes[n]);
+    }
+}
+
+#ifdef DEBUG_TEMPO_STUFF
+static int DEBUG_silence_recursive_tempo_printout = 0;
+#endif
+
+RealTime
+TempoMap::time2RealTime(timeT t, tempoT tempo)
+{
+    static timeT cdur = Note(Note::Crotchet).getDuration();
+
+    double dt = (double(t) * 100000 * 60) / (double(tempo) * cdur);
+
+    int sec = int(dt);
+    int nsec = int((dt - sec) * 1000000000);
+
+    RealTime rt(sec, nsec);
+
+#ifdef DEBUG_TEMPO_STUFF
+    if (!DEBUG_silence_recursive_tempo_printout) {
+        RG_DEBUG << "time2RealTime(): t " << t << ", sec " << sec << ", nsec "
+             << nsec << ", tempo " << tempo
+             << ", cdur " << cdur << ", dt " << dt << ", rt " << rt;
+        DEBUG_silence_recursive_tempo_printout = 1;
+        timeT ct = realTime2Time(rt, tempo);
+        timeT et = t - ct;
+        RealTime ert = time2RealTime(et, tempo);
+        RG_DEBUG << "cf. realTime2Time(" << rt << ") -> " << ct << " [err " << et << " (" << ert << "?)]";
+        DEBUG_silence_recursive_tempo_printout=0;
+    }
+#endif
+
+    return rt;
+}
+
+RealTime
+TempoMap::time2RealTime(timeT time, tempoT tempo,
+                        timeT targetTime, tempoT targetTempo)
+{
+    static timeT cdur = Note(Note::Crotchet).getDuration();
+
+    // The real time elapsed at musical time t, in seconds, during a
+    // smooth tempo change from "tempo" at musical time zero to
+    // "targetTempo" at musical time "targetTime", is
+    //
+    //           2
+    //     at + t (b - a)
+    //          ---------
+    //             2n
+    // where
+    //
+    // a is the initial tempo in seconds per tick
+    // b is the target tempo in seconds per tick
+    // n is targetTime in ticks
+
+    if (targetTime == 0 || targetTempo == tempo) {
+        return time2RealTime(time, targetTempo);
+    }
+
+    double a = (100000 * 60) / (double(tempo) * cdur);
+    double b = (100000 * 60) / (double(targetTempo) * cdur);
+    double t = time;
+    double n = targetTime;
+    double result = (a * t) + (t * t * (b - a)) / (2 * n);
+
+    int sec = int(result);
+    int nsec = int((result - sec) * 1000000000);
+
+    RealTime rt(sec, nsec);
+
+#ifdef DEBUG_TEMPO_STUFF
+    if (!DEBUG_silence_recursive_tempo_printout) {
+        RG_DEBUG << "time2RealTime(): [2] time " << time << ", tempo "
+             << tempo << ", targetTime " << targetTime << ", targetTempo "
+             << targetTempo << ": rt " << rt;
+        DEBUG_silence_recursive_tempo_printout = 1;
+//        RealTime nextRt = time2RealTime(targetTime, tempo, targetTime, targetTempo);
+        timeT ct = realTime2Time(rt, tempo, targetTime, targetTempo);
+        RG_DEBUG << "cf. realTime2Time: rt " << rt << " -> " << ct;
+        DEBUG_silence_recursive_tempo_printout=0;
+    }
+#endif
+
+    return rt;
+}
+
+timeT
+TempoMap::realTime2Time(RealTime rt, tempoT tempo)
+{
+    static timeT cdur = Note(Note::Crotchet).getDuration();
+
+    double tsec = (double(rt.sec) * cdur) * (tempo / (60.0 * 100000.0));
+    double tnsec = (double(rt.nsec) * cdur) * (tempo / 100000.0);
+
+    double dt = tsec + (tnsec / 60000000000.0);
+    timeT t = (timeT)(dt + (dt < 0 ? -1e-6 : 1e-6));
+
+#ifdef DEBUG_TEMPO_STUFF
+    if (!DEBUG_silence_recursive_tempo_printout) {
+        RG_DEBUG << "realTime2Time(): rt.sec " << rt.sec << ", rt.nsec "
+             << rt.nsec << ", tempo " << tempo
+             << ", cdur " << cdur << ", tsec " << tsec << ", tnsec " << tnsec << ", dt " << dt << ", t " << t;
+        DEBUG_silence_recursive_tempo_printout = 1;
+        RealTime crt = time2RealTime(t, tempo);
+        RealTime ert = rt - crt;
+        timeT et = realTime2Time(ert, tempo);
+        RG_DEBUG << "cf. time2RealTime(" << t << ") -> " << crt << " [err " << ert << " (" << et << "?)]";
+        DEBUG_silence_recursive_tempo_printout = 0;
+    }
+#endif
+
+    return t;
+}
+
+timeT
+TempoMap::realTime2Time(RealTime rt, tempoT tempo,
+                        timeT targetTime, tempoT targetTempo)
+{
+    static timeT cdur = Note(Note::Crotchet).getDuration();
+
+    // Inverse of the expression in time2RealTime above.
+    //
+    // The musical time elapsed at real time t, in ticks, during a
+    // smooth tempo change from "tempo" at real time zero to
+    // "targetTempo" at real time "targetTime", is
+    //
+    //          2na (+/-) sqrt((2nb)^2 + 8(b-a)tn)
+    //       -  ----------------------------------
+    //                       2(b-a)
+    // where
+    //
+    // a is the initial tempo in seconds per tick
+    // b is the target tempo in seconds per tick
+    // n is target real time in ticks
+
+    if (targetTempo == tempo) return realTime2Time(rt, tempo);
+
+    double a = (100000 * 60) / (double(tempo) * cdur);
+    double b = (100000 * 60) / (double(targetTempo) * cdur);
+    double t = double(rt.sec) + double(rt.nsec) / 1e9;
+    double n = targetTime;
+
+    double term1 = 2.0 * n * a;
+    double term2 = (2.0 * n * a) * (2.0 * n * a) + 8 * (b - a) * t * n;
+
+    if (term2 < 0) {
+        // We're screwed, but at least let's not crash
+        RG_WARNING << "realTime2Time(): ERROR: term2 < 0 (it's " << term2 << ")";
+#ifdef DEBUG_TEMPO_STUFF
+        RG_DEBUG << "rt = " << rt << ", tempo = " << tempo << ", targetTime = " << targetTime << ", targetTempo = " << targetTempo;
+        RG_DEBUG << "n = " << n << ", b = " << b << ", a = " << a << ", t = " << t;
+        RG_DEBUG << "that's sqrt( (" << ((2.0*n*a*2.0*n*a)) << ") + "
+                  << (8*(b-a)*t*n) << " )";
+
+        RG_DEBUG << "so our original expression was " << rt << " = "
+                  << a << "t + (t^2 * (" << b << " - " << a << ")) / " << 2*n;
+#endif
+
+        return realTime2Time(rt, tempo);
+    }
+
+    double term3 = std::sqrt(term2);
+
+    // We only want the positive root
+    if (term3 > 0) term3 = -term3;
+
+    double result = - (term1 + term3) / (2 * (b - a));
+
+#ifdef DEBUG_TEMPO_STUFF
+    RG_DEBUG << "realTime2Time():";
+    RG_DEBUG << "n = " << n << ", b = " << b << ", a = " << a << ", t = " << t;
+    RG_DEBUG << "+/-sqrt(term2) = " << term3;
+    RG_DEBUG << "result = " << result;
+#endif
+
+    return long(result + 0.1);
+}
+
+
+}
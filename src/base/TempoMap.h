@@ -0,0 +1,127 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_TEMPOMAP_H
+#define RG_TEMPOMAP_H
+
+#include "RealTime.h"
+#include "TimeT.h"
+
+#include <rosegardenprivate_export.h>
+
+#include <stddef.h>
+#include <vector>
+
+namespace Rosegarden
+{
+
+// We store tempo in quarter-notes per minute * 10^5 (hundred
+// thousandths of a quarter-note per minute).  This means the maximum
+// tempo in a 32-bit integer is about 21400 qpm.  We use a signed int
+// for compatibility with the Event integer type -- but note that we
+// use 0 (rather than -1) to indicate "tempo not set", by convention
+// (though see usage of target tempo in e.g. addTempoAtTime).
+typedef int tempoT;
+
+
+/// Read-only snapshot of a Composition's tempo changes.
+/**
+ * Converts between timeT and RealTime.  Composition rebuilds one of these
+ * whenever its tempos change (see Composition::getTempoMap()), and its
+ * own getElapsedRealTime() and getElapsedTimeForRealTime() use it.
+ *
+ * The tempo changes are held in flat arrays of time, real time, tempo
+ * and ramp target, so a conversion is a binary search plus a little
+ * arithmetic.  Nothing is looked up in PropertyMaps.  To convert many
+ * times in order, use getElapsedRealTimes() or
+ * getElapsedTimesForRealTimes(), which walk the changes once instead
+ * of searching for each time.
+ *
+ * A TempoMap is never modified once Composition has built it, so it
+ * may be handed to other threads.  Keep hold of the QSharedPointer for
+ * as long as it is in use.
+ */
+class ROSEGARDENPRIVATE_EXPORT TempoMap
+{
+public:
+    /// A map with no changes, at defaultTempo throughout.
+    explicit TempoMap(tempoT defaultTempo);
+
+    /// Add the next tempo change.  Used by Composition to build the map.
+    /**
+     * Changes must be added in time order.  rampTarget is the tempo
+     * being ramped to by rampEndTime, or -1 for a constant tempo.
+     */
+    void addTempoChange(timeT time, tempoT tempo,
+                        tempoT rampTarget, timeT rampEndTime);
+
+    /// Number of tempo changes.
+    size_t size() const  { return m_times.size(); }
+
+    /// Elapsed real time at the n'th tempo change.
+    RealTime getTempoChangeRealTime(size_t n) const  { return m_realTimes[n]; }
+
+    /// See Composition::getElapsedRealTime().
+    RealTime getElapsedRealTime(timeT t) const
+        { return elapsedRealTime(changeAtOrBefore(t), t); }
+
+    /// See Composition::getElapsedTimeForRealTime().
+    timeT getElapsedTimeForRealTime(RealTime t) const
+        { return elapsedTime(changeAtOrBefore(t), t); }
+
+    /// Convert count times, which must be in ascending order.
+    void getElapsedRealTimes(const timeT *times, RealTime *realTimes,
+                             size_t count) const;
+
+    /// Convert count real times, which must be in ascending order.
+    void getElapsedTimesForRealTimes(const RealTime *realTimes, timeT *times,
+                                     size_t count) const;
+
+    /// Real time taken by t at a constant tempo.
+    static RealTime time2RealTime(timeT t, tempoT tempo);
+    /// Real time taken by time during a ramp to targetTempo at targetTime.
+    static RealTime time2RealTime(timeT time, tempoT tempo,
+                                  timeT targetTime, tempoT targetTempo);
+    /// Inverse of time2RealTime(timeT, tempoT).
+    static timeT realTime2Time(RealTime rt, tempoT tempo);
+    /// Inverse of time2RealTime(timeT, tempoT, timeT, tempoT).
+    static timeT realTime2Time(RealTime rt, tempoT tempo,
+                               timeT targetTime, tempoT targetTempo);
+
+private:
+    /// Index of the last change at or before t, or -1 if none.
+    int changeAtOrBefore(timeT t) const;
+    int changeAtOrBefore(RealTime t) const;
+
+    /// Convert t, given the change at or before it.
+    RealTime elapsedRealTime(int change, timeT t) const;
+    timeT elapsedTime(int change, RealTime t) const;
+
+    tempoT m_defaultTempo;
+
+    std::vector<timeT> m_times;
+    std::vector<RealTime> m_realTimes;
+    std::vector<tempoT> m_tempos;
+    /// Tempo ramped to by m_rampEndTimes, or -1 if not ramping.
+    std::vector<tempoT> m_rampTargets;
+    std::vector<timeT> m_rampEndTimes;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,375 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[Trace]"
+
+#include "Trace.h"
+
+#include "misc/Debug.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+    /// Most recent sections timed by one thread.
+    /**
+     * Only the owning thread writes.  writeChromeTrace() may read while
+     * it does, so each field is atomic, and a reader checks afterwards
+     * which of the entries it read could have been overwritten.
+     */
+    struct ThreadBuffer
+    {
+        static const uint64_t capacity = 16384;
+
+        struct Entry
+        {
+            std::atomic<const TracePoint *> point;
+            std::atomic<uint64_t> start;
+            std::atomic<uint64_t> end;
+        };
+
+        ThreadBuffer() :
+            written(0),
+            inUse(true),
+            threadName(nullptr),
+            tid(0),
+            next(nullptr)
+        { }
+
+        Entry entries[capacity];
+        std::atomic<uint64_t> written;
+        /// False once the thread has exited, so another can reuse it.
+        std::atomic<bool> inUse;
+        std::atomic<const char *> threadName;
+        int tid;
+        ThreadBuffer *next;
+    };
+
+    /// All buffers ever made.  They are never freed, only reused.
+    std::atomic<ThreadBuffer *> buffers(nullptr);
+    std::atomic<int> bufferCount(0);
+
+    /// Gives the calling thread's buffer back when the thread exits.
+    struct ThreadBufferHolder
+    {
+        ThreadBufferHolder() : buffer(nullptr) { }
+        ~ThreadBufferHolder()
+        {
+            if (buffer)
+                buffer->inUse.store(false, std::memory_order_release);
+        }
+
+        ThreadBuffer *buffer;
+    };
+
+    thread_local ThreadBufferHolder threadBuffer;
+
+    /// threadBuffer.buffer, for record().  The holder has a destructor,
+    /// so the first use of it on a thread may allocate to register that.
+    /// A plain pointer is set up statically, so reading it never does.
+    thread_local ThreadBuffer *currentBuffer = nullptr;
+
+    /// Find or make the calling thread's buffer.  May allocate.
+    ThreadBuffer *getThreadBuffer(const char *threadName)
+    {
+        if (currentBuffer)
+            return currentBuffer;
+
+        // Reuse one whose thread has gone.
+        for (ThreadBuffer *buffer = buffers.load(std::memory_order_acquire);
+             buffer; buffer = buffer->next) {
+            bool inUse = false;
+            if (buffer->inUse.compare_exchange_strong(inUse, true)) {
+                buffer->threadName.store(threadName,
+                                         std::memory_order_relaxed);
+                threadBuffer.buffer = buffer;
+                currentBuffer = buffer;
+                return buffer;
+            }
+        }
+
+        ThreadBuffer *buffer = new ThreadBuffer;
+        buffer->tid = ++bufferCount;
+        buffer->threadName.store(threadName, std::memory_order_relaxed);
+        buffer->next = buffers.load(std::memory_order_relaxed);
+        while (!buffers.compare_exchange_weak(buffer->next, buffer,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) { }
+        threadBuffer.buffer = buffer;
+        currentBuffer = buffer;
+        return buffer;
+    }
+
+    /// Open-addressed on the name's address.  Entries are never removed.
+    const size_t pointCount = 1024;
+    TracePoint points[pointCount];
+
+    std::atomic<TraceCounter *> counters(nullptr);
+
+    uint64_t startTime = 0;
+
+    const char *outputPath()
+    {
+        const char *path = getenv("ROSEGARDEN_TRACE");
+        if (!path || !*path || !strcmp(path, "1"))
+            return nullptr;
+        return path;
+    }
+
+    /// Sets things up before main(), when there is only one thread.
+    struct Init
+    {
+        Init()
+        {
+            startTime = Trace::now();
+            if (getenv("ROSEGARDEN_TRACE"))
+                Trace::setEnabled(true);
+        }
+    };
+
+    Init init;
+}
+
+std::atomic<bool> Trace::m_enabled(false);
+
+
+void
+TracePoint::add(uint64_t ns)
+{
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_totalNs.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t worst = m_worstNs.load(std::memory_order_relaxed);
+    while (ns > worst &&
+           !m_worstNs.compare_exchange_weak(worst, ns,
+                                            std::memory_order_relaxed)) { }
+}
+
+
+TraceCounter::TraceCounter(const char *name) :
+    m_name(name),
+    m_value(0),
+    m_next(counters.load(std::memory_order_relaxed))
+{
+    while (!counters.compare_exchange_weak(m_next, this,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) { }
+}
+
+
+void
+Trace::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_release);
+}
+
+uint64_t
+Trace::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+TracePoint *
+Trace::getPoint(const char *name)
+{
+    const size_t home =
+            size_t((uint64_t(uintptr_t(name)) * 0x9E3779B97F4A7C15ull) >> 54);
+
+    for (size_t n = 0; n < pointCount; ++n) {
+        TracePoint &point = points[(home + n) % pointCount];
+        const char *existing = point.m_name.load(std::memory_order_acquire);
+        if (!existing &&
+            point.m_name.compare_exchange_strong(existing, name,
+                                                 std::memory_order_acq_rel))
+            return &point;
+        // The slot is taken, perhaps by another thread that has just
+        // added the same name.
+        if (existing == name)
+            return &point;
+    }
+
+    return nullptr;
+}
+
+void
+Trace::record(TracePoint *point, uint64_t start, uint64_t end)
+{
+    if (!point)
+        return;
+
+    point->add(end - start);
+
+    // Threads that haven't called setThreadName() have no buffer, and
+    // making one here could allocate on a real-time thread.
+    ThreadBuffer *buffer = currentBuffer;
+    if (!buffer)
+        return;
+
+    const uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    ThreadBuffer::Entry &entry =
+            buffer->entries[index % ThreadBuffer::capacity];
+    entry.point.store(point, std::memory_order_relaxed);
+    entry.start.store(start, std::memory_order_relaxed);
+    entry.end.store(end, std::memory_order_relaxed);
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void
+Trace::setThreadName(const char *name)
+{
+    ThreadBuffer *buffer = getThreadBuffer(name);
+    buffer->threadName.store(name, std::memory_order_relaxed);
+}
+
+std::vector<const TracePoint *>
+Trace::getPoints()
+{
+    std::vector<const TracePoint *> result;
+    for (size_t n = 0; n < pointCount; ++n) {
+        if (points[n].getName())
+            result.push_back(&points[n]);
+    }
+    return result;
+}
+
+std::vector<const TraceCounter *>
+Trace::getCounters()
+{
+    std::vector<const TraceCounter *> result;
+    for (const TraceCounter *counter =
+                 counters.load(std::memory_order_acquire);
+         counter; counter = counter->m_next) {
+        result.push_back(counter);
+    }
+    return result;
+}
+
+bool
+Trace::writeChromeTrace(const QString &filename)
+{
+    QJsonArray events;
+
+    // Microseconds since startup.
+    auto timestamp = [](uint64_t ns) {
+        return double(ns - startTime) / 1000.0;
+    };
+
+    for (ThreadBuffer *buffer = buffers.load(std::memory_order_acquire);
+         buffer; buffer = buffer->next) {
+
+        const uint64_t written =
+                buffer->written.load(std::memory_order_acquire);
+        const uint64_t first = (written > ThreadBuffer::capacity) ?
+                written - ThreadBuffer::capacity : 0;
+
+        QJsonArray threadEvents;
+        std::vector<uint64_t> indices;
+        for (uint64_t i = first; i < written; ++i) {
+            const ThreadBuffer::Entry &entry =
+                    buffer->entries[i % ThreadBuffer::capacity];
+            const TracePoint *point =
+                    entry.point.load(std::memory_order_relaxed);
+            const uint64_t start = entry.start.load(std::memory_order_relaxed);
+            const uint64_t end = entry.end.load(std::memory_order_relaxed);
+
+            QJsonObject event;
+            event["name"] = point->getName();
+            event["ph"] = "X";
+            event["ts"] = timestamp(start);
+            event["dur"] = double(end - start) / 1000.0;
+            event["pid"] = 1;
+            event["tid"] = buffer->tid;
+            threadEvents.append(event);
+            indices.push_back(i);
+        }
+
+        // Anything the thread may have written over while we read is
+        // not to be trusted.
+        const uint64_t writtenAfter =
+                buffer->written.load(std::memory_order_acquire);
+        const uint64_t firstSafe = (writtenAfter > ThreadBuffer::capacity) ?
+                writtenAfter - ThreadBuffer::capacity + 1 : 0;
+        for (int n = 0; n < threadEvents.size(); ++n) {
+            if (indices[n] >= firstSafe)
+                events.append(threadEvents[n]);
+        }
+
+        const char *threadName =
+                buffer->threadName.load(std::memory_order_relaxed);
+        if (threadName) {
+            QJsonObject args;
+            args["name"] = threadName;
+            QJsonObject event;
+            event["name"] = "thread_name";
+            event["ph"] = "M";
+            event["pid"] = 1;
+            event["tid"] = buffer->tid;
+            event["args"] = args;
+            events.append(event);
+        }
+    }
+
+    const double end = timestamp(now());
+    for (const TraceCounter *counter : getCounters()) {
+        QJsonObject args;
+        args["value"] = double(counter->get());
+        QJsonObject event;
+        event["name"] = counter->getName();
+        event["ph"] = "C";
+        event["ts"] = end;
+        event["pid"] = 1;
+        event["args"] = args;
+        events.append(event);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ns";
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        RG_WARNING << "writeChromeTrace(): Can't open" << filename;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+void
+Trace::saveIfRequested()
+{
+    const char *path = outputPath();
+    if (path)
+        writeChromeTrace(QString::fromLocal8Bit(path));
+}
+
+
+}
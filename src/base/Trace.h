@@ -0,0 +1,218 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_TRACE_H
+#define RG_TRACE_H
+
+#include <rosegardenprivate_export.h>
+
+#include <QString>
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+namespace Rosegarden
+{
+
+
+/// Timing totals for one named section of code.
+/**
+ * Get one from Trace::getPoint(), usually through RG_TRACE_SCOPE or
+ * Profiler.  There is one per name, and it lives as long as the
+ * program does.
+ */
+class ROSEGARDENPRIVATE_EXPORT TracePoint
+{
+public:
+    /// For Trace only.  Use Trace::getPoint().
+    constexpr TracePoint() :
+        m_name(nullptr),
+        m_count(0),
+        m_totalNs(0),
+        m_worstNs(0)
+    { }
+
+    const char *getName() const
+        { return m_name.load(std::memory_order_acquire); }
+
+    uint64_t getCount() const
+        { return m_count.load(std::memory_order_relaxed); }
+    uint64_t getTotalNs() const
+        { return m_totalNs.load(std::memory_order_relaxed); }
+    uint64_t getWorstNs() const
+        { return m_worstNs.load(std::memory_order_relaxed); }
+
+private:
+    friend class Trace;
+
+    TracePoint(const TracePoint &) = delete;
+    TracePoint &operator=(const TracePoint &) = delete;
+
+    void add(uint64_t ns);
+
+    std::atomic<const char *> m_name;
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_totalNs;
+    std::atomic<uint64_t> m_worstNs;
+};
+
+/// A count of something going wrong, such as an xrun.
+/**
+ * Only create these with static storage duration:
+ *
+ *   static TraceCounter xruns("JackDriver xruns");
+ *   xruns.increment();
+ *
+ * Each registers itself on construction, so that Trace can report
+ * them all.  increment() is a single atomic add, and counts whether or
+ * not tracing is enabled.
+ */
+class ROSEGARDENPRIVATE_EXPORT TraceCounter
+{
+public:
+    explicit TraceCounter(const char *name);
+
+    void increment()  { m_value.fetch_add(1, std::memory_order_relaxed); }
+
+    const char *getName() const  { return m_name; }
+    uint64_t get() const  { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    friend class Trace;
+
+    TraceCounter(const TraceCounter &) = delete;
+    TraceCounter &operator=(const TraceCounter &) = delete;
+
+    const char *m_name;
+    std::atomic<uint64_t> m_value;
+    TraceCounter *m_next;
+};
+
+/// Tracing of timed sections of code, for use on any thread.
+/**
+ * Each thread that calls setThreadName() gets its own ring buffer of
+ * the most recent sections it timed, which only it writes to, so
+ * recording takes no locks and allocates nothing.  This makes it safe
+ * to use in the JACK process callback and the other audio and
+ * sequencer threads.  Sections timed on threads that haven't called
+ * it only go into the totals.  Each TracePoint keeps totals for the
+ * whole run, which Profiles::dump() prints.
+ *
+ * Tracing is off unless the ROSEGARDEN_TRACE environment variable is
+ * set, or setEnabled() turns it on.  When it is off, a traced section
+ * costs one relaxed atomic load.  ROSEGARDEN_TRACE=1 just turns it on;
+ * any other value is taken as a file for saveIfRequested() to write.
+ *
+ * writeChromeTrace() writes what the buffers hold in the Chrome trace
+ * event format, which chrome://tracing and https://ui.perfetto.dev can
+ * display.
+ */
+class ROSEGARDENPRIVATE_EXPORT Trace
+{
+public:
+    static bool isEnabled()
+        { return m_enabled.load(std::memory_order_relaxed); }
+
+    static void setEnabled(bool enabled);
+
+    /// Monotonic time in nanoseconds.
+    static uint64_t now();
+
+    /// The TracePoint for name, which should be a string literal.
+    /**
+     * Returns nullptr if there are too many already.  This takes no
+     * locks, but RG_TRACE_SCOPE only calls it once per scope.
+     */
+    static TracePoint *getPoint(const char *name);
+
+    /// Add a section that ran from start to end (see now()).
+    /**
+     * Never allocates.  The section is only buffered for
+     * writeChromeTrace() if the calling thread has called
+     * setThreadName().
+     */
+    static void record(TracePoint *point, uint64_t start, uint64_t end);
+
+    /// Name the calling thread in the trace, and give it a buffer.
+    /**
+     * name should be a literal.  The first call on a thread may
+     * allocate, so call it from the thread's setup code, not from a
+     * real-time callback.  Threads may call it whether or not tracing
+     * is enabled.
+     */
+    static void setThreadName(const char *name);
+
+    /// Every TracePoint used so far.
+    static std::vector<const TracePoint *> getPoints();
+
+    /// Every TraceCounter.
+    static std::vector<const TraceCounter *> getCounters();
+
+    /// Write the buffered sections and the counters as Chrome trace
+    /// event JSON.
+    static bool writeChromeTrace(const QString &filename);
+
+    /// If ROSEGARDEN_TRACE names a file, write the trace to it.  Called
+    /// on the way out.
+    static void saveIfRequested();
+
+private:
+    static std::atomic<bool> m_enabled;
+};
+
+/// Times the rest of the enclosing scope.  See RG_TRACE_SCOPE.
+class TraceScope
+{
+public:
+    explicit TraceScope(TracePoint *point) :
+        m_point(point),
+        m_start(Trace::isEnabled() ? Trace::now() : 0)
+    { }
+
+    ~TraceScope()
+    {
+        if (m_start)
+            Trace::record(m_point, m_start, Trace::now());
+    }
+
+private:
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    TracePoint *m_point;
+    uint64_t m_start;
+};
+
+#define RG_TRACE_CONCAT2(a, b) a##b
+#define RG_TRACE_CONCAT(a, b) RG_TRACE_CONCAT2(a, b)
+
+/// Trace the rest of the enclosing scope under name, a string literal.
+/**
+ * The TracePoint is looked up once, the first time through.
+ */
+#define RG_TRACE_SCOPE(name) \
+    static Rosegarden::TracePoint *const \
+        RG_TRACE_CONCAT(rgTracePoint, __LINE__) = \
+            Rosegarden::Trace::getPoint(name); \
+    Rosegarden::TraceScope RG_TRACE_CONCAT(rgTraceScope, __LINE__)( \
+            RG_TRACE_CONCAT(rgTracePoint, __LINE__))
+
+
+}
+
+#endif
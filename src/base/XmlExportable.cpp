@@ -26,13 +26,15 @@ namespace
     class Deleter
     {
     public:
-        explicit Deleter(char *p) : m_p(p)  { }
+        // Hold a reference, as the buffer is realloc()ed after we are
+        // constructed.
+        explicit Deleter(char *&p) : m_p(p)  { }
         ~Deleter()
         {
             std::free(m_p);
         }
     private:
-        char *m_p;
+        char *&m_p;
     };
 }
 
@@ -42,15 +44,17 @@ namespace Rosegarden
 
 std::string XmlExportable::encode(const std::string &s0)
 {
-    static char *buffer = nullptr;
-    // Make sure we don't leak.  This will free(buffer) at static
-    // destruction time.
-    static Deleter deleter(buffer);
-    static size_t bufsiz = 0;
+    // One buffer per thread, since the document is saved from several
+    // threads at once.  See RosegardenDocument::writeXml().
+    thread_local char *buffer = nullptr;
+    // Make sure we don't leak.  This will free(buffer) when the thread
+    // exits.
+    thread_local Deleter deleter(buffer);
+    thread_local size_t bufsiz = 0;
 
     size_t buflen = 0;
 
-    static char multibyte[20];
+    char multibyte[20];
     size_t mblen = 0;
 
     size_t len = s0.length();
@@ -24,7 +24,7 @@ namespace Rosegarden
 {
 
 
-const std::string GeneratedRegion::EventType = "generated region";
+const std::string &GeneratedRegion::EventType = Event::internType("generated region");
 const int GeneratedRegion::EventSubOrdering = -180;
 const PropertyName GeneratedRegion::ChordPropertyName("chord source ID");
 const PropertyName GeneratedRegion::FigurationPropertyName("figuration source ID");
@@ -0,0 +1,500 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+// rosegarden-convert: converts .rg and MIDI files to other formats in
+// bulk, without a display.
+//
+//   rosegarden-convert -f lilypond -o out/ -j 8 --report report.json songs/
+//
+// Each file is converted by a worker process (this program, run with
+// --worker) rather than a thread, because the document model keeps
+// state for the whole process (RosegardenDocument::currentDocument,
+// the CommandHistory and so on).  That also means a file that crashes
+// the loader fails alone, and the peak memory reported for each file
+// is that file's.
+
+#include "document/io/DocumentConverter.h"
+#include "misc/Strings.h"
+
+#include "sound/audiostream/WavFileReadStream.h"
+#include "sound/audiostream/WavFileWriteStream.h"
+#include "sound/audiostream/OggVorbisReadStream.h"
+#include "sound/audiostream/SimpleWavFileWriteStream.h"
+
+#include "rosegarden-version.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QThread>
+#include <QTimer>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace Rosegarden;
+
+
+namespace
+{
+
+    /// Peak resident set size of this process, in kilobytes.
+    long peakRssKb()
+    {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+        // Kilobytes on Linux.
+        return usage.ru_maxrss;
+    }
+
+    /// Convert one file and print the result as one line of JSON.
+    int runWorker(const QString &input, const QString &output,
+                  DocumentConverter::Format format)
+    {
+        QJsonObject result;
+        QElapsedTimer timer;
+        bool ok;
+
+        DocumentConverter converter;
+
+        timer.start();
+        ok = converter.load(input);
+        result["load_ms"] = double(timer.nsecsElapsed()) / 1e6;
+
+        if (ok) {
+            timer.start();
+            ok = converter.save(output, format);
+            result["export_ms"] = double(timer.nsecsElapsed()) / 1e6;
+        }
+
+        result["ok"] = ok;
+        if (!ok)
+            result["error"] = converter.getError();
+        result["peak_rss_kb"] = double(peakRssKb());
+
+        std::cout << QJsonDocument(result).toJson(QJsonDocument::Compact)
+                         .constData() << std::endl;
+
+        return ok ? 0 : 1;
+    }
+
+    struct Job
+    {
+        QString input;
+        QString output;
+        QJsonObject result;
+        double wallMs = 0;
+    };
+
+    /// Runs the workers, up to a given number at a time.
+    class Batch
+    {
+    public:
+        Batch(std::vector<Job> &jobs, const QString &format,
+              int maxRunning, int timeoutSeconds) :
+            m_jobs(jobs),
+            m_format(format),
+            m_maxRunning(maxRunning),
+            m_timeoutMs(timeoutSeconds * 1000),
+            m_next(0),
+            m_running(0),
+            m_failed(0)
+        { }
+
+        /// Returns the number of files that failed.
+        int run()
+        {
+            QElapsedTimer timer;
+            timer.start();
+
+            QTimer::singleShot(0, [this]() { startMore(); });
+            if (!m_jobs.empty())
+                QCoreApplication::exec();
+
+            m_totalMs = double(timer.nsecsElapsed()) / 1e6;
+            return m_failed;
+        }
+
+        double getTotalMs() const  { return m_totalMs; }
+
+    private:
+        void startMore()
+        {
+            while (m_running < m_maxRunning  &&  m_next < m_jobs.size())
+                start(m_next++);
+
+            if (m_running == 0)
+                QCoreApplication::quit();
+        }
+
+        void start(size_t index)
+        {
+            Job &job = m_jobs[index];
+
+            QProcess *process = new QProcess;
+            // Nobody reads it, and a full pipe would stall the worker.
+            process->setStandardErrorFile(QProcess::nullDevice());
+            std::shared_ptr<QElapsedTimer> timer(new QElapsedTimer);
+            timer->start();
+
+            if (m_timeoutMs > 0) {
+                QTimer::singleShot(m_timeoutMs, process, [process]() {
+                    process->kill();
+                });
+            }
+
+            QObject::connect(
+                    process,
+                    static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(
+                            &QProcess::finished),
+                    [this, process, index, timer](
+                            int /*exitCode*/, QProcess::ExitStatus status) {
+                        finished(index, process, status,
+                                 double(timer->nsecsElapsed()) / 1e6);
+                    });
+
+            // finished() never comes if the worker can't be started.
+            QObject::connect(
+                    process, &QProcess::errorOccurred,
+                    [this, process, index](QProcess::ProcessError error) {
+                        if (error == QProcess::FailedToStart)
+                            finished(index, process, QProcess::CrashExit, 0);
+                    });
+
+            ++m_running;
+            process->start(QCoreApplication::applicationFilePath(),
+                           QStringList() << "--worker"
+                                         << "--format" << m_format
+                                         << job.input << job.output);
+        }
+
+        void finished(size_t index, QProcess *process,
+                      QProcess::ExitStatus status, double wallMs)
+        {
+            Job &job = m_jobs[index];
+            job.wallMs = wallMs;
+
+            // The worker's result is the last line it printed.
+            const QList<QByteArray> lines =
+                    process->readAllStandardOutput().trimmed().split('\n');
+            const QJsonDocument document =
+                    QJsonDocument::fromJson(lines.last());
+
+            if (status == QProcess::NormalExit  &&  document.isObject()) {
+                job.result = document.object();
+            } else {
+                job.result["ok"] = false;
+                job.result["error"] = QString("worker crashed or timed out");
+            }
+
+            const bool ok = job.result["ok"].toBool();
+            if (!ok)
+                ++m_failed;
+
+            std::cout << (ok ? "ok    " : "FAIL  ")
+                      << qPrintable(QString::number(wallMs, 'f', 1))
+                      << " ms  "
+                      << qPrintable(QString::number(
+                             job.result["peak_rss_kb"].toDouble() / 1024.0,
+                             'f', 1))
+                      << " MB  " << job.input;
+            if (!ok)
+                std::cout << ": " << job.result["error"].toString();
+            std::cout << std::endl;
+
+            process->deleteLater();
+            --m_running;
+            startMore();
+        }
+
+        std::vector<Job> &m_jobs;
+        QString m_format;
+        int m_maxRunning;
+        int m_timeoutMs;
+        size_t m_next;
+        int m_running;
+        int m_failed;
+        double m_totalMs = 0;
+    };
+
+    /// Every .rg and MIDI file in or under path, or path itself.
+    QStringList findInputs(const QString &path)
+    {
+        QStringList inputs;
+
+        if (!QFileInfo(path).isDir()) {
+            inputs << path;
+            return inputs;
+        }
+
+        QDirIterator it(path,
+                        QStringList() << "*.rg" << "*.mid" << "*.midi"
+                                      << "*.MID" << "*.MIDI",
+                        QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            inputs << it.next();
+        }
+        inputs.sort();
+
+        return inputs;
+    }
+
+    /// The directory to write the result for input, found under root.
+    /**
+     * root is the argument input came from.  With an output directory,
+     * input's path under root is kept under it, so that a/song.rg and
+     * b/song.rg don't both end up as song.mid.
+     */
+    QString outputDirFor(const QString &root, const QFileInfo &input,
+                         const QString &outputDir)
+    {
+        if (outputDir.isEmpty())
+            return input.absolutePath();
+
+        if (!QFileInfo(root).isDir())
+            return outputDir;
+
+        const QDir rootDir(QFileInfo(root).absoluteFilePath());
+        return QDir::cleanPath(QDir(outputDir).filePath(
+                rootDir.relativeFilePath(input.absolutePath())));
+    }
+
+    /// Where to write input, avoiding taken, which it is added to.
+    /**
+     * Normally the input's name with the new extension.  Never the
+     * input itself (.rg to .rg with no -o), and never an output another
+     * input already has (x.mid and x.rg, say): those get the input's
+     * extension added, then a number if need be.  Names the format can't
+     * be written to are fixed first, so the one reported is the real one.
+     */
+    QString outputFor(const QFileInfo &input, const QDir &dir,
+                      DocumentConverter::Format format,
+                      std::set<QString> &taken)
+    {
+        const QString extension = DocumentConverter::extension(format);
+        QString name = DocumentConverter::outputBaseName(
+                input.completeBaseName(), format);
+        QString output = dir.filePath(name + "." + extension);
+
+        auto isTaken = [&taken, &input](const QString &path) {
+            const QString absolute = QFileInfo(path).absoluteFilePath();
+            return absolute == input.absoluteFilePath()  ||
+                   taken.count(absolute) > 0;
+        };
+
+        if (isTaken(output)) {
+            name += "-" + input.suffix();
+            output = dir.filePath(name + "." + extension);
+        }
+        for (int n = 2; isTaken(output); ++n) {
+            output = dir.filePath(
+                    QString("%1-%2.%3").arg(name).arg(n).arg(extension));
+        }
+
+        taken.insert(QFileInfo(output).absoluteFilePath());
+        return output;
+    }
+
+    bool writeReport(const QString &filename, const std::vector<Job> &jobs,
+                     const QString &format, int maxRunning, double totalMs,
+                     int failed)
+    {
+        QJsonArray files;
+        for (const Job &job : jobs) {
+            QJsonObject file = job.result;
+            file["input"] = job.input;
+            file["output"] = job.output;
+            file["wall_ms"] = job.wallMs;
+            files.append(file);
+        }
+
+        QJsonObject root;
+        root["version"] = VERSION;
+        root["format"] = format;
+        root["jobs"] = maxRunning;
+        root["total_ms"] = totalMs;
+        root["converted"] = int(jobs.size()) - failed;
+        root["failed"] = failed;
+        root["files"] = files;
+
+        QFile file(filename);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+        file.write(QJsonDocument(root).toJson());
+        return true;
+    }
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    // See gui/application/main.cpp.
+#ifdef HAVE_LIBSNDFILE
+    WavFileReadStream::initStaticObjects();
+    WavFileWriteStream::initStaticObjects();
+#endif
+
+#ifdef HAVE_OGGZ
+#ifdef HAVE_FISHSOUND
+    OggVorbisReadStream::initStaticObjects();
+#endif
+#endif
+
+#ifndef HAVE_LIBSNDFILE
+    SimpleWavFileWriteStream::initStaticObjects();
+#endif
+
+    // No QApplication, so nothing can open a window.
+    QCoreApplication app(argc, argv);
+
+    // The same settings as the GUI, so exports use the user's options.
+    app.setOrganizationName("rosegardenmusic");
+    app.setOrganizationDomain("rosegardenmusic.com");
+    app.setApplicationName(QObject::tr("Rosegarden"));
+    app.setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+            "Converts Rosegarden (.rg) and MIDI files to other formats.\n"
+            "Directories are searched for .rg and MIDI files.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption formatOption(
+            QStringList() << "f" << "format",
+            "Output format: rg, midi, lilypond, musicxml, mup or csound.",
+            "format", "midi");
+    QCommandLineOption outputOption(
+            QStringList() << "o" << "output-dir",
+            "Where to write the results, keeping the layout of any "
+            "directories given.  Defaults to beside each input.",
+            "dir");
+    QCommandLineOption jobsOption(
+            QStringList() << "j" << "jobs",
+            "Files to convert at once.  Defaults to the number of cores.",
+            "n", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption reportOption(
+            "report",
+            "Write the time and peak memory for each file as JSON.",
+            "file");
+    QCommandLineOption timeoutOption(
+            "timeout",
+            "Give up on a file after this many seconds.  0 for never.",
+            "seconds", "0");
+    QCommandLineOption workerOption("worker");
+    workerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(jobsOption);
+    parser.addOption(reportOption);
+    parser.addOption(timeoutOption);
+    parser.addOption(workerOption);
+    parser.addPositionalArgument("inputs", "Files and directories.",
+                                 "inputs...");
+
+    parser.process(app);
+
+    const QString formatName = parser.value(formatOption);
+    const DocumentConverter::Format format =
+            DocumentConverter::formatFromName(formatName);
+    if (format == DocumentConverter::Unknown) {
+        std::cerr << "Unknown format: " << formatName << "\n";
+        return 2;
+    }
+
+    const QStringList args = parser.positionalArguments();
+
+    if (parser.isSet(workerOption)) {
+        if (args.size() != 2)
+            return 2;
+        return runWorker(args[0], args[1], format);
+    }
+
+    if (args.isEmpty())
+        parser.showHelp(2);
+
+    const QString outputDir = parser.value(outputOption);
+    if (!outputDir.isEmpty()  &&  !QDir().mkpath(outputDir)) {
+        std::cerr << "Can't create " << outputDir << "\n";
+        return 2;
+    }
+
+    // Every output is decided here, before any worker starts, so that
+    // no two inputs write the same file.
+    std::vector<Job> jobs;
+    std::set<QString> inputsSeen;
+    std::set<QString> outputs;
+    for (const QString &arg : args) {
+        for (const QString &input : findInputs(arg)) {
+            const QFileInfo info(input);
+
+            // Given twice, e.g. as a file and in a directory.
+            if (!inputsSeen.insert(info.absoluteFilePath()).second)
+                continue;
+
+            const QString dir = outputDirFor(arg, info, outputDir);
+            if (!QDir().mkpath(dir)) {
+                std::cerr << "Can't create " << dir << "\n";
+                return 2;
+            }
+
+            Job job;
+            job.input = input;
+            job.output = outputFor(info, QDir(dir), format, outputs);
+            jobs.push_back(job);
+        }
+    }
+
+    const int maxRunning = std::max(1, parser.value(jobsOption).toInt());
+
+    Batch batch(jobs, formatName, maxRunning,
+                parser.value(timeoutOption).toInt());
+    const int failed = batch.run();
+
+    std::cout << jobs.size() - failed << " converted, " << failed
+              << " failed in "
+              << qPrintable(QString::number(batch.getTotalMs() / 1000.0,
+                                            'f', 2))
+              << " s" << std::endl;
+
+    if (parser.isSet(reportOption)) {
+        const QString report = parser.value(reportOption);
+        if (!writeReport(report, jobs, formatName, maxRunning,
+                         batch.getTotalMs(), failed)) {
+            std::cerr << "Can't write " << report << "\n";
+            return 2;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[AutoSaveThread]"
+
+#include "AutoSaveThread.h"
+
+#include "GzipWriter.h"
+#include "misc/Debug.h"
+
+#include <QFile>
+
+#include <stdio.h>
+
+
+namespace Rosegarden
+{
+
+
+bool
+AutoSaveThread::save(const QString &fileName, std::vector<QByteArray> &xml)
+{
+    if (isRunning())
+        return false;
+
+    m_fileName = fileName;
+    m_xml.swap(xml);
+    m_succeeded = false;
+
+    start(LowPriority);
+
+    return true;
+}
+
+void
+AutoSaveThread::run()
+{
+    // Write alongside, then rename over the old one, which replaces it
+    // in one step, so that there is always a complete autosave file.
+    const QString tempFileName = m_fileName + ".tmp";
+
+    GzipWriter writer(tempFileName);
+    bool ok = writer.isOpen();
+
+    for (const QByteArray &part : m_xml) {
+        if (!ok)
+            break;
+        ok = writer.write(part);
+    }
+
+    ok = writer.close()  &&  ok;
+
+    m_xml.clear();
+
+    if (!ok) {
+        RG_WARNING << "run(): Could not write" << tempFileName;
+        QFile::remove(tempFileName);
+        return;
+    }
+
+    // Not QFile::rename(), which won't replace an existing file.
+    if (::rename(QFile::encodeName(tempFileName).constData(),
+                 QFile::encodeName(m_fileName).constData()) != 0) {
+        RG_WARNING << "run(): Could not rename" << tempFileName << "to"
+                   << m_fileName;
+        QFile::remove(tempFileName);
+        return;
+    }
+
+    m_succeeded = true;
+}
+
+
+}
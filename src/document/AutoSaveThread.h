@@ -0,0 +1,68 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_AUTOSAVETHREAD_H
+#define RG_AUTOSAVETHREAD_H
+
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+
+#include <vector>
+
+
+namespace Rosegarden
+{
+
+
+/// Compress and write an autosave file in the background.
+/**
+ * RosegardenDocument::slotAutoSave() takes a snapshot of the document's
+ * XML, which is quick, and hands it to this to do the slow part, so
+ * that autosaving doesn't hold up the GUI.
+ */
+class AutoSaveThread : public QThread
+{
+public:
+    AutoSaveThread() : m_succeeded(false)  { }
+
+    /// Write xml to fileName.
+    /**
+     * Returns false, and does nothing, if the previous save hasn't
+     * finished yet.  Check succeeded() once finished() is emitted.
+     */
+    bool save(const QString &fileName, std::vector<QByteArray> &xml);
+
+    /// Whether the last save wrote the whole file.
+    /**
+     * Only meaningful once the thread has finished.
+     */
+    bool succeeded() const  { return m_succeeded; }
+
+protected:
+    void run() override;
+
+private:
+    QString m_fileName;
+    std::vector<QByteArray> m_xml;
+    bool m_succeeded;
+};
+
+
+}
+
+#endif
@@ -49,7 +49,8 @@ BasicCommand::BasicCommand(const QString &name, Segment &segment,
     m_originalEvents(new Segment(segment.getType(), m_startTime)),
     m_doBruteForceRedo(false),
     m_redoEvents(nullptr),
-    m_segmentMarking("")
+    m_segmentMarking(""),
+    m_memoryUsage(0)
 {
     RG_DEBUG << "5 param ctor...";
     RG_DEBUG << "  start:" << start;
@@ -92,7 +93,8 @@ BasicCommand::BasicCommand(const QString &name,
     m_originalEvents(new Segment(segment.getType(), m_startTime)),
     m_doBruteForceRedo(true),
     m_redoEvents(redoEvents->clone()), // we do not own redoEvents
-    m_segmentMarking("")
+    m_segmentMarking(""),
+    m_memoryUsage(0)
 {
     RG_DEBUG << "3 param ctor...";
     RG_DEBUG << "  redoEvents->getStartTime():" << redoEvents->getStartTime();
@@ -119,7 +121,8 @@ BasicCommand::BasicCommand(const QString &name,
     m_originalEvents(nullptr),
     m_doBruteForceRedo(false),
     m_redoEvents(nullptr),
-    m_segmentMarking(segmentMarking)
+    m_segmentMarking(segmentMarking),
+    m_memoryUsage(0)
 {
     RG_DEBUG << "4 param ctor...";
     RG_DEBUG << "  start:" << start;
@@ -231,6 +234,9 @@ BasicCommand::execute()
     // calculate the start and end of the modified region
     calculateModifiedStartEnd();
 
+    // Only the modified region is needed for undo.
+    trimToModifiedRange(m_originalEvents);
+
     timeT updateStartTime = m_modifiedEventsStart;
     if (m_segment->getStartTime() < updateStartTime)
         updateStartTime = m_segment->getStartTime();
@@ -242,6 +248,8 @@ BasicCommand::execute()
 
     m_segment->signalChanged(updateStartTime, m_modifiedEventsEnd);
 
+    updateMemoryUsage();
+
     RG_DEBUG << getName() << "after execute";
     RG_DEBUG << getName() << "segment" <<
                 m_segment->getStartTime() << m_segment->getEndTime();
@@ -263,6 +271,7 @@ BasicCommand::unexecute()
 
     if (m_redoEvents) {
         copyTo(m_redoEvents);
+        trimToModifiedRange(m_redoEvents);
         m_doBruteForceRedo = true;
     }
 
@@ -313,6 +322,8 @@ BasicCommand::unexecute()
 
     m_segment->signalChanged(updateStartTime, m_modifiedEventsEnd);
 
+    updateMemoryUsage();
+
     RG_DEBUG << "unexecute() end.";
     RG_DEBUG << getName() << "after unexecute";
     RG_DEBUG << getName() << "segment" <<
@@ -375,6 +386,33 @@ void BasicCommand::copyFrom(QSharedPointer<Segment> source, bool wholeSegment)
     source->clear();
 }
 
+void
+BasicCommand::trimToModifiedRange(QSharedPointer<Segment> saved)
+{
+    // Exactly the Events that copyFrom() will copy back.
+    saved->erase(saved->findTime(m_modifiedEventsEnd), saved->end());
+    saved->erase(saved->begin(), saved->findTime(m_modifiedEventsStart));
+}
+
+void
+BasicCommand::updateMemoryUsage()
+{
+    size_t usage = sizeof(*this);
+
+    if (m_originalEvents) {
+        for (const Event *event : *m_originalEvents) {
+            usage += event->getStorageSize();
+        }
+    }
+    if (m_redoEvents) {
+        for (const Event *event : *m_redoEvents) {
+            usage += event->getStorageSize();
+        }
+    }
+
+    m_memoryUsage = usage;
+}
+
 void
 BasicCommand::requireSegment()
 {
@@ -78,6 +78,13 @@ public:
     void execute() override;
     void unexecute() override;
 
+    /// The Events kept for undo and redo.
+    /**
+     * Worked out at the end of each execute() and unexecute(), so this
+     * is cheap enough for CommandHistory to ask after every edit.
+     */
+    size_t getMemoryUsage() const override  { return m_memoryUsage; }
+
     /// events selected after command; 0 if no change / no meaningful selection
     virtual EventSelection *getSubsequentSelection() { return nullptr; }
 
@@ -149,6 +156,12 @@ private:
      * Events in m_segment are removed in the time range before the copy.
      */
     void copyFrom(QSharedPointer<Segment> source, bool wholeSegment = false);
+    /// Discard the Events in saved that copyFrom() won't need.
+    /**
+     * Only those in the modified time range are copied back, so once
+     * that is known there is no need to keep the rest of the Segment.
+     */
+    void trimToModifiedRange(QSharedPointer<Segment> saved);
 
     /// Original start time for m_Segment.
     timeT m_originalStartTime;
@@ -184,10 +197,11 @@ private:
      */
     void calculateModifiedStartEnd();
 
-    /// All Events from m_segment prior to executing the command.
+    /// Events from m_segment prior to executing the command.
     /**
-     * This is a complete backup of m_segment.
-     *
+     * execute() takes a complete backup of m_segment, which shares
+     * EventData with it until the command modifies an Event.  Once the
+     * modified range is known, only the Events in that range are kept.
      */
     QSharedPointer<Segment> m_originalEvents;
 
@@ -204,6 +218,10 @@ private:
     /// The segment marking for delayed access to segment
     QString m_segmentMarking;
 
+    /// Set m_memoryUsage from m_originalEvents and m_redoEvents.
+    void updateMemoryUsage();
+    size_t m_memoryUsage;
+
 };
 
 
@@ -76,6 +76,16 @@ MacroCommand::unexecute()
     }
 }
 
+size_t
+MacroCommand::getMemoryUsage() const
+{
+    size_t usage = 0;
+    for (size_t i = 0; i < m_commands.size(); ++i) {
+        usage += m_commands[i]->getMemoryUsage();
+    }
+    return usage;
+}
+
 QString
 MacroCommand::getName() const
 {
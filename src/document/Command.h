@@ -22,6 +22,7 @@
 #include <QString>
 #include <QCoreApplication> // for Q_DECLARE_TR_FUNCTIONS
 
+#include <stddef.h>
 #include <vector>
 #include <rosegardenprivate_export.h>
 
@@ -38,6 +39,13 @@ public:
     virtual void unexecute() = 0;
     virtual QString getName() const = 0;
 
+    /// Approximate memory kept for undo and redo, in bytes.
+    /**
+     * CommandHistory uses this to keep the history within its memory
+     * limit.  Commands that keep copies of events should override it.
+     */
+    virtual size_t getMemoryUsage() const  { return 0; }
+
     bool getUpdateLinks() const { return m_updateLinks; }
     void setUpdateLinks(bool update) { m_updateLinks = update; }
 
@@ -70,6 +78,7 @@ public:
 
     void execute() override;
     void unexecute() override;
+    size_t getMemoryUsage() const override;
 
     QString getName() const override;
     virtual void setName(QString name);
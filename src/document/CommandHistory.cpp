@@ -23,6 +23,7 @@
 #include "Command.h"
 #include "gui/general/ActionData.h"
 #include "misc/Debug.h"
+#include "misc/Headless.h"
 
 #include <QRegularExpression>
 #include <QMenu>
@@ -31,6 +32,7 @@
 #include <QTimer>
 #include <QAction>
 
+#include <algorithm>
 #include <iostream>
 
 namespace Rosegarden
@@ -39,12 +41,22 @@ namespace Rosegarden
 CommandHistory *CommandHistory::m_instance = nullptr;
 
 CommandHistory::CommandHistory() :
+    m_undoAction(nullptr),
+    m_redoAction(nullptr),
+    m_undoMenu(nullptr),
+    m_redoMenu(nullptr),
+    m_undoMemory(0),
     m_undoLimit(50),
     m_redoLimit(50),
     m_menuLimit(15),
+    m_memoryLimit(256 * 1024 * 1024),
     m_savedAt(0),
     m_enableUndo(true)
 {
+    // Without a QApplication there are no menus to keep up to date.
+    if (isHeadless())
+        return;
+
     // All Edit > Undo menu items share this QAction object.
     m_undoAction = new QAction(QIcon(":/icons/undo.png"), tr("&Undo"), this);
     m_undoAction->setObjectName("edit_undo");
@@ -113,12 +125,17 @@ CommandHistory::addCommand(Command *command)
     commInfo.command = command;
     commInfo.pointerPositionBefore = m_pointerPosition;
     commInfo.pointerPositionAfter = m_pointerPosition;
-    m_undoStack.push(commInfo);
-    clipCommands();
+    commInfo.memoryUsage = 0;
+    pushUndo(commInfo);
 
     // Execute the command
     command->execute();
 
+    // Now that we know how much it is keeping.
+    m_undoStack.back().memoryUsage = command->getMemoryUsage();
+    m_undoMemory += m_undoStack.back().memoryUsage;
+    clipCommands();
+
     emit updateLinkedSegments(command);
     emit commandExecuted();
     //emit commandExecuted2(command);
@@ -136,7 +153,7 @@ CommandHistory::undo()
 
     RG_DEBUG << "undo()";
 
-    CommandInfo commInfo = m_undoStack.top();
+    CommandInfo commInfo = m_undoStack.back();
     commInfo.command->unexecute();
     emit updateLinkedSegments(commInfo.command);
     emit commandExecuted();
@@ -144,8 +161,9 @@ CommandHistory::undo()
     m_pointerPosition = commInfo.pointerPositionBefore;
     emit commandUndone();
 
-    m_redoStack.push(commInfo);
-    m_undoStack.pop();
+    popUndo();
+    commInfo.memoryUsage = commInfo.command->getMemoryUsage();
+    m_redoStack.push_back(commInfo);
 
     clipCommands();
     updateActions();
@@ -158,7 +176,7 @@ CommandHistory::redo()
 {
     if (m_redoStack.empty()) return;
 
-    CommandInfo commInfo = m_redoStack.top();
+    CommandInfo commInfo = m_redoStack.back();
     commInfo.command->execute();
     emit updateLinkedSegments(commInfo.command);
     emit commandExecuted();
@@ -166,8 +184,9 @@ CommandHistory::redo()
     m_pointerPosition = commInfo.pointerPositionAfter;
     emit commandRedone();
 
-    m_undoStack.push(commInfo);
-    m_redoStack.pop();
+    commInfo.memoryUsage = commInfo.command->getMemoryUsage();
+    pushUndo(commInfo);
+    m_redoStack.pop_back();
     // no need to clip
 
     updateActions();
@@ -206,42 +225,91 @@ CommandHistory::setMenuLimit(int limit)
 }
 */
 
+void
+CommandHistory::setMemoryLimit(size_t limit)
+{
+    if (limit != m_memoryLimit) {
+        m_memoryLimit = limit;
+        clipCommands();
+        updateActions();
+    }
+}
+
 void
 CommandHistory::documentSaved()
 {
     m_savedAt = (int)m_undoStack.size();
 }
 
+void
+CommandHistory::pushUndo(CommandInfo commInfo)
+{
+    m_undoStack.push_back(commInfo);
+    m_undoMemory += commInfo.memoryUsage;
+}
+
+CommandHistory::CommandInfo
+CommandHistory::popUndo()
+{
+    CommandInfo commInfo = m_undoStack.back();
+    m_undoStack.pop_back();
+    m_undoMemory -= commInfo.memoryUsage;
+    return commInfo;
+}
+
 void
 CommandHistory::clipCommands()
 {
-    if ((int)m_undoStack.size() > m_undoLimit) {
-        m_savedAt -= (int(m_undoStack.size()) - m_undoLimit);
+    // Nearly always within both limits, which is quick to check.
+    if ((int)m_undoStack.size() > m_undoLimit  ||
+        m_undoMemory > m_memoryLimit) {
+
+        const int undoLimit = std::min(
+                m_undoLimit,
+                int(m_undoStack.size()) -
+                    commandsToDrop(m_undoStack, m_undoMemory, m_memoryLimit));
+
+        if ((int)m_undoStack.size() > undoLimit) {
+            m_savedAt -= (int(m_undoStack.size()) - undoLimit);
+        }
+
+        for (int i = 0; i < int(m_undoStack.size()) - undoLimit; ++i) {
+            m_undoMemory -= m_undoStack[i].memoryUsage;
+        }
+        clipStack(m_undoStack, undoLimit);
     }
 
-    clipStack(m_undoStack, m_undoLimit);
     clipStack(m_redoStack, m_redoLimit);
 }
 
-void
-CommandHistory::clipStack(CommandStack &stack, int limit)
+int
+CommandHistory::commandsToDrop(const CommandStack &stack, size_t total,
+                               size_t limit)
 {
-    if ((int)stack.size() > limit) {
+    int count = 0;
 
-        CommandStack tempStack;
+    // From the oldest, keeping the most recent.
+    while (total > limit  &&  count + 1 < int(stack.size())) {
+        total -= stack[count].memoryUsage;
+        ++count;
+    }
 
-        for (int i = 0; i < limit; ++i) {
-            RG_DEBUG << "clipStack(): Saving recent command: " << stack.top().command->getName().toLocal8Bit().data() << " at " << stack.top().command;
-            tempStack.push(stack.top());
-            stack.pop();
-        }
+    return count;
+}
 
-        clearStack(stack);
+void
+CommandHistory::clipStack(CommandStack &stack, int limit)
+{
+    if ((int)stack.size() > limit) {
 
-        for (int i = 0; i < m_undoLimit; ++i) {
-            stack.push(tempStack.top());
-            tempStack.pop();
+        // Delete the oldest.
+        const int drop = int(stack.size()) - limit;
+        for (int i = 0; i < drop; ++i) {
+            // Not safe to call getName() on a command about to be deleted
+            RG_DEBUG << "clipStack(): About to delete command " << stack[i].command;
+            delete stack[i].command;
         }
+        stack.erase(stack.begin(), stack.begin() + drop);
     }
 }
 
@@ -249,12 +317,15 @@ void
 CommandHistory::clearStack(CommandStack &stack)
 {
     while (!stack.empty()) {
-        CommandInfo commInfo = stack.top();
+        CommandInfo commInfo = stack.back();
         // Not safe to call getName() on a command about to be deleted
         RG_DEBUG << "clearStack(): About to delete command " << commInfo.command;
         delete commInfo.command;
-        stack.pop();
+        stack.pop_back();
     }
+
+    if (&stack == &m_undoStack)
+        m_undoMemory = 0;
 }
 
 void
@@ -297,6 +368,9 @@ CommandHistory::updateActions()
 {
     m_actionCounts.clear();
 
+    if (!m_undoAction)
+        return;
+
     // for undo then redo
     for (int undo = 0; undo <= 1; ++undo) {
 
@@ -314,7 +388,7 @@ CommandHistory::updateActions()
             action->setToolTip(strippedText(text));
         } else {
 
-            QString commandName = stack.top().command->getName();
+            QString commandName = stack.back().command->getName();
             commandName.replace(QRegularExpression("&"), "");
 
             QString text = (undo ? tr("&Undo %1") : tr("Re&do %1"))
@@ -341,14 +415,14 @@ CommandHistory::updateActions()
 
         menu->clear();
 
-        CommandStack tempStack;
         int j = 0;
 
-        while (j < m_menuLimit && !stack.empty()) {
+        // From the most recent.
+        for (CommandStack::const_reverse_iterator i = stack.rbegin();
+             j < m_menuLimit  &&  i != stack.rend();
+             ++i) {
 
-            CommandInfo commInfo = stack.top();
-            tempStack.push(commInfo);
-            stack.pop();
+            const CommandInfo &commInfo = *i;
 
             QString commandName = commInfo.command->getName();
             commandName.replace(QRegularExpression("&"), "");
@@ -360,11 +434,6 @@ CommandHistory::updateActions()
             QAction *action = menu->addAction(text);
             m_actionCounts[action] = j++;
         }
-
-        while (!tempStack.empty()) {
-            stack.push(tempStack.top());
-            tempStack.pop();
-        }
     }
 }
 
@@ -390,7 +459,7 @@ CommandHistory::setPointerPositionForRedo(timeT pos)
     // command.
 
     if ((int)m_undoStack.size() == 0) return;
-    CommandInfo& top = m_undoStack.top();
+    CommandInfo& top = m_undoStack.back();
     top.pointerPositionAfter = pos;
 }
 
@@ -21,7 +21,7 @@
 #include <QObject>
 #include <QString>
 
-#include <stack>
+#include <deque>
 #include <set>
 #include <map>
 
@@ -87,6 +87,17 @@ public:
     /// Set the maximum number of items in the redo history.
     // unused void setRedoLimit(int limit);
 
+    /// Return the most memory the undo history may hold, in bytes.
+    size_t getMemoryLimit() const { return m_memoryLimit; }
+
+    /// Set the most memory the undo history may hold, in bytes.
+    /**
+     * The oldest commands are dropped to keep within it, going by
+     * Command::getMemoryUsage().  The most recent command is always
+     * kept.
+     */
+    void setMemoryLimit(size_t limit);
+
     /// Return the maximum number of items visible in undo and redo menus.
     int getMenuLimit() const { return m_menuLimit; }
 
@@ -200,17 +211,32 @@ protected:
         Command *command;
         timeT pointerPositionBefore;  // for undo
         timeT pointerPositionAfter;   // for redo
+        /// command->getMemoryUsage() as of its last execute or unexecute.
+        size_t memoryUsage;
     };
-    typedef std::stack<CommandInfo> CommandStack;
+    /// Oldest first.  The most recent command is at the back.
+    typedef std::deque<CommandInfo> CommandStack;
     CommandStack m_undoStack;
     CommandStack m_redoStack;
+    /// Total memoryUsage of the commands in m_undoStack.
+    size_t m_undoMemory;
+    void pushUndo(CommandInfo commInfo);
+    CommandInfo popUndo();
     void clipStack(CommandStack &stack, int limit);
     void clearStack(CommandStack &stack);
     void clipCommands();
+    /// How many of the oldest commands in stack to drop so that the rest
+    /// fit in limit bytes, given that they take total bytes now.
+    /**
+     * Never all of them.
+     */
+    static int commandsToDrop(const CommandStack &stack, size_t total,
+                              size_t limit);
 
     int m_undoLimit;
     int m_redoLimit;
     int m_menuLimit;
+    size_t m_memoryLimit;
     int m_savedAt;
 
     /// Enable/Disable undo (during playback).
@@ -0,0 +1,272 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[GzipReader]"
+
+#include "GzipReader.h"
+
+#include "misc/Debug.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <string.h>
+#include <zlib.h>
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+    /// Decompressed bytes per chunk.
+    const int chunkSize = 256 * 1024;
+    /// Chunks the Inflater may get ahead of the reader.
+    const size_t maxQueuedChunks = 8;
+}
+
+
+/// Decompresses the file into GzipReader::m_chunks.
+class GzipReader::Inflater : public QThread
+{
+public:
+    Inflater(GzipReader *reader, gzFile file) :
+        m_reader(reader),
+        m_file(file)
+    { }
+
+protected:
+    void run() override;
+
+private:
+    GzipReader *m_reader;
+    gzFile m_file;
+};
+
+void
+GzipReader::Inflater::run()
+{
+    bool failed = false;
+
+    while (true) {
+        QByteArray data(chunkSize, Qt::Uninitialized);
+        const int got = gzread(m_file, data.data(), chunkSize);
+        if (got <= 0) {
+            // A truncated file reaches EOF too, but leaves an error
+            // (Z_BUF_ERROR) behind.
+            int error = Z_OK;
+            gzerror(m_file, &error);
+            failed = (got < 0  ||  !gzeof(m_file)  ||  error != Z_OK);
+            break;
+        }
+        data.resize(got);
+
+        const Chunk chunk = { data, qint64(gzoffset(m_file)) };
+
+        QMutexLocker locker(&m_reader->m_mutex);
+        while (m_reader->m_chunks.size() >= maxQueuedChunks  &&
+               !m_reader->m_stop) {
+            m_reader->m_spaceFree.wait(&m_reader->m_mutex);
+        }
+        if (m_reader->m_stop)
+            break;
+        m_reader->m_chunks.push_back(chunk);
+        m_reader->m_chunkReady.wakeOne();
+    }
+
+    if (failed)
+        RG_WARNING << "run(): error reading" << m_reader->m_fileName;
+
+    gzclose(m_file);
+
+    QMutexLocker locker(&m_reader->m_mutex);
+    m_reader->m_finished = true;
+    // Stopping early doesn't count as having read it all.
+    m_reader->m_failed = failed  ||  m_reader->m_stop;
+    m_reader->m_chunkReady.wakeAll();
+}
+
+
+GzipReader::GzipReader(const QString &fileName) :
+    m_fileName(fileName),
+    m_inflater(nullptr),
+    m_compressedSize(0),
+    m_compressedRead(0),
+    m_finished(false),
+    m_failed(false),
+    m_stop(false),
+    m_currentPos(0)
+{
+}
+
+GzipReader::~GzipReader()
+{
+    close();
+}
+
+bool
+GzipReader::open(OpenMode mode)
+{
+    if (isOpen()  ||  (mode & WriteOnly))
+        return false;
+
+    gzFile file = gzopen(m_fileName.toLocal8Bit().data(), "rb");
+    if (!file)
+        return false;
+
+    // Read the compressed file in large blocks too.
+    gzbuffer(file, chunkSize);
+
+    m_chunks.clear();
+    m_compressedSize = QFileInfo(m_fileName).size();
+    m_compressedRead = 0;
+    m_finished = false;
+    m_failed = false;
+    m_stop = false;
+    m_current.clear();
+    m_currentPos = 0;
+
+    // We have our own buffering, and Text mode would copy everything
+    // again to look for "\r\n".  QXmlStreamReader doesn't need it.
+    QIODevice::open(ReadOnly | Unbuffered);
+
+    m_inflater = new Inflater(this, file);
+    m_inflater->start();
+
+    return true;
+}
+
+void
+GzipReader::close()
+{
+    if (m_inflater) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stop = true;
+            m_spaceFree.wakeAll();
+        }
+        m_inflater->wait();
+        delete m_inflater;
+        m_inflater = nullptr;
+    }
+
+    m_chunks.clear();
+    m_current.clear();
+    m_currentPos = 0;
+
+    QIODevice::close();
+}
+
+bool
+GzipReader::takeChunk(bool wait)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (m_chunks.empty()) {
+        if (m_finished  ||  !wait)
+            return false;
+        m_chunkReady.wait(&m_mutex);
+    }
+
+    m_current = m_chunks.front().data;
+    m_currentPos = 0;
+    m_compressedRead = m_chunks.front().compressedOffset;
+    m_chunks.pop_front();
+    m_spaceFree.wakeOne();
+
+    return true;
+}
+
+qint64
+GzipReader::readData(char *data, qint64 maxSize)
+{
+    qint64 copied = 0;
+
+    while (copied < maxSize) {
+        if (m_currentPos >= m_current.size()) {
+            // Only wait if we have nothing at all to return.
+            if (!takeChunk(copied == 0))
+                break;
+        }
+
+        const qint64 n = qMin(maxSize - copied,
+                              qint64(m_current.size() - m_currentPos));
+        memcpy(data + copied, m_current.constData() + m_currentPos, size_t(n));
+        m_currentPos += int(n);
+        copied += n;
+    }
+
+    // Nothing to come, and not because we reached the end.
+    if (copied == 0  &&  !isComplete())
+        return -1;
+
+    return copied;
+}
+
+qint64
+GzipReader::writeData(const char * /* data */, qint64 /* maxSize */)
+{
+    return -1;
+}
+
+bool
+GzipReader::atEnd() const
+{
+    if (!isOpen())
+        return true;
+
+    if (m_currentPos < m_current.size())
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    return m_chunks.empty()  &&  m_finished;
+}
+
+qint64
+GzipReader::bytesAvailable() const
+{
+    qint64 available = m_current.size() - m_currentPos;
+
+    QMutexLocker locker(&m_mutex);
+    for (const Chunk &chunk : m_chunks) {
+        available += chunk.data.size();
+    }
+
+    return available + QIODevice::bytesAvailable();
+}
+
+bool
+GzipReader::isComplete() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_finished  &&  !m_failed;
+}
+
+int
+GzipReader::percentRead() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_compressedSize <= 0)
+        return 0;
+
+    return int(qMin(m_compressedRead * 100 / m_compressedSize, qint64(100)));
+}
+
+
+}
@@ -0,0 +1,117 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_GZIPREADER_H
+#define RG_GZIPREADER_H
+
+#include <rosegardenprivate_export.h>
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+#include <deque>
+
+namespace Rosegarden
+{
+
+
+/// Read-only device that decompresses a gzip file on a background thread.
+/**
+ * Unlike GzipFile::readFromFile(), which reads the whole file into a
+ * QString before anything can be done with it, this hands out the
+ * decompressed data a chunk at a time as it is read.  Give it to
+ * XMLReader::parse(QIODevice &) and the file is decompressed while the
+ * document is being built from the part that has already arrived.
+ *
+ * Only a few chunks are queued ahead of the reader, so memory use does
+ * not depend on the size of the file.
+ *
+ * Like gzopen(), this also reads files that aren't compressed.
+ */
+class ROSEGARDENPRIVATE_EXPORT GzipReader : public QIODevice
+{
+public:
+    explicit GzipReader(const QString &fileName);
+    ~GzipReader() override;
+
+    /// Open the file and start decompressing.  Only ReadOnly is supported.
+    bool open(OpenMode mode) override;
+    /// Stop decompressing and close the file.
+    void close() override;
+
+    bool isSequential() const override  { return true; }
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+
+    /// Whether the whole file has been decompressed without error.
+    /**
+     * Only meaningful once everything has been read.  A truncated or
+     * corrupt file reads up to the point of the problem, then ends.
+     */
+    bool isComplete() const;
+
+    /// How far through the compressed file the data read so far comes from.
+    int percentRead() const;
+
+protected:
+    /// Waits for the background thread if there is nothing queued.
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    class Inflater;
+
+    /// Move the next queued chunk into m_current.
+    /**
+     * If there isn't one, waits for it when wait is true, otherwise
+     * returns false at once.  Also returns false once the file is
+     * exhausted.
+     */
+    bool takeChunk(bool wait);
+
+    QString m_fileName;
+    Inflater *m_inflater;
+
+    struct Chunk {
+        QByteArray data;
+        /// Offset into the compressed file once this chunk was produced.
+        qint64 compressedOffset;
+    };
+
+    // Shared with the Inflater.
+    mutable QMutex m_mutex;
+    QWaitCondition m_chunkReady;
+    QWaitCondition m_spaceFree;
+    std::deque<Chunk> m_chunks;
+    qint64 m_compressedSize;
+    qint64 m_compressedRead;
+    bool m_finished;
+    bool m_failed;
+    bool m_stop;
+
+    // Reader side only.
+    QByteArray m_current;
+    int m_currentPos;
+};
+
+
+}
+
+#endif
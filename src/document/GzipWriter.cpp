@@ -0,0 +1,70 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "GzipWriter.h"
+
+#include <zlib.h>
+
+namespace Rosegarden
+{
+
+
+GzipWriter::GzipWriter(const QString &fileName) :
+    m_file(gzopen(fileName.toLocal8Bit().data(), "wb")),
+    m_ok(m_file != nullptr)
+{
+    if (m_file) {
+        // Fewer, larger writes.
+        gzbuffer(m_file, 256 * 1024);
+    }
+}
+
+GzipWriter::~GzipWriter()
+{
+    close();
+}
+
+bool
+GzipWriter::write(const QByteArray &data)
+{
+    if (!m_file)
+        return false;
+
+    if (data.isEmpty())
+        return true;
+
+    const int written = gzwrite(m_file, data.constData(), unsigned(data.size()));
+    if (written != data.size())
+        m_ok = false;
+
+    return m_ok;
+}
+
+bool
+GzipWriter::close()
+{
+    if (m_file) {
+        if (gzclose(m_file) != Z_OK)
+            m_ok = false;
+        m_file = nullptr;
+    }
+
+    return m_ok;
+}
+
+
+}
@@ -0,0 +1,65 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_GZIPWRITER_H
+#define RG_GZIPWRITER_H
+
+#include <rosegardenprivate_export.h>
+
+#include <QByteArray>
+#include <QString>
+
+struct gzFile_s;
+
+namespace Rosegarden
+{
+
+
+/// Writes a gzip file a piece at a time.
+/**
+ * The streaming counterpart of GzipFile::writeToFile(), for when the
+ * text is produced in parts and there is no need to join them up
+ * first.
+ */
+class ROSEGARDENPRIVATE_EXPORT GzipWriter
+{
+public:
+    /// Create (or truncate) the file.  Check isOpen() afterwards.
+    explicit GzipWriter(const QString &fileName);
+    ~GzipWriter();
+
+    bool isOpen() const  { return m_file != nullptr; }
+
+    /// Compress and write data.  Returns false on error.
+    bool write(const QByteArray &data);
+
+    /// Flush and close the file.  Returns false if anything failed.
+    bool close();
+
+private:
+    // Not copyable.
+    GzipWriter(const GzipWriter &);
+    GzipWriter &operator=(const GzipWriter &);
+
+    gzFile_s *m_file;
+    bool m_ok;
+};
+
+
+}
+
+#endif
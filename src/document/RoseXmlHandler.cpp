@@ -23,6 +23,7 @@
 #include "sound/Midi.h"
 #include "misc/Debug.h"
 #include "misc/Strings.h"
+#include "misc/Headless.h"
 #include "base/AudioLevel.h"
 #include "base/AudioPluginInstance.h"
 #include "base/BaseProperties.h"
@@ -51,6 +52,7 @@
 #include "gui/studio/AudioPlugin.h"
 #include "gui/studio/AudioPluginManager.h"
 #include "RosegardenDocument.h"
+#include "GzipReader.h"
 #include "sound/AudioFileManager.h"
 #include "XmlStorableEvent.h"
 #include "XmlSubHandler.h"
@@ -248,6 +250,7 @@ RoseXmlHandler::RoseXmlHandler(RosegardenDocument *doc,
     m_pluginId(0),
     m_totalElements(elementCount),
     m_elementsSoFar(0),
+    m_progressReader(nullptr),
     m_subHandler(nullptr),
     m_deprecation(false),
     m_createDevices(createNewDevicesWhenNeeded),
@@ -463,9 +466,14 @@ RoseXmlHandler::startElement(const QString& namespaceURI,
             if (major == RosegardenDocument::FILE_FORMAT_VERSION_MAJOR &&
                     minor > RosegardenDocument::FILE_FORMAT_VERSION_MINOR) {
 
-                StartupLogo::hideIfStillThere();
+                const QString msg = tr("This file was written by Rosegarden %1, which is more recent than this version.\nThere may be some incompatibilities with the file format.").arg(version);
 
-                QMessageBox::information(nullptr, tr("Rosegarden"), tr("This file was written by Rosegarden %1, which is more recent than this version.\nThere may be some incompatibilities with the file format.").arg(version));
+                if (isHeadless()) {
+                    RG_WARNING << msg;
+                } else {
+                    StartupLogo::hideIfStillThere();
+                    QMessageBox::information(nullptr, tr("Rosegarden"), msg);
+                }
 
             }
         }
@@ -2318,7 +2326,7 @@ RoseXmlHandler::endElement(const QString& namespaceURI,
 
     // Set percentage done
     //
-    if ((m_totalElements > m_elementsSoFar) &&
+    if ((m_progressReader || m_totalElements > m_elementsSoFar) &&
         (++m_elementsSoFar % 300 == 0)) {
 
         if (m_progressDialog) {
@@ -2326,9 +2334,13 @@ RoseXmlHandler::endElement(const QString& namespaceURI,
             if (m_progressDialog->wasCanceled())
                 return false;
 
-            m_progressDialog->setValue(static_cast<int>(
-                    static_cast<double>(m_elementsSoFar) /
-                    static_cast<double>(m_totalElements) * 100.0));
+            if (m_progressReader) {
+                m_progressDialog->setValue(m_progressReader->percentRead());
+            } else {
+                m_progressDialog->setValue(static_cast<int>(
+                        static_cast<double>(m_elementsSoFar) /
+                        static_cast<double>(m_totalElements) * 100.0));
+            }
         }
 
         // Kick the event loop so that we don't appear to be in
@@ -2728,6 +2740,12 @@ RoseXmlHandler::locateAudioFile(const QString& id,
                                 const QString& file,
                                 const QString& label)
 {
+    // Nobody to ask.  Carry on without it, as "Skip" would.
+    if (isHeadless()) {
+        RG_WARNING << "locateAudioFile(): Skipping missing audio file" << file;
+        return true;
+    }
+
     StartupLogo::hideIfStillThere();
 
     // Get rid of the wait cursor so it doesn't interfere with the
@@ -51,6 +51,7 @@ class Buss;
 class AudioPluginManager;
 class AudioPluginInstance;
 class AudioFileManager;
+class GzipReader;
 
 
 /**
@@ -85,6 +86,14 @@ public:
 
     ~RoseXmlHandler() override;
 
+    /// Report progress by how much of reader has been read.
+    /**
+     * For when the file is parsed as it is decompressed, and the number
+     * of elements isn't known in advance.
+     */
+    void setProgressReader(const GzipReader *reader)
+        { m_progressReader = reader; }
+
     /// overloaded handler functions
     bool startDocument() override;
     bool startElement(const QString& namespaceURI,
@@ -187,6 +196,7 @@ protected:
     unsigned int                      m_pluginId;
     unsigned int                      m_totalElements;
     unsigned int                      m_elementsSoFar;
+    const GzipReader                 *m_progressReader;
 
     XmlSubHandler                    *m_subHandler;
     bool                              m_deprecation;
@@ -23,6 +23,8 @@
 #include "CommandHistory.h"
 #include "RoseXmlHandler.h"
 #include "GzipFile.h"
+#include "GzipReader.h"
+#include "GzipWriter.h"
 
 #include "base/AudioDevice.h"
 #include "base/AudioPluginInstance.h"
@@ -66,6 +68,7 @@
 #include "gui/general/GUIPalette.h"
 #include "gui/general/ResourceFinder.h"
 #include "gui/widgets/StartupLogo.h"
+#include "misc/Headless.h"
 #include "gui/seqmanager/SequenceManager.h"
 #include "gui/studio/AudioPluginManager.h"
 #include "gui/studio/StudioControl.h"
@@ -111,10 +114,63 @@
 #include <QWidget>
 #include <QHostInfo>
 #include <QLockFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <memory>
 
 // ??? Get rid of this.
 using namespace Rosegarden::BaseProperties;
 
+namespace
+{
+    /// Makes a piece of the document's XML on one of QThreadPool's threads.
+    class XmlTask : public QRunnable
+    {
+    public:
+        explicit XmlTask(const std::function<QString ()> &function) :
+            m_function(function),
+            m_done(false)
+        {
+            // We wait for it, then delete it.
+            setAutoDelete(false);
+        }
+
+        void run() override
+        {
+            // Encoding is done here too, rather than on the GUI thread.
+            const QByteArray xml = m_function().toUtf8();
+
+            QMutexLocker locker(&m_mutex);
+            m_xml = xml;
+            m_done = true;
+            m_finished.wakeAll();
+        }
+
+        /// Wait for run() to finish and return the XML.
+        const QByteArray &wait()
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_done) {
+                m_finished.wait(&m_mutex);
+            }
+            return m_xml;
+        }
+
+    private:
+        std::function<QString ()> m_function;
+
+        QMutex m_mutex;
+        QWaitCondition m_finished;
+        bool m_done;
+        QByteArray m_xml;
+    };
+}
+
 
 namespace Rosegarden
 {
@@ -134,6 +190,7 @@ RosegardenDocument::RosegardenDocument(
     m_lockFile(nullptr),
     m_audioFileManager(this),
     m_audioPeaksThread(&m_audioFileManager),
+    m_autoSaveCurrent(false),
     m_seqManager(nullptr),
     m_pluginManager(audioPluginManager),
     m_audioRecordLatency(0, 0),
@@ -149,6 +206,9 @@ RosegardenDocument::RosegardenDocument(
     connect(CommandHistory::getInstance(), &CommandHistory::documentRestored,
             this, &RosegardenDocument::slotDocumentRestored);
 
+    connect(&m_autoSaveThread, &QThread::finished,
+            this, &RosegardenDocument::slotAutoSaveFinished);
+
     // autoload a new document
     if (!skipAutoload)
         performAutoload();
@@ -166,6 +226,8 @@ RosegardenDocument::~RosegardenDocument()
     m_audioPeaksThread.finish();
     m_audioPeaksThread.wait();
 
+    m_autoSaveThread.wait();
+
     deleteEditViews();
 
     //     ControlRulerCanvasRepository::clear();
@@ -237,6 +299,9 @@ const QString &RosegardenDocument::getAbsFilePath() const
 
 void RosegardenDocument::deleteAutoSaveFile()
 {
+    // Don't let an autosave in progress put it back.
+    m_autoSaveThread.wait();
+
     QFile::remove(getAutoSaveFileName());
 }
 
@@ -267,9 +332,11 @@ void RosegardenDocument::setModified()
 
     m_modified = true;
     m_autoSaved = false;
+    m_autoSaveCurrent = false;
 
     // Make sure the star (*) appears in the title bar.
-    RosegardenMainWindow::self()->slotUpdateTitle(true);
+    if (RosegardenMainWindow::self())
+        RosegardenMainWindow::self()->slotUpdateTitle(true);
 }
 
 void RosegardenDocument::clearModifiedStatus()
@@ -284,6 +351,7 @@ void RosegardenDocument::slotDocumentModified()
 {
     m_modified = true;
     m_autoSaved = false;
+    m_autoSaveCurrent = false;
 
     m_composition.invalidateDurationCache();
 
@@ -342,16 +410,35 @@ void RosegardenDocument::slotAutoSave()
     if (isAutoSaved() || !isModified())
         return ;
 
+    // Still writing the last one.  Try again next time.
+    if (m_autoSaveThread.isRunning())
+        return;
+
     QString autoSaveFileName = getAutoSaveFileName();
 
     RG_DEBUG << "RosegardenDocument::slotAutoSave() - doc modified - saving '"
     << getAbsFilePath() << "' as"
     << autoSaveFileName;
 
-    QString errMsg;
+    // Take a snapshot of the XML here, then compress and write it in
+    // the background.  Large files took seconds to gzip.
+    std::vector<QByteArray> xml;
+    writeXml([&xml](const QByteArray &part) {
+                 xml.push_back(part);
+                 return true;
+             });
 
-    saveDocument(autoSaveFileName, errMsg, true);
+    // Only marked auto-saved once the thread has written it all, so
+    // that a failed write is tried again next time.
+    m_autoSaveCurrent = m_autoSaveThread.save(autoSaveFileName, xml);
+}
+
+void RosegardenDocument::slotAutoSaveFinished()
+{
+    if (m_autoSaveCurrent  &&  m_autoSaveThread.succeeded())
+        setAutoSaved(true);
 
+    m_autoSaveCurrent = false;
 }
 
 bool RosegardenDocument::isRegularDotRGFile() const
@@ -549,44 +636,40 @@ bool RosegardenDocument::openDocument(const QString &filename,
 
     // If the file cannot be read, or it's a directory
     if (!fileInfo.isReadable() || fileInfo.isDir()) {
-        StartupLogo::hideIfStillThere();
-
-        QString msg(tr("Can't open file '%1'").arg(filename));
-        QMessageBox::warning(dynamic_cast<QWidget *>(parent()),
-                             tr("Rosegarden"), msg);
-
+        showLoadError(tr("Can't open file '%1'").arg(filename));
         return false;
     }
 
     // Progress Dialog
     // Note: The label text and range will be set later as needed.
-    QProgressDialog progressDialog(
-            tr("Reading file..."),  // labelText
-            tr("Cancel"),  // cancelButtonText
-            0, 100,  // min, max
-            RosegardenMainWindow::self());  // parent
-    progressDialog.setWindowTitle(tr("Rosegarden"));
-    progressDialog.setWindowModality(Qt::WindowModal);
-    // Don't want to auto close since this is a multi-step
-    // process.  Any of the steps may set progress to 100.  We
-    // will close anyway when this object goes out of scope.
-    progressDialog.setAutoClose(false);
-    // We're usually a bit late to the game here as it is.  Shave off a
-    // couple of seconds to make up for it.
-    // ??? We should move the progress dialog further up the call chain
-    //     to include the additional time.
-    //progressDialog.setMinimumDuration(2000);
-
-    m_progressDialog = &progressDialog;
-
-    if (squelchProgressDialog) {
-        m_progressDialog = nullptr;
-    } else {
+    std::unique_ptr<QProgressDialog> progressDialog;
+    m_progressDialog = nullptr;
+
+    if (!squelchProgressDialog  &&  !isHeadless()) {
+        progressDialog.reset(new QProgressDialog(
+                tr("Reading file..."),  // labelText
+                tr("Cancel"),  // cancelButtonText
+                0, 100,  // min, max
+                RosegardenMainWindow::self()));  // parent
+        progressDialog->setWindowTitle(tr("Rosegarden"));
+        progressDialog->setWindowModality(Qt::WindowModal);
+        // Don't want to auto close since this is a multi-step
+        // process.  Any of the steps may set progress to 100.  We
+        // will close anyway when this object goes out of scope.
+        progressDialog->setAutoClose(false);
+        // We're usually a bit late to the game here as it is.  Shave
+        // off a couple of seconds to make up for it.
+        // ??? We should move the progress dialog further up the call
+        //     chain to include the additional time.
+        //progressDialog->setMinimumDuration(2000);
+
+        m_progressDialog = progressDialog.get();
+
         // Just force the progress dialog up.
         // Both Qt4 and Qt5 have bugs related to delayed showing of progress
         // dialogs.  In Qt4, the dialog sometimes won't show.  In Qt5, KDE
         // based distros might lock up.  See Bug #1546.
-        progressDialog.show();
+        progressDialog->show();
     }
 
     setAbsFilePath(fileInfo.absoluteFilePath());
@@ -604,10 +687,9 @@ bool RosegardenDocument::openDocument(const QString &filename,
 
     // Load.
 
-    QString fileContents;
-
-    // Unzip
-    bool okay = GzipFile::readFromFile(filename, fileContents);
+    // Unzip as we parse.
+    GzipReader file(filename);
+    bool okay = file.open(QIODevice::ReadOnly);
 
     QString errMsg;
     bool cancelled = false;
@@ -616,20 +698,16 @@ bool RosegardenDocument::openDocument(const QString &filename,
         errMsg = tr("Could not open Rosegarden file");
     } else {
         // Parse the XML
-        okay = xmlParse(fileContents,
+        okay = xmlParse(file,
                         errMsg,
                         permanent,
                         cancelled);
     }
 
     if (!okay) {
-        StartupLogo::hideIfStillThere();
-
-        QString msg(tr("Error when parsing file '%1':<br />\"%2\"")
-                     .arg(filename)
-                     .arg(errMsg));
-        QMessageBox::warning(dynamic_cast<QWidget *>(parent()), tr("Rosegarden"), msg);
-
+        showLoadError(tr("Error when parsing file '%1':<br />\"%2\"")
+                          .arg(filename)
+                          .arg(errMsg));
         return false;
     }
 
@@ -659,15 +737,35 @@ bool RosegardenDocument::openDocument(const QString &filename,
         // generate any audio previews after loading the files
         m_audioFileManager.generatePreviews();
     } catch (const Exception &e) {
-        StartupLogo::hideIfStillThere();
-        QMessageBox::critical(dynamic_cast<QWidget *>(parent()), tr("Rosegarden"), strtoqstr(e.getMessage()));
+        if (isHeadless()) {
+            RG_WARNING << "openDocument():" << e.getMessage();
+        } else {
+            StartupLogo::hideIfStillThere();
+            QMessageBox::critical(dynamic_cast<QWidget *>(parent()), tr("Rosegarden"), strtoqstr(e.getMessage()));
+        }
     }
 
+    m_audioFileManager.setProgressDialog(nullptr);
+    m_progressDialog = nullptr;
+
     RG_DEBUG << "openDocument(): Successfully opened document \"" << filename << "\"";
 
     return true;
 }
 
+void
+RosegardenDocument::showLoadError(const QString &message)
+{
+    if (isHeadless()) {
+        RG_WARNING << "openDocument():" << message;
+        return;
+    }
+
+    StartupLogo::hideIfStillThere();
+    QMessageBox::warning(dynamic_cast<QWidget *>(parent()),
+                         tr("Rosegarden"), message);
+}
+
 void
 RosegardenDocument::stealLockFile(RosegardenDocument *other)
 {
@@ -1190,14 +1288,38 @@ bool RosegardenDocument::saveDocumentActual(const QString& filename,
 
     RG_DEBUG << "RosegardenDocument::saveDocumentActual(" << filename << ")";
 
+    // Compress each part as soon as it is ready.
+    GzipWriter writer(filename);
+    bool okay = writer.isOpen()  &&
+                writeXml([&writer](const QByteArray &xml) {
+                             return writer.write(xml);
+                         });
+    okay = writer.close()  &&  okay;
+
+    if (!okay) {
+        errMsg = tr("Error while writing on '%1'").arg(filename);
+        return false;
+    }
+
+    RG_DEBUG << "RosegardenDocument::saveDocument() finished";
+
+    if (!autosave) {
+        m_modified = false;
+        emit documentModified(false);
+        CommandHistory::getInstance()->documentSaved();
+    }
+
+    setAutoSaved(true);
+
+    return true;
+}
+
+bool
+RosegardenDocument::writeXml(
+        const std::function<bool (const QByteArray &)> &write)
+{
     QString outText;
     QTextStream outStream(&outText, QIODevice::WriteOnly);
-//    outStream.setEncoding(QTextStream::UnicodeUTF8); qt3
-#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
-    // qt6 default codec is UTF-8
-#else
-    outStream.setCodec("UTF-8");
-#endif
 
     // output XML header
     //
@@ -1225,27 +1347,19 @@ bool RosegardenDocument::saveDocumentActual(const QString& filename,
     outStream << strtoqstr(getConfiguration().toXmlString())
               << "\n\n";
 
-    long totalEvents = 0;
-    for (Composition::iterator segitr = m_composition.begin();
-         segitr != m_composition.end(); ++segitr) {
-        totalEvents += (long)(*segitr)->size();
-    }
-
-    for (Composition::triggersegmentcontaineriterator ci =
-             m_composition.getTriggerSegments().begin();
-         ci != m_composition.getTriggerSegments().end(); ++ci) {
-        totalEvents += (long)(*ci)->getSegment()->size();
-    }
-
-    // output all elements
-    //
-    // Iterate on segments
-    long eventCount = 0;
-
     // Put a break in the file
     //
     outStream << "\n\n";
 
+    outStream.flush();
+    if (!write(outText.toUtf8()))
+        return false;
+
+    // Gather the segments and their extra attributes.  The XML for each
+    // is then made separately on QThreadPool's threads.
+    //
+    std::vector<std::pair<Segment *, QString> > segments;
+
     for (Composition::iterator segitr = m_composition.begin();
          segitr != m_composition.end(); ++segitr) {
 
@@ -1269,17 +1383,14 @@ bool RosegardenDocument::saveDocumentActual(const QString& filename,
               .arg(segment->getLinkTransposeParams().m_transposeSegmentBack
                                                          ? "true" : "false");
 
-            saveSegment(outStream, segment, totalEvents,
-                                            eventCount, linkedSegAtts);
+            segments.push_back(std::make_pair(segment, linkedSegAtts));
         } else {
-            saveSegment(outStream, segment, totalEvents, eventCount);
+            segments.push_back(std::make_pair(segment, QString()));
         }
 
     }
 
-    // Put a break in the file
-    //
-    outStream << "\n\n";
+    const size_t firstTrigger = segments.size();
 
     for (Composition::triggersegmentcontaineriterator ci =
                 m_composition.getTriggerSegments().begin();
@@ -1293,10 +1404,68 @@ bool RosegardenDocument::saveDocumentActual(const QString& filename,
                               .arg((*ci)->getDefaultRetune())
                               .arg(strtoqstr((*ci)->getDefaultTimeAdjust()));
 
-        Segment *segment = (*ci)->getSegment();
-        saveSegment(outStream, segment, totalEvents, eventCount, triggerAtts);
+        segments.push_back(std::make_pair((*ci)->getSegment(), triggerAtts));
+    }
+
+    // Keep a few segments in hand ahead of the one being written, rather
+    // than holding the XML for all of them at once.
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const size_t window = size_t(std::max(2, 2 * pool->maxThreadCount()));
+
+    std::vector<std::unique_ptr<XmlTask> > tasks(segments.size());
+    size_t started = 0;
+    bool ok = true;
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+
+        while (ok  &&  started < segments.size()  &&
+               started < i + window) {
+            Segment *segment = segments[started].first;
+            const QString extraAttributes = segments[started].second;
+
+            tasks[started].reset(new XmlTask(
+                    [this, segment, extraAttributes]() {
+                        QString xml;
+                        QTextStream stream(&xml, QIODevice::WriteOnly);
+                        long count = 0;
+                        saveSegment(stream, segment, 0, count,
+                                    extraAttributes);
+                        stream.flush();
+                        return xml;
+                    }));
+            pool->start(tasks[started].get());
+            ++started;
+        }
+
+        // We stopped starting them after a write failed.
+        if (i >= started)
+            break;
+
+        // Wait for this one even if we won't write it, so that it is
+        // finished with before it is deleted.
+        const QByteArray &xml = tasks[i]->wait();
+
+        // Put a break in the file
+        //
+        if (ok  &&  i == firstTrigger)
+            ok = write("\n\n");
+
+        if (ok)
+            ok = write(xml);
+
+        tasks[i].reset();
     }
 
+    if (!ok)
+        return false;
+
+    outText.clear();
+
+    // Put a break in the file, if the loop didn't
+    //
+    if (firstTrigger == segments.size())
+        outStream << "\n\n";
+
     // Put a break in the file
     //
     outStream << "\n\n";
@@ -1315,23 +1484,8 @@ bool RosegardenDocument::saveDocumentActual(const QString& filename,
     //
     outStream << "</rosegarden-data>\n";
 
-    bool okay = GzipFile::writeToFile(filename, outText);
-    if (!okay) {
-        errMsg = tr("Error while writing on '%1'").arg(filename);
-        return false;
-    }
-
-    RG_DEBUG << "RosegardenDocument::saveDocument() finished";
-
-    if (!autosave) {
-        m_modified = false;
-        emit documentModified(false);
-        CommandHistory::getInstance()->documentSaved();
-    }
-
-    setAutoSaved(true);
-
-    return true;
+    outStream.flush();
+    return write(outText.toUtf8());
 }
 
 bool RosegardenDocument::exportStudio(const QString& filename,
@@ -1624,7 +1778,7 @@ bool RosegardenDocument::isSoundEnabled() const
 }
 
 bool
-RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
+RosegardenDocument::xmlParse(GzipReader &file, QString &errMsg,
                            bool permanent,
                            bool &cancelled)
 {
@@ -1632,21 +1786,17 @@ RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
 
     cancelled = false;
 
-    unsigned int elementCount = 0;
-    for (int i = 0; i < fileContents.length() - 1; ++i) {
-        if (fileContents[i] == '<' && fileContents[i+1] != '/') {
-            ++elementCount;
-        }
-    }
-
     if (permanent && m_soundEnabled) RosegardenSequencer::getInstance()->removeAllDevices();
 
-    RoseXmlHandler handler(this, elementCount, m_progressDialog, permanent);
+    // We don't know how many elements there are until we've read them
+    // all, so progress goes by how much of the file has been read.
+    RoseXmlHandler handler(this, 0, m_progressDialog, permanent);
+    handler.setProgressReader(&file);
 
     XMLReader reader;
     reader.setHandler(&handler);
 
-    bool ok = reader.parse(fileContents);
+    bool ok = reader.parse(file);
 
     if (m_progressDialog  &&  m_progressDialog->wasCanceled()) {
         QMessageBox::information(dynamic_cast<QWidget *>(parent()), tr("Rosegarden"), tr("File load cancelled"));
@@ -1654,6 +1804,13 @@ RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
         return true;
     }
 
+    // A truncated or corrupt file shows up here rather than as a
+    // failure to read it up front.
+    if (ok  &&  !file.isComplete()) {
+        errMsg = tr("Could not read the whole file");
+        return false;
+    }
+
     if (!ok) {
 
 #if 0
@@ -1763,8 +1920,12 @@ RosegardenDocument::xmlParse(QString fileContents, QString &errMsg,
                 QString msg(tr("This file contains one or more old element types that are now deprecated.\nSupport for these elements may disappear in future versions of Rosegarden.\nWe recommend you re-save this file from this version of Rosegarden to ensure that it can still be re-loaded in future versions."));
                 slotDocumentModified(); // so file can be re-saved immediately
 
-                StartupLogo::hideIfStillThere();
-                QMessageBox::information(dynamic_cast<QWidget *>(parent()), tr("Rosegarden"), msg);
+                if (isHeadless()) {
+                    RG_WARNING << "xmlParse():" << msg;
+                } else {
+                    StartupLogo::hideIfStillThere();
+                    QMessageBox::information(dynamic_cast<QWidget *>(parent()), tr("Rosegarden"), msg);
+                }
             }
 
         }
@@ -26,6 +26,7 @@
 #include "base/Segment.h"
 #include "base/Studio.h"
 #include "gui/editors/segment/compositionview/AudioPeaksThread.h"
+#include "document/AutoSaveThread.h"
 #include "sound/AudioFileManager.h"
 #include "base/Event.h"
 
@@ -36,6 +37,7 @@
 #include <QPointer>
 #include <QSharedPointer>
 
+#include <functional>
 #include <map>
 #include <vector>
 
@@ -54,6 +56,7 @@ class MappedEventList;
 class Event;
 class EditViewBase;
 class AudioPluginManager;
+class GzipReader;
 
 
 /// The document object for a document-view model.
@@ -573,6 +576,11 @@ signals:
     void docColoursChanged();
     void devicesResyncd();
 
+private slots:
+    /// The autosave thread has finished.  Mark the document auto-saved
+    /// if it wrote everything.
+    void slotAutoSaveFinished();
+
 private:
     /**
      * initializes the document generally
@@ -585,7 +593,7 @@ private:
     void performAutoload();
 
     /**
-     * Parse the Rosegarden file in \a file
+     * Parse the Rosegarden file in \a file as it is decompressed
      *
      * \a errMsg will contains the error messages
      * if parsing failed.
@@ -593,10 +601,13 @@ private:
      * @return false if parsing failed
      * @see RoseXmlHandler
      */
-    bool xmlParse(QString fileContents, QString &errMsg,
+    bool xmlParse(GzipReader &file, QString &errMsg,
                   bool permanent,
                   bool &cancelled);
 
+    /// Tell the user why openDocument() failed, or log it if headless.
+    void showLoadError(const QString &message);
+
     /**
      * Set the "auto saved" status of the document
      * Doc. modification sets it to false, autosaving
@@ -624,8 +635,18 @@ private:
     bool saveDocumentActual(const QString &filename, QString& errMsg,
                             bool autosave = false);
 
+    /**
+     * Generate the document's XML, passing it to write() a part at a
+     * time, in order.  The segments are done in parallel.  Stops and
+     * returns false if write() does.
+     */
+    bool writeXml(const std::function<bool (const QByteArray &)> &write);
+
     /**
      * Save one segment to the given text stream
+     *
+     * writeXml() calls this on several threads at once, so it must
+     * only read from the segment.
      */
     void saveSegment(QTextStream&, Segment*,
                      long totalNbOfEvents, long &count,
@@ -737,6 +758,13 @@ private:
      */
     AudioPeaksThread m_audioPeaksThread;
 
+    /**
+     * writes autosave files in the background
+     */
+    AutoSaveThread m_autoSaveThread;
+    /// No changes since the snapshot m_autoSaveThread is writing.
+    bool m_autoSaveCurrent;
+
     typedef std::map<InstrumentId, Segment *> RecordingSegmentMap;
 
     /**
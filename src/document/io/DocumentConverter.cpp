@@ -0,0 +1,234 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[DocumentConverter]"
+
+#include "DocumentConverter.h"
+
+#include "CsoundExporter.h"
+#include "LilyPondExporter.h"
+#include "MupExporter.h"
+#include "MusicXmlExporter.h"
+
+#include "base/Composition.h"
+#include "base/Segment.h"
+#include "base/SegmentNotationHelper.h"
+#include "base/Selection.h"
+#include "document/CommandHistory.h"
+#include "document/RosegardenDocument.h"
+#include "misc/Debug.h"
+#include "misc/Strings.h"
+#include "sound/MidiFile.h"
+
+#include <QFileInfo>
+
+
+namespace Rosegarden
+{
+
+
+DocumentConverter::DocumentConverter()
+{
+}
+
+DocumentConverter::~DocumentConverter()
+{
+    if (RosegardenDocument::currentDocument == m_document.get())
+        RosegardenDocument::currentDocument = nullptr;
+}
+
+DocumentConverter::Format
+DocumentConverter::formatFromName(const QString &name)
+{
+    const QString lower = name.toLower();
+
+    if (lower == "rg"  ||  lower == "rosegarden")
+        return Rg;
+    if (lower == "mid"  ||  lower == "midi")
+        return Midi;
+    if (lower == "ly"  ||  lower == "lilypond")
+        return LilyPond;
+    if (lower == "xml"  ||  lower == "musicxml")
+        return MusicXml;
+    if (lower == "mup")
+        return Mup;
+    if (lower == "csd"  ||  lower == "csound")
+        return Csound;
+
+    return Unknown;
+}
+
+QString
+DocumentConverter::extension(Format format)
+{
+    switch (format) {
+    case Rg:       return "rg";
+    case Midi:     return "mid";
+    case LilyPond: return "ly";
+    case MusicXml: return "xml";
+    case Mup:      return "mup";
+    case Csound:   return "csd";
+    case Unknown:
+    default:       return QString();
+    }
+}
+
+QString
+DocumentConverter::outputBaseName(const QString &baseName, Format format)
+{
+    if (format == LilyPond)
+        return LilyPondExporter::legalFileName(baseName);
+
+    return baseName;
+}
+
+bool
+DocumentConverter::load(const QString &filename)
+{
+    m_error.clear();
+
+    // Free the last one first, so that two are never alive at once.
+    if (RosegardenDocument::currentDocument == m_document.get())
+        RosegardenDocument::currentDocument = nullptr;
+    m_document.reset();
+    CommandHistory::getInstance()->clear();
+
+    m_document.reset(new RosegardenDocument(
+            nullptr,  // parent
+            {},  // audioPluginManager
+            true,  // skipAutoload
+            true,  // clearCommandHistory
+            false));  // enableSound
+
+    // The exporters and mappers look here for the document.
+    RosegardenDocument::currentDocument = m_document.get();
+
+    switch (formatFromFile(filename)) {
+    case Rg:
+        if (!m_document->openDocument(
+                    filename,
+                    false,  // permanent
+                    true,  // squelchProgressDialog
+                    false)) {  // enableLock
+            m_error = tr("Can't load \"%1\"").arg(filename);
+            return false;
+        }
+        return true;
+
+    case Midi:
+        return loadMidi(filename);
+
+    default:
+        m_error = tr("Can't load \"%1\": unknown file type").arg(filename);
+        return false;
+    }
+}
+
+bool
+DocumentConverter::loadMidi(const QString &filename)
+{
+    MidiFile midiFile;
+    if (!midiFile.convertToRosegarden(filename, m_document.get())) {
+        m_error = strtoqstr(midiFile.getError());
+        return false;
+    }
+
+    m_document->setTitle(QFileInfo(filename).fileName());
+    m_document->setAbsFilePath(QFileInfo(filename).absoluteFilePath());
+
+    // Give each segment a clef, as importing in the GUI does, so the
+    // notation exporters get something sensible.  Key guessing and
+    // notation quantization are left to the exporters.
+    Composition &composition = m_document->getComposition();
+    for (Segment *segment : composition) {
+        segment->insert(SegmentNotationHelper::guessClef(
+                                segment->begin(), segment->getEndMarker())
+                        .getAsEvent(segment->getStartTime()));
+    }
+
+    return true;
+}
+
+bool
+DocumentConverter::save(const QString &filename, Format format)
+{
+    m_error.clear();
+
+    if (!m_document) {
+        m_error = tr("Nothing loaded");
+        return false;
+    }
+
+    Composition &composition = m_document->getComposition();
+    const std::string name = qstrtostr(filename);
+    bool ok = false;
+
+    switch (format) {
+    case Rg:
+        ok = m_document->saveDocument(filename, m_error);
+        break;
+
+    case Midi: {
+        MidiFile midiFile;
+        ok = midiFile.convertToMidi(m_document.get(), filename);
+        break;
+    }
+
+    case LilyPond: {
+        LilyPondExporter exporter(m_document.get(), SegmentSelection(), name);
+        ok = exporter.write();
+        if (!exporter.getMessage().isEmpty())
+            m_error = exporter.getMessage();
+        break;
+    }
+
+    case MusicXml: {
+        MusicXmlExporter exporter(nullptr, m_document.get(), name);
+        ok = exporter.write();
+        break;
+    }
+
+    case Mup: {
+        MupExporter exporter(nullptr, &composition, name);
+        ok = exporter.write();
+        break;
+    }
+
+    case Csound: {
+        CsoundExporter exporter(nullptr, &composition, name);
+        ok = exporter.write();
+        break;
+    }
+
+    case Unknown:
+    default:
+        m_error = tr("Unknown output format");
+        return false;
+    }
+
+    if (!ok  &&  m_error.isEmpty())
+        m_error = tr("Can't write \"%1\"").arg(filename);
+
+    // A warning from an export that worked is not an error.
+    if (ok)
+        m_error.clear();
+
+    return ok;
+}
+
+
+}
@@ -0,0 +1,111 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_DOCUMENTCONVERTER_H
+#define RG_DOCUMENTCONVERTER_H
+
+#include <rosegardenprivate_export.h>
+
+#include <QCoreApplication>
+#include <QString>
+
+#include <memory>
+
+
+namespace Rosegarden
+{
+
+
+class RosegardenDocument;
+
+
+/// Loads a file into a document and exports it, without any UI.
+/**
+ * Used by rosegarden-convert.  This works with only a QCoreApplication,
+ * so it never shows a dialog: anything that would have asked the user
+ * is logged instead (see isHeadless()).
+ *
+ * The document model keeps some state for the whole process
+ * (RosegardenDocument::currentDocument and the CommandHistory), so
+ * there should be only one DocumentConverter at a time, on the main
+ * thread.  It can be reused for any number of files.
+ */
+class ROSEGARDENPRIVATE_EXPORT DocumentConverter
+{
+    Q_DECLARE_TR_FUNCTIONS(Rosegarden::DocumentConverter)
+
+public:
+    enum Format {
+        Unknown,
+        Rg,
+        Midi,
+        LilyPond,
+        MusicXml,
+        Mup,
+        Csound
+    };
+
+    DocumentConverter();
+    ~DocumentConverter();
+
+    /// "rg", "midi", "lilypond", etc. or a file extension.
+    static Format formatFromName(const QString &name);
+
+    /// The format for filename's extension.
+    static Format formatFromFile(const QString &filename)
+        { return formatFromName(filename.section('.', -1)); }
+
+    /// The extension to give files written in format, without the dot.
+    static QString extension(Format format);
+
+    /// baseName changed, if need be, so that format can be written to it.
+    /**
+     * LilyPond can't have spaces, backslashes or quotes in the name, and
+     * save() fails rather than write anywhere other than where it was
+     * asked, so outputs should be named with this.
+     */
+    static QString outputBaseName(const QString &baseName, Format format);
+
+    /// Whether files in format can be loaded.  .rg and MIDI only.
+    static bool canLoad(Format format)
+        { return format == Rg  ||  format == Midi; }
+
+    /// Load filename, replacing the previous document.
+    bool load(const QString &filename);
+
+    /// Write the loaded document to filename in format.
+    bool save(const QString &filename, Format format);
+
+    /// Why load() or save() last failed.
+    QString getError() const  { return m_error; }
+
+    RosegardenDocument *getDocument()  { return m_document.get(); }
+
+private:
+    DocumentConverter(const DocumentConverter &) = delete;
+    DocumentConverter &operator=(const DocumentConverter &) = delete;
+
+    bool loadMidi(const QString &filename);
+
+    std::unique_ptr<RosegardenDocument> m_document;
+    QString m_error;
+};
+
+
+}
+
+#endif
@@ -35,6 +35,7 @@
 
 #include "misc/Debug.h"
 #include "misc/Strings.h"
+#include "misc/Headless.h"
 #include "misc/ConfigGroups.h"
 #include "base/BaseProperties.h"
 #include "base/Composition.h"
@@ -794,6 +795,17 @@ struct MarkerComp {
     }
 };
 
+QString
+LilyPondExporter::legalFileName(const QString &fileName)
+{
+    QString legal = fileName;
+    legal.remove(' ');
+    legal.remove('\\');
+    legal.remove('\'');
+    legal.remove('"');
+    return legal;
+}
+
 bool
 LilyPondExporter::write()
 {
@@ -810,12 +822,18 @@ LilyPondExporter::write()
 
     // sed LilyPond-choking chars out of the filename proper
     bool illegalFilename = (baseName.contains(' ') || baseName.contains("\\"));
-    baseName.replace(QRegularExpression(" "), "");
-    baseName.replace(QRegularExpression("\\\\"), "");
-    baseName.replace(QRegularExpression("'"), "");
-    baseName.replace(QRegularExpression("\""), "");
+    const QString legalName = legalFileName(baseName);
+
+    // With no one to ask, writing somewhere other than where we were
+    // told would leave the caller reporting the wrong file.
+    if (legalName != baseName  &&  isHeadless()) {
+        RG_WARNING << "write(): LilyPond can't use the filename" << tmpName;
+        m_warningMessage = tr("Export failed.  LilyPond does not allow spaces, backslashes or quotes in filenames.  Try \"%1\" instead.").arg(legalName);
+        return false;
+    }
 
     // cat back together
+    baseName = legalName;
     tmpName = dirName + '/' + baseName;
 
     if (illegalFilename) {
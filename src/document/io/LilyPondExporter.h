@@ -120,6 +120,15 @@ public:
     */
     QString getMessage() const { return m_warningMessage; }
 
+    /// fileName without the characters LilyPond can't cope with.
+    /**
+     * Spaces, backslashes and quotes.  write() uses this on the name
+     * it was given; in headless mode it fails instead if that changes
+     * anything, so callers wanting the export to go ahead should pass
+     * a name that is already legal.
+     */
+    static QString legalFileName(const QString &fileName);
+
     void setProgressDialog(QPointer<QProgressDialog> progressDialog)
             { m_progressDialog = progressDialog; }
 
@@ -61,7 +61,7 @@ MusicXmlExporter::MusicXmlExporter(RosegardenMainWindow *parent,
         m_fileName(fileName)
 {
     m_composition = &m_doc->getComposition();
-    m_view = parent->getView();
+    m_view = parent ? parent->getView() : nullptr;
     readConfigVariables();
 }
 
@@ -19,6 +19,7 @@
 #define RG_XMLREADER_H
 
 class QFile;
+class QIODevice;
 class QXmlStreamReader;
 
 #include <QString>
@@ -48,6 +49,13 @@ class ROSEGARDENPRIVATE_EXPORT XMLReader
 
     /// parse the XML file
     bool parse(QFile& xmlFile);
+
+    /// parse XML from a device that is already open, as it arrives
+    /**
+     * The device is read in small blocks, so the whole document never
+     * has to be held in memory.  See GzipReader.
+     */
+    bool parse(QIODevice& device);
     
  private:
     XMLHandler* m_handler;
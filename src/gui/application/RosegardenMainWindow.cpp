@@ -44,6 +44,7 @@
 #include "base/SegmentNotationHelper.h"
 #include "base/Selection.h"
 #include "base/Studio.h"
+#include "base/Trace.h"
 #include "base/Track.h"
 #include "commands/edit/CopyCommand.h"
 #include "commands/edit/CutCommand.h"
@@ -564,6 +565,7 @@ RosegardenMainWindow::~RosegardenMainWindow()
     RosegardenDocument::currentDocument = nullptr;
 
     Profiles::getInstance()->dump();
+    Trace::saveIfRequested();
 }
 
 int RosegardenMainWindow::sigpipe[2];
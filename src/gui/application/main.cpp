@@ -26,6 +26,7 @@
 #include "gui/general/ThornStyle.h"
 #include "gui/application/RosegardenApplication.h"
 #include "base/RealTime.h"
+#include "base/Trace.h"
 #include "misc/Preferences.h"
 
 #include "sound/MidiFile.h"
@@ -383,6 +384,7 @@ static void convert(const QStringList &args)
 
 int main(int argc, char *argv[])
 {
+    Trace::setThreadName("GUI");
 
     // Initialization of static objects related to read and write of audio
     // files.
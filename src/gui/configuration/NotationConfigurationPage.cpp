@@ -624,6 +624,20 @@ NotationConfigurationPage::NotationConfigurationPage(QWidget *parent) :
     layout->addWidget(m_distributeVerses, row, 2);
     ++row;
 
+    layout->addWidget
+        (new QLabel
+         (tr("Only draw the part of the score near the view"), frame),
+         row, 0, 1, 2);
+    m_lazyRendering = new QCheckBox(frame);
+    m_lazyRendering->setToolTip(tr("<qt>Saves memory and time with large scores.  Takes effect the next time a notation editor is opened.</qt>"));
+    connect(m_lazyRendering, &QCheckBox::stateChanged,
+            this, &NotationConfigurationPage::slotModified);
+    bool defaultLazyRendering =
+        qStrToBool(settings.value("lazyrendering", "false")) ;
+    m_lazyRendering->setChecked(defaultLazyRendering);
+    layout->addWidget(m_lazyRendering, row, 2);
+    ++row;
+
 
     layout->setRowStretch(row, 10);
     frame->setLayout(layout);
@@ -769,6 +783,7 @@ NotationConfigurationPage::apply()
                        m_hideRedundantClefKey->isChecked());
     settings.setValue("distributeverses",
                        m_distributeVerses->isChecked());
+    settings.setValue("lazyrendering", m_lazyRendering->isChecked());
 
     settings.endGroup();
 }
@@ -95,6 +95,7 @@ protected:
     QCheckBox *m_editRepeated;
     QCheckBox *m_hideRedundantClefKey;
     QCheckBox *m_distributeVerses;
+    QCheckBox *m_lazyRendering;
 
     void populateSizeCombo(QComboBox *combo, QString font, int defaultSize);
 };
@@ -559,6 +559,8 @@ MatrixSelector::getSelection(EventSelection *&selection)
     m_previousCollisions = l;
 
     if (!l.empty()) {
+        std::vector<Event *> events;
+        events.reserve(l.size());
         for (int i = 0; i < l.size(); ++i) {
             QGraphicsItem *item = l[i];
             MatrixElement *element = MatrixElement::getMatrixElement(item);
@@ -567,9 +569,10 @@ MatrixSelector::getSelection(EventSelection *&selection)
                 //!!! NB. In principle, this element might not come
                 //!!! from the right segment (in practice we only have
                 //!!! one segment, but that may change)
-                selection->addEvent(element->event());
+                events.push_back(element->event());
             }
         }
+        selection->addEvents(events);
     }
 
     if (selection->getAddedEvents() == 0) {
@@ -67,6 +67,14 @@ public:
 
     void setSegments(NotationScene *scene);
 
+    /**
+     * Rebuild the context now if the segments have changed since it was
+     * last built, rather than in the next get...FromContext() call.
+     * Once this has been done the getters only read, so they may be
+     * called from several threads at once.
+     */
+    void update()  { if (m_changed) setSegments(m_scene); }
+
     /**
      * Returns the clef which should be in used on given track at given time
      * without looking at possible clef event on this precise place.
@@ -48,6 +48,7 @@
 #include <QSettings>
 #include <QObject>
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
@@ -61,6 +62,11 @@ NotationHLayout::NotationHLayout(Composition *c, NotePixmapFactory *npf,
                                  const NotationProperties &properties,
                                  QObject* parent) :
     HorizontalLayoutEngine(c),
+    m_barPositionsValid(false),
+    m_reconciledNameWidth(0.),
+    m_reconciledFirstBar(0),
+    m_reconciledLastBar(0),
+    m_firstChangedBar(0),
     m_totalWidth(0.),
     m_pageMode(false),
     m_pageWidth(0.),
@@ -132,12 +138,15 @@ NotationHLayout::getAvailableProportions()
 NotationHLayout::BarDataList &
 NotationHLayout::getBarData(ViewSegment &staff)
 {
+    // Look up before inserting, so that a staff that has been through
+    // prepareViewSegment() never modifies the map.
     BarDataMap::iterator i = m_barData.find(&staff);
     if (i == m_barData.end()) {
-        m_barData[&staff] = BarDataList();
+        i = m_barData.insert(BarDataMap::value_type(&staff,
+                                                    BarDataList())).first;
     }
 
-    return m_barData[&staff];
+    return i->second;
 }
 
 const NotationHLayout::BarDataList &
@@ -224,11 +233,20 @@ NotationHLayout::scanViewSegment(ViewSegment &staff, timeT startTime,
     TrackId trackId = segment.getTrack();
     std::string name =
         segment.getComposition()->getTrackById(trackId)->getLabel();
-    m_staffNameWidths[&staff] =
+    // As in getBarData(), find before inserting, so that the scan of a
+    // prepared staff doesn't modify the maps other scans are reading.
+    ViewSegmentIntMap::iterator nameWidthIter =
+            m_staffNameWidths.find(&staff);
+    if (nameWidthIter == m_staffNameWidths.end()) {
+        nameWidthIter = m_staffNameWidths.insert(
+                ViewSegmentIntMap::value_type(&staff, 0)).first;
+    }
+    int &staffNameWidth = nameWidthIter->second;
+    staffNameWidth =
         npf->getNoteBodyWidth() * 2 +
         npf->getTextWidth(Text(name, Text::StaffName));
 
-    RG_DEBUG << "scanViewSegment: full scan " << full << ", times " << startTime << "->" << endTime << ", bars " << startBarNo << "->" << endBarNo << ", staff name \"" << segment.getLabel() << "\", width " << m_staffNameWidths[&staff];
+    RG_DEBUG << "scanViewSegment: full scan " << full << ", times " << startTime << "->" << endTime << ", bars " << startBarNo << "->" << endBarNo << ", staff name \"" << segment.getLabel() << "\", width " << staffNameWidth;
 
     SegmentNotationHelper helper(segment);
     if (full) {
@@ -248,13 +266,21 @@ NotationHLayout::scanViewSegment(ViewSegment &staff, timeT startTime,
     int ottavaShift = 0;
     timeT ottavaEnd = segEndTime;
 
+    std::map<ViewSegment *, bool>::iterator ottavaIter =
+            m_haveOttavaSomewhere.find(&staff);
+    if (ottavaIter == m_haveOttavaSomewhere.end()) {
+        ottavaIter = m_haveOttavaSomewhere.insert(
+                std::make_pair(&staff, false)).first;
+    }
+    bool &haveOttavaSomewhere = ottavaIter->second;
+
     if (full) {
 
         RG_DEBUG << "full scan: setting haveOttava false";
 
-        m_haveOttavaSomewhere[&staff] = false;
+        haveOttavaSomewhere = false;
 
-    } else if (m_haveOttavaSomewhere[&staff]) {
+    } else if (haveOttavaSomewhere) {
 
         RG_DEBUG << "not full scan but ottava is listed";
 
@@ -478,7 +504,7 @@ NotationHLayout::scanViewSegment(ViewSegment &staff, timeT startTime,
                         ottavaShift = indication.getOttavaShift();
                         ottavaEnd = el->event()->getAbsoluteTime() +
                                     indication.getIndicationDuration();
-                        m_haveOttavaSomewhere[&staff] = true;
+                        haveOttavaSomewhere = true;
                     }
                 } catch (...) {
                     RG_DEBUG << "Bad indication!";
@@ -522,10 +548,18 @@ NotationHLayout::scanViewSegment(ViewSegment &staff, timeT startTime,
     */
 }
 
+void
+NotationHLayout::prepareViewSegment(ViewSegment &staff)
+{
+    (void)getBarData(staff);
+    (void)m_staffNameWidths[&staff];
+    (void)m_haveOttavaSomewhere[&staff];
+}
+
 void
 NotationHLayout::clearBarList(ViewSegment &staff)
 {
-    BarDataList &bdl = m_barData[&staff];
+    BarDataList &bdl = getBarData(staff);
     bdl.clear();
 }
 
@@ -542,7 +576,7 @@ NotationHLayout::setBarBasicData(ViewSegment &staff,
 {
     //    RG_DEBUG << "setBarBasicData for " << barNo;
 
-    BarDataList &bdl(m_barData[&staff]);
+    BarDataList &bdl(getBarData(staff));
 
     BarDataList::iterator i(bdl.find(barNo));
     if (i == bdl.end()) {
@@ -569,7 +603,7 @@ NotationHLayout::setBarSizeData(ViewSegment &staff,
 {
     //    RG_DEBUG << "setBarSizeData for " << barNo;
 
-    BarDataList &bdl(m_barData[&staff]);
+    BarDataList &bdl(getBarData(staff));
 
     BarDataList::iterator i(bdl.find(barNo));
     if (i == bdl.end()) {
@@ -1018,6 +1052,95 @@ NotationHLayout::getMaxRepeatedClefAndKeyWidth(int barNo)
         return 0;
 }
 
+double
+NotationHLayout::getMaxStaffNameWidth() const
+{
+    double width = 0.0;
+    for (ViewSegmentIntMap::const_iterator i = m_staffNameWidths.begin();
+            i != m_staffNameWidths.end(); ++i) {
+        if (i->second > width)
+            width = double(i->second);
+    }
+    return width;
+}
+
+void
+NotationHLayout::setReconciledWidth(int barNo, double width)
+{
+    for (BarDataMap::iterator i = m_barData.begin();
+            i != m_barData.end(); ++i) {
+
+        BarDataList &list = i->second;
+        BarDataList::iterator bdli = list.find(barNo);
+        if (bdli != list.end()) {
+
+            BarData::SizeData &bd(bdli->second.sizeData);
+
+            RG_DEBUG << "Changing width from " << bd.reconciledWidth << " to " << width;
+
+            double diff = width - bd.reconciledWidth;
+            if (diff < -0.1 || diff > 0.1) {
+                RG_DEBUG << "(So needsLayout becomes true)";
+                bdli->second.layoutData.needsLayout = true;
+            }
+            bd.reconciledWidth = width;
+        }
+    }
+}
+
+void
+NotationHLayout::setClefKeyWidth(int barNo, int width)
+{
+    for (BarDataMap::iterator i = m_barData.begin();
+            i != m_barData.end(); ++i) {
+
+        BarDataList &list = i->second;
+        BarDataList::iterator bdli = list.find(barNo);
+
+        if (bdli != list.end() &&
+            bdli->second.sizeData.clefKeyWidth != width) {
+            bdli->second.sizeData.clefKeyWidth = width;
+            bdli->second.layoutData.needsLayout = true;
+        }
+    }
+}
+
+bool
+NotationHLayout::reconcileBarLinear(int barNo)
+{
+    ViewSegment *widest = getViewSegmentWithWidestBar(barNo);
+
+    if (!widest) {
+        // have we reached the end of the piece?
+        if (barNo >= getLastVisibleBar()) { // yes
+            return false;
+        } else {
+            m_totalWidth += m_spacing / 3;
+            RG_DEBUG << "Setting bar position for degenerate bar "
+            << barNo << " to " << m_totalWidth;
+
+            m_barPositions[barNo] = m_totalWidth;
+            return true;
+        }
+    }
+
+    float maxWidth = m_barData[widest].find(barNo)->second.sizeData.idealWidth;
+    if (m_pageWidth > 0.1 && maxWidth > m_pageWidth) {
+        maxWidth = m_pageWidth;
+    }
+
+    RG_DEBUG << "Setting bar position for bar " << barNo
+    << " to " << m_totalWidth;
+
+    m_barPositions[barNo] = m_totalWidth;
+    m_totalWidth += maxWidth;
+
+    // Now apply width to this bar on all staffs
+    setReconciledWidth(barNo, maxWidth);
+
+    return true;
+}
+
 void
 NotationHLayout::reconcileBarsLinear()
 {
@@ -1030,80 +1153,83 @@ NotationHLayout::reconcileBarsLinear()
     // still sets the bar line positions etc.
 
     int barNo = getFirstVisibleBar();
+    m_firstChangedBar = barNo;
 
-    m_totalWidth = 0.0;
-    for (ViewSegmentIntMap::iterator i = m_staffNameWidths.begin();
-            i != m_staffNameWidths.end(); ++i) {
-        if (i->second > m_totalWidth)
-            m_totalWidth = double(i->second);
+    m_barPositions.clear();
+    m_totalWidth = getMaxStaffNameWidth();
+
+    while (reconcileBarLinear(barNo)) {
+        ++barNo;
     }
 
-    for (;;) {
+    RG_DEBUG << "Setting bar position for bar " << barNo
+    << " to " << m_totalWidth;
 
-        ViewSegment *widest = getViewSegmentWithWidestBar(barNo);
+    m_barPositions[barNo] = m_totalWidth;
+}
 
-        if (!widest) {
-            // have we reached the end of the piece?
-            if (barNo >= getLastVisibleBar()) { // yes
-                break;
-            } else {
-                m_totalWidth += m_spacing / 3;
-                RG_DEBUG << "Setting bar position for degenerate bar "
-                << barNo << " to " << m_totalWidth;
+bool
+NotationHLayout::reconcileBarsLinear(int firstBar, int lastBar)
+{
+    Profiler profiler("NotationHLayout::reconcileBarsLinear(range)");
 
-                m_barPositions[barNo] = m_totalWidth;
-                ++barNo;
-                continue;
-            }
-        }
+    // Only the bars from firstBar to lastBar have been scanned, so only
+    // their widths can have changed.  The bars before them stay where
+    // they are, and those after them move by however much the scanned
+    // bars grew or shrank.
 
-        float maxWidth = m_barData[widest].find(barNo)->second.sizeData.idealWidth;
-        if (m_pageWidth > 0.1 && maxWidth > m_pageWidth) {
-            maxWidth = m_pageWidth;
-        }
+    if (getMaxStaffNameWidth() != m_reconciledNameWidth)
+        return false;
 
-        RG_DEBUG << "Setting bar position for bar " << barNo
-        << " to " << m_totalWidth;
+    firstBar = std::max(firstBar, getFirstVisibleBar());
 
-        m_barPositions[barNo] = m_totalWidth;
-        m_totalWidth += maxWidth;
+    BarPositionList::iterator first = m_barPositions.find(firstBar);
+    BarPositionList::iterator next = m_barPositions.find(lastBar + 1);
+    if (first == m_barPositions.end() || next == m_barPositions.end())
+        return false;
 
-        // Now apply width to this bar on all staffs
+    const double oldNextX = next->second;
 
-        for (BarDataMap::iterator i = m_barData.begin();
-                i != m_barData.end(); ++i) {
+    m_firstChangedBar = firstBar;
+    m_totalWidth = first->second;
 
-            BarDataList &list = i->second;
-            BarDataList::iterator bdli = list.find(barNo);
-            if (bdli != list.end()) {
+    for (int barNo = firstBar; barNo <= lastBar; ++barNo) {
+        if (!reconcileBarLinear(barNo)) {
+            // The piece now ends here.
+            m_barPositions.erase(m_barPositions.lower_bound(barNo),
+                                 m_barPositions.end());
+            m_barPositions[barNo] = m_totalWidth;
+            return true;
+        }
+    }
 
-                BarData::SizeData &bd(bdli->second.sizeData);
+    const double delta = m_totalWidth - oldNextX;
 
-                RG_DEBUG << "Changing width from " << bd.reconciledWidth << " to " << maxWidth;
+    RG_DEBUG << "reconcileBarsLinear: bars" << firstBar << "to" << lastBar << "rescanned, moving later bars by" << delta;
 
-                double diff = maxWidth - bd.reconciledWidth;
-                if (diff < -0.1 || diff > 0.1) {
-                    RG_DEBUG << "(So needsLayout becomes true)";
-                    bdli->second.layoutData.needsLayout = true;
-                }
-                bd.reconciledWidth = maxWidth;
-            }
+    if (delta < -0.001 || delta > 0.001) {
+        for (BarPositionList::iterator i = m_barPositions.find(lastBar + 1);
+                i != m_barPositions.end(); ++i) {
+            i->second += delta;
         }
-
-        ++barNo;
     }
 
-    RG_DEBUG << "Setting bar position for bar " << barNo
-    << " to " << m_totalWidth;
+    m_totalWidth = m_barPositions.rbegin()->second;
 
-    m_barPositions[barNo] = m_totalWidth;
+    return true;
 }
 
 void
-NotationHLayout::reconcileBarsPage()
+NotationHLayout::reconcileBarsPage(size_t fromRow)
 {
     Profiler profiler("NotationHLayout::reconcileBarsPage");
 
+    // Rows before fromRow are unchanged, so we reflow from the first
+    // bar of fromRow, picking up the state we had there.
+
+    if (fromRow >= m_rowStartBars.size())
+        fromRow = 0;
+
     int barNo = getFirstVisibleBar();
     int barNoThisRow = 0;
 
@@ -1112,19 +1238,39 @@ NotationHLayout::reconcileBarsPage()
     std::vector<std::pair<int, double> > rowData;
 
     double stretchFactor = 10.0;
-    double maxViewSegmentNameWidth = 0.0;
+    double maxViewSegmentNameWidth = getMaxStaffNameWidth();
 
-    for (ViewSegmentIntMap::iterator i = m_staffNameWidths.begin();
-            i != m_staffNameWidths.end(); ++i) {
-        if (i->second > maxViewSegmentNameWidth) {
-            maxViewSegmentNameWidth = double(i->second);
+    double pageWidthSoFar = maxViewSegmentNameWidth;
+    m_totalWidth = maxViewSegmentNameWidth + getPreBarMargin();
+
+    if (fromRow > 0) {
+        barNo = m_rowStartBars[fromRow];
+        m_totalWidth = m_barPositions[barNo];
+
+        // The first bar of the row, as if we had just broken before it.
+        ViewSegment *widest = getViewSegmentWithWidestBar(barNo);
+        double maxWidth = m_spacing / 3;
+        if (widest) {
+            maxWidth =
+                m_barData[widest].find(barNo)->second.sizeData.idealWidth;
         }
+        int maxClefKeyWidth = getMaxRepeatedClefAndKeyWidth(barNo);
+        setClefKeyWidth(barNo, maxClefKeyWidth);
+
+        barNoThisRow = 1;
+        pageWidthSoFar = maxWidth + maxClefKeyWidth;
+        stretchFactor = m_pageWidth / pageWidthSoFar;
+        ++barNo;
+    } else {
+        m_barPositions.clear();
+        barNo = getFirstVisibleBar();
     }
 
-    double pageWidthSoFar = maxViewSegmentNameWidth;
-    m_totalWidth = maxViewSegmentNameWidth + getPreBarMargin();
+    m_firstChangedBar = (fromRow > 0 ? m_rowStartBars[fromRow] : barNo);
+    m_rowStartBars.resize(fromRow);
+    m_rowStartBars.push_back(m_firstChangedBar);
 
-    RG_DEBUG << "reconcileBarsPage: pageWidthSoFar is " << pageWidthSoFar;
+    RG_DEBUG << "reconcileBarsPage: from row " << fromRow << " (bar " << m_firstChangedBar << "), pageWidthSoFar is " << pageWidthSoFar;
 
     for (;;) {
 
@@ -1191,26 +1337,20 @@ NotationHLayout::reconcileBarsPage()
         if (tooFar) {
             rowData.push_back(std::pair<int, double>(barNoThisRow,
                               pageWidthSoFar));
+            m_rowStartBars.push_back(barNo);
             barNoThisRow = 1;
 
             // When we start a new row, we always need to allow for the
             // repeated clef and key at the start of it.
             int maxClefKeyWidth = getMaxRepeatedClefAndKeyWidth(barNo);
-
-            for (BarDataMap::iterator i = m_barData.begin();
-                    i != m_barData.end(); ++i) {
-
-                BarDataList &list = i->second;
-                BarDataList::iterator bdli = list.find(barNo);
-
-                if (bdli != list.end()) {
-                    bdli->second.sizeData.clefKeyWidth = maxClefKeyWidth;
-                }
-            }
+            setClefKeyWidth(barNo, maxClefKeyWidth);
 
             pageWidthSoFar = maxWidth + maxClefKeyWidth;
             stretchFactor = m_pageWidth / pageWidthSoFar;
         } else {
+            // It may have started a row last time.
+            setClefKeyWidth(barNo, 0);
+
             ++barNoThisRow;
             pageWidthSoFar = nextPageWidth;
             stretchFactor = nextStretchFactor;
@@ -1222,18 +1362,22 @@ NotationHLayout::reconcileBarsPage()
     if (barNoThisRow > 0) {
         rowData.push_back(std::pair<int, double>(barNoThisRow,
                           pageWidthSoFar));
+    } else {
+        m_rowStartBars.pop_back();
     }
 
     // Now we need to actually apply the widths
 
-    barNo = getFirstVisibleBar();
+    barNo = m_firstChangedBar;
+    m_barPositions.erase(m_barPositions.lower_bound(barNo),
+                         m_barPositions.end());
 
     for (unsigned int row = 0; row < rowData.size(); ++row) {
 
         barNoThisRow = barNo;
         int finalBarThisRow = barNo + rowData[row].first - 1;
 
-        pageWidthSoFar = (row > 0 ? 0 : maxViewSegmentNameWidth + getPreBarMargin());
+        pageWidthSoFar = (row + fromRow > 0 ? 0 : maxViewSegmentNameWidth + getPreBarMargin());
         stretchFactor = m_pageWidth / rowData[row].second;
 
         for (; barNoThisRow <= finalBarThisRow; ++barNoThisRow, ++barNo) {
@@ -1269,20 +1413,7 @@ NotationHLayout::reconcileBarsPage()
             m_barPositions[barNo] = m_totalWidth;
             m_totalWidth += maxWidth;
 
-            for (BarDataMap::iterator i = m_barData.begin();
-                    i != m_barData.end(); ++i) {
-
-                BarDataList &list = i->second;
-                BarDataList::iterator bdli = list.find(barNo);
-                if (bdli != list.end()) {
-                    BarData::SizeData &bd(bdli->second.sizeData);
-                    double diff = maxWidth - bd.reconciledWidth;
-                    if (diff < -0.1 || diff > 0.1) {
-                        bdli->second.layoutData.needsLayout = true;
-                    }
-                    bd.reconciledWidth = maxWidth;
-                }
-            }
+            setReconciledWidth(barNo, maxWidth);
 
             pageWidthSoFar += maxWidth;
         }
@@ -1291,14 +1422,63 @@ NotationHLayout::reconcileBarsPage()
     m_barPositions[barNo] = m_totalWidth;
 }
 
+bool
+NotationHLayout::reconcileBarsPageFrom(int firstBar)
+{
+    if (getMaxStaffNameWidth() != m_reconciledNameWidth ||
+        m_rowStartBars.empty())
+        return false;
+
+    // The row holding firstBar.  If firstBar starts it, the break
+    // before it may move, so go back a row.
+    std::vector<int>::iterator i = std::upper_bound(m_rowStartBars.begin(),
+                                                    m_rowStartBars.end(),
+                                                    firstBar);
+    if (i == m_rowStartBars.begin())
+        return false;
+    --i;
+    if (*i == firstBar && i != m_rowStartBars.begin())
+        --i;
+
+    const size_t row = i - m_rowStartBars.begin();
+    if (row == 0 || m_barPositions.find(*i) == m_barPositions.end())
+        return false;
+
+    reconcileBarsPage(row);
+    return true;
+}
+
 void
 NotationHLayout::finishLayout(timeT startTime, timeT endTime, bool full)
 {
     Profiler profiler("NotationHLayout::finishLayout");
-    m_barPositions.clear();
 
-    if (m_pageMode && (m_pageWidth > 0.1)) reconcileBarsPage();
-    else reconcileBarsLinear();
+    const bool pageMode = (m_pageMode && (m_pageWidth > 0.1));
+
+    // After a partial scan, only the scanned bars have new data.  One
+    // bar before the start too, as scanViewSegment() may go back one
+    // for accidentals.
+    bool reconciled = false;
+    if (!full && m_barPositionsValid &&
+        getFirstVisibleBar() == m_reconciledFirstBar &&
+        getLastVisibleBar() == m_reconciledLastBar) {
+        const int firstBar = getComposition()->getBarNumber(startTime) - 1;
+        const int lastBar = getComposition()->getBarNumber(endTime);
+        if (pageMode) reconciled = reconcileBarsPageFrom(firstBar);
+        else reconciled = reconcileBarsLinear(firstBar, lastBar);
+    }
+
+    if (!reconciled) {
+        if (pageMode) reconcileBarsPage();
+        else reconcileBarsLinear();
+        if (!full) m_firstChangedBar = getFirstVisibleBar();
+    }
+
+    m_reconciledNameWidth = getMaxStaffNameWidth();
+    m_reconciledFirstBar = getFirstVisibleBar();
+    m_reconciledLastBar = getLastVisibleBar();
+    if (!pageMode) m_rowStartBars.clear();
+    m_barPositionsValid = true;
 
     int staffNo = 0;
 
@@ -1361,7 +1541,9 @@ NotationHLayout::layout(BarDataMap::iterator i, timeT startTime, timeT endTime,
     Clef clef = segment.getClefAtTime(lastIncrement);
     TimeSignature timeSignature;
 
-    int startBar = getComposition()->getBarNumber(startTime);
+    // Reconciling may have moved bars before startTime, in page mode.
+    int startBar = std::min(getComposition()->getBarNumber(startTime),
+                            m_firstChangedBar);
 
     QSettings settings;
     settings.beginGroup(NotationOptionsConfigGroup);
@@ -2008,6 +2190,8 @@ NotationHLayout::reset()
 
     m_barData.clear();
     m_barPositions.clear();
+    m_rowStartBars.clear();
+    m_barPositionsValid = false;
     m_totalWidth = 0;
 }
 
@@ -2271,4 +2455,52 @@ NotationHLayout::dumpBarDataMap()
     RG_DEBUG << "dumpBarDataMap end";
 }
 
+void
+NotationHLayout::writeBarData(ViewSegment &staff, std::ostream &out) const
+{
+    BarDataMap::const_iterator i = m_barData.find(&staff);
+    if (i == m_barData.end())
+        return;
+
+    const std::streamsize precision =
+            out.precision(std::numeric_limits<double>::max_digits10);
+
+    NotationElementList *notes = staff.getViewElementList();
+
+    for (const BarDataPair &bar : i->second) {
+        const BarData &data = bar.second;
+
+        out << "bar " << bar.first << ": start ";
+        if (data.basicData.start == notes->end())
+            out << "end";
+        else
+            out << (*data.basicData.start)->getViewAbsoluteTime();
+        out << " correct " << data.basicData.correct
+            << " timeSig " << data.basicData.timeSignature.getNumerator()
+            << "/" << data.basicData.timeSignature.getDenominator()
+            << " newTimeSig " << data.basicData.newTimeSig
+            << " delayInBar " << data.basicData.delayInBar
+            << " trackId " << data.basicData.trackId
+            << "; ideal " << data.sizeData.idealWidth
+            << " reconciled " << data.sizeData.reconciledWidth
+            << " fixed " << data.sizeData.fixedWidth
+            << " timeSigFixed " << data.sizeData.timeSigFixedWidth
+            << " clefKey " << data.sizeData.clefKeyWidth
+            << " duration " << data.sizeData.actualDuration
+            << "; needsLayout " << data.layoutData.needsLayout
+            << " x " << data.layoutData.x
+            << " timeSigX " << data.layoutData.timeSigX << "\n";
+
+        for (const Chunk &chunk : data.chunks) {
+            out << "    chunk " << chunk.duration
+                << " " << chunk.subordering
+                << " " << chunk.fixed
+                << " " << chunk.stretchy
+                << " " << chunk.x << "\n";
+        }
+    }
+
+    out.precision(precision);
+}
+
 }
@@ -18,10 +18,13 @@
 #ifndef RG_NOTATIONHLAYOUT_H
 #define RG_NOTATIONHLAYOUT_H
 
+#include <rosegardenprivate_export.h>
+
 #include "base/LayoutEngine.h"
 #include "base/NotationTypes.h"
 #include "NotationElement.h"
 #include <map>
+#include <ostream>
 #include <vector>
 #include "base/Event.h"
 
@@ -53,7 +56,7 @@ class NotationScene;
  * computes the X coordinates of notation elements
  */
 
-class NotationHLayout : public HorizontalLayoutEngine
+class ROSEGARDENPRIVATE_EXPORT NotationHLayout : public HorizontalLayoutEngine
 {
 public:
     NotationHLayout(Composition *c,
@@ -79,6 +82,13 @@ public:
                                  timeT endTime,
                                  bool full) override;
 
+    /**
+     * Creates the entries for staff in the maps that scanViewSegment()
+     * writes to.  After this, scanViewSegment() for different staffs
+     * can run on different threads at once.
+     */
+    void prepareViewSegment(ViewSegment &staff);
+
     /**
      * Resets internal data stores, notably the BarDataMap that is
      * used to retain the data computed by scanViewSegment().
@@ -92,10 +102,24 @@ public:
                               timeT endTime,
                               bool full) override;
 
+    /**
+     * Returns the first bar whose position may have changed in the
+     * last finishLayout().  After a partial layout, everything before
+     * this bar is where it was before.
+     */
+    int getFirstChangedBar() const { return m_firstChangedBar; }
+
+    /**
+     * In page mode, the first bar of each row as of the last
+     * finishLayout().  Empty in linear mode.
+     */
+    const std::vector<int> &getRowStartBars() const { return m_rowStartBars; }
+
     /**
      * Set page mode
      */
-    virtual void setPageMode(bool pageMode) { m_pageMode = pageMode; }
+    virtual void setPageMode(bool pageMode)
+        { m_pageMode = pageMode; m_barPositionsValid = false; }
 
     /**
      * Get the page mode setting
@@ -105,7 +129,10 @@ public:
     /**
      * Set a page width
      */
-    void setPageWidth(double pageWidth) override { m_pageWidth = pageWidth; }
+    void setPageWidth(double pageWidth) override {
+        if (pageWidth != m_pageWidth) m_barPositionsValid = false;
+        m_pageWidth = pageWidth;
+    }
 
     /**
      * Get the page width
@@ -120,7 +147,8 @@ public:
     /**
      * Sets the current spacing factor (100 == "normal" spacing)
      */
-    void setSpacing(int spacing) { m_spacing = spacing; }
+    void setSpacing(int spacing)
+        { m_spacing = spacing; m_barPositionsValid = false; }
 
     /**
      * Gets the range of "standard" spacing factors (you can
@@ -140,7 +168,8 @@ public:
      * Sets the current proportion (100 == spaces proportional to
      * durations, 0 == equal spacings)
      */
-    void setProportion(int proportion) { m_proportion = proportion; }
+    void setProportion(int proportion)
+        { m_proportion = proportion; m_barPositionsValid = false; }
 
     /**
      * Gets the range of "standard" proportion factors (you can
@@ -229,6 +258,13 @@ public:
     /// YG: Only for debug
     void dumpBarDataMap();
 
+    /// Writes what scanning and laying out staff found for each bar.
+    /**
+     * For comparing one layout with another: floating point values are
+     * written in full, so equal output means equal data.
+     */
+    void writeBarData(ViewSegment &staff, std::ostream &out) const;
+
 protected:
 
     struct Chunk {
@@ -379,11 +415,40 @@ protected:
     /// For a single bar, makes sure synchronisation points align in all staves
     void preSquishBar(int barNo);
 
+    /// Widest staff name, which is where the first bar starts
+    double getMaxStaffNameWidth() const;
+
+    /// Sets the reconciled width of a bar on all staffs
+    void setReconciledWidth(int barNo, double width);
+
+    /// Sets the width allowed for a repeated clef and key on all staffs
+    void setClefKeyWidth(int barNo, int width);
+
+    /// Positions one bar at m_totalWidth (linear mode); false at the end
+    bool reconcileBarLinear(int barNo);
+
     /// Tries to harmonize the bar positions for all the staves (linear mode)
     void reconcileBarsLinear();
 
-    /// Tries to harmonize the bar positions for all the staves (page mode)
-    void reconcileBarsPage();
+    /**
+     * Re-harmonizes only bars firstBar to lastBar (linear mode), and
+     * moves the bars after them along.  Returns false if the existing
+     * positions can't be reused, in which case nothing was done.
+     */
+    bool reconcileBarsLinear(int firstBar, int lastBar);
+
+    /**
+     * Tries to harmonize the bar positions for all the staves (page
+     * mode), keeping the rows before fromRow as they are.
+     */
+    void reconcileBarsPage(size_t fromRow = 0);
+
+    /**
+     * Reflows from the row holding firstBar (page mode).  Returns
+     * false if the existing rows can't be reused, in which case nothing
+     * was done.
+     */
+    bool reconcileBarsPageFrom(int firstBar);
 
     void layout(BarDataMap::iterator,
                 timeT startTime,
@@ -443,6 +508,15 @@ protected:
     BarPositionList m_barPositions;
     NotationGroupMap m_groupsExtant;
 
+    // What the last finishLayout() reconciled, so that a partial
+    // layout can start from it.
+    bool m_barPositionsValid;
+    double m_reconciledNameWidth;
+    int m_reconciledFirstBar;
+    int m_reconciledLastBar;
+    std::vector<int> m_rowStartBars;  // page mode
+    int m_firstChangedBar;
+
     double m_totalWidth;
     bool m_pageMode;
     double m_pageWidth;
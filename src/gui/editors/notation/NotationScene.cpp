@@ -51,6 +51,18 @@
 #include <QSettings>
 #include <QGraphicsSceneMouseEvent>
 #include <QKeyEvent>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <set>
 
 using std::vector;
 
@@ -59,6 +71,47 @@ namespace Rosegarden
 
 static int instanceCount = 0;
 
+namespace
+{
+    /// Scans a staff on one of QThreadPool's threads.
+    class ScanTask : public QRunnable
+    {
+    public:
+        explicit ScanTask(const std::function<void ()> &function) :
+            m_function(function),
+            m_done(false)
+        {
+            // We wait for it, then delete it.
+            setAutoDelete(false);
+        }
+
+        void run() override
+        {
+            m_function();
+
+            QMutexLocker locker(&m_mutex);
+            m_done = true;
+            m_finished.wakeAll();
+        }
+
+        /// Wait for run() to finish.
+        void wait()
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_done) {
+                m_finished.wait(&m_mutex);
+            }
+        }
+
+    private:
+        std::function<void ()> m_function;
+
+        QMutex m_mutex;
+        QWaitCondition m_finished;
+        bool m_done;
+    };
+}
+
 NotationScene::NotationScene() :
     m_widget(nullptr),
     m_document(nullptr),
@@ -88,11 +141,21 @@ NotationScene::NotationScene() :
     m_showRepeated(false),
     m_editRepeated(false),
     m_haveInittedCurrentStaff(false),
-    m_previewNoteStaff(nullptr)
+    m_previewNoteStaff(nullptr),
+    m_lazyRendering(false),
+    m_lazyRenderingMargin(100),
+    m_viewportScene(),
+    m_renderRect(),
+    m_renderTimer(new QTimer(this))
 {
     QString prefix(QString("NotationScene%1::").arg(instanceCount++));
     m_properties.reset(new NotationProperties(qstrtostr(prefix)));
 
+    m_renderTimer->setSingleShot(true);
+    m_renderTimer->setInterval(0);
+    connect(m_renderTimer, &QTimer::timeout,
+            this, &NotationScene::slotRenderViewport);
+
 //    qRegisterMetaType<NotationMouseEvent>("Rosegarden::NotationMouseEvent");
 
     m_segmentsDeleted.clear();
@@ -302,6 +365,9 @@ NotationScene::setStaffs(RosegardenDocument *document,
     settings.beginGroup(NotationViewConfigGroup);
     m_showRepeated =  settings.value("showrepeated", true).toBool();
     m_editRepeated =  settings.value("editrepeated", false).toBool();
+    m_lazyRendering = settings.value("lazyrendering", false).toBool();
+    m_lazyRenderingMargin =
+            std::max(0, settings.value("lazyrenderingmargin", 100).toInt());
     settings.endGroup();
 
     if (m_showRepeated) {
@@ -1808,15 +1874,16 @@ NotationScene::layout(NotationStaff *singleStaff,
 
     {
         //Profiler profiler("NotationScene::layout: Scan layouts", true);
+    std::vector<NotationStaff *> staffs;
     for (unsigned int i = 0; i < m_staffs.size(); ++i) {
 
         NotationStaff *staff = m_staffs[i];
 
         if (singleStaff && staff != singleStaff) continue;
 
-        m_hlayout->scanViewSegment(*staff, startTime, endTime, full);
-        m_vlayout->scanViewSegment(*staff, startTime, endTime, full);
+        staffs.push_back(staff);
     }
+    scanStaffs(staffs, startTime, endTime, full);
     }
 
     m_hlayout->finishLayout(startTime, endTime, full);
@@ -1861,6 +1928,15 @@ NotationScene::layout(NotationStaff *singleStaff,
 
     setSceneRect(QRectF(0, 0, maxWidth, maxHeight));
 
+    // In page mode an edit can pull bars back onto the row above, so
+    // regenerate from the first bar the layout actually moved.
+    timeT regenerateStart = startTime;
+    if (!full) {
+        regenerateStart = std::min(startTime,
+                m_document->getComposition().getBarStart(
+                        m_hlayout->getFirstChangedBar()));
+    }
+
     {
         //Profiler profiler("NotationScene::layout: regeneration", true);
 
@@ -1879,13 +1955,137 @@ NotationScene::layout(NotationStaff *singleStaff,
         // will necessarily get some testing.
 
         bool secondary = (singleStaff && (singleStaff != staff));
-        staff->regenerate(startTime, endTime, secondary);
+        staff->regenerate(regenerateStart, endTime, secondary);
     }
     }
 
     emit layoutUpdated(startTime,endTime);
 }
 
+void
+NotationScene::scanStaffs(const std::vector<NotationStaff *> &staffs,
+                          timeT startTime, timeT endTime, bool full)
+{
+    Profiler profiler("NotationScene::scanStaffs");
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+
+    if (staffs.size() < 2  ||  pool->maxThreadCount() < 2) {
+        for (NotationStaff *staff : staffs) {
+            m_hlayout->scanViewSegment(*staff, startTime, endTime, full);
+            m_vlayout->scanViewSegment(*staff, startTime, endTime, full);
+        }
+        return;
+    }
+
+    // Each staff's scan only writes to that staff's segment, elements
+    // and layout data, so the staffs can be scanned at once.  What
+    // they share is filled in here first, so that the scans only ever
+    // read it: the composition's bar positions, the clef and key
+    // context, the layouts' per-staff maps, the glyph sizes and the
+    // mark property names.
+
+    (void)m_document->getComposition().getBarNumber(startTime);
+    m_clefKeyContext->update();
+    (void)BaseProperties::getMarkPropertyName(0);
+
+    std::set<NotePixmapFactory *> factories;
+    for (NotationStaff *staff : staffs) {
+        m_hlayout->prepareViewSegment(*staff);
+        m_vlayout->prepareViewSegment(*staff);
+        factories.insert(&staff->getNotePixmapFactory(false));
+        factories.insert(&staff->getNotePixmapFactory(true));
+    }
+    for (NotePixmapFactory *factory : factories) {
+        factory->cacheLayoutMetrics();
+    }
+    if (m_notePixmapFactory)
+        m_notePixmapFactory->cacheLayoutMetrics();
+
+    std::vector<std::exception_ptr> errors(staffs.size());
+
+    auto scan = [this, &staffs, &errors, startTime, endTime, full](
+            size_t i) {
+        try {
+            m_hlayout->scanViewSegment(*staffs[i], startTime, endTime, full);
+            m_vlayout->scanViewSegment(*staffs[i], startTime, endTime, full);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    // We do the first one while the pool does the rest.
+    std::vector<std::unique_ptr<ScanTask> > tasks;
+    for (size_t i = 1; i < staffs.size(); ++i) {
+        tasks.emplace_back(new ScanTask([&scan, i]() { scan(i); }));
+        pool->start(tasks.back().get());
+    }
+
+    scan(0);
+
+    for (const std::unique_ptr<ScanTask> &task : tasks) {
+        task->wait();
+    }
+
+    for (const std::exception_ptr &error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+bool
+NotationScene::isInRenderRect(double x, double y) const
+{
+    return !m_lazyRendering  ||  m_renderRect.contains(x, y);
+}
+
+bool
+NotationScene::isInRenderRect(const QRectF &rect) const
+{
+    return !m_lazyRendering  ||  m_renderRect.intersects(rect);
+}
+
+void
+NotationScene::slotViewportChanged(QRectF viewportScene)
+{
+    m_viewportScene = viewportScene;
+
+    if (!m_lazyRendering)
+        return;
+
+    // Still within the margin of what we made items for.
+    if (m_renderRect.contains(viewportScene))
+        return;
+
+    // Panned emits viewportChanged() while it paints, so leave
+    // changing the scene until it is done.
+    m_renderTimer->start();
+}
+
+void
+NotationScene::slotRenderViewport()
+{
+    if (!m_lazyRendering  ||  m_finished)
+        return;
+
+    Profiler profiler("NotationScene::slotRenderViewport");
+
+    const double dx = m_viewportScene.width() * m_lazyRenderingMargin / 100.0;
+    const double dy = m_viewportScene.height() * m_lazyRenderingMargin / 100.0;
+
+    // Elements in the old rect may have items to remove, and those in
+    // the new one may need items made.
+    const QRectF oldRect = m_renderRect;
+    m_renderRect = m_viewportScene.adjusted(-dx, -dy, dx, dy);
+
+    const QRectF changed =
+            oldRect.isEmpty() ? m_renderRect : oldRect.united(m_renderRect);
+
+    for (NotationStaff *staff : m_staffs) {
+        staff->renderSceneRect(changed);
+    }
+}
+
 void
 NotationScene::handleEventRemoved(Event *e)
 {
@@ -18,7 +18,10 @@
 #ifndef RG_NOTATION_SCENE_H
 #define RG_NOTATION_SCENE_H
 
+#include <rosegardenprivate_export.h>
+
 #include <QGraphicsScene>
+#include <QRectF>
 #include <QSharedPointer>
 
 #include "base/NotationTypes.h"
@@ -31,6 +34,7 @@
 
 class QGraphicsItem;
 class QGraphicsTextItem;
+class QTimer;
 
 namespace Rosegarden
 {
@@ -53,7 +57,7 @@ class RulerScale;
 
 typedef std::map<int, int> TrackIntMap;
 
-class NotationScene : public QGraphicsScene,
+class ROSEGARDENPRIVATE_EXPORT NotationScene : public QGraphicsScene,
                       public CompositionObserver,
                       public SelectionManager
 {
@@ -105,6 +109,9 @@ public:
 
     bool segmentsContainNotes() const;
 
+    /// Scan and lay out every staff from scratch.
+    void layoutAll();
+
     //!!! to keep current staff implementation happy:
     bool isInPrintMode() const { return false; }
     NotationHLayout *getHLayout() { return m_hlayout; }
@@ -219,6 +226,27 @@ public:
 
     void updatePageSize();
 
+    /// Whether items are made only for elements near the viewport.
+    /**
+     * Set by the "lazyrendering" notation setting.  Layout is still
+     * done for the whole score, but the staffs only make items for
+     * elements within the render rect: the viewport, widened on every
+     * side by "lazyrenderingmargin" percent of its size.  Items that
+     * fall outside it are deleted, and made again if they scroll back
+     * into it.
+     */
+    bool isLazyRendering() const  { return m_lazyRendering; }
+
+    /// Whether an element at scene coords x, y should have items.
+    /**
+     * Always true unless isLazyRendering().
+     */
+    bool isInRenderRect(double x, double y) const;
+
+    /// Whether something covering rect, in scene coords, should have
+    /// items.
+    bool isInRenderRect(const QRectF &rect) const;
+
     /// YG: Only for debug
     void dumpVectors();
     void dumpBarDataMap();
@@ -265,6 +293,13 @@ public slots:
     void slotMouseLeavesView();
     void slotCommandExecuted();
 
+    /// Connected to Panned::viewportChanged() by NotationWidget.
+    void slotViewportChanged(QRectF viewportScene);
+
+private slots:
+    /// Move the render rect to the viewport.  See isLazyRendering().
+    void slotRenderViewport();
+
 protected:
     void mousePressEvent(QGraphicsSceneMouseEvent *) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent *) override;
@@ -353,9 +388,17 @@ private:
 
     void checkUpdate();
     void positionStaffs();
-    void layoutAll();
     void layout(NotationStaff *singleStaff, timeT startTime, timeT endTime);
 
+    /// Run the horizontal and vertical scans for staffs.
+    /**
+     * The staffs are scanned at once on QThreadPool's threads when
+     * there are several.  The rest of layout(), which makes the scene's
+     * items, stays on the GUI thread.
+     */
+    void scanStaffs(const std::vector<NotationStaff *> &staffs,
+                    timeT startTime, timeT endTime, bool full);
+
     NotationStaff *setSelectionElementStatus(EventSelection *, bool set);
     void previewSelection(EventSelection *, EventSelection *oldSelection);
 
@@ -376,6 +419,12 @@ private:
 
     NotationStaff * m_previewNoteStaff;  // Remember where the preview note was
 
+    bool m_lazyRendering;
+    int m_lazyRenderingMargin;  // Percent of the viewport's size
+    QRectF m_viewportScene;
+    QRectF m_renderRect;
+    QTimer *m_renderTimer;
+
     // Remember current labels of tracks
     std::map<int, std::string> m_trackLabels;
 };
@@ -775,6 +775,8 @@ NotationSelector::getEventsInSelectionRect()
     EventSelection *selection = new EventSelection(segment);
     int nbw = m_selectedStaff->getNotePixmapFactory(false).getNoteBodyWidth();
 
+    std::vector<Event *> events;
+
     for (int i = 0; i < l.size(); ++i) {
 
         QGraphicsItem *item = l[i];
@@ -809,10 +811,12 @@ NotationSelector::getEventsInSelectionRect()
         // we can't select events across multiple segments
         if (selection->getSegment().findSingle(element->event()) !=
             selection->getSegment().end()) {
-            selection->addEvent(element->event(), m_ties);
+            events.push_back(element->event());
         }
     }
 
+    selection->addEvents(events, m_ties);
+
     if (selection->getAddedEvents() > 0) {
         return selection;
     } else {
@@ -63,14 +63,29 @@
 #include <QGraphicsScene>
 #include <QPainter>
 #include <QPoint>
+#include <QPointF>
 #include <QRect>
+#include <QRectF>
 
+#include <algorithm>
 #include <iostream>
 
 
 namespace Rosegarden
 {
 
+namespace
+{
+    timeT getIndicationDuration(const Event &event)
+    {
+        try {
+            return Indication(event).getIndicationDuration();
+        } catch (...) {
+            return 0;
+        }
+    }
+}
+
 NotationStaff::NotationStaff(NotationScene *scene, Segment *segment,
                              SnapGrid *snapGrid, int id,
                              NotePixmapFactory *normalFactory,
@@ -94,6 +109,7 @@ NotationStaff::NotationStaff(NotationScene *scene, Segment *segment,
     m_showRanges(true),
     m_showCollisions(true),
     m_hideRedundance(true),
+    m_longestIndication(0),
     m_printPainter(nullptr),
     m_refreshStatusId(segment->getNewRefreshStatusId()),
     m_segmentMarking(segment->getMarking())
@@ -512,6 +528,12 @@ NotationStaff::renderElements(NotationElementList::iterator from,
 
         ++nextIt;
 
+        NotationElement *el = static_cast<NotationElement *>(*it);
+        if (!isInRenderRect(el)) {
+            el->removeItem();
+            continue;
+        }
+
         bool selected = isSelected(it);
         RG_DEBUG << "Rendering at " << (*it)->event()->getAbsoluteTime()
                  << " (selected = " << selected << ")";
@@ -677,10 +699,19 @@ NotationStaff::positionElements(timeT from, timeT to)
             }
         }
 
+        if (el->event()->isa(Indication::EventType)) {
+            m_longestIndication = std::max(m_longestIndication,
+                                           getIndicationDuration(*el->event()));
+        }
+
         bool selected = isSelected(it);
-        bool needNewItem = elementNeedsRegenerating(it);
+        bool inRenderRect = isInRenderRect(el);
+        bool needNewItem = inRenderRect && elementNeedsRegenerating(it);
 
-        if (needNewItem) {
+        if (!inRenderRect) {
+            // Made again if it scrolls into view.  See renderSceneRect().
+            el->removeItem();
+        } else if (needNewItem) {
             renderSingleElement(it, currentClef, currentKey, selected);
             ++elementsRendered;
         }
@@ -690,7 +721,7 @@ NotationStaff::positionElements(timeT from, timeT to)
             currentKey = ::Rosegarden::Key(*el->event());
         }
 
-        if (!needNewItem) {
+        if (inRenderRect && !needNewItem) {
             StaffLayoutCoords coords = getSceneCoordsForLayoutCoords
                 (el->getLayoutX(), (int)el->getLayoutY());
             el->reposition(coords.first, (double)coords.second);
@@ -716,6 +747,138 @@ NotationStaff::positionElements(timeT from, timeT to)
     NotePixmapFactory::dumpStats(std::cerr);
 }
 
+bool
+NotationStaff::isInRenderRect(NotationElement *el) const
+{
+    if (!m_notationScene->isLazyRendering())
+        return true;
+
+    const double x = el->getLayoutX();
+    const int y = (int)el->getLayoutY();
+
+    StaffLayoutCoords start = getSceneCoordsForLayoutCoords(x, y);
+
+    const double endX = getLayoutEndX(el);
+    if (endX <= x)
+        return m_notationScene->isInRenderRect(start.first, start.second);
+
+    StaffLayoutCoords end = getSceneCoordsForLayoutCoords(endX, y);
+
+    QRectF extent;
+    if (end.second == start.second) {
+        extent = QRectF(QPointF(start.first, start.second - 1),
+                        QPointF(end.first, end.second + 1));
+    } else {
+        // In the page modes it carries on over the following rows,
+        // which cover the width of the scene.
+        const QRectF sceneRect = m_notationScene->sceneRect();
+        extent = QRectF(QPointF(sceneRect.left(), start.second - 1),
+                        QPointF(sceneRect.right(), end.second + 1));
+    }
+
+    return m_notationScene->isInRenderRect(extent);
+}
+
+double
+NotationStaff::getLayoutEndX(NotationElement *el) const
+{
+    const double x = el->getLayoutX();
+    const Event *event = el->event();
+
+    if (event->isa(Indication::EventType)) {
+        RulerScale *rs = m_notationScene->getHLayout();
+        return std::max(x, rs->getXForTime(el->getViewAbsoluteTime() +
+                                           getIndicationDuration(*event)));
+    }
+
+    if (event->isa(Note::EventType)) {
+        const NotationProperties &properties(getProperties());
+        long width = 0;
+        long tuplingWidth = 0;
+        (void)event->get<Int>(properties.BEAM_SECTION_WIDTH, width);
+        (void)event->get<Int>(properties.TUPLING_LINE_WIDTH, tuplingWidth);
+        return x + std::max(0L, std::max(width, tuplingWidth));
+    }
+
+    return x;
+}
+
+void
+NotationStaff::renderSceneRect(const QRectF &rect)
+{
+    if (getViewElementList()->empty())
+        return;
+
+    // The layout X range that rect covers on this staff.  In the page
+    // modes rect may span several rows, so try each corner.
+    double fromX = 0;
+    double toX = 0;
+    const QPointF corners[] = {
+        rect.topLeft(), rect.topRight(), rect.bottomLeft(), rect.bottomRight()
+    };
+    for (size_t i = 0; i < sizeof(corners) / sizeof(corners[0]); ++i) {
+        double x = getLayoutCoordsForSceneCoords
+            (corners[i].x(), (int)corners[i].y()).first;
+        if (i == 0 || x < fromX) fromX = x;
+        if (i == 0 || x > toX) toX = x;
+    }
+
+    RulerScale *rs = m_notationScene->getHLayout();
+    // Back far enough to include any indication reaching into rect.
+    timeT from = getSegment().getBarStartForTime(
+            rs->getTimeForX(fromX) - m_longestIndication);
+    timeT to = getSegment().getBarEndForTime(rs->getTimeForX(toX));
+
+    NotationElementList::iterator beginAt =
+        getViewElementList()->findTime(from);
+    NotationElementList::iterator endAt =
+        getViewElementList()->findTime(to);
+
+    if (beginAt == getViewElementList()->end())
+        return;
+
+    from = (*beginAt)->getViewAbsoluteTime();
+
+    Clef currentClef = getSegment().getClefAtTime(from);
+    ::Rosegarden::Key currentKey = m_notationScene->getClefKeyContext()->
+        getKeyFromContext(getSegment().getTrack(), from);
+
+    int elementsRendered = 0;
+    int elementsRemoved = 0;
+
+    for (NotationElementList::iterator it = beginAt, nextIt = beginAt;
+         it != endAt; it = nextIt) {
+
+        NotationElement *el = static_cast<NotationElement *>(*it);
+
+        ++nextIt;
+
+        if (el->event()->isa(Clef::EventType)) {
+            currentClef = Clef(*el->event());
+        }
+
+        if (isInRenderRect(el)) {
+            if (!el->getItem()) {
+                bool selected = isSelected(it);
+                renderSingleElement(it, currentClef, currentKey, selected);
+                el->setSelected(selected);
+                ++elementsRendered;
+            }
+        } else if (el->getItem()) {
+            el->removeItem();
+            ++elementsRemoved;
+        }
+
+        if (el->event()->isa(::Rosegarden::Key::EventType)) {
+            // update currentKey after rendering, not before
+            currentKey = ::Rosegarden::Key(*el->event());
+        }
+    }
+
+    RG_DEBUG << "renderSceneRect()" << rect << ":" << elementsRendered
+             << "rendered," << elementsRemoved << "removed";
+}
+
 void
 NotationStaff::truncateClefsAndKeysAt(int x)
 {
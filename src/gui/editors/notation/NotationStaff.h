@@ -31,6 +31,7 @@
 
 class QPainter;
 class QGraphicsItem;
+class QRectF;
 class StaffLayoutCoords;
 
 
@@ -148,6 +149,17 @@ public:
     void positionElements(timeT from,
                           timeT to) override;
 
+    /**
+     * Make items for the elements within rect that are in the scene's
+     * render rect and don't have any, and remove the items of those
+     * that are not.  Nothing else is repositioned or regenerated.
+     *
+     * Used by NotationScene to follow the viewport when it is lazy
+     * rendering (see NotationScene::isLazyRendering()).  rect is in
+     * scene coords.
+     */
+    void renderSceneRect(const QRectF &rect);
+
     /**
      * Insert time signature at x-coordinate \a x.
      * Use a gray color if \a grayed is true.
@@ -293,6 +305,23 @@ protected:
 
     void setTuplingParameters(NotationElement *, NotePixmapParameters &);
 
+    /**
+     * Whether the element should have items, given where the scene is
+     * rendering.  See NotationScene::isInRenderRect().
+     *
+     * Beams, tuplet lines and indications (slurs, hairpins, ottavas
+     * and so on) are drawn by the element at their left, so that
+     * element is in the render rect if any of what it draws is.
+     */
+    bool isInRenderRect(NotationElement *) const;
+
+    /**
+     * The layout x of the right end of what the element draws: the
+     * end of its indication, beam section or tuplet line, or its own
+     * x if it draws none.
+     */
+    double getLayoutEndX(NotationElement *) const;
+
     /**
      * Set an item representing the given note event to the given notation element
      */
@@ -368,6 +397,10 @@ protected:
     bool m_distributeVerses;
     int m_keySigCancelMode;
 
+    /// The longest indication positionElements() has seen.  How far
+    /// back renderSceneRect() looks for ones reaching into its rect.
+    timeT m_longestIndication;
+
     QPainter *m_printPainter;
 
     unsigned int m_refreshStatusId;
@@ -48,6 +48,12 @@ namespace Rosegarden
 
 using namespace BaseProperties;
 
+namespace
+{
+    // Made once at startup rather than per slur, since the staffs are
+    // laid out on several threads at once.
+    const PropertyName IndicationDurationPropertyName("indicationduration");
+}
 
 NotationVLayout::NotationVLayout(Composition *c, NotePixmapFactory *npf,
                                  const NotationProperties &properties,
@@ -75,10 +81,16 @@ NotationVLayout::getSlurList(ViewSegment &staff)
 {
     SlurListMap::iterator i = m_slurs.find(&staff);
     if (i == m_slurs.end()) {
-        m_slurs[&staff] = SlurList();
+        i = m_slurs.insert(SlurListMap::value_type(&staff, SlurList())).first;
     }
 
-    return m_slurs[&staff];
+    return i->second;
+}
+
+void
+NotationVLayout::prepareViewSegment(ViewSegment &staff)
+{
+    (void)getSlurList(staff);
 }
 
 void
@@ -465,7 +477,6 @@ NotationVLayout::positionSlur(NotationStaff &staff,
     NotationElementList::iterator scooter = i;
 
     timeT slurDuration = (*i)->event()->getDuration();
-    PropertyName IndicationDurationPropertyName("indicationduration");
     if (slurDuration == 0 && (*i)->event()->has(IndicationDurationPropertyName)) {
         slurDuration = (*i)->event()->get
                        <Int>(IndicationDurationPropertyName);  // obsolete property
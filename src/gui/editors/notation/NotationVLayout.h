@@ -67,6 +67,12 @@ public:
      */
     void reset() override;
 
+    /**
+     * Creates the slur list for staff, so that scanViewSegment() for
+     * different staffs can then run on different threads at once.
+     */
+    void prepareViewSegment(ViewSegment &staff);
+
     /**
      * Lay out a single staff.
      */
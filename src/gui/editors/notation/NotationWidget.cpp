@@ -445,6 +445,13 @@ NotationWidget::setSegments(RosegardenDocument *document,
 
     m_view->setScene(m_scene);
 
+    // For lazy rendering.  Panned only signals changes, and the
+    // viewport may be the same as for the previous scene.
+    connect(m_view, &Panned::viewportChanged,
+            m_scene, &NotationScene::slotViewportChanged);
+    m_scene->slotViewportChanged(
+            m_view->mapToScene(m_view->rect()).boundingRect());
+
     m_toolBox->setScene(m_scene);
 
     m_hpanner->setScene(m_scene);
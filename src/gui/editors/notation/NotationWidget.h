@@ -18,6 +18,8 @@
 #ifndef RG_NOTATION_WIDGET_H
 #define RG_NOTATION_WIDGET_H
 
+#include <rosegardenprivate_export.h>
+
 #include "StaffLayout.h"
 
 #include "gui/general/AutoScroller.h"
@@ -61,7 +63,7 @@ class RawNoteRuler;
 class ControlRulerWidget;
 class HeadersGroup;
 
-class NotationWidget : public QWidget,
+class ROSEGARDENPRIVATE_EXPORT NotationWidget : public QWidget,
                        public SelectionManager
 {
     Q_OBJECT
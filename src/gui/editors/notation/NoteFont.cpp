@@ -27,6 +27,7 @@
 #include "NoteCharacter.h"
 #include "NoteFontMap.h"
 #include "SystemFont.h"
+#include <QApplication>
 #include <QBitmap>
 #include <QImage>
 #include <QPainter>
@@ -34,11 +35,20 @@
 #include <QPoint>
 #include <QString>
 #include <QStringList>
+#include <QThread>
 #include <iostream>
+#include <mutex>
 
 namespace Rosegarden
 {
 
+namespace
+{
+    /// Guards the pixmap maps, which all NoteFonts share, and each
+    /// NoteFont's dimensions.  Recursive since getPixmap() is.
+    std::recursive_mutex fontMutex;
+}
+
 NoteFont::FontPixmapMap *NoteFont::m_fontPixmapMap = nullptr;
 
 NoteFont::DrawRepMap *NoteFont::m_drawRepMap = nullptr;
@@ -46,7 +56,8 @@ QPixmap *NoteFont::m_blankPixmap = nullptr;
 
 
 NoteFont::NoteFont(QString fontName, int size) :
-    m_fontMap(fontName)
+    m_fontMap(fontName),
+    m_dimensionsCached(false)
 {
     // Do the size checks first, to avoid doing the extra work if they fail
 
@@ -250,6 +261,8 @@ NoteFont::lookupDrawRep(QPixmap *pixmap) const
 bool
 NoteFont::getPixmap(CharName charName, QPixmap &pixmap, bool inverted) const
 {
+    std::lock_guard<std::recursive_mutex> lock(fontMutex);
+
     QPixmap *found = nullptr;
     bool ok = lookup(charName, inverted, found);
     if (ok) {
@@ -362,6 +375,8 @@ bool
 NoteFont::getColouredPixmap(CharName baseCharName, QPixmap &pixmap,
                             int hue, int minimum, bool inverted, int saturation) const
 {
+    std::lock_guard<std::recursive_mutex> lock(fontMutex);
+
     CharName charName(getNameWithColour(baseCharName, hue));
 
     QPixmap *found = nullptr;
@@ -444,11 +459,54 @@ NoteFont::getNameShaded(CharName origName)
 bool
 NoteFont::getDimensions(CharName charName, int &x, int &y, bool inverted) const
 {
-    QPixmap pixmap;
-    bool ok = getPixmap(charName, pixmap, inverted);
-    x = pixmap.width();
-    y = pixmap.height();
-    return ok;
+    std::lock_guard<std::recursive_mutex> lock(fontMutex);
+
+    const DimensionMap::key_type key(charName, inverted);
+    DimensionMap::const_iterator i = m_dimensions.find(key);
+
+    if (i == m_dimensions.end()) {
+
+        // A QPixmap can only be made on the GUI thread.  Once
+        // cacheDimensions() has been, anything missing is something
+        // the font doesn't have, which is the blank pixmap anyway.
+        if (QThread::currentThread() != qApp->thread()) {
+            Q_ASSERT(m_dimensionsCached);
+            x = m_blankPixmap->width();
+            y = m_blankPixmap->height();
+            return false;
+        }
+
+        QPixmap pixmap;
+        Dimensions dimensions;
+        dimensions.ok = getPixmap(charName, pixmap, inverted);
+        dimensions.width = pixmap.width();
+        dimensions.height = pixmap.height();
+        i = m_dimensions.insert(DimensionMap::value_type(key, dimensions)).first;
+    }
+
+    x = i->second.width;
+    y = i->second.height;
+    return i->second.ok;
+}
+
+void
+NoteFont::cacheDimensions() const
+{
+    std::lock_guard<std::recursive_mutex> lock(fontMutex);
+
+    if (m_dimensionsCached)
+        return;
+
+    Profiler profiler("NoteFont::cacheDimensions");
+
+    const std::set<CharName> names = m_fontMap.getCharNames();
+    int x, y;
+    for (const CharName &name : names) {
+        (void)getDimensions(name, x, y, false);
+        (void)getDimensions(name, x, y, true);
+    }
+
+    m_dimensionsCached = true;
 }
 
 int
@@ -42,6 +42,12 @@ class FontPixmapMap;
 class DrawRepMap;
 
 // Encapsulates NoteFontMap, and loads pixmaps etc on demand
+//
+// The pixmap caches are locked, so any thread may ask for dimensions
+// and hotspots (which layout needs).  Those are cached separately, and
+// once a character's have been asked for on the GUI thread, asking
+// again doesn't touch a QPixmap.  The characters themselves are still
+// for the GUI thread only.
 
 class NoteFont
 {
@@ -110,9 +116,21 @@ public:
                                      bool inverted = false);
 
     /// Returns false + dimensions of blank pixmap if none found
+    /**
+     * Off the GUI thread, this only answers from what has already been
+     * found, since finding out means making a pixmap.  Call
+     * cacheDimensions() from the GUI thread first.
+     */
     bool getDimensions(CharName charName, int &x, int &y,
                        bool inverted = false) const;
 
+    /// Find the dimensions of every character in the font.
+    /**
+     * So that getDimensions() can be called from other threads.  Only
+     * does the work once.
+     */
+    void cacheDimensions() const;
+
     /// Ignores problems, returning dimension of blank pixmap if necessary
     int getWidth(CharName charName) const;
 
@@ -159,6 +177,14 @@ private:
 
     typedef std::map<QPixmap *, NoteCharacterDrawRep *> DrawRepMap;
 
+    struct Dimensions
+    {
+        int width;
+        int height;
+        bool ok;
+    };
+    typedef std::map<std::pair<CharName, bool>, Dimensions> DimensionMap;
+
     //--------------- Data members ---------------------------------
 
     int m_size;
@@ -166,6 +192,11 @@ private:
 
     mutable PixmapMap *m_map; // pointer at a member of m_fontPixmapMap
 
+    /// What getDimensions() has found, keyed by name and inversion.
+    mutable DimensionMap m_dimensions;
+    /// cacheDimensions() has filled m_dimensions.
+    mutable bool m_dimensionsCached;
+
     static FontPixmapMap *m_fontPixmapMap;
     static DrawRepMap *m_drawRepMap;
 
@@ -17,6 +17,7 @@
 
 #include "NoteItem.h"
 
+#include "NotePixmapCache.h"
 #include "NotePixmapFactory.h"
 #include "misc/Debug.h"
 #include "base/Profiler.h"
@@ -103,15 +104,26 @@ NoteItem::paint(QPainter *painter,
         mode = DrawNormal;
     }
 
+    // At 1:1 the note looks the same as a pixmap, and most notes in a
+    // score share one with others, so draw it from the shared cache.
+    if (mode == DrawNormal &&
+        t.type() <= QTransform::TxTranslate &&
+        painter->device()->devicePixelRatio() == 1) {
+        QPixmap pixmap;
+        if (!NotePixmapCache::find(getPixmapKey(), pixmap))
+            pixmap = makePixmap();
+        painter->drawPixmap(m_offset, pixmap);
+        return;
+    }
+
+    setFactoryState();
+
     painter->save();
     if (mode == DrawLarge) {
         painter->setRenderHint(QPainter::Antialiasing, true);
     } else {
         painter->setRenderHint(QPainter::Antialiasing, false);
     }
-    m_factory->setNoteStyle(m_style);
-    m_factory->setSelected(m_selected);
-    m_factory->setShaded(m_shaded);
     m_factory->drawNoteForItem(m_parameters, m_dimensions, mode, painter);
     painter->restore();
 }
@@ -142,15 +154,30 @@ NoteItem::offset() const
 QPixmap
 NoteItem::makePixmap() const
 {
+    const QByteArray &key = getPixmapKey();
+    setFactoryState();
+
+    return m_factory->makeNotePixmap(m_parameters, key);
+}
+
+const QByteArray &
+NoteItem::getPixmapKey() const
+{
+    if (m_pixmapKey.isEmpty()) {
+        setFactoryState();
+        m_pixmapKey = m_factory->makeNotePixmapKey(m_parameters);
+    }
+
+    return m_pixmapKey;
+}
+
+void
+NoteItem::setFactoryState() const
+{
+    // The factory is shared by every item on the staff.
     m_factory->setNoteStyle(m_style);
     m_factory->setSelected(m_selected);
     m_factory->setShaded(m_shaded);
-
-    QGraphicsPixmapItem *pi = m_factory->makeNotePixmapItem(m_parameters);
-    QPixmap pixmap = pi->pixmap();
-    delete pi;
-
-    return pixmap;
 }
 
 
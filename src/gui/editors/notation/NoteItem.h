@@ -18,6 +18,7 @@
 #ifndef RG_NOTEITEM_H
 #define RG_NOTEITEM_H
 
+#include <QByteArray>
 #include <QGraphicsItem>
 #include <QSharedPointer>
 
@@ -75,7 +76,17 @@ protected:
     mutable QPoint m_offset;
     mutable QSize m_size;
 
+    /// NotePixmapCache key, made on first use by getPixmapKey().
+    /**
+     * The parameters, style and colouring are fixed for the item's
+     * lifetime (a change of selection makes a new item), so this never
+     * needs remaking.
+     */
+    mutable QByteArray m_pixmapKey;
+
     void getDimensions() const;
+    const QByteArray &getPixmapKey() const;
+    void setFactoryState() const;
 };
 
 }
@@ -0,0 +1,151 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "NotePixmapCache.h"
+
+#include <list>
+#include <map>
+
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+    struct Entry
+    {
+        QByteArray key;
+        QPixmap pixmap;
+        size_t bytes;
+    };
+
+    // Most recently used first.
+    typedef std::list<Entry> EntryList;
+    typedef std::map<QByteArray, EntryList::iterator> EntryMap;
+
+    EntryList entries;
+    EntryMap entryMap;
+
+    // Enough for a few thousand notes at the usual sizes.
+    size_t limit = 16 * 1024 * 1024;
+    size_t bytes = 0;
+
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+
+    size_t pixmapBytes(const QPixmap &pixmap)
+    {
+        return size_t(pixmap.width()) * size_t(pixmap.height()) *
+               size_t(pixmap.depth() / 8);
+    }
+
+    void evict(size_t wanted)
+    {
+        while (!entries.empty()  &&  bytes + wanted > limit) {
+            const Entry &entry = entries.back();
+            bytes -= entry.bytes;
+            entryMap.erase(entry.key);
+            entries.pop_back();
+            ++evictions;
+        }
+    }
+}
+
+bool
+NotePixmapCache::find(const QByteArray &key, QPixmap &pixmap)
+{
+    EntryMap::iterator i = entryMap.find(key);
+    if (i == entryMap.end()) {
+        ++misses;
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, i->second);
+    pixmap = i->second->pixmap;
+    ++hits;
+    return true;
+}
+
+void
+NotePixmapCache::insert(const QByteArray &key, const QPixmap &pixmap)
+{
+    EntryMap::iterator i = entryMap.find(key);
+    if (i != entryMap.end()) {
+        bytes -= i->second->bytes;
+        entries.erase(i->second);
+        entryMap.erase(i);
+    }
+
+    const size_t size = pixmapBytes(pixmap);
+    if (size > limit)
+        return;
+
+    evict(size);
+
+    entries.push_front(Entry{key, pixmap, size});
+    entryMap[key] = entries.begin();
+    bytes += size;
+}
+
+void
+NotePixmapCache::clear()
+{
+    entryMap.clear();
+    entries.clear();
+    bytes = 0;
+}
+
+void
+NotePixmapCache::setLimit(size_t newLimit)
+{
+    limit = newLimit;
+    evict(0);
+}
+
+NotePixmapCache::Statistics
+NotePixmapCache::getStatistics()
+{
+    Statistics statistics;
+    statistics.hits = hits;
+    statistics.misses = misses;
+    statistics.evictions = evictions;
+    statistics.pixmaps = entries.size();
+    statistics.bytes = bytes;
+    statistics.limit = limit;
+    return statistics;
+}
+
+void
+NotePixmapCache::resetStatistics()
+{
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+void
+NotePixmapCache::dumpStats(std::ostream &s)
+{
+    s << "NotePixmapCache: " << hits << " hits, " << misses << " misses, "
+      << evictions << " evictions; " << entries.size() << " pixmaps in "
+      << bytes << " of " << limit << " bytes\n";
+}
+
+
+}
@@ -0,0 +1,84 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_NOTEPIXMAPCACHE_H
+#define RG_NOTEPIXMAPCACHE_H
+
+#include <rosegardenprivate_export.h>
+
+#include <QByteArray>
+#include <QPixmap>
+
+#include <cstddef>
+#include <ostream>
+
+
+namespace Rosegarden
+{
+
+
+/// Pixmaps that NotePixmapFactory has drawn, shared by every view.
+/**
+ * A note is drawn from its NotePixmapParameters and the factory's font,
+ * size, style and colouring, and a score has only so many different
+ * notes.  NotePixmapFactory::makeNotePixmap() keeps what it has drawn
+ * here, keyed by all of those, so that another view, or the same view
+ * after a zoom, gets a copy instead of drawing the note again.
+ *
+ * The total size is bounded.  When an insert() would go over the
+ * limit, the least recently used pixmaps are dropped until it fits.
+ *
+ * QPixmaps belong to the GUI thread, and so does this.
+ */
+class ROSEGARDENPRIVATE_EXPORT NotePixmapCache
+{
+public:
+    struct Statistics
+    {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t pixmaps;
+        size_t bytes;
+        size_t limit;
+    };
+
+    /// Copies the pixmap for key into pixmap.  False if there isn't one.
+    static bool find(const QByteArray &key, QPixmap &pixmap);
+
+    /// Adds or replaces the pixmap for key, evicting others to make room.
+    static void insert(const QByteArray &key, const QPixmap &pixmap);
+
+    /// Drops all the pixmaps.  The statistics are kept.
+    static void clear();
+
+    /// Sets the most the pixmaps may take, in bytes.
+    static void setLimit(size_t bytes);
+
+    static Statistics getStatistics();
+    static void resetStatistics();
+
+    static void dumpStats(std::ostream &);
+
+private:
+    NotePixmapCache() = delete;
+};
+
+
+}
+
+#endif
@@ -47,6 +47,7 @@
 #include "NoteCharacterNames.h"
 #include "NoteFontFactory.h"
 #include "NoteFont.h"
+#include "NotePixmapCache.h"
 #include "NotePixmapParameters.h"
 #include "NotePixmapPainter.h"
 #include "NoteStyleFactory.h"
@@ -61,6 +62,7 @@
 #include <QFont>
 #include <QFontMetrics>
 #include <QImage>
+#include <QMutexLocker>
 #include <QPainter>
 #include <QPen>
 #include <QPixmap>
@@ -302,6 +304,7 @@ void
 NotePixmapFactory::dumpStats(std::ostream &s)
 {
 #ifdef DUMP_STATS
+    NotePixmapCache::dumpStats(s);
 /*
   s << "NotePixmapFactory: total times since last stats dump:\n"
   << "makeNotePixmap: "
@@ -390,6 +393,45 @@ NotePixmapFactory::makeNotePixmapItem(const NotePixmapParameters &params)
     return makeItem(hotspot);
 }
 
+QByteArray
+NotePixmapFactory::makeNotePixmapKey(const NotePixmapParameters &params) const
+{
+    // Everything else that drawNoteAux() draws from.
+    NoteFont *font = (m_haveGrace ? m_graceFont : m_font);
+    QByteArray key = QString("%1/%2/%3/%4%5%6/")
+        .arg(font->getName())
+        .arg(font->getSize())
+        .arg(m_style->getName())
+        .arg(int(m_selected))
+        .arg(int(m_shaded))
+        .arg(int(m_inPrinterMethod))
+        .toUtf8();
+    params.appendToKey(key);
+    return key;
+}
+
+QPixmap
+NotePixmapFactory::makeNotePixmap(const NotePixmapParameters &params)
+{
+    return makeNotePixmap(params, makeNotePixmapKey(params));
+}
+
+QPixmap
+NotePixmapFactory::makeNotePixmap(const NotePixmapParameters &params,
+                                  const QByteArray &key)
+{
+    QPixmap pixmap;
+    if (NotePixmapCache::find(key, pixmap))
+        return pixmap;
+
+    QGraphicsPixmapItem *item = makeNotePixmapItem(params);
+    pixmap = item->pixmap();
+    delete item;
+
+    NotePixmapCache::insert(key, pixmap);
+    return pixmap;
+}
+
 /* unused
 void
 NotePixmapFactory::drawNote(const NotePixmapParameters &params,
@@ -3257,9 +3299,13 @@ NotePixmapFactory::makeTimeSig(const TimeSignature& sig)
 
 int NotePixmapFactory::getTimeSigWidth(const TimeSignature &timesig) const
 {
+    // Layout asks from several threads at once, and a QFontMetrics
+    // can't be shared between threads, so each call makes its own.
+
     if (timesig.isCommon()) {
 
-        QRect r(m_bigTimeSigFontMetrics.boundingRect("c"));
+        QFontMetrics metrics(m_bigTimeSigFont);
+        QRect r(metrics.boundingRect("c"));
         return r.width() + 2;
 
     } else {
@@ -3272,8 +3318,9 @@ int NotePixmapFactory::getTimeSigWidth(const TimeSignature &timesig) const
         numS.setNum(numerator);
         denomS.setNum(denominator);
 
-        QRect numR = m_timeSigFontMetrics.boundingRect(numS);
-        QRect denomR = m_timeSigFontMetrics.boundingRect(denomS);
+        QFontMetrics metrics(m_timeSigFont);
+        QRect numR = metrics.boundingRect(numS);
+        QRect denomR = metrics.boundingRect(denomS);
         int width = std::max(numR.width(), denomR.width()) + 2;
 
         return width;
@@ -3283,6 +3330,9 @@ int NotePixmapFactory::getTimeSigWidth(const TimeSignature &timesig) const
 QFont
 NotePixmapFactory::getTextFont(const Text &text) const
 {
+    // Layout may ask from several threads at once.
+    QMutexLocker locker(&m_textFontMutex);
+
     std::string type(text.getTextType());
     TextFontCache::iterator i = m_textFontCache.find(type);
     if (i != m_textFontCache.end())
@@ -3890,27 +3940,61 @@ int NotePixmapFactory::getKeyWidth(const Key &key,
     else
         keyCharName = NoteCharacterNames::FLAT;
 
-    NoteCharacter keyCharacter;
-    NoteCharacter cancelCharacter;
-
-    keyCharacter = m_font->getCharacter(keyCharName);
-    if (cancelCount > 0) {
-        cancelCharacter = m_font->getCharacter(NoteCharacterNames::NATURAL);
-    }
+    // Only the sizes are needed, and getting those rather than the
+    // characters keeps this safe to call from layout threads.
+    const int keyWidth = m_font->getWidth(keyCharName);
 
     //int x = 0;
     //int lw = getLineSpacing();
-    int keyDelta = keyCharacter.getWidth() - keyCharacter.getHotspot().x();
+    int keyDelta = keyWidth - m_font->getHotspot(keyCharName).x();
 
     int cancelDelta = 0;
     int between = 0;
     if (cancelCount > 0) {
-        cancelDelta = cancelCharacter.getWidth() + cancelCharacter.getWidth() / 3;
-        between = cancelCharacter.getWidth();
+        const int cancelWidth = m_font->getWidth(NoteCharacterNames::NATURAL);
+        cancelDelta = cancelWidth + cancelWidth / 3;
+        between = cancelWidth;
     }
 
     return (keyDelta * ah1.size() + cancelDelta * cancelCount + between +
-            keyCharacter.getWidth() / 4);
+            keyWidth / 4);
+}
+
+void NotePixmapFactory::cacheLayoutMetrics() const
+{
+    Profiler profiler("NotePixmapFactory::cacheLayoutMetrics");
+
+    for (Note::Type type = Note::Shortest; type <= Note::Longest; ++type) {
+        (void)getNoteBodyWidth(type);
+        (void)getRestWidth(Note(type));
+    }
+
+    const Accidental accidentals[] = {
+        Accidentals::Sharp, Accidentals::Flat, Accidentals::Natural,
+        Accidentals::DoubleSharp, Accidentals::DoubleFlat,
+        Accidentals::QuarterFlat, Accidentals::ThreeQuarterFlat,
+        Accidentals::QuarterSharp, Accidentals::ThreeQuarterSharp
+    };
+    for (const Accidental &accidental : accidentals) {
+        (void)getAccidentalWidth(accidental, 1, true);
+    }
+
+    const std::string clefs[] = {
+        Clef::Treble, Clef::French, Clef::Soprano, Clef::Mezzosoprano,
+        Clef::Alto, Clef::Tenor, Clef::Baritone, Clef::Varbaritone,
+        Clef::Bass, Clef::Subbass, Clef::TwoBar
+    };
+    for (const std::string &clef : clefs) {
+        (void)getClefWidth(Clef(clef));
+    }
+
+    (void)getDotWidth();
+    (void)getKeyWidth(Key("E major"), Key("Ab major"));
+
+    // Everything else the layout asks the fonts for.
+    m_font->cacheDimensions();
+    if (m_graceFont)
+        m_graceFont->cacheDimensions();
 }
 
 int NotePixmapFactory::getTextWidth(const Text &text) const
@@ -30,6 +30,7 @@
 
 #include <QFont>
 #include <QFontMetrics>
+#include <QMutex>
 #include <QPixmap>
 #include <QPoint>
 #include <QCoreApplication> // for Q_DECLARE_TR_FUNCTIONS
@@ -128,6 +129,25 @@ public:
 
     QGraphicsPixmapItem *makeNotePixmapItem(const NotePixmapParameters &params);
 
+    /// The note as makeNotePixmapItem() draws it, hotspot at -offset.
+    /**
+     * Notes already drawn by any factory with the same font, style and
+     * colouring come from the NotePixmapCache instead.
+     */
+    QPixmap makeNotePixmap(const NotePixmapParameters &params);
+
+    /// makeNotePixmap() with a key from makeNotePixmapKey().
+    /**
+     * For callers that draw the same note repeatedly and keep its key,
+     * such as NoteItem.  The key must have been made with this factory's
+     * current style and colouring.
+     */
+    QPixmap makeNotePixmap(const NotePixmapParameters &params,
+                           const QByteArray &key);
+
+    /// The NotePixmapCache key for params with the current style and colouring.
+    QByteArray makeNotePixmapKey(const NotePixmapParameters &params) const;
+
     void getNoteDimensions(const NotePixmapParameters &params,
                            NoteItemDimensions &dimensions);
 
@@ -242,6 +262,14 @@ public:
                     Key previousKey = Key::DefaultKey) const;
     int getTextWidth(const Text &text) const;
 
+    /// Look up the glyph sizes that layout uses, on the calling thread.
+    /**
+     * After this, the width methods above only read what is already
+     * cached, so NotationScene can call them from several layout
+     * threads at once.  Call it from the GUI thread.
+     */
+    void cacheLayoutMetrics() const;
+
     /**
      * Returns the width of clef and key signature drawn in a track header.
      */
@@ -423,6 +451,7 @@ protected:
 
     typedef std::map<std::string, QFont> TextFontCache;
     mutable TextFontCache m_textFontCache;
+    mutable QMutex m_textFontMutex;
 };
 
 
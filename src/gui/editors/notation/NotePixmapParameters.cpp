@@ -20,6 +20,8 @@
 
 #include "base/NotationTypes.h"
 
+#include <cmath>
+
 
 namespace Rosegarden
 {
@@ -90,6 +92,71 @@ NotePixmapParameters::removeMarks()
     m_marks.clear();
 }
 
+namespace
+{
+    void appendInt(QByteArray &key, int value)
+    {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void appendString(QByteArray &key, const std::string &value)
+    {
+        appendInt(key, int(value.size()));
+        key.append(value.data(), int(value.size()));
+    }
+
+    // Gradients compare equal within 0.0001.
+    void appendGradient(QByteArray &key, double value)
+    {
+        appendInt(key, int(lround(value * 10000)));
+    }
+}
+
+void
+NotePixmapParameters::appendToKey(QByteArray &key) const
+{
+    appendInt(key, m_noteType);
+    appendInt(key, m_dots);
+    appendString(key, m_accidental);
+
+    const bool flags[] = {
+        m_cautionary, m_shifted, m_dotShifted, m_accidentalExtra,
+        m_drawFlag, m_drawStem, m_stemGoesUp, m_selected, m_highlighted,
+        m_quantized, m_onLine, m_restOutsideStave, m_beamed,
+        m_thisPartialBeams, m_nextPartialBeams, m_tuplingLineFollowsBeam,
+        m_tied, m_tiePositionExplicit, m_tieAbove, m_inRange,
+        m_memberOfParallel, m_forceColor
+    };
+    int bits = 0;
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+        if (flags[i]) bits |= (1 << i);
+    }
+    appendInt(key, bits);
+
+    appendInt(key, m_accidentalShift);
+    appendInt(key, m_stemLength);
+    appendInt(key, m_legerLines);
+    appendInt(key, m_slashes);
+    appendInt(key, m_trigger);
+    appendInt(key, m_safeVertDistance);
+    appendInt(key, m_nextBeamCount);
+    appendInt(key, m_width);
+    appendGradient(key, m_gradient);
+    appendInt(key, m_tupletCount);
+    appendInt(key, m_tuplingLineY);
+    appendInt(key, m_tuplingLineWidth);
+    appendGradient(key, m_tuplingLineGradient);
+    appendInt(key, m_tieLength);
+
+    appendInt(key, int(m_marks.size()));
+    for (size_t i = 0; i < m_marks.size(); ++i) {
+        appendString(key, m_marks[i]);
+    }
+
+    if (m_forceColor)
+        appendInt(key, int(m_forcedColor.rgba()));
+}
+
 std::vector<Rosegarden::Mark>
 NotePixmapParameters::getNormalMarks() const
 {
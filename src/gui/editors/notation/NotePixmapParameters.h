@@ -19,8 +19,11 @@
 #ifndef RG_NOTEPIXMAPPARAMETERS_H
 #define RG_NOTEPIXMAPPARAMETERS_H
 
+#include <rosegardenprivate_export.h>
+
 #include "base/NotationTypes.h"
 
+#include <QByteArray>
 #include <QColor>
 
 #include <vector>
@@ -34,7 +37,7 @@ namespace Rosegarden
 
 
 
-class NotePixmapParameters
+class ROSEGARDENPRIVATE_EXPORT NotePixmapParameters
 {
 public:
     enum Triggering { triggerNone, triggerYes, triggerSkip, };
@@ -116,6 +119,13 @@ public:
     // always be drawn *below* the note, and we get it wrong, and/or there are
     // some things we treat as normal marks and shouldn't.  Hrm.
 
+    /**
+     * Appends everything that operator== compares to key, so that
+     * parameters that compare equal append the same bytes.  Keep the
+     * two in step.  Used by NotePixmapFactory::makeNotePixmap().
+     */
+    void appendToKey(QByteArray &key) const;
+
     bool operator==(const NotePixmapParameters &p) const {
 	return (m_noteType == p.m_noteType &&
 		m_dots == p.m_dots &&
@@ -18,6 +18,8 @@
 #ifndef RG_STAFFLAYOUT_H
 #define RG_STAFFLAYOUT_H
 
+#include <rosegardenprivate_export.h>
+
 #include "base/Event.h"
 #include "base/ViewElement.h"
 #include <QRect>
@@ -50,7 +52,7 @@ class Event;
  * staff lines be a precise integral distance apart.
  */
 
-class StaffLayout
+class ROSEGARDENPRIVATE_EXPORT StaffLayout
 {
 public:
     typedef std::pair<double, int> StaffLayoutCoords;
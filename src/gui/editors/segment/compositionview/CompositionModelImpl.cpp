@@ -23,6 +23,7 @@
 #include "AudioPeaksGenerator.h"
 #include "AudioPreviewPainter.h"
 #include "ChangingSegment.h"
+#include "SegmentIndex.h"
 #include "SegmentRect.h"
 #include "CompositionColourCache.h"
 
@@ -55,7 +56,7 @@
 #include <QTimer>
 
 #include <math.h>
-#include <algorithm>  // std::lower_bound() and std::min()
+#include <algorithm>  // std::lower_bound(), std::min() and std::sort()
 
 
 namespace Rosegarden
@@ -77,6 +78,7 @@ CompositionModelImpl::CompositionModelImpl(
     m_audioPeaksGeneratorMap(),
     m_audioPeaksCache(),
     m_audioPreviewImageCache(),
+    m_segmentIndex(composition),
     m_selectedSegments(),
     m_tmpSelectedSegments(),
     m_previousTmpSelectedSegments(),
@@ -170,10 +172,11 @@ void CompositionModelImpl::getSegmentRects(
     CompositionColourCache *colourCache =
             CompositionColourCache::getInstance();
 
-    const SegmentMultiSet &segments = m_composition.getSegments();
+    std::vector<Segment *> segments;
+    getSegmentsIn(clipRect, segments);
 
-    // For each segment in the composition
-    for (SegmentMultiSet::const_iterator i = segments.begin();
+    // For each segment that might be in the clip rect
+    for (std::vector<Segment *>::const_iterator i = segments.begin();
          i != segments.end();
          ++i) {
 
@@ -280,10 +283,11 @@ void CompositionModelImpl::getSegmentRects(
 
 ChangingSegmentPtr CompositionModelImpl::getSegmentAt(const QPoint &pos)
 {
-    const SegmentMultiSet &segments = m_composition.getSegments();
+    std::vector<Segment *> segments;
+    getSegmentsIn(QRect(pos, QSize(1, 1)), segments);
 
-    // For each segment in the composition
-    for (SegmentMultiSet::iterator i = segments.begin();
+    // For each segment that might be at pos
+    for (std::vector<Segment *>::const_iterator i = segments.begin();
          i != segments.end();
          ++i) {
 
@@ -302,6 +306,46 @@ ChangingSegmentPtr CompositionModelImpl::getSegmentAt(const QPoint &pos)
     return ChangingSegmentPtr();
 }
 
+void CompositionModelImpl::getSegmentsIn(
+        const QRect &rect, std::vector<Segment *> &segments)
+{
+    // A pixel either side, as the segment rects are rounded to pixels.
+    const RulerScale *rulerScale = m_grid.getRulerScale();
+    const timeT startTime = rulerScale->getTimeForX(rect.left() - 1);
+    const timeT endTime = rulerScale->getTimeForX(rect.right() + 1);
+
+    const int firstPosition = std::max(0, m_grid.getYBin(rect.top()));
+    const int lastPosition =
+            std::min(int(m_composition.getNbTracks()) - 1,
+                     m_grid.getYBin(rect.bottom()));
+
+    std::vector<TrackId> trackIds;
+    for (int position = firstPosition; position <= lastPosition; ++position) {
+        const Track *track = m_composition.getTrackByPosition(position);
+        if (track)
+            trackIds.push_back(track->getId());
+    }
+
+    // The composition orders its segments by track ID.
+    std::sort(trackIds.begin(), trackIds.end());
+
+    for (std::vector<TrackId>::const_iterator i = trackIds.begin();
+         i != trackIds.end();
+         ++i) {
+        m_segmentIndex.getSegments(*i, startTime, endTime, segments);
+    }
+
+    // Recording segments grow without telling the index, so they
+    // can be anywhere after their start.
+    for (RecordingSegmentSet::const_iterator i = m_recordingSegments.begin();
+         i != m_recordingSegments.end();
+         ++i) {
+        if (std::find(segments.begin(), segments.end(), *i) ==
+                segments.end())
+            segments.push_back(*i);
+    }
+}
+
 void CompositionModelImpl::getSegmentQRect(
         const Segment &segment, QRect &rect) const
 {
@@ -444,6 +488,7 @@ void CompositionModelImpl::segmentAdded(const Composition *, Segment *s)
 {
     // Keep tabs on it.
     s->addObserver(this);
+    m_segmentIndex.invalidate();
 
     // TrackEditor::commandExecuted() already updates us.  However, it
     // shouldn't.  This is the right thing to do.
@@ -458,6 +503,7 @@ void CompositionModelImpl::segmentRemoved(const Composition *, Segment *s)
     deleteCachedPreview(s);
     m_selectedSegments.erase(s);
     m_recordingSegments.erase(s);
+    m_segmentIndex.invalidate();
 
     // TrackEditor::commandExecuted() already updates us.  However, it
     // shouldn't.  This is the right thing to do.
@@ -467,14 +513,20 @@ void CompositionModelImpl::segmentRemoved(const Composition *, Segment *s)
 void CompositionModelImpl::segmentTrackChanged(
         const Composition *, Segment *, TrackId /*tid*/)
 {
+    m_segmentIndex.invalidate();
+
     // TrackEditor::commandExecuted() already updates us.  However, it
     // shouldn't.  This is the right thing to do.
     emit needUpdate();
 }
 
 void CompositionModelImpl::segmentStartChanged(
-        const Composition *, Segment *, timeT)
+        const Composition *, Segment *s, timeT)
 {
+    // getSegmentsIn() checks the recording segments itself.
+    if (!isRecording(s))
+        m_segmentIndex.invalidate();
+
     // Ignore high-frequency updates during record.
     // This routine gets hit really hard when recording and
     // notes are coming in.
@@ -487,8 +539,12 @@ void CompositionModelImpl::segmentStartChanged(
 }
 
 void CompositionModelImpl::segmentEndMarkerChanged(
-        const Composition *, Segment *, bool)
+        const Composition *, Segment *s, bool)
 {
+    // getSegmentsIn() checks the recording segments itself.
+    if (!isRecording(s))
+        m_segmentIndex.invalidate();
+
     // Ignore high-frequency updates during record.
     // This routine gets hit really hard when recording.
     // Just holding down a single note results in 50 calls
@@ -504,6 +560,8 @@ void CompositionModelImpl::segmentEndMarkerChanged(
 void CompositionModelImpl::segmentRepeatChanged(
         const Composition *, Segment *, bool)
 {
+    m_segmentIndex.invalidate();
+
     // TrackEditor::commandExecuted() already updates us.  However, it
     // shouldn't.  This is the right thing to do.
     emit needUpdate();
@@ -511,7 +569,9 @@ void CompositionModelImpl::segmentRepeatChanged(
 
 void CompositionModelImpl::endMarkerTimeChanged(const Composition *, bool)
 {
-    // The size of the composition has changed.
+    // The size of the composition has changed.  Repeating segments
+    // may now repeat further.
+    m_segmentIndex.invalidate();
 
     // TrackEditor::commandExecuted() already updates us.  However, it
     // shouldn't.  This is the right thing to do.
@@ -553,6 +613,9 @@ void CompositionModelImpl::clearRecordingItems()
 
     m_recordingSegments.clear();
 
+    // The index hasn't kept up with them.
+    m_segmentIndex.invalidate();
+
     emit needUpdate();
 }
 
@@ -1229,12 +1292,13 @@ void CompositionModelImpl::setSelectionRect(const QRect &rect)
     m_previousTmpSelectedSegments = m_tmpSelectedSegments;
     m_tmpSelectedSegments.clear();
 
-    const SegmentMultiSet &segments = m_composition.getSegments();
+    std::vector<Segment *> segments;
+    getSegmentsIn(m_selectionRect, segments);
 
     QRect updateRect = m_selectionRect;
 
-    // For each segment in the composition
-    for (SegmentMultiSet::iterator i = segments.begin();
+    // For each segment that might be in the selection rect
+    for (std::vector<Segment *>::const_iterator i = segments.begin();
          i != segments.end();
          ++i) {
 
@@ -1264,10 +1328,11 @@ void CompositionModelImpl::setSelectionRect(const QRect &rect)
 
 void CompositionModelImpl::finalizeSelectionRect()
 {
-    const SegmentMultiSet &segments = m_composition.getSegments();
+    std::vector<Segment *> segments;
+    getSegmentsIn(m_selectionRect, segments);
 
-    // For each segment in the composition
-    for (SegmentMultiSet::const_iterator i = segments.begin();
+    // For each segment that might be in the selection rect
+    for (std::vector<Segment *>::const_iterator i = segments.begin();
          i != segments.end();
          ++i) {
 
@@ -21,6 +21,7 @@
 #include "base/SnapGrid.h"
 #include "SegmentRect.h"
 #include "ChangingSegment.h"
+#include "SegmentIndex.h"
 #include "SegmentOrderer.h"
 #include "base/TimeT.h"  // timeT
 
@@ -222,6 +223,15 @@ public:
     /// Get the segment at the given position on the view.
     ChangingSegmentPtr getSegmentAt(const QPoint &pos);
 
+    /// Get the segments whose rects might intersect rect.
+    /**
+     * Uses m_segmentIndex to find the segments on the tracks and in the
+     * time range that rect covers, so this costs about the same for any
+     * size of composition.  Callers still need to check each segment's
+     * rect against rect.
+     */
+    void getSegmentsIn(const QRect &rect, std::vector<Segment *> &segments);
+
     void getSegmentQRect(const Segment &segment, QRect &rect) const;
     void getSegmentRect(const Segment &segment, SegmentRect &segmentRect) const;
 
@@ -466,6 +476,9 @@ private:
 
     // --- Segments ---------------------------------------
 
+    /// Segments by track and time, for getSegmentsIn().
+    SegmentIndex m_segmentIndex;
+
     void updateAllTrackHeights();
 
     /// Update SegmentRect::repeatMarks with the Segment's repeat marks.
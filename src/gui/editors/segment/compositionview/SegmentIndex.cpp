@@ -0,0 +1,98 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "SegmentIndex.h"
+
+#include "base/Composition.h"
+#include "base/Profiler.h"
+#include "base/Segment.h"
+
+#include <algorithm>
+
+
+namespace Rosegarden
+{
+
+
+SegmentIndex::SegmentIndex(const Composition &composition) :
+    m_composition(composition),
+    m_tracks(),
+    m_valid(false)
+{
+}
+
+void
+SegmentIndex::rebuild()
+{
+    Profiler profiler("SegmentIndex::rebuild()");
+
+    m_tracks.clear();
+
+    const SegmentMultiSet &segments = m_composition.getSegments();
+
+    // The composition's segments are already in track, then start
+    // time order, so each track's entries come out sorted.
+    for (SegmentMultiSet::const_iterator i = segments.begin();
+         i != segments.end();
+         ++i) {
+
+        Segment *segment = *i;
+
+        Entry entry;
+        entry.startTime = segment->getStartTime();
+        entry.endTime = segment->isRepeating() ?
+                                segment->getRepeatEndTime() :
+                                segment->getEndMarkerTime();
+        entry.segment = segment;
+
+        TrackEntries &track = m_tracks[segment->getTrack()];
+        track.entries.push_back(entry);
+        track.longest = std::max(track.longest,
+                                 entry.endTime - entry.startTime);
+    }
+
+    m_valid = true;
+}
+
+void
+SegmentIndex::getSegments(TrackId trackId, timeT startTime, timeT endTime,
+                          std::vector<Segment *> &segments)
+{
+    if (!m_valid)
+        rebuild();
+
+    TrackMap::const_iterator trackIter = m_tracks.find(trackId);
+    if (trackIter == m_tracks.end())
+        return;
+
+    const TrackEntries &track = trackIter->second;
+
+    // Nothing that starts before this can reach startTime.
+    const timeT earliest = startTime - track.longest;
+
+    std::vector<Entry>::const_iterator i = std::lower_bound(
+            track.entries.begin(), track.entries.end(), earliest,
+            [](const Entry &entry, timeT t) { return entry.startTime < t; });
+
+    for (; i != track.entries.end()  &&  i->startTime <= endTime; ++i) {
+        if (i->endTime >= startTime)
+            segments.push_back(i->segment);
+    }
+}
+
+
+}
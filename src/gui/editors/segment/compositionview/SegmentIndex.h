@@ -0,0 +1,102 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A MIDI and audio sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+
+    Other copyrights also apply to some parts of this work.  Please
+    see the AUTHORS file and individual file headers for details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_SEGMENTINDEX_H
+#define RG_SEGMENTINDEX_H
+
+#include <rosegardenprivate_export.h>
+
+#include "base/Track.h"  // TrackId
+#include "base/TimeT.h"  // timeT
+
+#include <map>
+#include <vector>
+
+
+namespace Rosegarden
+{
+
+
+class Composition;
+class Segment;
+
+
+/// The segments on each track, by time, for CompositionModelImpl.
+/**
+ * CompositionModelImpl needs the segments under a clip rect on every
+ * paint, and the segment under the mouse on every mouse event.  Going
+ * through every segment in the composition for those is slow once
+ * there are thousands.
+ *
+ * This keeps each track's segments sorted by start time, along with
+ * the longest segment on the track, so the segments overlapping a
+ * time range are found with a binary search.  Track and time don't
+ * depend on the zoom or on the track heights, so only changes to the
+ * segments themselves make it stale.  Call invalidate() for those and
+ * it is rebuilt the next time it is asked.
+ *
+ * A segment's extent is its start time to its repeat end time if it is
+ * repeating, or its end marker time if not.  Segments being recorded
+ * grow without telling us, so callers should check those separately.
+ */
+class ROSEGARDENPRIVATE_EXPORT SegmentIndex
+{
+public:
+    explicit SegmentIndex(const Composition &composition);
+
+    /// The segments have changed.  Rebuild before the next query.
+    void invalidate()  { m_valid = false; }
+
+    /// Appends the segments on trackId that overlap startTime to endTime.
+    /**
+     * Both ends are inclusive, so that a segment that only touches
+     * the range is included.  The segments are appended in start time
+     * order, which is the composition's order within a track.
+     */
+    void getSegments(TrackId trackId, timeT startTime, timeT endTime,
+                     std::vector<Segment *> &segments);
+
+private:
+    void rebuild();
+
+    struct Entry
+    {
+        timeT startTime;
+        timeT endTime;
+        Segment *segment;
+    };
+
+    struct TrackEntries
+    {
+        TrackEntries() : longest(0) { }
+
+        std::vector<Entry> entries;  // sorted by startTime
+        timeT longest;
+    };
+
+    const Composition &m_composition;
+
+    typedef std::map<TrackId, TrackEntries> TrackMap;
+    TrackMap m_tracks;
+
+    bool m_valid;
+};
+
+
+}
+
+#endif
@@ -41,6 +41,8 @@
 
 #include <algorithm>
 #include <cfloat>
+#include <set>
+#include <vector>
 
 #include <QMainWindow>
 #include <QColor>
@@ -911,11 +913,13 @@ void ControlRuler::updateSelection()
     if (m_eventSelection) delete m_eventSelection;
     m_eventSelection = new EventSelection(*m_segment);
 
+    std::vector<Event *> events;
     for (ControlItemList::iterator it = m_selectedItems.begin();
          it != m_selectedItems.end();
          ++it) {
-        m_eventSelection->addEvent((*it)->getEvent());
+        events.push_back((*it)->getEvent());
     }
+    m_eventSelection->addEvents(events);
 
     emit rulerSelectionChanged(m_eventSelection);
 
@@ -948,6 +952,30 @@ void ControlRuler::addToSelection(QSharedPointer<ControlItem> item)
     RG_DEBUG << "addToSelection() done";
 }
 
+void ControlRuler::addToSelection(const ControlItemList &items)
+{
+    if (items.empty()) return;
+
+    std::set<ControlItem *> selected;
+    for (const QSharedPointer<ControlItem> &item : m_selectedItems) {
+        selected.insert(item.data());
+    }
+
+    std::vector<Event *> events;
+    for (const QSharedPointer<ControlItem> &item : items) {
+        // If we already have this item, skip it.
+        if (!selected.insert(item.data()).second) continue;
+        m_selectedItems.push_back(item);
+        item->setSelected(true);
+        events.push_back(item->getEvent());
+    }
+
+    if (events.empty()) return;
+
+    m_eventSelection->addEvents(events);
+    emit rulerSelectionChanged(m_eventSelection);
+}
+
 void ControlRuler::removeFromSelection(QSharedPointer<ControlItem> item)
 {
     m_selectedItems.remove(item);
@@ -116,6 +116,8 @@ public:
 
     void clearSelectedItems();
     void addToSelection(QSharedPointer<ControlItem>);
+    /// Add several items, updating the EventSelection once.
+    void addToSelection(const ControlItemList &items);
     void removeFromSelection(QSharedPointer<ControlItem>);
     EventSelection *getEventSelection()
     { return m_eventSelection; }
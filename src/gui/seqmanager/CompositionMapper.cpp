@@ -67,6 +67,21 @@ CompositionMapper::segmentModified(Segment *segment)
     return mapper->refresh();
 }
 
+bool
+CompositionMapper::segmentModified(Segment *segment,
+                                   timeT startTime, timeT endTime)
+{
+    if (m_segmentMappers.find(segment) == m_segmentMappers.end())
+        return false;
+
+    QSharedPointer<SegmentMapper> mapper = m_segmentMappers[segment];
+
+    if (!mapper)
+        return false;
+
+    return mapper->refreshRange(startTime, endTime);
+}
+
 void
 CompositionMapper::segmentAdded(Segment *segment)
 {
@@ -18,6 +18,8 @@
 #ifndef RG_COMPOSITIONMAPPER_H
 #define RG_COMPOSITIONMAPPER_H
 
+#include "base/TimeT.h"
+
 #include <QSharedPointer>
 
 #include <map>
@@ -52,6 +54,8 @@ public:
     QSharedPointer<MappedEventBuffer> getMappedEventBuffer(Segment *);
 
     bool segmentModified(Segment *);
+    /// The Segment's events between startTime and endTime have changed.
+    bool segmentModified(Segment *, timeT startTime, timeT endTime);
     void segmentAdded(Segment *);
     void segmentDeleted(Segment *);
 
@@ -47,7 +47,12 @@ InternalSegmentMapper::InternalSegmentMapper(RosegardenDocument *doc,
                                              Segment *segment)
     : SegmentMapper(doc, segment),
       m_channelManager(doc->getInstrument(segment)),
-      m_triggeredEvents(new Segment)
+      m_triggeredEvents(new Segment),
+      m_lastEventTime(std::numeric_limits<timeT>::min()),
+      m_canRemapRange(false),
+      m_mappedStartTime(0),
+      m_mappedEndMarkerTime(0),
+      m_remapping(false)
 {}
 
 InternalSegmentMapper::
@@ -102,6 +107,12 @@ void InternalSegmentMapper::fillBuffer()
     m_triggeredEvents->clear();
     m_controllerCache.clear();
     m_noteOffs = NoteoffContainer();
+    m_entries.clear();
+    m_lastEventTime = std::numeric_limits<timeT>::min();
+
+    m_canRemapRange = (repeatCount == 0  &&  m_segment->getDelay() >= 0);
+    m_mappedStartTime = segmentStartTime;
+    m_mappedEndMarkerTime = segmentEndTime;
 
     for (int repeatNo = 0; repeatNo <= repeatCount; ++repeatNo) {
 
@@ -163,6 +174,8 @@ void InternalSegmentMapper::fillBuffer()
 
                 if (triggerId >= 0) {
 
+                    m_canRemapRange = false;
+
                     TriggerSegmentRec *rec =
                         comp.getTriggerSegmentRec(triggerId);
                     // We will invalidate `implied' so we arrange to
@@ -206,74 +219,10 @@ void InternalSegmentMapper::fillBuffer()
                 }
             }
 
-            // Ignore rests
-            //
-            if (!(**k)->isa(Note::EventRestType)) {
-
-                SegmentPerformanceHelper helper
-                (usingImplied ? *m_triggeredEvents : *m_segment);
-
-                timeT playTime =
-                    helper.getSoundingAbsoluteTime(*k) + timeForRepeats;
-                if (playTime >= repeatEndTime) break;
-
-                timeT playDuration = helper.getSoundingDuration(*k);
-
-                // Ignore notes without duration -- they're probably in a tied
-                // series but not as first note
-                //
-                if (playDuration > 0 || !(**k)->isa(Note::EventType)) {
-
-                    if (playTime + playDuration > repeatEndTime)
-                        playDuration = repeatEndTime - playTime;
-
-                    playTime = playTime + m_segment->getDelay();
-                    const RealTime eventTime = toRealTime(comp, playTime);
-
-                    // slightly quicker than calling helper.getRealSoundingDuration()
-                    RealTime endTime =
-                        toRealTime(comp, playTime + playDuration);
-                    const RealTime duration = endTime - eventTime;
-
-                    try {
-                        // Create mapped event and put it in buffer.
-                        // The instrument will be set later by
-                        // ChannelManager, so we set it to zero here.
-                        MappedEvent e(0,
-                                      ***k,  // three stars! what an accolade
-                                      eventTime,
-                                      duration);
-
-                        // Somewhat hacky: The MappedEvent ctor makes
-                        // events that needn't be inserted invalid.
-                        if (e.isValid()) {
-                            e.setTrackId(track->getId());
-
-                            if ((**k)->isa(Controller::EventType) ||
-                                (**k)->isa(PitchBend::EventType)) {
-                                m_controllerCache.storeLatestValue((**k));
-                            }
-
-                            if ((**k)->isa(Note::EventType)) {
-                                if (m_segment->getTranspose() != 0) {
-                                    e.setPitch(e.getPitch() +
-                                               m_segment->getTranspose());
-                                }
-                                if (e.getType() != MappedEvent::MidiNoteOneShot) {
-                                    enqueueNoteoff(playTime + playDuration,
-                                                   e.getPitch());
-                                }
-                            }
-                            mapAnEvent(&e);
-                        } else {}
-
-                    } catch (...) {
-#ifdef DEBUG_INTERNAL_SEGMENT_MAPPER
-                        RG_DEBUG << "fillBuffer() - caught exception while trying to create MappedEvent";
-#endif
-                    }
-                }
-            }
+            if (!mapSegmentEvent(comp, track->getId(),
+                                 usingImplied ? *m_triggeredEvents : *m_segment,
+                                 *k, timeForRepeats, repeatEndTime))
+                break;
 
             ++*k; // increment either i or j, whichever one we just used
         }
@@ -284,6 +233,264 @@ void InternalSegmentMapper::fillBuffer()
         popInsertNoteoff(track->getId(), comp);
     }
 
+    finishMapping(track);
+}
+
+bool
+InternalSegmentMapper::mapSegmentEvent(Composition &comp, TrackId trackId,
+                                       Segment &segment, Segment::iterator i,
+                                       timeT timeForRepeats,
+                                       timeT repeatEndTime)
+{
+    // Ignore rests
+    //
+    if ((*i)->isa(Note::EventRestType))
+        return true;
+
+    SegmentPerformanceHelper helper(segment);
+
+    timeT playTime =
+        helper.getSoundingAbsoluteTime(i) + timeForRepeats;
+    if (playTime >= repeatEndTime) return false;
+
+    timeT playDuration = helper.getSoundingDuration(i);
+
+    // Ignore notes without duration -- they're probably in a tied
+    // series but not as first note
+    //
+    if (playDuration <= 0 && (*i)->isa(Note::EventType))
+        return true;
+
+    if (playTime + playDuration > repeatEndTime)
+        playDuration = repeatEndTime - playTime;
+
+    playTime = playTime + m_segment->getDelay();
+    const RealTime eventTime = toRealTime(comp, playTime);
+
+    // slightly quicker than calling helper.getRealSoundingDuration()
+    RealTime endTime =
+        toRealTime(comp, playTime + playDuration);
+    const RealTime duration = endTime - eventTime;
+
+    try {
+        // Create mapped event and put it in buffer.
+        // The instrument will be set later by
+        // ChannelManager, so we set it to zero here.
+        MappedEvent e(0,
+                      **i,
+                      eventTime,
+                      duration);
+
+        // Somewhat hacky: The MappedEvent ctor makes
+        // events that needn't be inserted invalid.
+        if (e.isValid()) {
+            e.setTrackId(trackId);
+
+            Entry entry;
+            entry.time = (*i)->getAbsoluteTime() + timeForRepeats;
+            entry.noteOff = false;
+            entry.controller = ((*i)->isa(Controller::EventType) ||
+                                (*i)->isa(PitchBend::EventType));
+            entry.quiet = (m_noteOffs.empty() &&
+                           entry.time != m_lastEventTime);
+
+            if (entry.controller) {
+                m_controllerCache.storeLatestValue(*i);
+            }
+
+            if ((*i)->isa(Note::EventType)) {
+                if (m_segment->getTranspose() != 0) {
+                    e.setPitch(e.getPitch() +
+                               m_segment->getTranspose());
+                }
+                if (e.getType() != MappedEvent::MidiNoteOneShot) {
+                    enqueueNoteoff(playTime + playDuration,
+                                   e.getPitch());
+                }
+            }
+            addEvent(e, entry);
+        } else {}
+
+    } catch (...) {
+#ifdef DEBUG_INTERNAL_SEGMENT_MAPPER
+        RG_DEBUG << "mapSegmentEvent() - caught exception while trying to create MappedEvent";
+#endif
+    }
+
+    return true;
+}
+
+void
+InternalSegmentMapper::addEvent(MappedEvent &event, const Entry &entry)
+{
+    if (m_remapping) {
+        m_remapEvents.push_back(event);
+        m_remapEntries.push_back(entry);
+    } else {
+        mapAnEvent(&event);
+        m_entries.push_back(entry);
+    }
+
+    if (!entry.noteOff)
+        m_lastEventTime = entry.time;
+}
+
+bool
+InternalSegmentMapper::refreshRange(timeT startTime, timeT endTime)
+{
+    const int oldCapacity = capacity();
+
+    if (!remapRange(startTime, endTime)) {
+        ++m_rangeFallbacks;
+        return refresh();
+    }
+
+    return capacity() != oldCapacity;
+}
+
+namespace
+{
+    // For searching InternalSegmentMapper::m_entries, which are in time
+    // order like the buffer.
+    struct EntryTimeCmp
+    {
+        template <typename Entry>
+        bool operator()(const Entry &entry, timeT t) const
+            { return entry.time < t; }
+    };
+}
+
+bool
+InternalSegmentMapper::remapRange(timeT startTime, timeT endTime)
+{
+    // Repeats and triggered segments interleave events from different
+    // times, so those segments are always remapped in full.  So are
+    // segments that have been moved or resized, since the times outside
+    // the range will have changed too.
+    if (!m_canRemapRange  ||
+        getSegmentRepeatCount() > 0  ||
+        m_segment->getDelay() < 0  ||
+        m_segment->getStartTime() != m_mappedStartTime  ||
+        m_segment->getEndMarkerTime() != m_mappedEndMarkerTime  ||
+        int(m_entries.size()) != size())
+        return false;
+
+    Composition &comp = m_doc->getComposition();
+    Track *track = comp.getTrackById(m_segment->getTrack());
+    if (!track)
+        return false;
+
+    // Start from the last quiet event before the range.  Nothing before
+    // it is affected by the change: every note before it has ended.
+    int first = int(std::lower_bound(m_entries.begin(), m_entries.end(),
+                                     startTime, EntryTimeCmp()) -
+                    m_entries.begin()) - 1;
+    while (first >= 0  &&  !m_entries[first].quiet)
+        --first;
+
+    // Nothing to gain.
+    if (first <= 0)
+        return false;
+
+    const timeT firstTime = m_entries[first].time;
+    const timeT segmentEndTime = m_segment->getEndMarkerTime();
+
+    m_noteOffs = NoteoffContainer();
+    m_lastEventTime = std::numeric_limits<timeT>::min();
+    m_remapEvents.clear();
+    m_remapEntries.clear();
+    m_remapping = true;
+
+    // Remap from there until, past the end of the range, we reach the
+    // first event at a time where nothing is sounding in either the old
+    // mapping or the new.  From there on the old mapping still holds.
+    int last = size();
+    bool ok = true;
+    timeT previousTime = std::numeric_limits<timeT>::min();
+
+    for (Segment::iterator i = m_segment->findTime(firstTime);
+         m_segment->isBeforeEndMarker(i);
+         // No step here.  Noteoffs don't step.
+         ) {
+        const timeT t = (*i)->getAbsoluteTime();
+
+        if (haveEarlierNoteoff(t)) {
+            popInsertNoteoff(track->getId(), comp);
+            continue;
+        }
+
+        if (t > endTime  &&  t != previousTime  &&  m_noteOffs.empty()) {
+            // Skip the old noteoffs at t to find the old first event.
+            int old = int(std::lower_bound(m_entries.begin(),
+                                           m_entries.end(),
+                                           t, EntryTimeCmp()) -
+                          m_entries.begin());
+            while (old < size()  &&  m_entries[old].noteOff  &&
+                   m_entries[old].time == t)
+                ++old;
+            if (old < size()  &&  m_entries[old].time == t  &&
+                m_entries[old].quiet) {
+                last = old;
+                break;
+            }
+        }
+        previousTime = t;
+
+        // Triggered segments and controllers need the full treatment
+        // (ControllerContextMap caches the latest controller values).
+        long triggerId = -1;
+        (*i)->get<Int>(BaseProperties::TRIGGER_SEGMENT_ID, triggerId);
+        if (triggerId >= 0  ||
+            (*i)->isa(Controller::EventType)  ||
+            (*i)->isa(PitchBend::EventType)) {
+            ok = false;
+            break;
+        }
+
+        if (!mapSegmentEvent(comp, track->getId(), *m_segment, i,
+                             0, segmentEndTime))
+            break;
+
+        ++i;
+    }
+
+    // If we got to the end, flush the noteoffs.
+    if (ok  &&  last == size()) {
+        while (!m_noteOffs.empty()) {
+            popInsertNoteoff(track->getId(), comp);
+        }
+    }
+
+    m_remapping = false;
+
+    // Any controllers among the events we're replacing?
+    for (int i = first; ok  &&  i < last; ++i) {
+        if (m_entries[i].controller)
+            ok = false;
+    }
+
+    if (!ok)
+        return false;
+
+    splice(first, last - first,
+           m_remapEvents.data(), int(m_remapEvents.size()));
+    m_entries.erase(m_entries.begin() + first, m_entries.begin() + last);
+    m_entries.insert(m_entries.begin() + first,
+                     m_remapEntries.begin(), m_remapEntries.end());
+
+#ifdef DEBUG_INTERNAL_SEGMENT_MAPPER
+    RG_DEBUG << "remapRange(): replaced" << (last - first) << "events with"
+             << m_remapEvents.size() << "of" << size();
+#endif
+
+    finishMapping(track);
+
+    return true;
+}
+
+void
+InternalSegmentMapper::finishMapping(Track *track)
+{
     bool anything = (size() != 0);
 
     RealTime minRealTime;
@@ -372,7 +579,13 @@ popInsertNoteoff(int trackid, Composition &comp)
     MappedEvent event(0, MappedEvent::MidiNote, pitch, 0);
     event.setEventTime(toRealTime(comp, internalTime));
     event.setTrackId(trackid);
-    mapAnEvent(&event);
+
+    Entry entry;
+    entry.time = internalTime;
+    entry.noteOff = true;
+    entry.controller = false;
+    entry.quiet = false;
+    addEvent(event, entry);
 
     // pop
     m_noteOffs.erase(m_noteOffs.begin());
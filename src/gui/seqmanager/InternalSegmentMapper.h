@@ -19,11 +19,13 @@
 #define RG_INTERNALSEGMENTMAPPER_H
 
 #include "base/ControllerContext.h"
+#include "base/Segment.h"
 #include "gui/seqmanager/MappedEventBuffer.h"
 #include "gui/seqmanager/SegmentMapper.h"
 #include "gui/seqmanager/ChannelManager.h"
 
 #include <set>
+#include <vector>
 
 namespace Rosegarden
 {
@@ -31,6 +33,7 @@ namespace Rosegarden
 class TriggerSegmentRec;
 class Composition;
 class RealTime;
+class Track;
 
 /// Converts (maps) Event objects into MappedEvent objects for a Segment
 /**
@@ -61,6 +64,9 @@ public:
     InternalSegmentMapper(RosegardenDocument *doc, Segment *segment);
     ~InternalSegmentMapper() override;
 
+    // SegmentMapper override
+    bool refreshRange(timeT startTime, timeT endTime) override;
+
 protected:
     // MappedEventBuffer Overrides
 
@@ -114,6 +120,48 @@ private:
 
     int addSize(int size, Segment *) const;
 
+    /// Map one event from segment (m_segment or m_triggeredEvents).
+    /**
+     * Returns false if the event plays at or after repeatEndTime, in
+     * which case nothing more from segment should be mapped.
+     */
+    bool mapSegmentEvent(Composition &comp, TrackId trackId,
+                         Segment &segment, Segment::iterator i,
+                         timeT timeForRepeats, timeT repeatEndTime);
+
+    /// Remap only the events around startTime to endTime.
+    /**
+     * Returns false if that isn't possible, in which case the buffer is
+     * unchanged and the caller should remap the whole segment.
+     */
+    bool remapRange(timeT startTime, timeT endTime);
+
+    /// Update the sounding times and channel after (re)mapping.
+    void finishMapping(Track *track);
+
+    /// What we know about each event in the buffer.
+    /**
+     * Kept in step with the buffer, for remapRange().
+     */
+    struct Entry
+    {
+        /// Segment time of the Event, or time of the noteoff.
+        timeT time;
+        bool noteOff;
+        /// A controller or pitchbend, which m_controllerCache knows about.
+        bool controller;
+        /// The first event at its time, with no notes sounding.
+        /**
+         * Mapping can start over from here without knowing anything
+         * about the events before.
+         */
+        bool quiet;
+    };
+    std::vector<Entry> m_entries;
+
+    /// Add an event to the buffer, or to m_remapEvents when remapping.
+    void addEvent(MappedEvent &event, const Entry &entry);
+
     Instrument *getInstrument() const
         { return m_channelManager.getInstrument(); }
 
@@ -141,6 +189,24 @@ private:
 
     /// Queue of noteoffs.
     NoteoffContainer m_noteOffs;
+
+    /// Time of the last (non-noteoff) event added, for Entry::quiet.
+    timeT m_lastEventTime;
+
+    /// Whether the last fillBuffer() left a buffer remapRange() can edit.
+    /**
+     * Not if it had repeats or triggered segments, or played before the
+     * segment's start.
+     */
+    bool m_canRemapRange;
+    /// Segment start and end marker as of the last fillBuffer().
+    timeT m_mappedStartTime;
+    timeT m_mappedEndMarkerTime;
+
+    /// Whether addEvent() is collecting events for remapRange().
+    bool m_remapping;
+    std::vector<MappedEvent> m_remapEvents;
+    std::vector<Entry> m_remapEntries;
 };
 
 
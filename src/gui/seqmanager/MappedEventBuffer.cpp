@@ -24,6 +24,7 @@
 #include "sound/MappedEvent.h"
 #include "sound/MappedInserterBase.h"
 
+#include <algorithm>
 #include <limits>  // for std::numeric_limits
 
 // #define DEBUG_MAPPED_EVENT_BUFFER 1
@@ -173,6 +174,36 @@ mapAnEvent(MappedEvent *e)
     resize(size() + 1);
 }
 
+void
+MappedEventBuffer::splice(int position, int count,
+                          const MappedEvent *events, int newCount)
+{
+    const int oldSize = size();
+    const int newSize = oldSize - count + newCount;
+
+    // Grow as mapAnEvent() does, so that a run of small edits doesn't
+    // reallocate every time.  reserve() takes the lock itself.
+    if (newSize > capacity())
+        reserve(std::max(newSize, int(1 + float(capacity()) * 1.5)));
+
+    QWriteLocker locker(&m_lock);
+
+    MappedEvent *buffer = getBuffer();
+
+    // Move the events after the replaced ones into place.
+    if (newCount > count) {
+        std::copy_backward(buffer + position + count, buffer + oldSize,
+                           buffer + newSize);
+    } else if (newCount < count) {
+        std::copy(buffer + position + count, buffer + oldSize,
+                  buffer + position + newCount);
+    }
+
+    std::copy(events, events + newCount, buffer + position);
+
+    resize(newSize);
+}
+
 void
 MappedEventBuffer::
 doInsert(MappedInserterBase &inserter, MappedEvent &evt,
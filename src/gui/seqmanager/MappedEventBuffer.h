@@ -232,6 +232,18 @@ protected:
     /// Add an event to the buffer.
     void mapAnEvent(MappedEvent *e);
 
+    /// Replace count events at position with the given events.
+    /**
+     * For mappers that remap part of a segment.  The buffer is grown if
+     * needed, and the events after the replaced ones are moved up or
+     * down, all while holding the write lock, so that readers never see
+     * the buffer half-shifted.  Iterators past position will be pointing
+     * at different events afterwards, so the sequencer needs to be told
+     * (as for any refresh).
+     */
+    void splice(int position, int count,
+                const MappedEvent *events, int newCount);
+
     /// Set the sounding times (m_start, m_end).
     /**
      * InternalSegmentMapper::fillBuffer() keeps this updated.
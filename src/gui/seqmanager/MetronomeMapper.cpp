@@ -36,6 +36,7 @@
 #include <QSettings>
 
 #include <algorithm>  // For std::sort().
+#include <vector>
 
 namespace Rosegarden
 {
@@ -182,6 +183,16 @@ void MetronomeMapper::fillBuffer()
 
     const RealTime tickDuration(0, 100000000);
 
+    // m_ticks is sorted, so convert all the times in one pass.
+    std::vector<timeT> tickTimes;
+    tickTimes.reserve(m_ticks.size());
+    for (const TickContainer::value_type &tick : m_ticks) {
+        tickTimes.push_back(tick.first);
+    }
+    std::vector<RealTime> eventTimes(tickTimes.size());
+    composition.getTempoMap()->getElapsedRealTimes(
+            tickTimes.data(), eventTimes.data(), tickTimes.size());
+
     int index = 0;
 
     // For each tick
@@ -191,7 +202,7 @@ void MetronomeMapper::fillBuffer()
 
         //RG_DEBUG << "fillBuffer(): velocity = " << int(velocity);
 
-        RealTime eventTime = composition.getElapsedRealTime(tick->first);
+        const RealTime &eventTime = eventTimes[index];
 
         MappedEvent e;
 
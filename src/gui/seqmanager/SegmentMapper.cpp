@@ -34,7 +34,8 @@ namespace Rosegarden
 SegmentMapper::SegmentMapper(RosegardenDocument *doc,
                              Segment *segment) :
     MappedEventBuffer(doc),
-    m_segment(segment)
+    m_segment(segment),
+    m_rangeFallbacks(0)
 {
     //RG_DEBUG << "ctor: " << this;
 }
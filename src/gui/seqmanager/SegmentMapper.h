@@ -18,6 +18,7 @@
 #ifndef RG_SEGMENTMAPPER_H
 #define RG_SEGMENTMAPPER_H
 
+#include "base/TimeT.h"
 #include "gui/seqmanager/MappedEventBuffer.h"
 
 #include <QString>
@@ -40,11 +41,29 @@ public:
     // MappedEventBuffer override
     TrackId getTrackID() const override;
 
+    /// Refresh after the segment's events between the given times changed.
+    /**
+     * Mappers that can remap part of a segment override this.  The
+     * default remaps the whole segment.  Returns true if the buffer was
+     * resized, like refresh().
+     */
+    virtual bool refreshRange(timeT /* startTime */, timeT /* endTime */)
+        { ++m_rangeFallbacks; return refresh(); }
+
+    /// How many times refreshRange() has remapped the whole segment.
+    /**
+     * So that tests can tell which way it went.
+     */
+    int getRangeFallbackCount() const  { return m_rangeFallbacks; }
+
 protected:
     SegmentMapper(RosegardenDocument *, Segment *);
 
     Segment *m_segment;
 
+    /// See getRangeFallbackCount().
+    int m_rangeFallbacks;
+
     int getSegmentRepeatCount() const;
 
     bool mutedEtc() const;
@@ -25,6 +25,7 @@
 #include "sound/ExternalController.h"
 #include "misc/Debug.h"
 #include "misc/Strings.h"  // for qStrToBool()
+#include "misc/Headless.h"
 #include "misc/ConfigGroups.h"
 #include "base/Composition.h"
 #include "base/Device.h"
@@ -134,7 +135,10 @@ SequenceManager::setDocument(RosegardenDocument *doc)
     delete m_countdownDialog;
     delete m_countdownTimer;
 
-    m_countdownDialog = new CountdownDialog(RosegardenMainWindow::self());
+    m_countdownDialog = nullptr;
+    // Only needed for recording, which can't happen headless.
+    if (!isHeadless())
+        m_countdownDialog = new CountdownDialog(RosegardenMainWindow::self());
 
     // Bug #394: playback pointer wonkiness when stopping recording
     // (was 933041)  No longer connect the CountdownDialog from
@@ -1440,11 +1444,18 @@ void SequenceManager::refresh()
 
     for (SegmentRefreshMap::iterator i = m_segments.begin();
             i != m_segments.end(); ++i) {
-        // If this Segment needs a refresh
-        if (i->first->getRefreshStatus(i->second).needsRefresh() ||
-                ridset.find(i->first->getRuntimeId()) != ridset.end()) {
+        SegmentRefreshStatus &status =
+                i->first->getRefreshStatus(i->second);
+
+        // If a trigger Segment it uses has changed, all of it needs a
+        // refresh.
+        if (ridset.find(i->first->getRuntimeId()) != ridset.end()) {
             segmentModified(i->first);
-            i->first->getRefreshStatus(i->second).setNeedsRefresh(false);
+            status.setNeedsRefresh(false);
+        } else if (status.needsRefresh()) {
+            // Just the part that changed.
+            segmentModified(i->first, status.from(), status.to());
+            status.setNeedsRefresh(false);
         }
     }
 
@@ -1467,6 +1478,18 @@ SequenceManager::segmentModified(Segment* s)
         (m_compositionMapper->getMappedEventBuffer(s));
 }
 
+void
+SequenceManager::segmentModified(Segment *s, timeT startTime, timeT endTime)
+{
+    RG_DEBUG << "segmentModified(" << s << "," << startTime << ","
+             << endTime << ")";
+
+    m_compositionMapper->segmentModified(s, startTime, endTime);
+
+    RosegardenSequencer::getInstance()->segmentModified
+        (m_compositionMapper->getMappedEventBuffer(s));
+}
+
 void SequenceManager::segmentAdded(const Composition*, Segment* s)
 {
     RG_DEBUG << "segmentAdded(" << s << "); queueing";
@@ -380,6 +380,8 @@ private:
     void segmentAdded(Segment *);
     /// Inform CompositionMapper and RosegardenSequencer that a Segment has changed.
     void segmentModified(Segment *);
+    /// As above, when only the events between startTime and endTime changed.
+    void segmentModified(Segment *, timeT startTime, timeT endTime);
     /**
      * Remove Segment from CompositionMapper, RosegardenSequencer, and the
      * SegmentRefreshMap (m_segments).
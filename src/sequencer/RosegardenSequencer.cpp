@@ -168,6 +168,9 @@ RosegardenSequencer::quit()
 #endif
     // and break out of the loop next time around
     m_transportStatus = QUIT;
+
+    // Don't wait for SequencerThread's next tick.
+    m_driver->wake();
 }
 
 
@@ -213,6 +216,8 @@ RosegardenSequencer::play(const RealTime &time)
     m_driver->setAudioBufferSizes(m_audioMix, m_audioRead, m_audioWrite,
                                   m_smallFileSize);
 
+    m_driver->wake();
+
     // report
     //
 #ifdef DEBUG_ROSEGARDEN_SEQUENCER
@@ -333,6 +338,7 @@ RosegardenSequencer::record(const RealTime &time,
     m_transportStatus = localRecordMode;
 
     if (localRecordMode == RECORDING) { // punch in
+        m_driver->wake();
         return true;
     } else {
 
@@ -374,6 +380,8 @@ RosegardenSequencer::stop(bool autoStop)
     Profiles::getInstance()->dump();
 
     incrementTransportToken();
+
+    m_driver->wake();
 }
 
 bool
@@ -386,6 +394,7 @@ RosegardenSequencer::punchOut()
     if (m_transportStatus == RECORDING) {
         m_driver->punchOut();
         m_transportStatus = PLAYING;
+        m_driver->wake();
         return true;
     }
     return false;
@@ -520,6 +529,7 @@ RosegardenSequencer::processMappedEvent(MappedEvent mE)
 {
     QMutexLocker locker(&m_asyncQueueMutex);
     m_asyncOutQueue.push_back(new MappedEvent(mE));
+    m_driver->wake();
 //    SEQUENCER_DEBUG << "processMappedEvent: Have " << m_asyncOutQueue.size()
 //                    << " events in async out queue" << endl;
 }
@@ -1349,6 +1359,12 @@ RosegardenSequencer::sleep(const RealTime &rt)
     m_driver->sleep(rt);
 }
 
+bool
+RosegardenSequencer::hasPendingEvents() const
+{
+    return m_driver->hasPendingEvents();
+}
+
 void
 RosegardenSequencer::processRecordedMidi()
 {
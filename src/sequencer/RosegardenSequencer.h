@@ -396,11 +396,19 @@ public:
     /**
      * Called from the main loop in order to lighten CPU load (i.e. the
      * timing quality of the sequencer does not depend on this being
-     * accurate).  A good implementation of this call would return right
-     * away when an incoming MIDI event needed to be handled.
+     * accurate).  Returns right away when an incoming MIDI event needs
+     * to be handled or when a transport or async out request comes in
+     * from the GUI.  See SoundDriver::wake().
      */
     void sleep(const RealTime &rt);
 
+    /// Whether the sequencer thread must keep ticking while stopped.
+    /**
+     * True while there are note-offs outstanding from events played
+     * while stopped (e.g. previews).  See SoundDriver::hasPendingEvents().
+     */
+    bool hasPendingEvents() const;
+
     /// Removes events not matching a MidiFilter from a MappedEventsList.
     /**
      * From the menu, Studio > Modify MIDI Filters... allows the user to
@@ -18,6 +18,7 @@
 
 #include "misc/Debug.h"
 #include "base/RealTime.h"
+#include "base/Trace.h"
 #include "RosegardenSequencer.h"
 #include "gui/application/TransportStatus.h"
 
@@ -32,15 +33,28 @@ SequencerThread::run()
 {
     RG_DEBUG << "run()";
 
+    Trace::setThreadName("Sequencer");
+
     RosegardenSequencer &seq = *RosegardenSequencer::getInstance();
 
     TransportStatus lastSeqStatus = seq.getStatus();
 
-    const RealTime sleepTime = RealTime::fromMilliseconds(10);
+    // While playing, recording, or sending out pending note-offs, we
+    // tick on this period.  The ticks are scheduled against a deadline
+    // so that the time spent processing doesn't add up to drift.
+    const qint64 tickNs = 10 * 1000000;
+    // When idle we only need to wake up to look for new clients.
+    // Everything else (transport changes from the GUI, async events,
+    // incoming MIDI) wakes us up early.  See SoundDriver::wake().
+    const qint64 clientCheckMs = 1000;
 
     QElapsedTimer timer;
     timer.start();
 
+    QElapsedTimer clock;
+    clock.start();
+    qint64 nextTickNs = 0;
+
     bool exiting = false;
 
     seq.lock();
@@ -158,22 +172,45 @@ SequencerThread::run()
         }
 
         // Every second
-        if (timer.elapsed() > 1000) {
+        if (timer.elapsed() > clientCheckMs) {
             seq.checkForNewClients();
             timer.restart();
         }
 
+        const TransportStatus status = seq.getStatus();
+        const bool ticking = (status == PLAYING  ||
+                              status == RECORDING  ||
+                              seq.hasPendingEvents());
+
         seq.unlock();
 
         // permitting synchronised calls from the gui or wherever to
         // be made now
 
-        // If the sequencer status hasn't changed, sleep for a bit
+        // If the sequencer status hasn't changed, sleep until the next
+        // deadline or until something wakes us.
         if (atLeisure) {
-            // ??? Could we use a QWaitCondition/QMutex here to reduce the
-            //     (upwards of sleepTime) delay between pressing play and
-            //     playing?
-            seq.sleep(sleepTime);
+            const qint64 nowNs = clock.nsecsElapsed();
+            qint64 waitNs;
+
+            if (ticking) {
+                // Woken early?  Keep the deadline we had.
+                if (nowNs >= nextTickNs) {
+                    nextTickNs += tickNs;
+                    // Fallen behind (or just started)?  Resync.
+                    if (nextTickNs <= nowNs)
+                        nextTickNs = nowNs + tickNs;
+                }
+                waitNs = nextTickNs - nowNs;
+            } else {
+                waitNs = (clientCheckMs - timer.elapsed()) * 1000000;
+                if (waitNs < 0)
+                    waitNs = 0;
+                nextTickNs = nowNs;
+            }
+
+            seq.sleep(RealTime(waitNs / 1000000000,
+                               waitNs % 1000000000));
         }
 
         seq.lock();
@@ -48,6 +48,7 @@
 #include "AudioPlayQueue.h"
 #include "base/levenshtein.hpp"
 #include "SequencerDataBlock.h"
+#include "base/Trace.h"
 #include "PlayableAudioFile.h"
 #include "ExternalController.h"
 #include "gui/application/RosegardenMainWindow.h"
@@ -94,6 +95,12 @@ static MappedEvent::FailureCode failureReports[FAILURE_REPORT_COUNT];
 static int failureReportWriteIndex = 0;
 static int failureReportReadIndex = 0;
 
+namespace
+{
+    TraceCounter alsaCallFailureCount("AlsaDriver ALSA call failures");
+    TraceCounter failureCount("AlsaDriver failures reported");
+}
+
 namespace {
     enum ClientClass {
         System, Internal, OSSSequencer, Hardware, Software, Invalid };
@@ -2261,31 +2268,30 @@ AlsaDriver::resetPlayback(const RealTime &oldPosition, const RealTime &position)
     // modify the note offs that exist as they're relative to the
     // playStartPosition terms.
     //
-    for (NoteOffQueue::iterator i = m_noteOffQueue.begin();
-         i != m_noteOffQueue.end(); ++i) {
+    m_noteOffQueue.adjustTimes([&](RealTime &realTime) {
 
         // if we're fast forwarding then we bring the note off closer
         if (jump >= RealTime::zero()) {
 
-            RealTime endTime = formerStartPosition + (*i)->realTime;
+            RealTime endTime = formerStartPosition + realTime;
 
 #ifdef DEBUG_PROCESS_MIDI_OUT
             RG_DEBUG << "resetPlayback(): Forward jump of " << jump << ": adjusting note off from "
-                      << (*i)->getRealTime() << " (absolute " << endTime
+                      << realTime << " (absolute " << endTime
                       << ") to:";
 #endif
-            (*i)->realTime = endTime - position;
+            realTime = endTime - position;
 #ifdef DEBUG_PROCESS_MIDI_OUT
-            RG_DEBUG << "resetPlayback():     " << (*i)->getRealTime();
+            RG_DEBUG << "resetPlayback():     " << realTime;
 #endif
         } else // we're rewinding - kill the note immediately
             {
 #ifdef DEBUG_PROCESS_MIDI_OUT
                 RG_DEBUG << "resetPlayback(): Rewind by " << jump << ": setting note off to zero";
 #endif
-                (*i)->realTime = RealTime::zero();
+                realTime = RealTime::zero();
             }
-    }
+    });
 
     pushRecentNoteOffs();
     processNotesOff(getAlsaTime(), true);
@@ -2375,11 +2381,12 @@ AlsaDriver::pushRecentNoteOffs()
 #endif
 
     // Move all to m_noteOffQueue.
-    for (NoteOffQueue::iterator i = m_recentNoteOffs.begin();
-         i != m_recentNoteOffs.end(); ++i) {
-        (*i)->realTime = RealTime::zero();
-        m_noteOffQueue.insert(*i);
-    }
+    m_recentNoteOffs.forEach([this](const NoteOffEvent &noteOff) {
+        m_noteOffQueue.insert(NoteOffEvent(RealTime::zero(),
+                                           noteOff.pitch,
+                                           noteOff.channel,
+                                           noteOff.instrumentId));
+    });
 
     m_recentNoteOffs.clear();
 }
@@ -2389,16 +2396,14 @@ void
 AlsaDriver::cropRecentNoteOffs(const RealTime &t)
 {
     while (!m_recentNoteOffs.empty()) {
-        NoteOffQueue::const_iterator noteOffIter = m_recentNoteOffs.begin();
-        const NoteOffEvent *noteOff = *noteOffIter;
+        const NoteOffEvent &noteOff = m_recentNoteOffs.top();
 #ifdef DEBUG_PROCESS_MIDI_OUT
-        RG_DEBUG << "cropRecentNoteOffs(): " << noteOff->getRealTime() << " vs " << t;
+        RG_DEBUG << "cropRecentNoteOffs(): " << noteOff.realTime << " vs " << t;
 #endif
-        if (noteOff->realTime >= t)
+        if (noteOff.realTime >= t)
             break;
 
-        delete noteOff;
-        m_recentNoteOffs.erase(noteOffIter);
+        m_recentNoteOffs.pop();
     }
 }
 
@@ -2406,26 +2411,15 @@ void
 AlsaDriver::weedRecentNoteOffs(unsigned int pitch, MidiByte channel,
                                InstrumentId instrument)
 {
-    for (NoteOffQueue::iterator i = m_recentNoteOffs.begin();
-         i != m_recentNoteOffs.end(); ++i) {
-        if ((*i)->pitch == pitch &&
-            (*i)->channel == channel &&
-            (*i)->instrumentId == instrument) {
+    if (m_recentNoteOffs.remove(pitch, channel, instrument)) {
 #ifdef DEBUG_PROCESS_MIDI_OUT
-            RG_DEBUG << "weedRecentNoteOffs(): deleting one";
+        RG_DEBUG << "weedRecentNoteOffs(): deleting one";
 #endif
-            delete *i;
-            m_recentNoteOffs.erase(i);
-            break;
-        }
     }
 }
 
 void AlsaDriver::clearRecentNoteOffs()
 {
-    for (NoteOffEvent *noteOff : m_recentNoteOffs) {
-        delete noteOff;
-    }
     m_recentNoteOffs.clear();
 }
 
@@ -2444,26 +2438,25 @@ AlsaDriver::allNotesOff()
     snd_seq_ev_clear(&event);
     offTime = getAlsaTime();
 
-    for (NoteOffQueue::iterator it = m_noteOffQueue.begin();
-         it != m_noteOffQueue.end(); ++it) {
+    m_noteOffQueue.forEach([&](const NoteOffEvent &noteOff) {
         // Set destination according to connection for instrument
         //
-        outputDevice = getPairForMappedInstrument((*it)->instrumentId);
+        outputDevice = getPairForMappedInstrument(noteOff.instrumentId);
         if (outputDevice.client < 0  ||  outputDevice.port < 0)
-            continue;
+            return;
 
         snd_seq_ev_set_subs(&event);
 
         // Set source according to port for device
         //
-        int src = getOutputPortForMappedInstrument((*it)->instrumentId);
+        int src = getOutputPortForMappedInstrument(noteOff.instrumentId);
         if (src < 0)
-            continue;
+            return;
         snd_seq_ev_set_source(&event, src);
 
         snd_seq_ev_set_noteoff(&event,
-                               (*it)->channel,
-                               (*it)->pitch,
+                               noteOff.channel,
+                               noteOff.pitch,
                                NOTE_OFF_VELOCITY);
 
         //snd_seq_event_output(m_midiHandle, &event);
@@ -2475,11 +2468,9 @@ AlsaDriver::allNotesOff()
 #endif
 
         }
+    });
 
-        delete(*it);
-    }
-
-    m_noteOffQueue.erase(m_noteOffQueue.begin(), m_noteOffQueue.end());
+    m_noteOffQueue.clear();
 
     //RG_DEBUG << "allNotesOff() - queue size = " << m_noteOffQueue.size();
 
@@ -2490,6 +2481,8 @@ AlsaDriver::allNotesOff()
 void
 AlsaDriver::processNotesOff(const RealTime &time, bool now, bool everything)
 {
+    RG_TRACE_SCOPE("AlsaDriver::processNotesOff");
+
     if (m_noteOffQueue.empty()) {
         return;
     }
@@ -2507,25 +2500,22 @@ AlsaDriver::processNotesOff(const RealTime &time, bool now, bool everything)
 
     // For each note-off event in the note-off queue.
     while (!m_noteOffQueue.empty()) {
-        // Use the begin() element since we will be deleting from the
-        // container and an iterator will become invalid after erase().
-        // Actually, erase() returns the next element.  We could do it
-        // that way.  Or increment before use.  So many options.
-        NoteOffQueue::iterator noteOffIter = m_noteOffQueue.begin();
-        NoteOffEvent *noteOff = *noteOffIter;
-
-        if (noteOff->realTime > time) {
+        if (m_noteOffQueue.top().realTime > time) {
 #ifdef DEBUG_PROCESS_MIDI_OUT
-            RG_DEBUG << "processNotesOff(): Note off time " << noteOff->getRealTime() << " is beyond current time " << time;
+            RG_DEBUG << "processNotesOff(): Note off time " << m_noteOffQueue.top().realTime << " is beyond current time " << time;
 #endif
             if (!everything) break;
         }
 
+        // Take a copy, since it will be moved to m_recentNoteOffs.
+        const NoteOffEvent noteOff = m_noteOffQueue.top();
+        m_noteOffQueue.pop();
+
 #ifdef DEBUG_PROCESS_MIDI_OUT
-        RG_DEBUG << "processNotesOff(" << time << "): found event at " << noteOff->getRealTime() << ", instr " << noteOff->getInstrument() << ", channel " << int(noteOff->getChannel()) << ", pitch " << int(noteOff->getPitch());
+        RG_DEBUG << "processNotesOff(" << time << "): found event at " << noteOff.realTime << ", instr " << noteOff.instrumentId << ", channel " << int(noteOff.channel) << ", pitch " << int(noteOff.pitch);
 #endif
 
-        RealTime offTime = noteOff->realTime;
+        RealTime offTime = noteOff.realTime;
         if (offTime < RealTime::zero())
             offTime = RealTime::zero();
         bool scheduled = (offTime > alsaTime) && !now;
@@ -2536,11 +2526,11 @@ AlsaDriver::processNotesOff(const RealTime &time, bool now, bool everything)
                                             (unsigned int)offTime.nsec };
 
         snd_seq_ev_set_noteoff(&alsaEvent,
-                               noteOff->channel,
-                               noteOff->pitch,
+                               noteOff.channel,
+                               noteOff.pitch,
                                NOTE_OFF_VELOCITY);
 
-        bool isSoftSynth = (noteOff->instrumentId >= SoftSynthInstrumentBase);
+        bool isSoftSynth = (noteOff.instrumentId >= SoftSynthInstrumentBase);
 
         if (!isSoftSynth) {
 
@@ -2548,11 +2538,9 @@ AlsaDriver::processNotesOff(const RealTime &time, bool now, bool everything)
 
             // Set source according to instrument
             //
-            int src = getOutputPortForMappedInstrument(noteOff->instrumentId);
+            int src = getOutputPortForMappedInstrument(noteOff.instrumentId);
             if (src < 0) {
-                RG_WARNING << "processNotesOff(): WARNING: Note off has no output port (instr = " << noteOff->instrumentId << ")";
-                delete noteOff;
-                m_noteOffQueue.erase(noteOffIter);
+                RG_WARNING << "processNotesOff(): WARNING: Note off has no output port (instr = " << noteOff.instrumentId << ")";
                 continue;
             }
 
@@ -2572,15 +2560,11 @@ AlsaDriver::processNotesOff(const RealTime &time, bool now, bool everything)
 
             alsaEvent.time.time = alsaOffTime;
 
-            processSoftSynthEventOut(noteOff->instrumentId, &alsaEvent, now);
+            processSoftSynthEventOut(noteOff.instrumentId, &alsaEvent, now);
         }
 
-        if (!now) {
+        if (!now)
             m_recentNoteOffs.insert(noteOff);
-        } else {
-            delete noteOff;
-        }
-        m_noteOffQueue.erase(noteOffIter);
     }
 
     // We don't flush the queue here, as this is called nested from
@@ -2635,6 +2619,8 @@ AlsaDriver::getAlsaTime()
 bool
 AlsaDriver::getMappedEventList(MappedEventList &mappedEventList)
 {
+    RG_TRACE_SCOPE("AlsaDriver::getMappedEventList");
+
     while (failureReportReadIndex != failureReportWriteIndex) {
         MappedEvent::FailureCode code = failureReports[failureReportReadIndex];
         //RG_DEBUG << "getMappedEventList(): failure code: " << code;
@@ -4130,17 +4116,15 @@ AlsaDriver::processMidiOut(const MappedEventList &rgEventList,
         // Add note to note off stack
         //
         if (needNoteOff) {
-            NoteOffEvent *noteOffEvent =
-                new NoteOffEvent(outputStopTime,  // already calculated
-                                 rgEvent->getPitch(),
-                                 channel,
-                                 rgEvent->getInstrument());
-
 #ifdef DEBUG_ALSA
             RG_DEBUG << "processMidiOut(): Adding NOTE OFF at " << outputStopTime;
 #endif
 
-            m_noteOffQueue.insert(noteOffEvent);
+            m_noteOffQueue.insert(NoteOffEvent(
+                    outputStopTime,  // already calculated
+                    rgEvent->getPitch(),
+                    channel,
+                    rgEvent->getInstrument()));
         }
     }  // for each event
 
@@ -4374,6 +4358,8 @@ AlsaDriver::processEventsOut(const MappedEventList &rgEventList,
                              const RealTime &sliceStart,
                              const RealTime &sliceEnd)
 {
+    RG_TRACE_SCOPE("AlsaDriver::processEventsOut");
+
     // special case for unqueued events
 #ifdef HAVE_LIBJACK
     const bool now = (sliceStart == RealTime::zero() && sliceEnd == RealTime::zero());
@@ -5464,10 +5450,33 @@ void
 AlsaDriver::sleep(const RealTime &rt)
 {
     int npfd = snd_seq_poll_descriptors_count(m_midiHandle, POLLIN);
+    // One more for the wake fd.
     // cppcheck-suppress allocaCalled
-    struct pollfd *pfd = (struct pollfd *)alloca(npfd * sizeof(struct pollfd));
+    struct pollfd *pfd = (struct pollfd *)alloca((npfd + 1) * sizeof(struct pollfd));
     snd_seq_poll_descriptors(m_midiHandle, pfd, npfd, POLLIN);
-    poll(pfd, npfd, rt.sec * 1000 + rt.msec());
+
+    if (m_wakeFd >= 0) {
+        pfd[npfd].fd = m_wakeFd;
+        pfd[npfd].events = POLLIN;
+        pfd[npfd].revents = 0;
+        ++npfd;
+    }
+
+    // ppoll() rather than poll() for sub-millisecond timeouts.
+    struct timespec timeout;
+    timeout.tv_sec = std::max(rt.sec, 0);
+    timeout.tv_nsec = (rt.sec < 0) ? 0 : std::max(rt.nsec, 0);
+
+    ppoll(pfd, npfd, &timeout, nullptr);
+
+    clearWake();
+}
+
+bool
+AlsaDriver::hasPendingEvents() const
+{
+    // processPending() sends these while we are stopped.
+    return !m_playing  &&  !m_noteOffQueue.empty();
 }
 
 void
@@ -5520,6 +5529,11 @@ AlsaDriver::runTasks()
 void
 AlsaDriver::reportFailure(MappedEvent::FailureCode code)
 {
+    // Count them all, including those we don't pass on below.
+    failureCount.increment();
+    if (code == MappedEvent::FailureALSACallFailed)
+        alsaCallFailureCount.increment();
+
     //#define REPORT_XRUNS 1
 #ifndef REPORT_XRUNS
     if (code == MappedEvent::FailureXRuns ||
@@ -18,7 +18,7 @@
 #ifdef HAVE_ALSA
 
 #include "SoundDriver.h"
-#include "NoteOffEvent.h"
+#include "NoteOffQueue.h"
 #include "base/Instrument.h"
 #include "base/Device.h"
 #include "AlsaPort.h"
@@ -349,6 +349,7 @@ public:
     void setLoop(const RealTime &loopStart, const RealTime &loopEnd) override;
 
     void sleep(const RealTime &) override;
+    bool hasPendingEvents() const override;
 
     // ----------------------- End of Virtuals ----------------------
 
@@ -698,7 +699,7 @@ private:
     void cropRecentNoteOffs(const RealTime &t); // remove old note offs
     void weedRecentNoteOffs(unsigned int pitch, MidiByte channel,
 			    InstrumentId instrument); // on subsequent note on
-    // Delete and erase all.
+    // Erase all.
     void clearRecentNoteOffs();
 
     bool m_queueRunning;
@@ -0,0 +1,207 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "AudioFileMapping.h"
+
+#include "misc/Strings.h"
+
+#include <iostream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//#define DEBUG_AUDIO_FILE_MAPPING 1
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+    uint32_t a_littleEndian32(const unsigned char *bytes)
+    {
+        return uint32_t(bytes[0]) |
+               (uint32_t(bytes[1]) << 8) |
+               (uint32_t(bytes[2]) << 16) |
+               (uint32_t(bytes[3]) << 24);
+    }
+
+    size_t a_pageSize()
+    {
+        static const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        return pageSize;
+    }
+}
+
+
+AudioFileMapping::AudioFileMapping(const QString &absoluteFilePath,
+                                   size_t bytesPerFrame) :
+    m_fd(-1),
+    m_map(nullptr),
+    m_mapSize(0),
+    m_data(nullptr),
+    m_bytesPerFrame(bytesPerFrame),
+    m_frameCount(0),
+    m_readAheadEnd(0)
+{
+    if (bytesPerFrame == 0)
+        return;
+
+    const int fd = ::open(absoluteFilePath.toLocal8Bit().constData(),
+                          O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0  ||  st.st_size <= 0) {
+        ::close(fd);
+        return;
+    }
+
+    void *map = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED,
+                     fd, 0);
+
+    if (map == MAP_FAILED) {
+#ifdef DEBUG_AUDIO_FILE_MAPPING
+        std::cerr << "AudioFileMapping: mmap failed for " << absoluteFilePath
+                  << ": " << strerror(errno) << std::endl;
+#endif
+        ::close(fd);
+        return;
+    }
+
+    m_fd = fd;
+
+    m_map = static_cast<unsigned char *>(map);
+    m_mapSize = size_t(st.st_size);
+
+    if (!findDataChunk()) {
+#ifdef DEBUG_AUDIO_FILE_MAPPING
+        std::cerr << "AudioFileMapping: no data chunk in " << absoluteFilePath
+                  << std::endl;
+#endif
+        munmap(m_map, m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    // We mostly read straight through.
+    madvise(m_map, m_mapSize, MADV_SEQUENTIAL);
+
+#ifdef DEBUG_AUDIO_FILE_MAPPING
+    std::cerr << "AudioFileMapping: mapped " << absoluteFilePath << ", "
+              << m_frameCount << " frames at offset " << (m_data - m_map)
+              << std::endl;
+#endif
+}
+
+AudioFileMapping::~AudioFileMapping()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+bool
+AudioFileMapping::isIntact() const
+{
+    if (!m_map)
+        return false;
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+        return false;
+
+    return st.st_size >= 0  &&  size_t(st.st_size) >= m_mapSize;
+}
+
+bool
+AudioFileMapping::findDataChunk()
+{
+    if (m_mapSize < 12  ||
+        memcmp(m_map, "RIFF", 4) != 0  ||
+        memcmp(m_map + 8, "WAVE", 4) != 0)
+        return false;
+
+    // Walk the chunks.  Each is a four character name and a length,
+    // padded to an even number of bytes.
+    size_t offset = 12;
+
+    while (offset + 8 <= m_mapSize) {
+
+        const unsigned char *chunk = m_map + offset;
+        const size_t length = a_littleEndian32(chunk + 4);
+        offset += 8;
+
+        if (memcmp(chunk, "data", 4) == 0) {
+            size_t dataSize = m_mapSize - offset;
+            // Files that weren't closed properly have a zero length
+            // here.  Take everything that's there, as RIFFAudioFile
+            // does.
+            if (length != 0  &&  length < dataSize)
+                dataSize = length;
+            m_data = m_map + offset;
+            m_frameCount = dataSize / m_bytesPerFrame;
+            return true;
+        }
+
+        offset += length + (length & 1);
+    }
+
+    return false;
+}
+
+void
+AudioFileMapping::readAhead(size_t frame, size_t frames)
+{
+    if (!m_map)
+        return;
+
+    const size_t dataOffset = size_t(m_data - m_map);
+    size_t start = dataOffset + frame * m_bytesPerFrame;
+    size_t end = start + frames * m_bytesPerFrame;
+    if (end > m_mapSize)
+        end = m_mapSize;
+
+    // Wait until at least half of the window is new, so that we make
+    // one call per half window rather than one per read.
+    if (m_readAheadEnd > start  &&
+        m_readAheadEnd - start >= (end - start) / 2)
+        return;
+
+    if (start < m_readAheadEnd)
+        start = m_readAheadEnd;
+    if (start >= end)
+        return;
+
+    // madvise() wants a page-aligned start.
+    const size_t pageStart = start - start % a_pageSize();
+
+    madvise(m_map + pageStart, end - pageStart, MADV_WILLNEED);
+
+    m_readAheadEnd = end;
+}
+
+
+}
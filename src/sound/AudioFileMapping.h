@@ -0,0 +1,104 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_AUDIO_FILE_MAPPING_H
+#define RG_AUDIO_FILE_MAPPING_H
+
+#include <rosegardenprivate_export.h>
+
+#include <QString>
+
+#include <stddef.h>
+
+namespace Rosegarden
+{
+
+
+/// Read-only memory mapping of the sample data in a RIFF (WAV/BWF) file.
+/**
+ * PlayableAudioFile uses this to decode straight from the page cache
+ * into its ring buffers, instead of reading through an ifstream into a
+ * separate raw buffer.  Seeking is just arithmetic.
+ *
+ * The kernel is told to read ahead of the play position with
+ * madvise(MADV_WILLNEED) as playback moves through the file, so the
+ * disk thread rarely has to wait on a page fault.
+ *
+ * The mapping is shared with the file, so if something truncates the
+ * file while it is mapped, touching the pages past the new end raises
+ * SIGBUS.  Check isIntact() before reading through getFrames(), and
+ * fall back to reading the file if it has shrunk.  That still leaves a
+ * window between the check and the read, but audio files are only
+ * ever appended to by Rosegarden itself.
+ */
+class ROSEGARDENPRIVATE_EXPORT AudioFileMapping
+{
+public:
+    /// Map the data chunk of the file.  Check isValid() afterwards.
+    AudioFileMapping(const QString &absoluteFilePath, size_t bytesPerFrame);
+    ~AudioFileMapping();
+
+    /// Whether the file was mapped and has a data chunk.
+    bool isValid() const  { return m_map != nullptr; }
+
+    /// Number of whole frames in the data chunk.
+    size_t getFrameCount() const  { return m_frameCount; }
+
+    /// Whether the file is still as long as it was when it was mapped.
+    /**
+     * One fstat() call.
+     */
+    bool isIntact() const;
+
+    /// Interleaved sample data starting at frame.
+    const unsigned char *getFrames(size_t frame) const
+        { return m_data + frame * m_bytesPerFrame; }
+
+    /// Ask the kernel to read the given frames in the background.
+    /**
+     * Cheap to call after every read: the kernel is only asked again
+     * once half of the range is new.
+     */
+    void readAhead(size_t frame, size_t frames);
+
+    /// Forget what has been requested, after a seek.
+    void resetReadAhead()  { m_readAheadEnd = 0; }
+
+private:
+    // Not copyable.
+    AudioFileMapping(const AudioFileMapping &);
+    AudioFileMapping &operator=(const AudioFileMapping &);
+
+    /// Find the "data" chunk.  Returns false if there isn't one.
+    bool findDataChunk();
+
+    /// Kept open for isIntact().
+    int m_fd;
+
+    unsigned char *m_map;
+    size_t m_mapSize;
+
+    const unsigned char *m_data;
+    size_t m_bytesPerFrame;
+    size_t m_frameCount;
+
+    /// Offset into the mapping up to which read-ahead has been requested.
+    size_t m_readAheadEnd;
+};
+
+
+}
+
+#endif
@@ -16,6 +16,8 @@
 #include "AudioProcess.h"
 
 #include "RunnablePluginInstance.h"
+#include "MixKernels.h"
+#include "AudioWorkerPool.h"
 #include "PlayableAudioFile.h"
 #include "RecordableAudioFile.h"
 #include "WAVAudioFile.h"
@@ -26,6 +28,7 @@
 #include "ControlBlock.h"
 
 #include "misc/Strings.h"
+#include "base/Trace.h"
 #include <sys/time.h>
 #include <pthread.h>
 
@@ -48,20 +51,10 @@
 namespace Rosegarden
 {
 
-/* Branch-free optimizer-resistant denormal killer courtesy of Simon
-   Jenkins on LAD: */
-
-static inline float flushToZero(volatile float f)
-{
-    f += 9.8607615E-32f;
-    return f - 9.8607615E-32f;
-}
-
-static inline void denormalKill(float *buffer, int size)
+namespace
 {
-    for (int i = 0; i < size; ++i) {
-        buffer[i] = flushToZero(buffer[i]);
-    }
+    TraceCounter discUnderrunCount("AudioProcess disc underruns");
+    TraceCounter discOverrunCount("AudioProcess disc overruns");
 }
 
 AudioThread::AudioThread(const std::string& name,
@@ -445,6 +438,8 @@ AudioBussMixer::emptyBuffers()
 void
 AudioBussMixer::kick(bool wantLock, bool signalInstrumentMixer)
 {
+    RG_TRACE_SCOPE("AudioBussMixer::kick");
+
     // Needs to be RT safe if wantLock is not specified
 
     if (wantLock)
@@ -587,6 +582,10 @@ AudioBussMixer::processBlocks()
         gain[0] = rec.gainLeft;
         gain[1] = rec.gainRight;
 
+        float lastGain[2];
+        lastGain[0] = rec.lastGainLeft;
+        lastGain[1] = rec.lastGainRight;
+
         // The dormant calculation here depends on the buffer length
         // for this mixer being the same as that for the instrument mixer
 
@@ -758,8 +757,9 @@ AudioBussMixer::processBlocks()
 
                     while (ch < 2 && ch < plugin->getAudioOutputCount()) {
 
-                        denormalKill(plugin->getAudioOutputBuffers()[ch],
-                                     m_blockSize);
+                        MixKernels::flushDenormals(
+                                plugin->getAudioOutputBuffers()[ch],
+                                m_blockSize);
 
                         memcpy(m_processBuffers[ch],
                                plugin->getAudioOutputBuffers()[ch],
@@ -774,14 +774,17 @@ AudioBussMixer::processBlocks()
                 if (dormant) {
                     rec.buffers[ch]->zero(m_blockSize);
                 } else {
-                    for (size_t j = 0; j < m_blockSize; ++j) {
-                        m_processBuffers[ch][j] *= gain[ch];
-                    }
+                    // Ramp over the first block after a level change.
+                    MixKernels::gainRamp(m_processBuffers[ch], m_blockSize,
+                                         lastGain[ch], gain[ch]);
                     rec.buffers[ch]->write(m_processBuffers[ch], m_blockSize);
                 }
+                lastGain[ch] = gain[ch];
             }
 
             rec.dormant = dormant;
+            rec.lastGainLeft = lastGain[0];
+            rec.lastGainRight = lastGain[1];
 
 #ifdef DEBUG_BUSS_MIXER
 
@@ -827,6 +830,8 @@ AudioBussMixer::processBlocks()
 void
 AudioBussMixer::threadRun()
 {
+    Trace::setThreadName("AudioBussMixer");
+
     while (!m_exiting) {
 
         if (m_driver->areClocksRunning()) {
@@ -859,7 +864,8 @@ AudioInstrumentMixer::AudioInstrumentMixer(SoundDriver *driver,
         AudioThread("AudioInstrumentMixer", driver, sampleRate),
         m_fileReader(fileReader),
         m_bussMixer(nullptr),
-        m_blockSize(blockSize)
+        m_blockSize(blockSize),
+        m_workerPool(nullptr)
 {
     // Pregenerate empty plugin slots
 
@@ -889,7 +895,13 @@ AudioInstrumentMixer::AudioInstrumentMixer(SoundDriver *driver,
         }
     }
 
-    // Leave the buffer map and process buffer list empty for now.
+    // The workers run plugins, so they get the same priority as we do.
+    m_workerPool = new AudioWorkerPool("AudioInstrumentMixer",
+                                       AudioWorkerPool::getDefaultWorkerCount(),
+                                       getPriority());
+    m_blockContexts.resize(m_workerPool->getWorkerCount() + 1);
+
+    // Leave the buffer map and process buffer lists empty for now.
     // The buffer length can change between plays, so we always
     // examine the buffers in fillBuffers and are prepared to
     // regenerate from scratch if necessary.  Don't like it though.
@@ -902,9 +914,12 @@ AudioInstrumentMixer::~AudioInstrumentMixer()
 
     removeAllPlugins();
 
-    for (std::vector<sample_t *>::iterator i = m_processBuffers.begin();
-            i != m_processBuffers.end(); ++i) {
-        delete[] *i;
+    delete m_workerPool;
+
+    for (BlockContext &context : m_blockContexts) {
+        for (sample_t *buffer : context.processBuffers) {
+            delete[] buffer;
+        }
     }
 
     //std::cerr << "AudioInstrumentMixer::~AudioInstrumentMixer exiting" << std::endl;
@@ -1448,15 +1463,22 @@ AudioInstrumentMixer::generateBuffers()
         }
     }
 
-    while ((unsigned int)m_processBuffers.size() > maxChannels) {
-        std::vector<sample_t *>::iterator bi = m_processBuffers.end();
-        --bi;
-        delete[] *bi;
-        m_processBuffers.erase(bi);
-    }
-    while ((unsigned int)m_processBuffers.size() < maxChannels) {
-        m_processBuffers.push_back(new sample_t[m_blockSize]);
+    for (BlockContext &context : m_blockContexts) {
+        std::vector<sample_t *> &processBuffers = context.processBuffers;
+        while ((unsigned int)processBuffers.size() > maxChannels) {
+            std::vector<sample_t *>::iterator bi = processBuffers.end();
+            --bi;
+            delete[] *bi;
+            processBuffers.erase(bi);
+        }
+        while ((unsigned int)processBuffers.size() < maxChannels) {
+            processBuffers.push_back(new sample_t[m_blockSize]);
+        }
     }
+
+    // So that processBlocks() doesn't allocate.
+    m_tasks.reserve(m_bufferMap.size());
+    m_groupedTasks.reserve(m_bufferMap.size());
 }
 
 void
@@ -1651,55 +1673,137 @@ AudioInstrumentMixer::processBlocks(bool &readSomething)
         // read it, so it'll fall behind if we put the volume up again.
     }
 
-    bool more = true;
+    // Each instrument only touches its own BufferRec, ring buffers,
+    // plugins and audio files, so the instruments can be processed in
+    // parallel.  The exception is plugins that share state between
+    // instances, which all go in one task.
 
-    static const int MAX_FILES_PER_INSTRUMENT = 500;
-    static PlayableAudioFile *playing[MAX_FILES_PER_INSTRUMENT];
+    m_tasks.clear();
+    m_groupedTasks.clear();
 
-    RealTime blockDuration = RealTime::frame2RealTime(m_blockSize, m_sampleRate);
+    for (BufferMap::iterator i = m_bufferMap.begin();
+            i != m_bufferMap.end(); ++i) {
 
-    while (more) {
+        InstrumentId id = i->first;
+        BufferRec &rec = i->second;
 
-        more = false;
+        if (rec.empty) {
+            rec.dormant = true;
+            continue;
+        }
 
-        for (BufferMap::iterator i = m_bufferMap.begin();
-                i != m_bufferMap.end(); ++i) {
+        InstrumentTask task;
+        task.id = id;
+        task.rec = &rec;
+        task.plugins = &m_plugins[id];
+        task.synth = nullptr;
+
+        SynthPluginMap::iterator si = m_synths.find(id);
+        if (si != m_synths.end())
+            task.synth = si->second;
+
+        bool grouped = (task.synth && task.synth->isInGroup());
+        for (PluginList::iterator j = task.plugins->begin();
+                j != task.plugins->end(); ++j) {
+            if (*j && (*j)->isInGroup())
+                grouped = true;
+        }
 
-            InstrumentId id = i->first;
-            BufferRec &rec = i->second;
+        if (grouped)
+            m_groupedTasks.push_back(task);
+        else
+            m_tasks.push_back(task);
+    }
 
-            if (rec.empty) {
-                rec.dormant = true;
-                continue;
-            }
+    for (BlockContext &context : m_blockContexts) {
+        context.readSomething = false;
+        context.discUnderrun = false;
+    }
 
-            size_t playCount = MAX_FILES_PER_INSTRUMENT;
+    size_t taskCount = m_tasks.size();
+    if (!m_groupedTasks.empty())
+        ++taskCount;
 
-            if (id >= SoftSynthInstrumentBase)
-                playCount = 0;
-            else {
-                queue->getPlayingFilesForInstrument(rec.filledTo,
-                                                    blockDuration, id,
-                                                    playing, playCount);
-            }
+    // We take tasks as well, and return only once they are all done.
+    m_workerPool->run(staticProcessTask, this, taskCount);
 
-            if (processBlock(id, playing, playCount, readSomething)) {
-                more = true;
-            }
-        }
+    bool discUnderrun = false;
+
+    for (const BlockContext &context : m_blockContexts) {
+        if (context.readSomething)
+            readSomething = true;
+        if (context.discUnderrun)
+            discUnderrun = true;
+    }
+
+    if (discUnderrun) {
+        discUnderrunCount.increment();
+        m_driver->reportFailure(MappedEvent::FailureDiscUnderrun);
     }
 }
 
+void
+AudioInstrumentMixer::staticProcessTask(void *mixer, size_t task, int worker)
+{
+    // Needs to be RT safe
 
-bool
-AudioInstrumentMixer::processBlock(InstrumentId id,
-                                   PlayableAudioFile **playing,
-                                   size_t playCount,
-                                   bool &readSomething)
+    AudioInstrumentMixer *self = static_cast<AudioInstrumentMixer *>(mixer);
+    BlockContext &context = self->m_blockContexts[worker];
+
+    if (task < self->m_tasks.size()) {
+        self->processInstrument(self->m_tasks[task], context);
+        return;
+    }
+
+    // The last task is the grouped instruments, in order.
+    for (const InstrumentTask &groupedTask : self->m_groupedTasks) {
+        self->processInstrument(groupedTask, context);
+    }
+}
+
+void
+AudioInstrumentMixer::processInstrument(const InstrumentTask &task,
+                                        BlockContext &context)
 {
     // Needs to be RT safe
 
-    BufferRec &rec = m_bufferMap[id];
+    const AudioPlayQueue *queue = m_driver->getAudioQueue();
+
+    const RealTime blockDuration =
+            RealTime::frame2RealTime(m_blockSize, m_sampleRate);
+
+    bool more = true;
+
+    while (more) {
+
+        size_t playCount = MAX_FILES_PER_INSTRUMENT;
+
+        if (task.id >= SoftSynthInstrumentBase)
+            playCount = 0;
+        else {
+            queue->getPlayingFilesForInstrument(task.rec->filledTo,
+                                                blockDuration, task.id,
+                                                context.playing, playCount);
+        }
+
+        more = processBlock(task, context, playCount);
+    }
+}
+
+bool
+AudioInstrumentMixer::processBlock(const InstrumentTask &task,
+                                   BlockContext &context,
+                                   size_t playCount)
+{
+    // Needs to be RT safe.  May be called on any worker thread, so it
+    // must not touch anything shared with other instruments.
+
+#if defined(DEBUG_MIXER) || defined(DEBUG_MIXER_LIGHTWEIGHT)
+    const InstrumentId id = task.id;
+#endif
+    BufferRec &rec = *task.rec;
+    std::vector<sample_t *> &processBuffers = context.processBuffers;
+    PlayableAudioFile **playing = context.playing;
     RealTime bufferTime = rec.filledTo;
 
 #ifdef DEBUG_MIXER
@@ -1712,12 +1816,12 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
     unsigned int channels = rec.channels;
     if (channels > (unsigned int)rec.buffers.size())
         channels = (unsigned int)rec.buffers.size();
-    if (channels > (unsigned int)m_processBuffers.size())
-        channels = (unsigned int)m_processBuffers.size();
+    if (channels > (unsigned int)processBuffers.size())
+        channels = (unsigned int)processBuffers.size();
     if (channels == 0) {
 #ifdef DEBUG_MIXER
         if ((id % 100) == 0)
-            std::cerr << "AudioInstrumentMixer::processBlock(" << id << "): nominal channels " << rec.channels << ", ring buffers " << rec.buffers.size() << ", process buffers " << m_processBuffers.size() << std::endl;
+            std::cerr << "AudioInstrumentMixer::processBlock(" << id << "): nominal channels " << rec.channels << ", ring buffers " << rec.buffers.size() << ", process buffers " << processBuffers.size() << std::endl;
 #endif
 
         return false; // buffers just haven't been set up yet
@@ -1745,7 +1849,7 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
         }
     }
 
-    PluginList &plugins = m_plugins[id];
+    PluginList &plugins = *task.plugins;
 
 #ifdef DEBUG_MIXER
 
@@ -1811,7 +1915,8 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
                 // to accept that it won't be available for a while
                 // and just read silence from it instead.
                 if (file->isBuffered()) {
-                    m_driver->reportFailure(MappedEvent::FailureDiscUnderrun);
+                    // Reported by processBlocks(), on the mixer thread.
+                    context.discUnderrun = true;
                     haveBlock = false;
                 } else {
                     // ignore happily.
@@ -1832,10 +1937,10 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
 #endif
 
     for (unsigned int ch = 0; ch < targetChannels; ++ch) {
-        memset(m_processBuffers[ch], 0, sizeof(sample_t) * m_blockSize);
+        memset(processBuffers[ch], 0, sizeof(sample_t) * m_blockSize);
     }
 
-    RunnablePluginInstance *synth = m_synths[id];
+    RunnablePluginInstance *synth = task.synth;
 
     if (synth && !synth->isBypassed()) {
 
@@ -1844,9 +1949,9 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
         unsigned int ch = 0;
 
         while (ch < synth->getAudioOutputCount() && ch < channels) {
-            denormalKill(synth->getAudioOutputBuffers()[ch],
-                         m_blockSize);
-            memcpy(m_processBuffers[ch],
+            MixKernels::flushDenormals(synth->getAudioOutputBuffers()[ch],
+                                       m_blockSize);
+            memcpy(processBuffers[ch],
                    synth->getAudioOutputBuffers()[ch],
                    m_blockSize * sizeof(sample_t));
             ++ch;
@@ -1889,8 +1994,8 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
             // pooled buffers.
 
             if (blockSize > 0) {
-                file->addSamples(m_processBuffers, channels, blockSize, offset);
-                readSomething = true;
+                file->addSamples(processBuffers, channels, blockSize, offset);
+                context.readSomething = true;
             }
         }
     }
@@ -1919,7 +2024,7 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
 
             if (ch < channels || ch < 2) {
                 memcpy(plugin->getAudioInputBuffers()[ch],
-                       m_processBuffers[ch % channels],
+                       processBuffers[ch % channels],
                        m_blockSize * sizeof(sample_t));
             } else {
                 memset(plugin->getAudioInputBuffers()[ch], 0,
@@ -1939,20 +2044,19 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
 
         while (ch < plugin->getAudioOutputCount()) {
 
-            denormalKill(plugin->getAudioOutputBuffers()[ch],
-                         m_blockSize);
+            MixKernels::flushDenormals(plugin->getAudioOutputBuffers()[ch],
+                                       m_blockSize);
 
             if (ch < channels) {
-                memcpy(m_processBuffers[ch],
+                memcpy(processBuffers[ch],
                        plugin->getAudioOutputBuffers()[ch],
                        m_blockSize * sizeof(sample_t));
             } else if (ch == 1) {
                 // stereo output from plugin on a mono track
-                for (size_t i = 0; i < m_blockSize; ++i) {
-                    m_processBuffers[0][i] +=
-                        plugin->getAudioOutputBuffers()[ch][i];
-                    m_processBuffers[0][i] /= 2;
-                }
+                MixKernels::mixAdd(processBuffers[0],
+                                   plugin->getAudioOutputBuffers()[ch],
+                                   m_blockSize);
+                MixKernels::gain(processBuffers[0], m_blockSize, 0.5f);
             } else {
                 break;
             }
@@ -1961,46 +2065,61 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
         }
     }
 
-    // special handling for pan on mono tracks
-
     bool allZeros = true;
 
-    if (targetChannels == 2 && channels == 1) {
+    // Ramp over the first block after a level change.
+    const float gainLeft = rec.gainLeft;
+    const float gainRight = rec.gainRight;
 
-        for (size_t i = 0; i < m_blockSize; ++i) {
+    // special handling for pan on mono tracks
 
-            sample_t sample = m_processBuffers[0][i];
+    if (targetChannels == 2 && channels == 1) {
 
-            m_processBuffers[0][i] = sample * rec.gainLeft;
-            m_processBuffers[1][i] = sample * rec.gainRight;
+        allZeros = (MixKernels::peak(processBuffers[0], m_blockSize) == 0.0f);
 
-            if (allZeros && sample != 0.0)
-                allZeros = false;
+        if (gainLeft == rec.lastGainLeft && gainRight == rec.lastGainRight) {
+            MixKernels::pan(processBuffers[0],
+                            processBuffers[0], processBuffers[1],
+                            m_blockSize, gainLeft, gainRight);
+        } else {
+            memcpy(processBuffers[1], processBuffers[0],
+                   m_blockSize * sizeof(sample_t));
+            MixKernels::gainRamp(processBuffers[0], m_blockSize,
+                                 rec.lastGainLeft, gainLeft);
+            MixKernels::gainRamp(processBuffers[1], m_blockSize,
+                                 rec.lastGainRight, gainRight);
         }
 
-        rec.buffers[0]->write(m_processBuffers[0], m_blockSize);
-        rec.buffers[1]->write(m_processBuffers[1], m_blockSize);
+        rec.buffers[0]->write(processBuffers[0], m_blockSize);
+        rec.buffers[1]->write(processBuffers[1], m_blockSize);
 
     } else {
 
         for (unsigned int ch = 0; ch < targetChannels; ++ch) {
 
-            float gain = ((ch == 0) ? rec.gainLeft :
-                          (ch == 1) ? rec.gainRight : rec.volume);
-
-            for (size_t i = 0; i < m_blockSize; ++i) {
-
-                // handle volume and pan
-                m_processBuffers[ch][i] *= gain;
-
-                if (allZeros && m_processBuffers[ch][i] != 0.0)
-                    allZeros = false;
+            // handle volume and pan
+            if (ch == 0) {
+                MixKernels::gainRamp(processBuffers[ch], m_blockSize,
+                                     rec.lastGainLeft, gainLeft);
+            } else if (ch == 1) {
+                MixKernels::gainRamp(processBuffers[ch], m_blockSize,
+                                     rec.lastGainRight, gainRight);
+            } else {
+                MixKernels::gain(processBuffers[ch], m_blockSize,
+                                 rec.volume);
             }
 
-            rec.buffers[ch]->write(m_processBuffers[ch], m_blockSize);
+            if (allZeros &&
+                MixKernels::peak(processBuffers[ch], m_blockSize) != 0.0f)
+                allZeros = false;
+
+            rec.buffers[ch]->write(processBuffers[ch], m_blockSize);
         }
     }
 
+    rec.lastGainLeft = gainLeft;
+    rec.lastGainRight = gainRight;
+
     bool dormant = true;
 
     if (allZeros) {
@@ -2038,6 +2157,8 @@ AudioInstrumentMixer::processBlock(InstrumentId id,
 void
 AudioInstrumentMixer::kick(bool wantLock)
 {
+    RG_TRACE_SCOPE("AudioInstrumentMixer::kick");
+
     // Needs to be RT safe if wantLock is not specified
 
     if (wantLock)
@@ -2056,6 +2177,8 @@ AudioInstrumentMixer::kick(bool wantLock)
 void
 AudioInstrumentMixer::threadRun()
 {
+    Trace::setThreadName("AudioInstrumentMixer");
+
     while (!m_exiting) {
 
         if (m_driver->areClocksRunning()) {
@@ -2135,6 +2258,8 @@ AudioFileReader::fillBuffers(const RealTime &currentTime)
 bool
 AudioFileReader::kick(bool wantLock)
 {
+    RG_TRACE_SCOPE("AudioFileReader::kick");
+
     if (wantLock)
         getLock();
 
@@ -2178,6 +2303,8 @@ AudioFileReader::kick(bool wantLock)
 void
 AudioFileReader::threadRun()
 {
+    Trace::setThreadName("AudioFileReader");
+
     while (!m_exiting) {
 
         //	struct timeval now;
@@ -2329,6 +2456,7 @@ AudioFileWriter::write(InstrumentId id,
     if (!m_files[id].first)
         return ; // no file
     if (m_files[id].second->buffer(samples, channel, sampleCount) < sampleCount) {
+        discOverrunCount.increment();
         m_driver->reportFailure(MappedEvent::FailureDiscOverrun);
     }
 }
@@ -2400,6 +2528,8 @@ AudioFileWriter::haveRecordFilesOpen()
 void
 AudioFileWriter::kick(bool wantLock)
 {
+    RG_TRACE_SCOPE("AudioFileWriter::kick");
+
     if (wantLock)
         getLock();
 
@@ -2441,6 +2571,8 @@ AudioFileWriter::kick(bool wantLock)
 void
 AudioFileWriter::threadRun()
 {
+    Trace::setThreadName("AudioFileWriter");
+
     while (!m_exiting) {
 
         kick(false);
@@ -144,7 +144,8 @@ protected:
     struct BufferRec
     {
         BufferRec() : dormant(true), buffers(), instruments(),
-                      gainLeft(0.0), gainRight(0.0) { }
+                      gainLeft(0.0), gainRight(0.0),
+                      lastGainLeft(0.0), lastGainRight(0.0) { }
         ~BufferRec();
 
         bool dormant;
@@ -154,6 +155,10 @@ protected:
 
         float gainLeft;
         float gainRight;
+
+        // The gains applied to the previous block, to ramp from.
+        float lastGainLeft;
+        float lastGainRight;
     };
 
     typedef std::map<int, BufferRec> BufferMap;
@@ -163,6 +168,7 @@ protected:
 
 class AudioFileReader;
 class AudioFileWriter;
+class AudioWorkerPool;
 
 class AudioInstrumentMixer : public AudioThread
 {
@@ -285,7 +291,6 @@ protected:
 
     void processBlocks(bool &readSomething);
     void processEmptyBlocks(InstrumentId id);
-    bool processBlock(InstrumentId id, PlayableAudioFile **, size_t, bool &readSomething);
     void generateBuffers();
 
     AudioFileReader  *m_fileReader;
@@ -299,15 +304,12 @@ protected:
     PluginMap m_plugins;
     SynthPluginMap m_synths;
 
-    // maintain the same number of these as the maximum number of
-    // channels on any audio instrument
-    std::vector<sample_t *> m_processBuffers;
-
     struct BufferRec
     {
         BufferRec() : empty(true), dormant(true), zeroFrames(0),
                       filledTo(RealTime::zero()), channels(2),
                       buffers(), gainLeft(0.0), gainRight(0.0), volume(0.0),
+                      lastGainLeft(0.0), lastGainRight(0.0),
                       muted(false) { }
         ~BufferRec();
 
@@ -322,11 +324,61 @@ protected:
         float gainLeft;
         float gainRight;
         float volume;
+        // The gains applied to the previous block, to ramp from.
+        float lastGainLeft;
+        float lastGainRight;
         bool muted;
     };
 
     typedef std::map<InstrumentId, BufferRec> BufferMap;
     BufferMap m_bufferMap;
+
+    static const int MAX_FILES_PER_INSTRUMENT = 500;
+
+    /// One instrument's share of the work in processBlocks().
+    struct InstrumentTask
+    {
+        InstrumentId id;
+        BufferRec *rec;
+        PluginList *plugins;
+        RunnablePluginInstance *synth;
+    };
+
+    /// Scratch space for one thread running processBlock().
+    struct BlockContext
+    {
+        BlockContext() : processBuffers(), playing(),
+                         readSomething(false), discUnderrun(false) { }
+
+        // maintain the same number of these as the maximum number of
+        // channels on any audio instrument
+        std::vector<sample_t *> processBuffers;
+        PlayableAudioFile *playing[MAX_FILES_PER_INSTRUMENT];
+
+        // Results, collected by processBlocks() once all threads are done.
+        bool readSomething;
+        bool discUnderrun;
+    };
+
+    /// Fill blocks for one instrument until it wants no more or blocks.
+    void processInstrument(const InstrumentTask &task, BlockContext &context);
+    bool processBlock(const InstrumentTask &task, BlockContext &context,
+                      size_t playCount);
+
+    /// AudioWorkerPool::TaskFunction for processBlocks().
+    static void staticProcessTask(void *mixer, size_t task, int worker);
+
+    /// Runs the instruments' plugin chains in parallel.
+    AudioWorkerPool *m_workerPool;
+    /// One per pool thread, after the first, which is the mixer thread's.
+    std::vector<BlockContext> m_blockContexts;
+
+    /// Instruments that can be processed concurrently, one task each.
+    std::vector<InstrumentTask> m_tasks;
+    /// Instruments with plugins that share state between instances
+    /// (see RunnablePluginInstance::isInGroup()).  These run serially,
+    /// as a single task.
+    std::vector<InstrumentTask> m_groupedTasks;
 };
 
 
@@ -0,0 +1,287 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "AudioWorkerPool.h"
+
+#include <iostream>
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//#define DEBUG_THREAD_CREATE_DESTROY 1
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+    const int a_maxWorkers = 15;
+
+    // How long run() spins waiting for the other threads before it
+    // sleeps.  Tasks are typically a few tens of microseconds, so most
+    // joins finish within the spin.
+    const int a_joinSpins = 2000;
+
+    uint32_t a_job(uint64_t next)  { return uint32_t(next >> 32); }
+    uint32_t a_task(uint64_t next)  { return uint32_t(next & 0xFFFFFFFF); }
+
+    /// Task index for a job that is being set up.  No count reaches it.
+    const uint32_t a_closed = 0xFFFFFFFF;
+}
+
+
+AudioWorkerPool::AudioWorkerPool(const std::string &name,
+                                 int workers,
+                                 int priority) :
+    m_name(name),
+    m_exiting(false),
+    m_function(nullptr),
+    m_context(nullptr),
+    m_count(0),
+    m_next(0),
+    m_finished(0)
+{
+    pthread_mutex_init(&m_lock, nullptr);
+    pthread_cond_init(&m_startCondition, nullptr);
+    pthread_cond_init(&m_doneCondition, nullptr);
+
+    if (workers > a_maxWorkers)
+        workers = a_maxWorkers;
+    if (workers <= 0)
+        return;
+
+    // Reserve up front so the ThreadArg addresses are stable.
+    m_threadArgs.reserve(workers);
+    m_threads.reserve(workers);
+
+    for (int i = 0; i < workers; ++i) {
+
+        ThreadArg arg;
+        arg.pool = this;
+        arg.worker = i + 1;
+        m_threadArgs.push_back(arg);
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+
+        if (priority > 0) {
+            struct sched_param param;
+            memset(&param, 0, sizeof(struct sched_param));
+            param.sched_priority = priority;
+
+            if (pthread_attr_setschedpolicy(&attr, SCHED_FIFO) ||
+                pthread_attr_setschedparam(&attr, &param)) {
+                pthread_attr_init(&attr); // reset to safety
+            }
+        }
+
+        pthread_attr_setstacksize(&attr, 1048576);
+
+        pthread_t thread;
+        int rv = pthread_create(&thread, &attr, staticThreadRun,
+                                &m_threadArgs.back());
+
+        if (rv != 0 && priority > 0) {
+#ifdef DEBUG_THREAD_CREATE_DESTROY
+            std::cerr << m_name << ": WARNING: unable to start RT worker;"
+                      << " trying again with normal scheduling" << std::endl;
+#endif
+            pthread_attr_init(&attr);
+            pthread_attr_setstacksize(&attr, 1048576);
+            rv = pthread_create(&thread, &attr, staticThreadRun,
+                                &m_threadArgs.back());
+        }
+
+        pthread_attr_destroy(&attr);
+
+        if (rv != 0) {
+            // Not fatal.  We just have fewer workers.
+            std::cerr << m_name << ": WARNING: failed to start worker "
+                      << (i + 1) << std::endl;
+            m_threadArgs.pop_back();
+            break;
+        }
+
+        m_threads.push_back(thread);
+    }
+
+#ifdef DEBUG_THREAD_CREATE_DESTROY
+    std::cerr << m_name << ": started " << m_threads.size() << " workers"
+              << std::endl;
+#endif
+}
+
+AudioWorkerPool::~AudioWorkerPool()
+{
+    pthread_mutex_lock(&m_lock);
+    m_exiting = true;
+    pthread_cond_broadcast(&m_startCondition);
+    pthread_mutex_unlock(&m_lock);
+
+    for (pthread_t thread : m_threads) {
+        pthread_join(thread, nullptr);
+    }
+
+    pthread_cond_destroy(&m_doneCondition);
+    pthread_cond_destroy(&m_startCondition);
+    pthread_mutex_destroy(&m_lock);
+}
+
+int
+AudioWorkerPool::getDefaultWorkerCount()
+{
+    const char *env = getenv("ROSEGARDEN_AUDIO_WORKERS");
+    if (env)
+        return atoi(env);
+
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 1)
+        return 0;
+    if (cpus - 1 > a_maxWorkers)
+        return a_maxWorkers;
+    return int(cpus - 1);
+}
+
+void
+AudioWorkerPool::run(TaskFunction function, void *context, size_t count)
+{
+    // Needs to be RT safe
+
+    if (count == 0)
+        return;
+
+    // Not worth waking anyone.
+    if (m_threads.empty() || count == 1) {
+        for (size_t task = 0; task < count; ++task) {
+            function(context, task, 0);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    // Close the last job before touching anything a worker reads.  A
+    // worker that is slow to notice the end of it may still try to
+    // claim a task from it, and if m_next were left alone that would
+    // succeed once m_count went up.  Now its compare-and-swap fails,
+    // and it sees the new job number and stops.
+    const uint32_t job = a_job(m_next.load(std::memory_order_relaxed)) + 1;
+    m_next.store((uint64_t(job) << 32) | a_closed,
+                 std::memory_order_release);
+    // No worker can claim a task until task 0 is opened below, so
+    // nothing reads these while they change.
+    m_function = function;
+    m_context = context;
+    m_count.store(count, std::memory_order_relaxed);
+    m_finished.store(0, std::memory_order_relaxed);
+    // Open task 0.  The release makes the job visible to any thread
+    // that claims a task from it.
+    m_next.store(uint64_t(job) << 32, std::memory_order_release);
+    pthread_cond_broadcast(&m_startCondition);
+    pthread_mutex_unlock(&m_lock);
+
+    work(0);
+
+    // Join.
+
+    for (int i = 0; i < a_joinSpins; ++i) {
+        if (m_finished.load(std::memory_order_acquire) == count)
+            return;
+        sched_yield();
+    }
+
+    pthread_mutex_lock(&m_lock);
+    while (m_finished.load(std::memory_order_acquire) != count) {
+        pthread_cond_wait(&m_doneCondition, &m_lock);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void
+AudioWorkerPool::work(int worker)
+{
+    uint64_t next = m_next.load(std::memory_order_acquire);
+    const uint32_t job = a_job(next);
+    size_t done = 0;
+
+    while (true) {
+
+        if (a_job(next) != job)
+            break;  // a new job has started; we missed the end of ours
+        if (a_task(next) >= m_count.load(std::memory_order_relaxed))
+            break;  // nothing left
+
+        if (!m_next.compare_exchange_weak(next, next + 1,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire))
+            continue;  // "next" has been reloaded; try again
+
+        m_function(m_context, a_task(next), worker);
+        ++done;
+
+        next = m_next.load(std::memory_order_acquire);
+    }
+
+    if (done == 0)
+        return;
+
+    if (m_finished.fetch_add(done, std::memory_order_acq_rel) + done ==
+            m_count.load(std::memory_order_relaxed)) {
+        // We finished the job.  Wake run() if it has gone to sleep.
+        pthread_mutex_lock(&m_lock);
+        pthread_cond_signal(&m_doneCondition);
+        pthread_mutex_unlock(&m_lock);
+    }
+}
+
+void *
+AudioWorkerPool::staticThreadRun(void *arg)
+{
+    ThreadArg *threadArg = static_cast<ThreadArg *>(arg);
+    threadArg->pool->threadRun(threadArg->worker);
+    return nullptr;
+}
+
+void
+AudioWorkerPool::threadRun(int worker)
+{
+    uint32_t lastJob = 0;
+
+    pthread_mutex_lock(&m_lock);
+
+    while (true) {
+
+        while (!m_exiting &&
+               a_job(m_next.load(std::memory_order_relaxed)) == lastJob) {
+            pthread_cond_wait(&m_startCondition, &m_lock);
+        }
+
+        if (m_exiting)
+            break;
+
+        lastJob = a_job(m_next.load(std::memory_order_relaxed));
+
+        pthread_mutex_unlock(&m_lock);
+        work(worker);
+        pthread_mutex_lock(&m_lock);
+    }
+
+    pthread_mutex_unlock(&m_lock);
+}
+
+
+}
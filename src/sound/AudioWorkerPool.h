@@ -0,0 +1,135 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_AUDIO_WORKER_POOL_H
+#define RG_AUDIO_WORKER_POOL_H
+
+#include <rosegardenprivate_export.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace Rosegarden
+{
+
+
+/// Fixed pool of threads for running independent audio tasks in parallel.
+/**
+ * AudioInstrumentMixer uses this to run the plugin chains of several
+ * instruments at once.  The threads are started once, at the same
+ * real-time priority as the mixer, and sleep between jobs.
+ *
+ * run() hands out tasks through a single atomic counter, so whichever
+ * thread is free takes the next task and no thread sits idle while
+ * tasks remain.  The calling thread works on tasks too, then waits for
+ * the others to finish before returning.
+ *
+ * The number of threads defaults to one less than the number of CPUs
+ * (up to 15).  Setting the environment variable ROSEGARDEN_AUDIO_WORKERS
+ * overrides this.  Zero runs everything on the calling thread.
+ */
+class ROSEGARDENPRIVATE_EXPORT AudioWorkerPool
+{
+public:
+    /// Task callback.
+    /**
+     * "worker" is 0 for the thread that called run(), and 1 to
+     * getWorkerCount() for the pool threads.  Use it to index per-thread
+     * scratch space.
+     */
+    typedef void (*TaskFunction)(void *context, size_t task, int worker);
+
+    /// Start the pool threads.
+    /**
+     * If priority is greater than zero, the threads are given
+     * SCHED_FIFO scheduling at that priority, if permitted.
+     */
+    AudioWorkerPool(const std::string &name, int workers, int priority);
+    ~AudioWorkerPool();
+
+    /// The number of pool threads, not counting the caller of run().
+    int getWorkerCount() const  { return int(m_threads.size()); }
+
+    /// Run tasks 0 to count-1 and return when all are finished.
+    /**
+     * RT safe.  Only one thread may call this at a time.
+     */
+    void run(TaskFunction function, void *context, size_t count);
+
+    /// See ROSEGARDEN_AUDIO_WORKERS above.
+    static int getDefaultWorkerCount();
+
+private:
+    // Not copyable.
+    AudioWorkerPool(const AudioWorkerPool &);
+    AudioWorkerPool &operator=(const AudioWorkerPool &);
+
+    struct ThreadArg
+    {
+        AudioWorkerPool *pool;
+        int worker;
+    };
+
+    static void *staticThreadRun(void *arg);
+    void threadRun(int worker);
+
+    /// Take and run tasks until there are none left in this job.
+    void work(int worker);
+
+    std::string m_name;
+
+    std::vector<pthread_t> m_threads;
+    std::vector<ThreadArg> m_threadArgs;
+
+    pthread_mutex_t m_lock;
+    /// Signalled when a job starts or the pool is shutting down.
+    pthread_cond_t m_startCondition;
+    /// Signalled when the last task of a job finishes.
+    pthread_cond_t m_doneCondition;
+    /// Protected by m_lock.
+    bool m_exiting;
+
+    // The current job.  Written by run() while the job is closed (see
+    // m_next), and only read by threads that have claimed a task from
+    // it, so they never change under a reader.
+    TaskFunction m_function;
+    void *m_context;
+    /// Atomic since threads check it before claiming a task.
+    std::atomic<size_t> m_count;
+
+    /// Job number (high 32 bits) and next task index (low 32 bits).
+    /**
+     * A thread claims a task with a compare-and-swap, which fails if a
+     * new job has been started in the meantime.  So a thread that is
+     * slow to notice the end of one job can never claim a task from
+     * the next with the wrong function.
+     *
+     * While run() sets up a job, the task index is all ones, which is
+     * never less than m_count, so no task can be claimed until task 0
+     * is opened.
+     */
+    std::atomic<uint64_t> m_next;
+    /// Number of tasks finished in the current job.
+    std::atomic<size_t> m_finished;
+};
+
+
+}
+
+#endif
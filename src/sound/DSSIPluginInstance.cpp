@@ -58,6 +58,7 @@ DSSIPluginInstance::DSSIPluginInstance(PluginFactory *factory,
         m_descriptor(descriptor),
         m_programCacheValid(false),
         m_eventBuffer(EVENT_BUFFER_SIZE),
+        m_localEventBuffer(EVENT_BUFFER_SIZE),
         m_blockSize(blockSize),
         m_idealChannelCount(idealChannelCount),
         m_sampleRate(sampleRate),
@@ -114,6 +115,7 @@ DSSIPluginInstance::DSSIPluginInstance(PluginFactory *factory,
         m_position(position),
         m_descriptor(descriptor),
         m_eventBuffer(EVENT_BUFFER_SIZE),
+        m_localEventBuffer(EVENT_BUFFER_SIZE),
         m_blockSize(blockSize),
         m_inputBuffers(inputBuffers),
         m_outputBuffers(outputBuffers),
@@ -874,7 +876,7 @@ DSSIPluginInstance::handleController(snd_seq_event_t *ev)
 void
 DSSIPluginInstance::run(const RealTime &blockTime)
 {
-    static snd_seq_event_t localEventBuffer[EVENT_BUFFER_SIZE];
+    snd_seq_event_t *localEventBuffer = m_localEventBuffer.data();
     int evCount = 0;
     unsigned int evDeferred = 0;
 
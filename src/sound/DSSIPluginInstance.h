@@ -71,7 +71,7 @@ public:
     void discardEvents() override;
     void setIdealChannelCount(size_t channels) override; // may re-instantiate
 
-    virtual bool isInGroup() const { return m_grouped; }
+    bool isInGroup() const override { return m_grouped; }
     virtual void detachFromGroup();
 
 protected:
@@ -148,6 +148,9 @@ protected:
     bool m_programCacheValid;
 
     RingBuffer<snd_seq_event_t> m_eventBuffer;
+    // Events for the current block, handed to run_synth().  Per
+    // instance so that instruments can be processed concurrently.
+    std::vector<snd_seq_event_t> m_localEventBuffer;
 
     size_t                    m_blockSize;
     sample_t                **m_inputBuffers;
@@ -19,6 +19,7 @@
 #include "AlsaDriver.h"
 #include "MappedStudio.h"
 #include "AudioProcess.h"
+#include "MixKernels.h"
 #include "base/Profiler.h"
 #include "base/AudioLevel.h"
 #include "Audit.h"
@@ -32,6 +33,8 @@
 #include <QSettings>
 #include <QtGlobal>
 
+#include <sys/time.h>
+
 #ifdef HAVE_ALSA
 #ifdef HAVE_LIBJACK
 
@@ -48,6 +51,14 @@ static unsigned long framesThisPlay = 0;
 static RealTime startTime;
 #endif
 
+namespace
+{
+    TraceCounter xRunCount("JackDriver xruns");
+    TraceCounter cpuOverloadCount("JackDriver CPU overloads");
+    TraceCounter bussMixUnderrunCount("JackDriver buss mix underruns");
+    TraceCounter mixUnderrunCount("JackDriver instrument mix underruns");
+}
+
 JackDriver::JackDriver(AlsaDriver *alsaDriver) :
         m_client(nullptr),
         m_bufferSize(0),
@@ -252,6 +263,7 @@ JackDriver::initialise(bool reinitialise)
 
     // set callbacks
     //
+    jack_set_thread_init_callback(m_client, jackThreadInit, this);
     jack_set_process_callback(m_client, jackProcessStatic, this);
     jack_set_buffer_size_callback(m_client, jackBufferSize, this);
     jack_set_sample_rate_callback(m_client, jackSampleRate, this);
@@ -281,6 +293,11 @@ JackDriver::initialise(bool reinitialise)
         RG_DEBUG << "initialise() - creating disk thread...";
         AUDIT << "Creating audio file thread...\n";
 
+        // Pick the mixing kernels here rather than in an audio thread.
+        RG_DEBUG << "initialise() - using" <<
+            MixKernels::getImplementationName(MixKernels::getImplementation()) <<
+            "mixing kernels";
+
         m_fileReader = new AudioFileReader(m_alsaDriver, m_sampleRate);
         m_fileWriter = new AudioFileWriter(m_alsaDriver, m_sampleRate);
         m_instrumentMixer = new AudioInstrumentMixer
@@ -780,6 +797,14 @@ JackDriver::getMaximumPlayLatency() const
     return m_maxInstrumentLatency;
 }
 
+void
+JackDriver::jackThreadInit(void * /*arg*/)
+{
+    // Called on the process thread before it runs any callbacks, so
+    // that jackProcess() can trace without allocating.
+    Trace::setThreadName("JACK process");
+}
+
 int
 JackDriver::jackProcessStatic(jack_nframes_t nframes, void *arg)
 {
@@ -824,9 +849,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
 #ifdef DEBUG_JACK_PROCESS
     Profiler profiler("jackProcess", true);
 #else
-  #ifdef DEBUG_JACK_XRUN
-    Profiler profiler("jackProcess", false);
-  #endif
+    RG_TRACE_SCOPE("jackProcess");
 #endif
 
     if (lowLatencyMode) {
@@ -860,6 +883,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
         //     values on different systems.  Those values do not
         //     necessarily reflect CPU usage.
         if (jack_cpu_load(m_client) > 97.0) {
+            cpuOverloadCount.increment();
             reportFailure(MappedEvent::FailureCPUOverload);
             return jackProcessEmpty(nframes);
         }
@@ -868,9 +892,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
 #ifdef DEBUG_JACK_PROCESS
     Profiler profiler2("jackProcess post mix", true);
 #else
-  #ifdef DEBUG_JACK_XRUN
-    Profiler profiler2("jackProcess post mix", false);
-  #endif
+    RG_TRACE_SCOPE("jackProcess post mix");
 #endif
 
     jack_position_t position;
@@ -998,9 +1020,7 @@ JackDriver::jackProcess(jack_nframes_t nframes)
 #ifdef DEBUG_JACK_PROCESS
     Profiler profiler3("jackProcess post transport", true);
 #else
-  #ifdef DEBUG_JACK_XRUN
-    Profiler profiler3("jackProcess post transport", false);
-  #endif
+    RG_TRACE_SCOPE("jackProcess post transport");
 #endif
 
     InstrumentId synthInstrumentBase;
@@ -1069,14 +1089,11 @@ JackDriver::jackProcess(jack_nframes_t nframes)
             } else {
                 size_t actual = rb->read(submaster[ch], nframes);
                 if (actual < nframes) {
+                    bussMixUnderrunCount.increment();
                     reportFailure(MappedEvent::FailureBussMixUnderrun);
                 }
-                for (size_t i = 0; i < nframes; ++i) {
-                    sample_t sample = submaster[ch][i];
-                    if (sample > peak[ch])
-                        peak[ch] = sample;
-                    master[ch][i] += sample;
-                }
+                peak[ch] = MixKernels::peak(submaster[ch], nframes);
+                MixKernels::mixAdd(master[ch], submaster[ch], nframes);
             }
         }
 
@@ -1184,16 +1201,13 @@ JackDriver::jackProcess(jack_nframes_t nframes)
 
                 if (actual < nframes) {
                     RG_WARNING << "jackProcess(): WARNING: read " << actual << " of " << nframes << " frames for " << id << " ch " << ch << " (pl " << playing << ", cl " << clocksRunning << ", aa " << asyncAudio << ")";
+                    mixUnderrunCount.increment();
                     reportFailure(MappedEvent::FailureMixUnderrun);
                 }
 
-                for (size_t f = 0; f < nframes; ++f) {
-                    sample_t sample = instrument[ch][f];
-                    if (sample > peak[ch])
-                        peak[ch] = sample;
-                    if (directToMaster)
-                        master[ch][f] += sample;
-                }
+                peak[ch] = MixKernels::peak(instrument[ch], nframes);
+                if (directToMaster)
+                    MixKernels::mixAdd(master[ch], instrument[ch], nframes);
             }
 
             // If the instrument is connected straight to master we
@@ -1233,12 +1247,8 @@ JackDriver::jackProcess(jack_nframes_t nframes)
     float masterPeak[2] = { 0.0, 0.0 };
 
     for (int ch = 0; ch < 2; ++ch) {
-        for (size_t i = 0; i < nframes; ++i) {
-            sample_t sample = master[ch][i] * gain;
-            if (sample > masterPeak[ch])
-                masterPeak[ch] = sample;
-            master[ch][i] = sample;
-        }
+        MixKernels::gain(master[ch], nframes, gain);
+        masterPeak[ch] = MixKernels::peak(master[ch], nframes);
     }
 
     LevelInfo info;
@@ -1349,10 +1359,7 @@ JackDriver::jackProcessRecord(InstrumentId id,
 #ifdef DEBUG_JACK_PROCESS
     Profiler profiler("jackProcessRecord", true);
 #else
-#ifdef DEBUG_JACK_XRUN
-
-    Profiler profiler("jackProcessRecord", false);
-#endif
+    RG_TRACE_SCOPE("jackProcessRecord");
 #endif
 
     bool wroteSomething = false;
@@ -1885,6 +1892,8 @@ JackDriver::jackXRun(void *arg)
     Profiles::getInstance()->dump();
 #endif
 
+    xRunCount.increment();
+
     // Report to GUI
     //
     JackDriver *inst = static_cast<JackDriver*>(arg);
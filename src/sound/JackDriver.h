@@ -194,6 +194,7 @@ public:
 protected:
 
     // static methods for JACK process thread:
+    static void  jackThreadInit(void *arg);
     static int   jackProcessStatic(jack_nframes_t nframes, void *arg);
     static int   jackBufferSize(jack_nframes_t nframes, void *arg);
     static int   jackSampleRate(jack_nframes_t nframes, void *arg);
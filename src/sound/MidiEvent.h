@@ -18,6 +18,8 @@
 #include "Midi.h"
 #include "base/Event.h"
 
+#include <rosegardenprivate_export.h>
+
 namespace Rosegarden
 {
 
@@ -34,7 +36,7 @@ namespace Rosegarden
  * Rosegarden doesn't have any internal concept of MIDI events, only
  * the Event class which offers a superset of MIDI functionality.
  */
-class MidiEvent
+class ROSEGARDENPRIVATE_EXPORT MidiEvent
 {
 
 public:
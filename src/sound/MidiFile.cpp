@@ -38,12 +38,24 @@
 #include "sound/MidiInserter.h"
 #include "sound/SortingInserter.h"
 
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QProgressDialog>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <string>
 #include <sstream>
 
+#include <string.h>
+
 static const char MIDI_FILE_HEADER[] = "MThd";
 static const char MIDI_TRACK_HEADER[] = "MTrk";
 
@@ -57,11 +69,7 @@ MidiFile::MidiFile() :
     m_timingFormat(MIDI_TIMING_PPQ_TIMEBASE),
     m_timingDivision(0),
     m_fps(0),
-    m_subframes(0),
-    m_fileSize(0),
-    m_trackByteCount(0),
-    m_decrementCount(false),
-    m_bytesRead(0)
+    m_subframes(0)
 {
 }
 
@@ -71,174 +79,160 @@ MidiFile::~MidiFile()
     clearMidiComposition();
 }
 
-long
-MidiFile::midiBytesToLong(const std::string &bytes)
-{
-    if (bytes.length() != 4) {
-        RG_WARNING << "midiBytesToLong(): WARNING: Wrong length for long data (" << bytes.length() << ", should be 4)";
-
-        // TRANSLATOR: "long" is a C++ data type
-        throw Exception(qstrtostr(tr("Wrong length for long data in MIDI stream")));
-    }
-
-    long longRet = static_cast<long>(static_cast<MidiByte>(bytes[0])) << 24 |
-                   static_cast<long>(static_cast<MidiByte>(bytes[1])) << 16 |
-                   static_cast<long>(static_cast<MidiByte>(bytes[2])) << 8 |
-                   static_cast<long>(static_cast<MidiByte>(bytes[3]));
-
-    RG_DEBUG << "midiBytesToLong(" << static_cast<long>(static_cast<MidiByte>(bytes[0])) << "," << static_cast<long>(static_cast<MidiByte>(bytes[1])) << "," << static_cast<long>(static_cast<MidiByte>(bytes[2])) << "," << static_cast<long>(static_cast<MidiByte>(bytes[3])) << ") -> " << longRet;
-
-    return longRet;
-}
-
-int
-MidiFile::midiBytesToInt(const std::string &bytes)
-{
-    if (bytes.length() != 2) {
-        RG_WARNING << "midiBytesToInt(): WARNING: Wrong length for int data (" << bytes.length() << ", should be 2)";
-
-        // TRANSLATOR: "int" is a C++ data type
-        throw Exception(qstrtostr(tr("Wrong length for int data in MIDI stream")));
-    }
-
-    return static_cast<int>(static_cast<MidiByte>(bytes[0])) << 8 |
-           static_cast<int>(static_cast<MidiByte>(bytes[1]));
-}
-
-MidiByte
-MidiFile::read(std::ifstream *midiFile)
-{
-    return static_cast<MidiByte>(read(midiFile, 1)[0]);
-}
-
-std::string
-MidiFile::read(std::ifstream *midiFile, unsigned long numberOfBytes)
+namespace
 {
-    if (midiFile->eof()) {
-        RG_WARNING << "read(): MIDI file EOF - got 0 bytes out of " << numberOfBytes;
-
-        throw Exception(qstrtostr(tr("End of MIDI file encountered while reading")));
+    unsigned long readLong(const MidiByte *bytes)
+    {
+        return static_cast<unsigned long>(bytes[0]) << 24 |
+               static_cast<unsigned long>(bytes[1]) << 16 |
+               static_cast<unsigned long>(bytes[2]) << 8 |
+               static_cast<unsigned long>(bytes[3]);
     }
 
-    // For each track section we can read only m_trackByteCount bytes.
-    if (m_decrementCount  &&
-        numberOfBytes > static_cast<unsigned long>(m_trackByteCount)) {
-
-        RG_WARNING << "read(): Attempt to get more bytes than allowed on Track (" << numberOfBytes << " > " << m_trackByteCount << ")";
-
-        throw Exception(qstrtostr(tr("Attempt to get more bytes than expected on Track")));
+    int readInt(const MidiByte *bytes)
+    {
+        return static_cast<int>(bytes[0]) << 8 |
+               static_cast<int>(bytes[1]);
     }
 
-    char fileMidiByte;
-    std::string stringRet;
-
-    // ??? Reading one byte at a time is terribly slow.  However, this
-    //     routine is usually called with numberOfBytes == 1.
-    while (stringRet.length() < numberOfBytes  &&
-           midiFile->read(&fileMidiByte, 1)) {
-        stringRet += fileMidiByte;
-
-        // Kick the event loop to make sure the UI doesn't become
-        // unresponsive during a long load.
-        qApp->processEvents();
-    }
-
-    // Unexpected EOF
-    if (stringRet.length() < numberOfBytes) {
-        RG_WARNING << "read(): Attempt to read past file end - got " << stringRet.length() << " bytes out of " << numberOfBytes;
-
-        throw Exception(qstrtostr(tr("Attempt to read past MIDI file end")));
-    }
-
-    if (m_decrementCount)
-        m_trackByteCount -= numberOfBytes;
-
-    m_bytesRead += numberOfBytes;
-
-    // Every 2000 bytes...
-    if (m_bytesRead >= 2000) {
-        m_bytesRead = 0;
+    /// Reads a MIDI file track chunk held in memory, front to back.
+    class TrackReader
+    {
+    public:
+        /// size is the chunk's length according to its header, and
+        /// available is how much of it is actually there.
+        TrackReader(const MidiByte *data, size_t size, size_t available) :
+            m_data(data),
+            m_size(size),
+            m_available(available),
+            m_pos(0)
+        { }
+
+        /// Bytes left in the chunk according to its header.
+        size_t remaining() const  { return m_size - m_pos; }
+
+        MidiByte readByte()
+        {
+            if (m_pos >= m_available)
+                overrun(1);
+            return m_data[m_pos++];
+        }
 
-        // Update the progress dialog if one is connected.
-        if (m_progressDialog) {
-            if (m_progressDialog->wasCanceled())
-                throw Exception(qstrtostr(tr("Cancelled by user")));
+        /// Read a "variable-length quantity".
+        /**
+         * In case the first byte has already been read, it can be sent
+         * in as firstByte.
+         */
+        unsigned long readNumber(int firstByte = -1)
+        {
+            unsigned long value = (firstByte >= 0) ?
+                    static_cast<MidiByte>(firstByte) : readByte();
+
+            // See MIDI spec section 4, pages 2 and 11.
+
+            // Most are a single byte.
+            if (!(value & 0x80))
+                return value;
+            value &= 0x7F;
+
+            // There are at most three more.  If they're all there,
+            // there's no need to check for the end before each one.
+            if (m_available - m_pos >= 3) {
+                const MidiByte *bytes = m_data + m_pos;
+                value = (value << 7) | (bytes[0] & 0x7F);
+                if (!(bytes[0] & 0x80)) {
+                    m_pos += 1;
+                    return value;
+                }
+                value = (value << 7) | (bytes[1] & 0x7F);
+                if (!(bytes[1] & 0x80)) {
+                    m_pos += 2;
+                    return value;
+                }
+                value = (value << 7) | (bytes[2] & 0x7F);
+                m_pos += 3;
+                if (!(bytes[2] & 0x80))
+                    return value;
+            }
 
-            // This is the first 20% of the "reading" process.
-            int progressValue = static_cast<int>(
-                    static_cast<double>(midiFile->tellg()) /
-                    static_cast<double>(m_fileSize) * 20.0);
+            // Near the end of the data, or too long to be valid.
+            MidiByte midiByte;
+            do {
+                midiByte = readByte();
+                value = (value << 7) | (midiByte & 0x7F);
+            } while (midiByte & 0x80);
 
-            m_progressDialog->setValue(progressValue);
+            return value;
         }
-    }
-
-    return stringRet;
-}
 
-long
-MidiFile::readNumber(std::ifstream *midiFile, int firstByte)
-{
-    if (midiFile->eof())
-        return 0;
+        std::string readString(size_t length)
+        {
+            if (length > m_available - m_pos)
+                overrun(length);
+            std::string result(reinterpret_cast<const char *>(m_data + m_pos),
+                               length);
+            m_pos += length;
+            return result;
+        }
 
-    MidiByte midiByte;
+    private:
+        [[noreturn]] void overrun(size_t wanted) const
+        {
+            // For each track section we can read only m_size bytes.
+            if (wanted > m_size - m_pos) {
+                RG_WARNING << "TrackReader: Attempt to get more bytes than allowed on Track (" << wanted << " > " << m_size - m_pos << ")";
 
-    // If we already have the first byte, use it
-    if (firstByte >= 0) {
-        midiByte = static_cast<MidiByte>(firstByte);
-    } else {  // read it
-        midiByte = read(midiFile);
-    }
+                throw Exception(qstrtostr(MidiFile::tr("Attempt to get more bytes than expected on Track")));
+            }
 
-    long longRet = midiByte;
+            RG_WARNING << "TrackReader: Attempt to read past file end - got " << m_available - m_pos << " bytes out of " << wanted;
 
-    // See MIDI spec section 4, pages 2 and 11.
+            throw Exception(qstrtostr(MidiFile::tr("Attempt to read past MIDI file end")));
+        }
 
-    if (midiByte & 0x80) {
-        longRet &= 0x7F;
-        do {
-            midiByte = read(midiFile);
-            longRet = (longRet << 7) + (midiByte & 0x7F);
-        } while (!midiFile->eof() && (midiByte & 0x80));
-    }
+        const MidiByte *m_data;
+        size_t m_size;
+        size_t m_available;
+        size_t m_pos;
+    };
+
+    /// Parses a track chunk on one of QThreadPool's threads.
+    class TrackTask : public QRunnable
+    {
+    public:
+        explicit TrackTask(const std::function<void ()> &function) :
+            m_function(function),
+            m_done(false)
+        {
+            // We wait for it, then delete it.
+            setAutoDelete(false);
+        }
 
-    return longRet;
-}
+        void run() override
+        {
+            m_function();
 
-void
-MidiFile::findNextTrack(std::ifstream *midiFile)
-{
-    // Conforms to recommendation in the MIDI spec, section 4, page 3:
-    // "Your programs should /expect/ alien chunks and treat them as if
-    // they weren't there."  (Emphasis theirs.)
-
-    // Assume not found.
-    m_decrementCount = false;
-    m_trackByteCount = -1;
-
-    // For each chunk
-    while (!midiFile->eof()) {
-        // Read the chunk type and size.
-        std::string chunkType = read(midiFile, 4);
-        long chunkSize = midiBytesToLong(read(midiFile, 4));
-
-        // If we've found a track chunk
-        if (chunkType.compare(0, 4, MIDI_TRACK_HEADER) == 0) {
-            m_trackByteCount = chunkSize;
-            m_decrementCount = true;
-            return;
+            QMutexLocker locker(&m_mutex);
+            m_done = true;
+            m_finished.wakeAll();
         }
 
-        RG_DEBUG << "findNextTrack(): skipping alien chunk.  Type:" << chunkType;
+        /// Wait for run() to finish.
+        void wait()
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_done) {
+                m_finished.wait(&m_mutex);
+            }
+        }
 
-        // Alien chunk encountered, initiate evasive maneuvers (skip it).
-        midiFile->seekg(chunkSize, std::ios::cur);
-    }
+    private:
+        std::function<void ()> m_function;
 
-    // Track not found.
-    RG_WARNING << "findNextTrack(): Couldn't find Track";
-    throw Exception(qstrtostr(tr("File corrupted or in non-standard format")));
+        QMutex m_mutex;
+        QWaitCondition m_finished;
+        bool m_done;
+    };
 }
 
 bool
@@ -248,41 +242,106 @@ MidiFile::read(const QString &filename)
 
     clearMidiComposition();
 
-    // Open the file
-    std::ifstream *midiFile =
-            new std::ifstream(filename.toLocal8Bit(),
-                              std::ios::in | std::ios::binary);
-
-    if (!(*midiFile)) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
         m_error = "File not found or not readable.";
         m_format = MIDI_FILE_NOT_LOADED;
         return false;
     }
 
-    // Compute the file size so we can report progress.
-    midiFile->seekg(0, std::ios::end);
-    m_fileSize = midiFile->tellg();
-    midiFile->seekg(0, std::ios::beg);
+    // Map the file if we can, otherwise read it all in.  Either way,
+    // it stays in memory until we've parsed it.
+    size_t size = file.size();
+    const MidiByte *data = nullptr;
+    QByteArray contents;
+    if (size > 0)
+        data = file.map(0, size);
+    if (!data) {
+        contents = file.readAll();
+        data = reinterpret_cast<const MidiByte *>(contents.constData());
+        size = contents.size();
+    }
+
+    std::vector<ParsedTrack> parsedTracks;
 
     // The parsing process throws string exceptions back up here if we
     // run into trouble which we can then pass back out to whomever
     // called us using m_error and a nice bool.
     try {
         // Parse the MIDI header first.
-        parseHeader(midiFile);
+        size_t pos = parseHeader(data, size);
 
-        // For each track chunk in the MIDI file.
-        for (unsigned track = 0; track < m_numberOfTracks; ++track) {
+        // A track chunk, after its type and size.
+        struct Chunk
+        {
+            size_t offset;
+            size_t size;
+            size_t available;
+        };
+        std::vector<Chunk> chunks;
+
+        // Find the track chunks.  Conforms to recommendation in the MIDI
+        // spec, section 4, page 3: "Your programs should /expect/ alien
+        // chunks and treat them as if they weren't there."  (Emphasis
+        // theirs.)
+        while (chunks.size() < m_numberOfTracks) {
+            if (size - pos < 8) {
+                RG_WARNING << "read(): Couldn't find Track";
+                throw Exception(qstrtostr(tr("File corrupted or in non-standard format")));
+            }
 
-            RG_DEBUG << "read(): Parsing MIDI file track " << track;
+            const MidiByte *chunkType = data + pos;
+            const size_t chunkSize = readLong(data + pos + 4);
+            pos += 8;
+            const size_t available = std::min(chunkSize, size - pos);
 
-            // Skip any alien chunks.
-            findNextTrack(midiFile);
+            if (memcmp(chunkType, MIDI_TRACK_HEADER, 4) == 0) {
+                RG_DEBUG << "read(): Track" << chunks.size() << "has" << chunkSize << "bytes";
+                chunks.push_back(Chunk{pos, chunkSize, available});
+            } else {
+                RG_DEBUG << "read(): skipping alien chunk.  Type:" << std::string(reinterpret_cast<const char *>(chunkType), 4);
+            }
 
-            RG_DEBUG << "read(): Track has " << m_trackByteCount << " bytes";
+            pos += available;
+        }
+
+        if (m_progressDialog  &&  m_progressDialog->wasCanceled())
+            throw Exception(qstrtostr(tr("Cancelled by user")));
+
+        // Each track is parsed on its own.  We do the first one while
+        // the pool does the rest.
+        parsedTracks.resize(chunks.size());
+
+        auto parse = [data, &chunks, &parsedTracks](size_t track) {
+            const Chunk &chunk = chunks[track];
+            try {
+                parseTrack(data + chunk.offset, chunk.size, chunk.available,
+                           parsedTracks[track]);
+            } catch (const Exception &e) {
+                parsedTracks[track].error = e.getMessage();
+            }
+        };
+
+        QThreadPool *pool = QThreadPool::globalInstance();
+        std::vector<std::unique_ptr<TrackTask> > tasks;
 
-            // Read the track into m_midiComposition.
-            parseTrack(midiFile);
+        for (size_t track = 1; track < chunks.size(); ++track) {
+            tasks.emplace_back(new TrackTask([&parse, track]() {
+                parse(track);
+            }));
+            pool->start(tasks.back().get());
+        }
+
+        if (!chunks.empty())
+            parse(0);
+
+        for (const std::unique_ptr<TrackTask> &task : tasks) {
+            task->wait();
+        }
+
+        for (const ParsedTrack &parsedTrack : parsedTracks) {
+            if (!parsedTrack.error.empty())
+                throw Exception(parsedTrack.error);
         }
 
     } catch (const Exception &e) {
@@ -293,32 +352,42 @@ MidiFile::read(const QString &filename)
         return false;
     }
 
-    midiFile->close();
+    // Number the m_midiComposition tracks in file order.
+    for (ParsedTrack &parsedTrack : parsedTracks) {
+        for (size_t i = 0; i < parsedTrack.tracks.size(); ++i) {
+            const TrackId trackId = m_midiComposition.size();
+            m_midiComposition[trackId].swap(parsedTrack.tracks[i]);
+            if (parsedTrack.channels[i] >= 0)
+                m_trackChannelMap[trackId] = parsedTrack.channels[i];
+            m_trackNames.push_back(parsedTrack.name);
+        }
+    }
+
+    // This is the first 20% of the "reading" process.
+    if (m_progressDialog)
+        m_progressDialog->setValue(20);
 
     return true;
 }
 
-void
-MidiFile::parseHeader(std::ifstream *midiFile)
+size_t
+MidiFile::parseHeader(const MidiByte *data, size_t size)
 {
     // The basic MIDI header is 14 bytes.
-    std::string midiHeader = read(midiFile, 14);
-
-    if (midiHeader.size() < 14) {
+    if (size < 14) {
         RG_WARNING << "parseHeader() - file header undersized";
         throw Exception(qstrtostr(tr("Not a MIDI file")));
     }
 
-    if (midiHeader.compare(0, 4, MIDI_FILE_HEADER) != 0) {
+    if (memcmp(data, MIDI_FILE_HEADER, 4) != 0) {
         RG_WARNING << "parseHeader() - file header not found or malformed";
         throw Exception(qstrtostr(tr("Not a MIDI file")));
     }
 
-    long chunkSize = midiBytesToLong(midiHeader.substr(4, 4));
-    m_format = static_cast<FileFormatType>(
-            midiBytesToInt(midiHeader.substr(8, 2)));
-    m_numberOfTracks = midiBytesToInt(midiHeader.substr(10, 2));
-    m_timingDivision = midiBytesToInt(midiHeader.substr(12, 2));
+    const size_t chunkSize = readLong(data + 4);
+    m_format = static_cast<FileFormatType>(readInt(data + 8));
+    m_numberOfTracks = readInt(data + 10);
+    m_timingDivision = readInt(data + 12);
     m_timingFormat = MIDI_TIMING_PPQ_TIMEBASE;
 
     if (m_format == MIDI_SEQUENTIAL_TRACK_FILE) {
@@ -339,46 +408,51 @@ MidiFile::parseHeader(std::ifstream *midiFile)
         // MIDI spec section 4, page 5: "[...] more parameters may be
         // added to the MThd chunk in the future: it is important to
         // read and honor the length, even if it is longer than 6."
-        midiFile->seekg(chunkSize - 6, std::ios::cur);
+        return 14 + std::min(chunkSize - 6, size - 14);
     }
+
+    return 14;
 }
 
 static const std::string defaultTrackName = "Imported MIDI";
 
 void
-MidiFile::parseTrack(std::ifstream *midiFile)
+MidiFile::parseTrack(const MidiByte *data, size_t size, size_t available,
+                     ParsedTrack &parsedTrack)
 {
     // The term "Track" is overloaded in this routine.  The first
     // meaning is a track in the MIDI file.  That is what this routine
     // processes.  A single track from a MIDI file.  The second meaning
-    // is a track in m_midiComposition.  This is the most common usage.
-    // To improve clarity, "MIDI file track" will be used to refer to
-    // the first sense of the term.  Occasionally, "m_midiComposition
-    // track" will be used to refer to the second sense.
+    // is one of parsedTrack.tracks, which become tracks in
+    // m_midiComposition.  This is the most common usage.  To improve
+    // clarity, "MIDI file track" will be used to refer to the first
+    // sense of the term.
+
+    TrackReader reader(data, size, available);
 
     // Absolute time of the last event on any track.
     unsigned long eventTime = 0;
 
-    // lastTrackNum is the track for all events provided they're
-    // all on the same channel.  If we find events on more than one
-    // channel, we increment lastTrackNum and record the mapping from
-    // channel to trackNum in channelToTrack.
-    TrackId lastTrackNum = m_midiComposition.size();
+    std::vector<MidiTrack> &tracks = parsedTrack.tracks;
 
-    // MIDI channel to m_midiComposition track.
-    // Note: This would be a vector<TrackId> but TrackId is unsigned
-    //       and we need -1 to indicate "not yet used"
+    // The first track is for all events provided they're all on the
+    // same channel.  If we find events on more than one channel, we
+    // add a track for each further channel and record the mapping from
+    // channel to track in channelToTrack.
+    tracks.resize(1);
+    parsedTrack.channels.assign(1, -1);
+
+    // MIDI channel to index in tracks, -1 if not yet used.
     std::vector<int> channelToTrack(16, -1);
 
     // This is used to store the last absolute time found on each track,
     // allowing us to modify delta-times correctly when separating events
     // out from one to multiple tracks
-    std::map<int /*track*/, unsigned long /*lastTime*/> lastEventTime;
-    lastEventTime[lastTrackNum] = 0;
+    std::vector<unsigned long> lastEventTime(1, 0);
 
     // Meta-events don't have a channel, so we place them in a fixed
-    // track number instead
-    TrackId metaTrack = lastTrackNum;
+    // track instead
+    const size_t metaTrack = 0;
 
     std::string trackName = defaultTrackName;
     std::string instrumentName;
@@ -388,17 +462,15 @@ MidiFile::parseTrack(std::ifstream *midiFile)
 
     bool firstTrack = true;
 
-    RG_DEBUG << "parseTrack(): last track number is " << lastTrackNum;
-
     // While there is still data to read in the MIDI file track.
-    // Why "m_trackByteCount > 1" instead of "m_trackByteCount > 0"?  Since
+    // Why "remaining() > 1" instead of "remaining() > 0"?  Since
     // no event and its associated delta time can fit in just one
     // byte, a single remaining byte in the MIDI file track has to be padding.
     // This is obscure and non-standard, but such files do exist; ordinarily
     // there should be no bytes in the MIDI file track after the last event.
-    while (!midiFile->eof()  &&  m_trackByteCount > 1) {
+    while (reader.remaining() > 1) {
 
-        unsigned long deltaTime = readNumber(midiFile);
+        unsigned long deltaTime = reader.readNumber();
 
         RG_DEBUG << "parseTrack(): read delta time " << deltaTime;
 
@@ -406,7 +478,7 @@ MidiFile::parseTrack(std::ifstream *midiFile)
         eventTime += deltaTime;
 
         // Get a single byte
-        MidiByte midiByte = read(midiFile);
+        MidiByte midiByte = reader.readByte();
 
         MidiByte statusByte = 0;
         MidiByte data1 = 0;
@@ -416,7 +488,7 @@ MidiFile::parseTrack(std::ifstream *midiFile)
             RG_DEBUG << "parseTrack(): have new status byte" << QString("0x%1").arg(midiByte, 0, 16);
 
             statusByte = midiByte;
-            data1 = read(midiFile);
+            data1 = reader.readByte();
         } else {  // Use running status.
             // If we haven't seen a status byte yet, fail.
             if (runningStatus < 0)
@@ -431,11 +503,11 @@ MidiFile::parseTrack(std::ifstream *midiFile)
         if (statusByte == MIDI_FILE_META_EVENT) {
 
             MidiByte metaEventCode = data1;
-            unsigned messageLength = readNumber(midiFile);
+            unsigned long messageLength = reader.readNumber();
 
             RG_DEBUG << "parseTrack(): Meta event of type " << QString("0x%1").arg(metaEventCode, 0, 16) << " and " << messageLength << " bytes found";
 
-            std::string metaMessage = read(midiFile, messageLength);
+            std::string metaMessage = reader.readString(messageLength);
 
             // Compute the difference between this event and the previous
             // event on this track.
@@ -443,18 +515,17 @@ MidiFile::parseTrack(std::ifstream *midiFile)
             // Store the absolute time of the last event on this track.
             lastEventTime[metaTrack] = eventTime;
 
-            // create and store our event
-            MidiEvent *e = new MidiEvent(deltaTime,
-                                         MIDI_FILE_META_EVENT,
-                                         metaEventCode,
-                                         metaMessage);
-            m_midiComposition[metaTrack].push_back(e);
-
             if (metaEventCode == MIDI_TRACK_NAME)
                 trackName = metaMessage;
             else if (metaEventCode == MIDI_INSTRUMENT_NAME)
                 instrumentName = metaMessage;
 
+            // create and store our event
+            tracks[metaTrack].push_back(MidiEvent(deltaTime,
+                                                  MIDI_FILE_META_EVENT,
+                                                  metaEventCode,
+                                                  metaMessage));
+
             // Get the next event.
             continue;
         }
@@ -465,43 +536,26 @@ MidiFile::parseTrack(std::ifstream *midiFile)
 
         // If this channel hasn't been seen yet in this MIDI file track
         if (channelToTrack[channel] == -1) {
-            // If this is the first m_midiComposition track we've
-            // used
+            // If this is the first track we've used
             if (firstTrack) {
-                // We've already allocated an m_midiComposition track for
-                // the first channel we encounter.  Use it.
+                // We've already allocated a track for the first channel
+                // we encounter.  Use it.
                 firstTrack = false;
             } else {  // We need a new track.
                 // Allocate a new track for this channel.
-                ++lastTrackNum;
-                lastEventTime[lastTrackNum] = 0;
+                tracks.emplace_back();
+                parsedTrack.channels.push_back(-1);
+                lastEventTime.push_back(0);
             }
 
-            RG_DEBUG << "parseTrack(): new channel map entry: channel " << channel << " -> track " << lastTrackNum;
+            RG_DEBUG << "parseTrack(): new channel map entry: channel " << channel << " -> track " << tracks.size() - 1;
 
-            channelToTrack[channel] = lastTrackNum;
-            m_trackChannelMap[lastTrackNum] = channel;
+            channelToTrack[channel] = tracks.size() - 1;
+            parsedTrack.channels.back() = channel;
         }
 
-        TrackId trackNum = channelToTrack[channel];
-
-#ifdef DEBUG
-        {
-            static int prevTrackNum = -1;
-            static int prevChannel = -1;
-
-            // If we're on a different track or channel
-            if (prevTrackNum != static_cast<int>(trackNum)  ||
-                prevChannel != channel) {
-
-                // Report it for debugging.
-                RG_DEBUG << "parseTrack(): track number for channel " << channel << " is " << trackNum;
-
-                prevTrackNum = trackNum;
-                prevChannel = channel;
-            }
-        }
-#endif
+        const size_t trackNum = channelToTrack[channel];
+        MidiTrack &track = tracks[trackNum];
 
         // Compute the difference between this event and the previous
         // event on this track.
@@ -516,16 +570,14 @@ MidiFile::parseTrack(std::ifstream *midiFile)
         case MIDI_CTRL_CHANGE:
         case MIDI_PITCH_BEND:
             {
-                MidiByte data2 = read(midiFile);
+                MidiByte data2 = reader.readByte();
 
                 // create and store our event
-                MidiEvent *midiEvent =
-                        new MidiEvent(deltaTime, statusByte, data1, data2);
-                m_midiComposition[trackNum].push_back(midiEvent);
+                track.push_back(MidiEvent(deltaTime, statusByte, data1, data2));
 
                 if (statusByte != MIDI_PITCH_BEND) {
                     RG_DEBUG << "parseTrack(): MIDI event for channel " << channel + 1 << " (track " << trackNum << ')';
-                    RG_DEBUG << *midiEvent;
+                    RG_DEBUG << track.back();
                 }
             }
             break;
@@ -536,35 +588,32 @@ MidiFile::parseTrack(std::ifstream *midiFile)
                 RG_DEBUG << "parseTrack(): Program change (Cn) or channel aftertouch (Dn): time " << deltaTime << ", code " << QString("0x%1").arg(statusByte, 0, 16) << ", data " << (int) data1  << " going to track " << trackNum;
 
                 // create and store our event
-                MidiEvent *midiEvent =
-                        new MidiEvent(deltaTime, statusByte, data1);
-                m_midiComposition[trackNum].push_back(midiEvent);
+                track.push_back(MidiEvent(deltaTime, statusByte, data1));
             }
             break;
 
         case MIDI_SYSTEM_EXCLUSIVE:
             {
-                unsigned messageLength = readNumber(midiFile, data1);
+                unsigned long messageLength = reader.readNumber(data1);
 
                 RG_DEBUG << "parseTrack(): SysEx of " << messageLength << " bytes found";
 
-                std::string sysex = read(midiFile, messageLength);
+                std::string sysex = reader.readString(messageLength);
 
-                if (MidiByte(sysex[sysex.length() - 1]) !=
+                if (sysex.empty()  ||
+                    MidiByte(sysex[sysex.length() - 1]) !=
                         MIDI_END_OF_EXCLUSIVE) {
                     RG_WARNING << "parseTrack() - malformed or unsupported SysEx type";
                     continue;
                 }
 
                 // Chop off the EOX.
-                sysex = sysex.substr(0, sysex.length() - 1);
+                sysex.resize(sysex.length() - 1);
 
                 // create and store our event
-                MidiEvent *midiEvent =
-                        new MidiEvent(deltaTime,
-                                      MIDI_SYSTEM_EXCLUSIVE,
-                                      sysex);
-                m_midiComposition[trackNum].push_back(midiEvent);
+                track.push_back(MidiEvent(deltaTime,
+                                          MIDI_SYSTEM_EXCLUSIVE,
+                                          sysex));
             }
             break;
 
@@ -578,18 +627,10 @@ MidiFile::parseTrack(std::ifstream *midiFile)
         }
     }
 
-    // If the MIDI file track has a padding byte, read and discard it
-    // to make sure that the stream is positioned at the beginning of
-    // the following MIDI file track (if there is one.)
-    if (m_trackByteCount == 1)
-        midiFile->ignore();
-
     if (instrumentName != "")
         trackName += " (" + instrumentName + ")";
 
-    // Fill out the Track Names
-    for (TrackId i = metaTrack; i <= lastTrackNum; ++i)
-        m_trackNames.push_back(trackName);
+    parsedTrack.name = trackName;
 }
 
 bool
@@ -640,12 +681,12 @@ MidiFile::convertToRosegarden(const QString &filename, RosegardenDocument *doc)
             for (MidiTrack::const_iterator midiEvent = m_midiComposition[i].begin();
                  midiEvent != m_midiComposition[i].end();
                  ++midiEvent) {        
-                if ((*midiEvent)->isMeta()) {
+                if (midiEvent->isMeta()) {
                     // If we have a set tempo meta-event
-                    if ((*midiEvent)->getMetaEventCode() == MIDI_SET_TEMPO) {
-                        MidiByte m0 = (*midiEvent)->getMetaMessage()[0];
-                        MidiByte m1 = (*midiEvent)->getMetaMessage()[1];
-                        MidiByte m2 = (*midiEvent)->getMetaMessage()[2];
+                    if (midiEvent->getMetaEventCode() == MIDI_SET_TEMPO) {
+                        MidiByte m0 = midiEvent->getMetaMessage()[0];
+                        MidiByte m1 = midiEvent->getMetaMessage()[1];
+                        MidiByte m2 = midiEvent->getMetaMessage()[2];
                         long tempo = (((m0 << 8) + m1) << 8) + m2;
                         if (tempo != 0) {
                             double qpm = 60000000.0 / double(tempo);
@@ -653,7 +694,7 @@ MidiFile::convertToRosegarden(const QString &filename, RosegardenDocument *doc)
                             // Store the tempo in the tempo map.
                             // ??? Strange.  The event's time is a delta
                             //     time at this point.  Seems wrong.
-                            tempi[(*midiEvent)->getTime()] = rgt;
+                            tempi[midiEvent->getTime()] = rgt;
                         }
                     }
                 }
@@ -721,8 +762,8 @@ MidiFile::convertToRosegarden(const QString &filename, RosegardenDocument *doc)
         for (MidiTrack::iterator eventIter = m_midiComposition[trackId].begin();
              eventIter != m_midiComposition[trackId].end();
              ++eventIter) {
-            absTime += (*eventIter)->getTime();
-            (*eventIter)->setTime(absTime);
+            absTime += eventIter->getTime();
+            eventIter->setTime(absTime);
         }
 
         // Consolidate NOTE ON and NOTE OFF events into NOTE ON events with
@@ -757,16 +798,21 @@ MidiFile::convertToRosegarden(const QString &filename, RosegardenDocument *doc)
         int noteCount = 0;
         int keySigCount = 0;
 
+        // For kicking the event loop.
+        int eventCount = 0;
+
         // For each event on the current track
         // ??? BIG loop.
         for (MidiTrack::const_iterator midiEventIter =
                  m_midiComposition[trackId].begin();
              midiEventIter != m_midiComposition[trackId].end();
              ++midiEventIter) {
-            const MidiEvent &midiEvent = **midiEventIter;
+            const MidiEvent &midiEvent = *midiEventIter;
 
-            // Kick the event loop.
-            qApp->processEvents();
+            // Kick the event loop now and then.  Doing it for every
+            // event would take longer than the conversion itself.
+            if (++eventCount % 1000 == 0)
+                qApp->processEvents();
 
             const timeT midiAbsoluteTime = midiEvent.getTime();
             const timeT midiDuration = midiEvent.getDuration();
@@ -1448,7 +1494,7 @@ MidiFile::writeTrack(std::ofstream *midiFile, TrackId trackNumber)
     for (MidiTrack::iterator i = m_midiComposition[trackNumber].begin();
          i != m_midiComposition[trackNumber].end();
          ++i) {
-        const MidiEvent &midiEvent = **i;
+        const MidiEvent &midiEvent = *i;
 
         // Do not write controller reset events to the buffer/file.
         // HACK for #1404.  I gave up trying to find where the events
@@ -1587,103 +1633,100 @@ MidiFile::consolidateNoteEvents(TrackId trackId)
 {
     MidiTrack &track = m_midiComposition[trackId];
 
-    // For each MIDI event on the track.
-    for (MidiTrack::iterator firstEventIter = track.begin();
-         firstEventIter != track.end();
-         ++firstEventIter) {
-        MidiEvent &firstEvent = **firstEventIter;
-
-        // Not a note-on?  Try the next event.
-        if (firstEvent.getMessageType() != MIDI_NOTE_ON)
-            continue;
-
-        // Note-on with velocity 0 is a note-off.  Try the next event.
-        if (firstEvent.getVelocity() == 0)
-            continue;
+    // Each note-on is paired with the first note-off after it with the
+    // same pitch and channel that an earlier note-on hasn't taken.
+    // That is done here in one pass, keeping the note-ons still
+    // waiting for a note-off in order, by channel and pitch.  The
+    // note-offs that are used are removed at the end.
 
-        // At this point, firstEvent is a note-on event.
-        // Search for the matching note-off event.
+    // Indices in track of the note-ons waiting for a note-off, by
+    // channel * 128 + pitch.
+    std::vector<std::deque<size_t> > &waiting = m_waitingNoteOns;
+    waiting.resize(16 * 128);
+    std::vector<bool> used(track.size(), false);
+    bool anyUsed = false;
 
-        bool noteOffFound = false;
+    // For each MIDI event on the track.
+    for (size_t i = 0; i < track.size(); ++i) {
+        const MidiEvent &event = track[i];
 
-        MidiTrack::iterator secondEventIter;
+        const bool noteOn = (event.getMessageType() == MIDI_NOTE_ON);
+        const bool noteOff = (event.getMessageType() == MIDI_NOTE_OFF  ||
+                              (noteOn  &&  event.getVelocity() == 0x00));
 
-        // For each following MIDI event
-        for (secondEventIter = firstEventIter + 1;
-             secondEventIter != track.end();
-             ++secondEventIter) {
-            const MidiEvent &secondEvent = **secondEventIter;
+        // Not a note?  Try the next event.
+        if (!noteOn  &&  !noteOff)
+            continue;
 
-            bool noteOff = (secondEvent.getMessageType() == MIDI_NOTE_OFF  ||
-                    (secondEvent.getMessageType() == MIDI_NOTE_ON  &&
-                     secondEvent.getVelocity() == 0x00));
+        std::deque<size_t> &notes =
+                waiting[event.getChannelNumber() * 128 +
+                        (event.getPitch() & 0x7F)];
 
-            // Not a note-off?  Try the next event.
-            if (!noteOff)
-                continue;
+        // Note-on with velocity > 0.  Wait for its note-off.
+        if (!noteOff) {
+            notes.push_back(i);
+            continue;
+        }
 
-            // Wrong pitch?  Try the next event.
-            if (secondEvent.getPitch() != firstEvent.getPitch())
-                continue;
+        // A stray note-off?  Leave it.
+        if (notes.empty())
+            continue;
 
-            // Wrong channel?  Try the next event.
-            // Note: Since all the events in a track are for a single channel,
-            //       this will never be true.
-            if (secondEvent.getChannelNumber() != firstEvent.getChannelNumber())
-                continue;
+        MidiEvent &firstEvent = track[notes.front()];
+        notes.pop_front();
 
-            timeT noteDuration = secondEvent.getTime() - firstEvent.getTime();
+        timeT noteDuration = event.getTime() - firstEvent.getTime();
 
-            // Some MIDI files floating around in the real world
-            // apparently have note-on followed immediately by note-off
-            // on percussion tracks.  Instead of setting the duration to
-            // 0 in this case, which has no meaning, set it to 1.
-            if (noteDuration == 0) {
-                RG_WARNING << "consolidateNoteEvents() - detected MIDI note duration of 0.  Using duration of 1.  Touch wood.";
-                noteDuration = 1;
-            }
+        // Some MIDI files floating around in the real world
+        // apparently have note-on followed immediately by note-off
+        // on percussion tracks.  Instead of setting the duration to
+        // 0 in this case, which has no meaning, set it to 1.
+        if (noteDuration == 0) {
+            RG_WARNING << "consolidateNoteEvents() - detected MIDI note duration of 0.  Using duration of 1.  Touch wood.";
+            noteDuration = 1;
+        }
 
-            firstEvent.setDuration(noteDuration);
+        firstEvent.setDuration(noteDuration);
 
-            // Remove the note-off.
-            delete *secondEventIter;
-            track.erase(secondEventIter);
+        // Remove the note-off.
+        used[i] = true;
+        anyUsed = true;
+    }
 
-            noteOffFound = true;
-            break;
+    // Note-ons that never found a note-off last until the last event
+    // on the track that is staying.
+    size_t last = track.size();
+    while (last > 0  &&  used[last - 1]) {
+        --last;
+    }
+    for (std::deque<size_t> &notes : waiting) {
+        for (size_t i : notes) {
+            // last can't be before i, as i isn't a note-off.
+            track[i].setDuration(
+                    track[last - 1].getTime() - track[i].getTime());
         }
+        // Empty for the next track.
+        notes.clear();
+    }
 
-        if (!noteOffFound) {
-            // avoid crash due to secondEventIter == track.end()
-            --secondEventIter;
-            // Set Event duration to length of Segment.
-            firstEvent.setDuration(
-                    (*secondEventIter)->getTime() - firstEvent.getTime());
-        }
+    if (!anyUsed)
+        return;
+
+    // Remove the note-offs that were used.
+    size_t kept = 0;
+    for (size_t i = 0; i < track.size(); ++i) {
+        if (used[i])
+            continue;
+        if (kept != i)
+            track[kept] = std::move(track[i]);
+        ++kept;
     }
+    track.erase(track.begin() + kept, track.end());
 }
 
 void
 MidiFile::clearMidiComposition()
 {
-    // For each track
-    for (MidiComposition::iterator trackIter = m_midiComposition.begin();
-         trackIter != m_midiComposition.end();
-         ++trackIter) {
-
-        MidiTrack &midiTrack = trackIter->second;
-
-        // For each event on the track.
-        for (MidiTrack::iterator eventIter = midiTrack.begin();
-             eventIter != midiTrack.end();
-             ++eventIter) {
-
-            delete *eventIter;
-        }
-
-        midiTrack.clear();
-    }
-
     m_midiComposition.clear();
     m_trackChannelMap.clear();
     m_trackNames.clear();
@@ -1691,4 +1734,3 @@ MidiFile::clearMidiComposition()
 
 
 }
-
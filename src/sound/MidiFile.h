@@ -16,13 +16,16 @@
 #define RG_MIDIFILE_H
 
 #include "base/Composition.h"
+#include "sound/MidiEvent.h"
 
 #include <QObject>
 #include <QPointer>
 #include <QString>
 
 class QProgressDialog;
+class TestMidiFile;
 
+#include <deque>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -32,7 +35,6 @@ namespace Rosegarden
 {
 
 
-class MidiEvent;
 class RosegardenDocument;
 
 /// Conversion class for Composition to and from MIDI Files.
@@ -79,6 +81,7 @@ private:
     // - m_midiComposition
     // - clearMidiComposition()
     friend class MidiInserter;
+    friend class ::TestMidiFile;
 
     // *** Standard MIDI File Header
 
@@ -113,9 +116,10 @@ private:
      * We use a vector and not a set because we want the order of
      * the events to be arbitrary until we explicitly sort them
      * (necessary when converting Composition absolute times to
-     * MIDI delta times).
+     * MIDI delta times).  The events are held by value so that a
+     * large file doesn't mean a heap allocation for every event.
      */
-    typedef std::vector<MidiEvent *> MidiTrack;
+    typedef std::vector<MidiEvent> MidiTrack;
     typedef std::map<TrackId, MidiTrack> MidiComposition;
     MidiComposition m_midiComposition;
     void clearMidiComposition();
@@ -123,50 +127,57 @@ private:
     // *** Standard MIDI File to Rosegarden
 
     /// Read a MIDI file into m_midiComposition.
+    /**
+     * The whole file is mapped (or read) into memory, and its track
+     * chunks are parsed in parallel on QThreadPool's threads.
+     */
     bool read(const QString &filename);
-    void parseHeader(std::ifstream *midiFile);
-    /// Convert a track to events in m_midiComposition.
-    void parseTrack(std::ifstream *midiFile);
+    /// Parse the header chunk at the start of data.
+    /**
+     * Returns the size of the header chunk.
+     */
+    size_t parseHeader(const MidiByte *data, size_t size);
+
+    /// The m_midiComposition tracks made from one MIDI file track.
+    struct ParsedTrack
+    {
+        /// The meta events and the first channel's, then one for each
+        /// further channel, in the order they were found.
+        std::vector<MidiTrack> tracks;
+        /// The MIDI channel for each of tracks, or -1 if none.
+        std::vector<int> channels;
+        std::string name;
+        /// Set if parsing failed.
+        std::string error;
+    };
+    /// Convert a MIDI file track chunk to events.
+    /**
+     * size is the length the chunk claims to have.  available is how
+     * much of that is actually in the file.
+     *
+     * Touches no members, so it can run on any thread.  Throws
+     * Exception on error.
+     */
+    static void parseTrack(const MidiByte *data, size_t size,
+                           size_t available, ParsedTrack &parsedTrack);
+
     // m_midiComposition track to MIDI channel.
     std::map<TrackId, int /*channel*/> m_trackChannelMap;
     // Names for each track.
     std::vector<std::string> m_trackNames;
-    /// Find the next track chunk and set m_trackByteCount.
-    void findNextTrack(std::ifstream *midiFile);
     /// Combine each note-on/note-off pair into a single note event with a duration.
     void consolidateNoteEvents(TrackId trackId);
+    /// Note-ons waiting for their note-off, by channel and pitch.
+    /**
+     * For consolidateNoteEvents().  Kept between calls, and empty
+     * between them, so that each track doesn't allocate a deque for
+     * every channel and pitch again.
+     */
+    std::vector<std::deque<size_t> > m_waitingNoteOns;
     /// Configure the Instrument based on events in Segment at time 0.
     static void configureInstrument(
             Track *track, Segment *segment, Instrument *instrument);
 
-    // Read
-    /// Read a "variable-length quantity" from the MIDI byte stream.
-    /**
-     * In case the first byte has already been read, it can be sent
-     * in as firstByte.
-     */
-    long readNumber(std::ifstream *midiFile, int firstByte = -1);
-    MidiByte read(std::ifstream *midiFile);
-    std::string read(std::ifstream *midiFile,
-                     unsigned long numberOfBytes);
-
-    // Conversion
-    int midiBytesToInt(const std::string &bytes);
-    long midiBytesToLong(const std::string &bytes);
-
-    size_t m_fileSize;
-    /// Number of bytes left to read in the current track.
-    long m_trackByteCount;
-    /// Allow decrementing of m_trackByteCount while reading.
-    /**
-     * Set to true while processing a track.  false while processing other
-     * parts of the file.
-     */
-    bool m_decrementCount;
-
-    /// Counter for kicking the message loop.
-    int m_bytesRead;
-
     std::string m_error;
 
     // *** Rosegarden to Standard MIDI File
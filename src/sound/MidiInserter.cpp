@@ -37,26 +37,25 @@ namespace Rosegarden
 {
     /*** TrackData ***/
 
-// Insert and take ownership of a MidiEvent.  The event's time is
-// converted from an absolute time to a time delta relative to the
-// previous time.
+// Insert a copy of a MidiEvent.  The copy's time is converted from
+// an absolute time to a time delta relative to the previous time.
 // @author Tom Breton (Tehom)
 void
 MidiInserter::TrackData::
-insertMidiEvent(MidiEvent *event)
+insertMidiEvent(const MidiEvent &event)
 {
-    timeT absoluteTime = event->getTime();
+    timeT absoluteTime = event.getTime();
     timeT delta        = absoluteTime - m_previousTime;
     if (delta < 0)
         { delta = 0; }
     else
         { m_previousTime = absoluteTime; }
-    event->setTime(delta);
 #ifdef MIDI_DEBUG
     RG_DEBUG << "Converting absoluteTime" << (int)absoluteTime
              << "to delta" << (int)delta;
 #endif
     m_midiTrack.push_back(event);
+    m_midiTrack.back().setTime(delta);
 }
 
 void
@@ -66,7 +65,7 @@ endTrack(timeT t)
     // Safe even if t is too early in timeT because insertMidiEvent
     // fixes it.
     insertMidiEvent
-        (new MidiEvent(t, MIDI_FILE_META_EVENT,
+        (MidiEvent(t, MIDI_FILE_META_EVENT,
                        MIDI_END_OF_TRACK, ""));
 }
 
@@ -84,7 +83,7 @@ insertTempo(timeT t, long tempo)
 
 
     insertMidiEvent
-        (new MidiEvent(t,
+        (MidiEvent(t,
                        MIDI_FILE_META_EVENT,
                        MIDI_SET_TEMPO,
                        tempoString));
@@ -135,7 +134,7 @@ initNormalTrack(TrackData &trackData, TrackId RGTrackPos) const
     trackData.m_previousTime = 0;
     trackData.
         insertMidiEvent
-        (new MidiEvent(0,
+        (MidiEvent(0,
                        MIDI_FILE_META_EVENT,
                        MIDI_TRACK_NAME,
                        track->getLabel()));
@@ -179,17 +178,17 @@ setup()
     //
     m_conductorTrack.
         insertMidiEvent
-        (new MidiEvent(0, MIDI_FILE_META_EVENT, MIDI_COPYRIGHT_NOTICE,
+        (MidiEvent(0, MIDI_FILE_META_EVENT, MIDI_COPYRIGHT_NOTICE,
                        m_comp.getCopyrightNote()));
 
     m_conductorTrack.
         insertMidiEvent
-        (new MidiEvent(0, MIDI_FILE_META_EVENT, MIDI_CUE_POINT,
+        (MidiEvent(0, MIDI_FILE_META_EVENT, MIDI_CUE_POINT,
                        "Created by Rosegarden"));
 
     m_conductorTrack.
         insertMidiEvent
-        (new MidiEvent(0, MIDI_FILE_META_EVENT, MIDI_CUE_POINT,
+        (MidiEvent(0, MIDI_FILE_META_EVENT, MIDI_CUE_POINT,
                        "http://www.rosegardenmusic.com/"));
 }
 
@@ -304,7 +303,7 @@ insertCopy(const MappedEvent &evt)
 
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_FILE_META_EVENT,
                                        MIDI_TIME_SIGNATURE,
                                        timeSigString));
@@ -315,7 +314,7 @@ insertCopy(const MappedEvent &evt)
                 {
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_CTRL_CHANGE | midiChannel,
                                        evt.getData1(), evt.getData2()));
 
@@ -325,7 +324,7 @@ insertCopy(const MappedEvent &evt)
                 {
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_PROG_CHANGE | midiChannel,
                                        evt.getData1()));
                     break;
@@ -348,7 +347,7 @@ insertCopy(const MappedEvent &evt)
                         // with a preset velocity of 64"
                         trackData.
                             insertMidiEvent
-                            (new MidiEvent(midiEventAbsoluteTime,
+                            (MidiEvent(midiEventAbsoluteTime,
                                            MIDI_NOTE_OFF | midiChannel,
                                            pitch,
                                            64));
@@ -356,7 +355,7 @@ insertCopy(const MappedEvent &evt)
                         // It's a NOTE_ON.
                         trackData.
                             insertMidiEvent
-                            (new MidiEvent(midiEventAbsoluteTime,
+                            (MidiEvent(midiEventAbsoluteTime,
                                            MIDI_NOTE_ON | midiChannel,
                                            pitch,
                                            midiVelocity));
@@ -367,7 +366,7 @@ insertCopy(const MappedEvent &evt)
                 {
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_PITCH_BEND | midiChannel,
                                        evt.getData2(), evt.getData1()));
                     break;
@@ -389,7 +388,7 @@ insertCopy(const MappedEvent &evt)
                     //
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_SYSTEM_EXCLUSIVE,
                                        data));
 
@@ -400,7 +399,7 @@ insertCopy(const MappedEvent &evt)
                 {
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_CHNL_AFTERTOUCH | midiChannel,
                                        evt.getData1()));
 
@@ -410,7 +409,7 @@ insertCopy(const MappedEvent &evt)
                 {
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_POLY_AFTERTOUCH | midiChannel,
                                        evt.getData1(), evt.getData2()));
 
@@ -425,7 +424,7 @@ insertCopy(const MappedEvent &evt)
 
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_FILE_META_EVENT,
                                        MIDI_TEXT_MARKER,
                                        metaMessage));
@@ -443,7 +442,7 @@ insertCopy(const MappedEvent &evt)
 
                     trackData.
                         insertMidiEvent
-                        (new MidiEvent(midiEventAbsoluteTime,
+                        (MidiEvent(midiEventAbsoluteTime,
                                        MIDI_FILE_META_EVENT,
                                        midiTextType,
                                        metaMessage));
@@ -516,13 +515,14 @@ assignToMidiFile(MidiFile &midifile)
     midifile.m_timingDivision = m_timingDivision;
     midifile.m_format         = MidiFile::MIDI_SIMULTANEOUS_TRACK_FILE;
 
-    midifile.m_midiComposition[0] = m_conductorTrack.m_midiTrack;
+    // The tracks are finished with, so move them rather than copy.
+    midifile.m_midiComposition[0].swap(m_conductorTrack.m_midiTrack);
     unsigned int index = 0;
     for (TrackIterator i = m_trackPosMap.begin();
          i != m_trackPosMap.end();
          ++i, ++index) {
-        midifile.m_midiComposition[index + 1] =
-            i->second.m_midiTrack;
+        midifile.m_midiComposition[index + 1].swap(
+            i->second.m_midiTrack);
     }
 }
 
@@ -38,10 +38,10 @@ class MidiInserter : public MappedInserterBase
     // @author Tom Breton (Tehom)
     struct TrackData
     {
-        // Insert and take ownership of a MidiEvent.  The event's time
-        // is converted from an absolute time to a time delta relative
-        // to the previous time.
-        void insertMidiEvent(MidiEvent *event);
+        // Insert a copy of a MidiEvent.  The copy's time is converted
+        // from an absolute time to a time delta relative to the
+        // previous time.
+        void insertMidiEvent(const MidiEvent &event);
         // Make and insert a tempo event.
         void insertTempo(timeT t, long tempo);
         void endTrack(timeT t);
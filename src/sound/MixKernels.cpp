@@ -0,0 +1,492 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#define RG_MODULE_STRING "[MixKernels]"
+
+#include "MixKernels.h"
+
+#include "misc/Debug.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// The SSE2 and AVX2 versions are compiled with per-function target
+// attributes so that no special compiler flags are needed, and the
+// binary still runs on CPUs without AVX2.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define RG_MIX_KERNELS_X86 1
+#include <immintrin.h>
+#define RG_TARGET_SSE2 __attribute__((target("sse2")))
+#define RG_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+namespace Rosegarden
+{
+
+
+namespace
+{
+
+    // *** Scalar
+
+    void mixAddScalar(float *dest, const float *src, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            dest[i] += src[i];
+        }
+    }
+
+    void gainScalar(float *buffer, size_t n, float gain)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            buffer[i] *= gain;
+        }
+    }
+
+    void gainRampScalar(float *buffer, size_t n, float from, float to)
+    {
+        const float step = (to - from) / float(n);
+        for (size_t i = 0; i < n; ++i) {
+            buffer[i] *= from + step * float(i);
+        }
+    }
+
+    void panScalar(const float *src, float *left, float *right, size_t n,
+                   float gainLeft, float gainRight)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            const float sample = src[i];
+            left[i] = sample * gainLeft;
+            right[i] = sample * gainRight;
+        }
+    }
+
+    float peakScalar(const float *src, size_t n)
+    {
+        float peak = 0.0f;
+        for (size_t i = 0; i < n; ++i) {
+            const float sample = fabsf(src[i]);
+            if (sample > peak)
+                peak = sample;
+        }
+        return peak;
+    }
+
+    float sumSquaresScalar(const float *src, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i) {
+            sum += src[i] * src[i];
+        }
+        return sum;
+    }
+
+    void flushDenormalsScalar(float *buffer, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            // Written this way round so that NaNs are flushed too.
+            if (!(fabsf(buffer[i]) >= FLT_MIN))
+                buffer[i] = 0.0f;
+        }
+    }
+
+    const MixKernels::Functions a_scalarFunctions = {
+        mixAddScalar,
+        gainScalar,
+        gainRampScalar,
+        panScalar,
+        peakScalar,
+        sumSquaresScalar,
+        flushDenormalsScalar
+    };
+
+#ifdef RG_MIX_KERNELS_X86
+
+    // *** SSE2
+
+    RG_TARGET_SSE2
+    void mixAddSSE2(float *dest, const float *src, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i),
+                                               _mm_loadu_ps(src + i)));
+        }
+        mixAddScalar(dest + i, src + i, n - i);
+    }
+
+    RG_TARGET_SSE2
+    void gainSSE2(float *buffer, size_t n, float gain)
+    {
+        const __m128 g = _mm_set1_ps(gain);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(buffer + i, _mm_mul_ps(_mm_loadu_ps(buffer + i), g));
+        }
+        gainScalar(buffer + i, n - i, gain);
+    }
+
+    RG_TARGET_SSE2
+    void gainRampSSE2(float *buffer, size_t n, float from, float to)
+    {
+        const float step = (to - from) / float(n);
+        const __m128 vstep = _mm_set1_ps(step);
+        const __m128 vfrom = _mm_set1_ps(from);
+        __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        const __m128 four = _mm_set1_ps(4.0f);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            const __m128 g = _mm_add_ps(vfrom, _mm_mul_ps(vstep, index));
+            _mm_storeu_ps(buffer + i, _mm_mul_ps(_mm_loadu_ps(buffer + i), g));
+            index = _mm_add_ps(index, four);
+        }
+        for (; i < n; ++i) {
+            buffer[i] *= from + step * float(i);
+        }
+    }
+
+    RG_TARGET_SSE2
+    void panSSE2(const float *src, float *left, float *right, size_t n,
+                 float gainLeft, float gainRight)
+    {
+        const __m128 gl = _mm_set1_ps(gainLeft);
+        const __m128 gr = _mm_set1_ps(gainRight);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            const __m128 sample = _mm_loadu_ps(src + i);
+            _mm_storeu_ps(left + i, _mm_mul_ps(sample, gl));
+            _mm_storeu_ps(right + i, _mm_mul_ps(sample, gr));
+        }
+        panScalar(src + i, left + i, right + i, n - i, gainLeft, gainRight);
+    }
+
+    RG_TARGET_SSE2
+    float horizontalMaxSSE2(__m128 v)
+    {
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+
+    RG_TARGET_SSE2
+    float horizontalSumSSE2(__m128 v)
+    {
+        v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+
+    RG_TARGET_SSE2
+    float peakSSE2(const float *src, size_t n)
+    {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 peak = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            // NaNs lose: _mm_max_ps() returns the second operand if
+            // either is a NaN.
+            peak = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(src + i), absMask),
+                              peak);
+        }
+        const float tail = peakScalar(src + i, n - i);
+        const float head = horizontalMaxSSE2(peak);
+        return (tail > head) ? tail : head;
+    }
+
+    RG_TARGET_SSE2
+    float sumSquaresSSE2(const float *src, size_t n)
+    {
+        __m128 sum = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            const __m128 sample = _mm_loadu_ps(src + i);
+            sum = _mm_add_ps(sum, _mm_mul_ps(sample, sample));
+        }
+        return horizontalSumSSE2(sum) + sumSquaresScalar(src + i, n - i);
+    }
+
+    RG_TARGET_SSE2
+    void flushDenormalsSSE2(float *buffer, size_t n)
+    {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 smallest = _mm_set1_ps(FLT_MIN);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            const __m128 sample = _mm_loadu_ps(buffer + i);
+            // All ones where |sample| >= FLT_MIN, zero elsewhere and
+            // for NaNs.
+            const __m128 keep =
+                    _mm_cmpge_ps(_mm_and_ps(sample, absMask), smallest);
+            _mm_storeu_ps(buffer + i, _mm_and_ps(sample, keep));
+        }
+        flushDenormalsScalar(buffer + i, n - i);
+    }
+
+    const MixKernels::Functions a_sse2Functions = {
+        mixAddSSE2,
+        gainSSE2,
+        gainRampSSE2,
+        panSSE2,
+        peakSSE2,
+        sumSquaresSSE2,
+        flushDenormalsSSE2
+    };
+
+    // *** AVX2
+    //
+    // Eight samples at a time, handing the remainder to the SSE2
+    // versions.
+
+    RG_TARGET_AVX2
+    void mixAddAVX2(float *dest, const float *src, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(dest + i,
+                             _mm256_add_ps(_mm256_loadu_ps(dest + i),
+                                           _mm256_loadu_ps(src + i)));
+        }
+        mixAddSSE2(dest + i, src + i, n - i);
+    }
+
+    RG_TARGET_AVX2
+    void gainAVX2(float *buffer, size_t n, float gain)
+    {
+        const __m256 g = _mm256_set1_ps(gain);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(buffer + i,
+                             _mm256_mul_ps(_mm256_loadu_ps(buffer + i), g));
+        }
+        gainSSE2(buffer + i, n - i, gain);
+    }
+
+    RG_TARGET_AVX2
+    void gainRampAVX2(float *buffer, size_t n, float from, float to)
+    {
+        const float step = (to - from) / float(n);
+        const __m256 vstep = _mm256_set1_ps(step);
+        const __m256 vfrom = _mm256_set1_ps(from);
+        __m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f,
+                                      4.0f, 5.0f, 6.0f, 7.0f);
+        const __m256 eight = _mm256_set1_ps(8.0f);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            const __m256 g = _mm256_add_ps(vfrom, _mm256_mul_ps(vstep, index));
+            _mm256_storeu_ps(buffer + i,
+                             _mm256_mul_ps(_mm256_loadu_ps(buffer + i), g));
+            index = _mm256_add_ps(index, eight);
+        }
+        for (; i < n; ++i) {
+            buffer[i] *= from + step * float(i);
+        }
+    }
+
+    RG_TARGET_AVX2
+    void panAVX2(const float *src, float *left, float *right, size_t n,
+                 float gainLeft, float gainRight)
+    {
+        const __m256 gl = _mm256_set1_ps(gainLeft);
+        const __m256 gr = _mm256_set1_ps(gainRight);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            const __m256 sample = _mm256_loadu_ps(src + i);
+            _mm256_storeu_ps(left + i, _mm256_mul_ps(sample, gl));
+            _mm256_storeu_ps(right + i, _mm256_mul_ps(sample, gr));
+        }
+        panSSE2(src + i, left + i, right + i, n - i, gainLeft, gainRight);
+    }
+
+    RG_TARGET_AVX2
+    float peakAVX2(const float *src, size_t n)
+    {
+        const __m256 absMask =
+                _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        __m256 peak = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            peak = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(src + i),
+                                               absMask),
+                                 peak);
+        }
+        const float head = horizontalMaxSSE2(
+                _mm_max_ps(_mm256_castps256_ps128(peak),
+                           _mm256_extractf128_ps(peak, 1)));
+        const float tail = peakSSE2(src + i, n - i);
+        return (tail > head) ? tail : head;
+    }
+
+    RG_TARGET_AVX2
+    float sumSquaresAVX2(const float *src, size_t n)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            const __m256 sample = _mm256_loadu_ps(src + i);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(sample, sample));
+        }
+        return horizontalSumSSE2(
+                       _mm_add_ps(_mm256_castps256_ps128(sum),
+                                  _mm256_extractf128_ps(sum, 1))) +
+               sumSquaresSSE2(src + i, n - i);
+    }
+
+    RG_TARGET_AVX2
+    void flushDenormalsAVX2(float *buffer, size_t n)
+    {
+        const __m256 absMask =
+                _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        const __m256 smallest = _mm256_set1_ps(FLT_MIN);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            const __m256 sample = _mm256_loadu_ps(buffer + i);
+            const __m256 keep = _mm256_cmp_ps(
+                    _mm256_and_ps(sample, absMask), smallest, _CMP_GE_OQ);
+            _mm256_storeu_ps(buffer + i, _mm256_and_ps(sample, keep));
+        }
+        flushDenormalsSSE2(buffer + i, n - i);
+    }
+
+    const MixKernels::Functions a_avx2Functions = {
+        mixAddAVX2,
+        gainAVX2,
+        gainRampAVX2,
+        panAVX2,
+        peakAVX2,
+        sumSquaresAVX2,
+        flushDenormalsAVX2
+    };
+
+#endif
+
+    const MixKernels::Functions *a_functionsFor(
+            MixKernels::Implementation implementation)
+    {
+        switch (implementation) {
+#ifdef RG_MIX_KERNELS_X86
+        case MixKernels::AVX2:
+            return &a_avx2Functions;
+        case MixKernels::SSE2:
+            return &a_sse2Functions;
+#else
+        case MixKernels::AVX2:
+        case MixKernels::SSE2:
+#endif
+        case MixKernels::Scalar:
+        default:
+            return &a_scalarFunctions;
+        }
+    }
+}
+
+const MixKernels::Functions *MixKernels::m_functions = nullptr;
+
+bool
+MixKernels::isSupported(Implementation implementation)
+{
+    switch (implementation) {
+    case Scalar:
+        return true;
+#ifdef RG_MIX_KERNELS_X86
+    case SSE2:
+        return __builtin_cpu_supports("sse2");
+    case AVX2:
+        return __builtin_cpu_supports("avx2");
+#else
+    case SSE2:
+    case AVX2:
+#endif
+    default:
+        return false;
+    }
+}
+
+void
+MixKernels::init()
+{
+    Implementation implementation = Scalar;
+    if (isSupported(AVX2))
+        implementation = AVX2;
+    else if (isSupported(SSE2))
+        implementation = SSE2;
+
+    const char *env = getenv("ROSEGARDEN_MIX_KERNELS");
+    if (env) {
+        for (int i = Scalar; i <= AVX2; ++i) {
+            const Implementation requested = static_cast<Implementation>(i);
+            if (strcmp(env, getImplementationName(requested)) != 0)
+                continue;
+            if (isSupported(requested)) {
+                implementation = requested;
+            } else {
+                RG_WARNING << "init(): ROSEGARDEN_MIX_KERNELS=" << env <<
+                              " is not supported by this CPU";
+            }
+        }
+    }
+
+    m_functions = a_functionsFor(implementation);
+}
+
+MixKernels::Implementation
+MixKernels::getImplementation()
+{
+    const Functions *current = &functions();
+    for (int i = AVX2; i > Scalar; --i) {
+        const Implementation implementation = static_cast<Implementation>(i);
+        if (current == a_functionsFor(implementation))
+            return implementation;
+    }
+    return Scalar;
+}
+
+bool
+MixKernels::setImplementation(Implementation implementation)
+{
+    if (!isSupported(implementation))
+        return false;
+
+    m_functions = a_functionsFor(implementation);
+    return true;
+}
+
+const char *
+MixKernels::getImplementationName(Implementation implementation)
+{
+    switch (implementation) {
+    case AVX2:
+        return "avx2";
+    case SSE2:
+        return "sse2";
+    case Scalar:
+    default:
+        return "scalar";
+    }
+}
+
+float
+MixKernels::rms(const float *src, size_t n)
+{
+    if (n == 0)
+        return 0.0f;
+    return sqrtf(functions().sumSquares(src, n) / float(n));
+}
+
+
+}
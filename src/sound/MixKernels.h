@@ -0,0 +1,142 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Rosegarden
+    A sequencer and musical notation editor.
+    Copyright 2000-2023 the Rosegarden development team.
+    See the AUTHORS file for more details.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef RG_MIX_KERNELS_H
+#define RG_MIX_KERNELS_H
+
+#include <rosegardenprivate_export.h>
+
+#include <cstddef>
+
+namespace Rosegarden
+{
+
+
+/// Vectorized inner loops for the audio mixers.
+/**
+ * AudioInstrumentMixer, AudioBussMixer, JackDriver and RingBuffer do
+ * their summing, gain, pan, metering and denormal flushing through
+ * these functions.  On x86 the best of AVX2, SSE2 and plain C++ is
+ * picked at runtime on first use.  Elsewhere the plain C++ versions
+ * are used and left to the compiler to vectorize.
+ *
+ * Setting the environment variable ROSEGARDEN_MIX_KERNELS to "scalar",
+ * "sse2" or "avx2" before startup overrides the choice (if the CPU
+ * supports it).  This is for comparing implementations (see
+ * test/mixkernels.cpp).
+ *
+ * The choice is made on first use.  JackDriver makes that happen
+ * before any audio thread starts.
+ *
+ * Buffers need not be aligned, and source and destination must not
+ * overlap unless noted.  All functions are RT safe.
+ */
+class ROSEGARDENPRIVATE_EXPORT MixKernels
+{
+public:
+    enum Implementation {
+        Scalar = 0,
+        SSE2 = 1,
+        AVX2 = 2
+    };
+
+    /// The implementation in use.
+    static Implementation getImplementation();
+    /// Whether the CPU can run the given implementation.
+    static bool isSupported(Implementation implementation);
+    /// Switch implementations.  Not thread-safe.  For tests.
+    /**
+     * Returns false (and changes nothing) if the implementation is not
+     * supported.
+     */
+    static bool setImplementation(Implementation implementation);
+    static const char *getImplementationName(Implementation implementation);
+
+    /// dest[i] += src[i]
+    static void mixAdd(float *dest, const float *src, size_t n)
+            { functions().mixAdd(dest, src, n); }
+
+    /// buffer[i] *= gain
+    static void gain(float *buffer, size_t n, float gain)
+            { functions().gain(buffer, n, gain); }
+
+    /// buffer[i] *= a gain moving linearly from "from" towards "to".
+    /**
+     * The gain for the first sample is "from", and the gain for the
+     * sample following the last would be "to".  Use this when a fader
+     * has moved since the last block, to avoid zipper noise.
+     */
+    static void gainRamp(float *buffer, size_t n, float from, float to)
+    {
+        if (from == to)
+            functions().gain(buffer, n, to);
+        else
+            functions().gainRamp(buffer, n, from, to);
+    }
+
+    /// left[i] = src[i] * gainLeft, right[i] = src[i] * gainRight
+    /**
+     * src may be the same as left or right.
+     */
+    static void pan(const float *src, float *left, float *right, size_t n,
+                    float gainLeft, float gainRight)
+            { functions().pan(src, left, right, n, gainLeft, gainRight); }
+
+    /// Largest absolute sample value.
+    static float peak(const float *src, size_t n)
+            { return functions().peak(src, n); }
+
+    /// Root mean square of the samples.
+    static float rms(const float *src, size_t n);
+
+    /// Set denormals (and NaNs) to zero.
+    /**
+     * Plugins left to decay into silence can produce denormals, which
+     * are very slow to process on most CPUs.
+     */
+    static void flushDenormals(float *buffer, size_t n)
+            { functions().flushDenormals(buffer, n); }
+
+    /// Function table for one implementation.
+    struct Functions
+    {
+        void (*mixAdd)(float *dest, const float *src, size_t n);
+        void (*gain)(float *buffer, size_t n, float gain);
+        void (*gainRamp)(float *buffer, size_t n, float from, float to);
+        void (*pan)(const float *src, float *left, float *right, size_t n,
+                    float gainLeft, float gainRight);
+        float (*peak)(const float *src, size_t n);
+        float (*sumSquares)(const float *src, size_t n);
+        void (*flushDenormals)(float *buffer, size_t n);
+    };
+
+private:
+    static const Functions *m_functions;
+
+    static const Functions &functions()
+    {
+        if (!m_functions)
+            init();
+        return *m_functions;
+    }
+
+    /// Pick the best implementation for this CPU.
+    static void init();
+};
+
+
+}
+
+#endif
@@ -0,0 +1,211 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+/*
+  Rosegarden
+  A sequencer and musical notation editor.
+  Copyright 2020-2023 the Rosegarden development team.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#include "NoteOffQueue.h"
+
+
+namespace Rosegarden
+{
+
+
+const uint32_t NoteOffQueue::NoSlot;
+
+NoteOffQueue::NoteOffQueue(size_t initialCapacity) :
+    m_nextSequence(0)
+{
+    m_slots.reserve(initialCapacity);
+    m_freeSlots.reserve(initialCapacity);
+    m_heap.reserve(initialCapacity);
+}
+
+uint32_t
+NoteOffQueue::allocateSlot()
+{
+    if (!m_freeSlots.empty()) {
+        const uint32_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return slot;
+    }
+
+    m_slots.push_back(Slot());
+    return static_cast<uint32_t>(m_slots.size() - 1);
+}
+
+void
+NoteOffQueue::insert(const NoteOffEvent &noteOff)
+{
+    const uint32_t slot = allocateSlot();
+    Slot &s = m_slots[slot];
+    s.noteOff = noteOff;
+    s.sequence = m_nextSequence++;
+    s.nextSameNote = NoSlot;
+    s.prevSameNote = NoSlot;
+
+    // Append to the per-note list.  Lists are short (usually one entry)
+    // so walking to the end is cheap.
+    uint32_t &head = m_noteIndex.insert(
+            NoteIndex::value_type(makeKey(noteOff), NoSlot)).first->second;
+    if (head == NoSlot) {
+        head = slot;
+    } else {
+        uint32_t last = head;
+        while (m_slots[last].nextSameNote != NoSlot)
+            last = m_slots[last].nextSameNote;
+        m_slots[last].nextSameNote = slot;
+        s.prevSameNote = last;
+    }
+
+    m_heap.push_back(slot);
+    s.heapIndex = static_cast<uint32_t>(m_heap.size() - 1);
+    siftUp(m_heap.size() - 1);
+}
+
+void
+NoteOffQueue::pop()
+{
+    removeSlot(m_heap.front());
+}
+
+bool
+NoteOffQueue::contains(MidiByte pitch, MidiByte channel,
+                       InstrumentId instrumentId) const
+{
+    NoteIndex::const_iterator it =
+            m_noteIndex.find(makeKey(pitch, channel, instrumentId));
+    return (it != m_noteIndex.end()  &&  it->second != NoSlot);
+}
+
+bool
+NoteOffQueue::remove(MidiByte pitch, MidiByte channel,
+                     InstrumentId instrumentId)
+{
+    NoteIndex::const_iterator it =
+            m_noteIndex.find(makeKey(pitch, channel, instrumentId));
+    if (it == m_noteIndex.end()  ||  it->second == NoSlot)
+        return false;
+
+    // The list is in insertion order, not time order.  Find the earliest.
+    uint32_t earliest = it->second;
+    for (uint32_t slot = m_slots[earliest].nextSameNote;
+         slot != NoSlot;
+         slot = m_slots[slot].nextSameNote) {
+        if (earlier(slot, earliest))
+            earliest = slot;
+    }
+
+    removeSlot(earliest);
+    return true;
+}
+
+void
+NoteOffQueue::clear()
+{
+    // Keep the capacity of everything, including the index keys.
+    for (uint32_t slot : m_heap) {
+        m_slots[slot].heapIndex = NoSlot;
+        m_freeSlots.push_back(slot);
+    }
+    m_heap.clear();
+
+    for (NoteIndex::value_type &entry : m_noteIndex) {
+        entry.second = NoSlot;
+    }
+}
+
+void
+NoteOffQueue::removeSlot(uint32_t slot)
+{
+    Slot &s = m_slots[slot];
+
+    // Unlink from the per-note list.
+    if (s.prevSameNote != NoSlot) {
+        m_slots[s.prevSameNote].nextSameNote = s.nextSameNote;
+    } else {
+        m_noteIndex[makeKey(s.noteOff)] = s.nextSameNote;
+    }
+    if (s.nextSameNote != NoSlot)
+        m_slots[s.nextSameNote].prevSameNote = s.prevSameNote;
+
+    // Remove from the heap by moving the last entry into the hole.
+    const size_t heapIndex = s.heapIndex;
+    const uint32_t last = m_heap.back();
+    m_heap.pop_back();
+    if (last != slot) {
+        placeInHeap(heapIndex, last);
+        if (heapIndex > 0  &&  earlier(last, m_heap[(heapIndex - 1) / 2]))
+            siftUp(heapIndex);
+        else
+            siftDown(heapIndex);
+    }
+
+    s.heapIndex = NoSlot;
+    m_freeSlots.push_back(slot);
+}
+
+void
+NoteOffQueue::placeInHeap(size_t heapIndex, uint32_t slot)
+{
+    m_heap[heapIndex] = slot;
+    m_slots[slot].heapIndex = static_cast<uint32_t>(heapIndex);
+}
+
+void
+NoteOffQueue::siftUp(size_t heapIndex)
+{
+    const uint32_t slot = m_heap[heapIndex];
+
+    while (heapIndex > 0) {
+        const size_t parent = (heapIndex - 1) / 2;
+        if (!earlier(slot, m_heap[parent]))
+            break;
+        placeInHeap(heapIndex, m_heap[parent]);
+        heapIndex = parent;
+    }
+
+    placeInHeap(heapIndex, slot);
+}
+
+void
+NoteOffQueue::siftDown(size_t heapIndex)
+{
+    const uint32_t slot = m_heap[heapIndex];
+    const size_t size = m_heap.size();
+
+    while (true) {
+        size_t child = heapIndex * 2 + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size  &&  earlier(m_heap[child + 1], m_heap[child]))
+            ++child;
+        if (!earlier(m_heap[child], slot))
+            break;
+        placeInHeap(heapIndex, m_heap[child]);
+        heapIndex = child;
+    }
+
+    placeInHeap(heapIndex, slot);
+}
+
+void
+NoteOffQueue::rebuildHeap()
+{
+    if (m_heap.size() < 2)
+        return;
+
+    for (size_t i = m_heap.size() / 2; i > 0; --i) {
+        siftDown(i - 1);
+    }
+}
+
+
+}
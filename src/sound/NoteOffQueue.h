@@ -0,0 +1,158 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+/*
+  Rosegarden
+  A sequencer and musical notation editor.
+  Copyright 2020-2023 the Rosegarden development team.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#pragma once
+
+#include "NoteOffEvent.h"
+
+#include <rosegardenprivate_export.h>
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace Rosegarden
+{
+
+
+/// Time ordered queue of pending NoteOffEvent objects.
+/**
+ * A binary min-heap over a pool of preallocated slots.  NoteOffEvent
+ * objects are stored by value, so there is no allocation per note once
+ * the pool has grown to the size of the busiest passage.
+ *
+ * Note-offs mostly arrive in increasing time order, which is the best
+ * case for a heap: insert() usually stops after a single compare.
+ * Note-offs with equal times come out in the order they went in.
+ *
+ * Each slot is also linked into a per-note list keyed by (instrument,
+ * channel, pitch), so that contains() and remove() (used when a note is
+ * retriggered) don't need to scan the queue.
+ *
+ * Not thread-safe.  AlsaDriver uses this from the sequencer thread only.
+ */
+class ROSEGARDENPRIVATE_EXPORT NoteOffQueue
+{
+public:
+    explicit NoteOffQueue(size_t initialCapacity = 1024);
+
+    bool empty() const  { return m_heap.empty(); }
+    size_t size() const  { return m_heap.size(); }
+
+    void insert(const NoteOffEvent &noteOff);
+
+    /// The earliest note-off.  The queue must not be empty.
+    const NoteOffEvent &top() const  { return m_slots[m_heap.front()].noteOff; }
+    /// Remove the earliest note-off.  The queue must not be empty.
+    void pop();
+
+    /// Whether a note-off is pending for this note.
+    bool contains(MidiByte pitch, MidiByte channel,
+                  InstrumentId instrumentId) const;
+    /// Remove the earliest pending note-off for this note, if any.
+    /**
+     * Returns true if one was removed.
+     */
+    bool remove(MidiByte pitch, MidiByte channel, InstrumentId instrumentId);
+
+    void clear();
+
+    /// Call f(const NoteOffEvent &) for each note-off, in no particular order.
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (uint32_t slot : m_heap) {
+            f(m_slots[slot].noteOff);
+        }
+    }
+
+    /// Call f(RealTime &) to modify each note-off's time.
+    /**
+     * The queue is re-ordered afterwards.
+     */
+    template <typename F>
+    void adjustTimes(F f)
+    {
+        for (uint32_t slot : m_heap) {
+            f(m_slots[slot].noteOff.realTime);
+        }
+        rebuildHeap();
+    }
+
+    /// Pool statistics, for debugging and the benchmark.
+    size_t getCapacity() const  { return m_slots.size(); }
+
+private:
+    static const uint32_t NoSlot = 0xFFFFFFFF;
+
+    struct Slot
+    {
+        NoteOffEvent noteOff;
+        /// Insertion order, to keep equal times in order.
+        uint64_t sequence;
+        /// Position in m_heap, or NoSlot if free.
+        uint32_t heapIndex;
+        /// Per-note list.  Next slot for the same note, in insertion order.
+        uint32_t nextSameNote;
+        uint32_t prevSameNote;
+    };
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+
+    /// Slot indices.  Min-heap on (time, sequence).
+    std::vector<uint32_t> m_heap;
+
+    uint64_t m_nextSequence;
+
+    /// (instrument, channel, pitch) to the first slot in the per-note list.
+    /**
+     * Keys are left in place when their list empties (with NoSlot), so
+     * that a steady state of retriggered notes doesn't allocate.
+     */
+    typedef std::unordered_map<uint64_t, uint32_t> NoteIndex;
+    NoteIndex m_noteIndex;
+
+    static uint64_t makeKey(MidiByte pitch, MidiByte channel,
+                            InstrumentId instrumentId)
+    {
+        return (uint64_t(instrumentId) << 16) |
+               (uint64_t(channel) << 8) |
+               uint64_t(pitch);
+    }
+
+    static uint64_t makeKey(const NoteOffEvent &noteOff)
+    {
+        return makeKey(noteOff.pitch, noteOff.channel, noteOff.instrumentId);
+    }
+
+    bool earlier(uint32_t slot1, uint32_t slot2) const
+    {
+        const Slot &s1 = m_slots[slot1];
+        const Slot &s2 = m_slots[slot2];
+        if (s1.noteOff.realTime != s2.noteOff.realTime)
+            return s1.noteOff.realTime < s2.noteOff.realTime;
+        return s1.sequence < s2.sequence;
+    }
+
+    uint32_t allocateSlot();
+    /// Unlink from the per-note list and the heap and free the slot.
+    void removeSlot(uint32_t slot);
+
+    void placeInHeap(size_t heapIndex, uint32_t slot);
+    void siftUp(size_t heapIndex);
+    void siftDown(size_t heapIndex);
+    void rebuildHeap();
+};
+
+
+}
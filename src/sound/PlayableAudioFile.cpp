@@ -15,6 +15,7 @@
 
 #include "PlayableAudioFile.h"
 
+#include "AudioFileMapping.h"
 #include "RingBufferPool.h"
 
 #include <utility>
@@ -42,6 +43,9 @@ RingBufferPool *PlayableAudioFile::m_ringBufferPool = nullptr;
 
 static constexpr size_t a_xfadeFrames = 30;
 
+// How far ahead of the play position mapped files are read, in seconds.
+static constexpr size_t a_readAheadSeconds = 4;
+
 PlayableAudioFile::PlayableAudioFile(InstrumentId instrumentId,
                                      AudioFile *audioFile,
                                      const RealTime &startTime,
@@ -55,6 +59,8 @@ PlayableAudioFile::PlayableAudioFile(InstrumentId instrumentId,
     m_startIndex(startIndex),
     m_duration(duration),
     m_file(nullptr),
+    m_mapping(nullptr),
+    m_mappedFrame(0),
     m_audioFile(audioFile),
     m_instrumentId(instrumentId),
     m_targetChannels(targetChannels),
@@ -104,7 +110,10 @@ PlayableAudioFile::initialise(size_t bufferSize, size_t smallFileSize)
 
     checkSmallFileCache(smallFileSize);
 
-    if (!m_isSmallFile) {
+    if (!m_isSmallFile)
+        mapFile();
+
+    if (!m_isSmallFile && !m_mapping) {
 
         m_file = new std::ifstream(m_audioFile->getAbsoluteFilePath().toLocal8Bit(),
                                    std::ios::in | std::ios::binary);
@@ -122,7 +131,7 @@ PlayableAudioFile::initialise(size_t bufferSize, size_t smallFileSize)
     std::cerr << "PlayableAudioFile::initialise - scanning to " << m_startIndex << std::endl;
 #endif
 
-    if (m_file) {
+    if (m_file || m_mapping) {
         scanTo(m_startIndex);
     } else {
         m_fileEnded = false;
@@ -148,6 +157,47 @@ PlayableAudioFile::initialise(size_t bufferSize, size_t smallFileSize)
     }
 }
 
+void
+PlayableAudioFile::mapFile()
+{
+    // Only PCM RIFF files can be decoded in place.
+    if (m_audioFile->getType() != WAV && m_audioFile->getType() != BWF)
+        return;
+
+    m_mapping = new AudioFileMapping(m_audioFile->getAbsoluteFilePath(),
+                                     getBytesPerFrame());
+
+    if (!m_mapping->isValid()) {
+#ifdef DEBUG_PLAYABLE
+        std::cerr << "PlayableAudioFile::mapFile: can't map " << m_audioFile->getAbsoluteFilePath() << ", reading it instead" << std::endl;
+#endif
+        delete m_mapping;
+        m_mapping = nullptr;
+    }
+}
+
+void
+PlayableAudioFile::unmapFile()
+{
+    std::cerr << "WARNING: PlayableAudioFile::unmapFile: " << m_audioFile->getAbsoluteFilePath() << " has been truncated, reading it instead" << std::endl;
+
+    delete m_mapping;
+    m_mapping = nullptr;
+
+    m_file = new std::ifstream(m_audioFile->getAbsoluteFilePath().toLocal8Bit(),
+                               std::ios::in | std::ios::binary);
+    if (!*m_file) {
+        std::cerr << "ERROR: PlayableAudioFile::unmapFile: Failed to open audio file " << m_audioFile->getAbsoluteFilePath() << std::endl;
+        delete m_file;
+        m_file = nullptr;
+        return;
+    }
+
+    // Carry on from where the mapping got to, if that is still there.
+    if (!m_audioFile->scanTo(m_file, m_currentScanPoint))
+        m_fileEnded = true;
+}
+
 PlayableAudioFile::~PlayableAudioFile()
 {
     if (m_file) {
@@ -155,6 +205,8 @@ PlayableAudioFile::~PlayableAudioFile()
         delete m_file;
     }
 
+    delete m_mapping;
+
     returnRingBuffers();
     delete[] m_ringBuffers;
     m_ringBuffers = nullptr;
@@ -206,6 +258,22 @@ PlayableAudioFile::scanTo(const RealTime &time)
 #endif
         ok = true;
 
+    } else if (m_mapping) {
+
+        const size_t frame = (size_t)RealTime::realTime2Frame
+            (time, getSourceSampleRate());
+
+        // As RIFFAudioFile::scanTo() does, refuse to go past the end.
+        if (frame <= m_mapping->getFrameCount()) {
+            m_mappedFrame = frame;
+            m_currentScanPoint = time;
+            // Start reading from the new position straight away.
+            m_mapping->resetReadAhead();
+            m_mapping->readAhead(frame,
+                                 a_readAheadSeconds * getSourceSampleRate());
+            ok = true;
+        }
+
     } else {
 
         ok = m_audioFile->scanTo(m_file, time);
@@ -514,7 +582,7 @@ PlayableAudioFile::fillBuffers(const RealTime &currentTime)
         return true;
     }
 
-    if (!m_isSmallFile && (!m_file || !*m_file)) {
+    if (!m_isSmallFile && !m_mapping && (!m_file || !*m_file)) {
         m_file = new std::ifstream(m_audioFile->getAbsoluteFilePath().toLocal8Bit(),
                                    std::ios::in | std::ios::binary);
         if (!*m_file) {
@@ -556,7 +624,13 @@ PlayableAudioFile::updateBuffers()
 {
     if (m_isSmallFile)
         return false;
-    if (!m_file)
+
+    // Reading the mapping past the end of a truncated file would
+    // raise SIGBUS.
+    if (m_mapping && !m_mapping->isIntact())
+        unmapFile();
+
+    if (!m_file && !m_mapping)
         return false;
 
     if (m_fileEnded) {
@@ -624,23 +698,49 @@ PlayableAudioFile::updateBuffers()
     std::cerr << "Want " << fileFrames << " (" << block << ") from file (" << (m_duration + m_startIndex - m_currentScanPoint - block) << " to go)" << std::endl;
 #endif
 
-    // !!! need to be doing this in initialise, want to avoid allocations here
-    if ((getBytesPerFrame() * fileFrames) > m_rawFileBufferSize) {
-        delete[] m_rawFileBuffer;
-        m_rawFileBufferSize = getBytesPerFrame() * fileFrames;
+    const unsigned char *source = nullptr;
+    size_t obtained = 0;
+
+    if (m_mapping) {
+
+        // Decode straight from the mapping.
+        const size_t frameCount = m_mapping->getFrameCount();
+        if (m_mappedFrame < frameCount)
+            obtained = std::min(fileFrames, frameCount - m_mappedFrame);
+
+        source = m_mapping->getFrames(m_mappedFrame);
+        m_mappedFrame += obtained;
+
+        if (obtained < fileFrames || m_mappedFrame >= frameCount) {
+            m_fileEnded = true;
+        }
+
+        // Keep the kernel reading ahead of us.
+        m_mapping->readAhead(m_mappedFrame,
+                             a_readAheadSeconds * getSourceSampleRate());
+
+    } else {
+
+        // !!! need to be doing this in initialise, want to avoid allocations here
+        if ((getBytesPerFrame() * fileFrames) > m_rawFileBufferSize) {
+            delete[] m_rawFileBuffer;
+            m_rawFileBufferSize = getBytesPerFrame() * fileFrames;
 #ifdef DEBUG_PLAYABLE_READ
 
-        std::cerr << "Expanding raw file buffer to " << m_rawFileBufferSize << " chars" << std::endl;
+            std::cerr << "Expanding raw file buffer to " << m_rawFileBufferSize << " chars" << std::endl;
 #endif
 
-        m_rawFileBuffer = new char[m_rawFileBufferSize];
-    }
+            m_rawFileBuffer = new char[m_rawFileBufferSize];
+        }
 
-    size_t obtained =
-        m_audioFile->getSampleFrames(m_file, m_rawFileBuffer, fileFrames);
+        obtained =
+            m_audioFile->getSampleFrames(m_file, m_rawFileBuffer, fileFrames);
 
-    if (obtained < fileFrames || m_file->eof()) {
-        m_fileEnded = true;
+        if (obtained < fileFrames || m_file->eof()) {
+            m_fileEnded = true;
+        }
+
+        source = (const unsigned char *)m_rawFileBuffer;
     }
 
     {
@@ -672,7 +772,9 @@ PlayableAudioFile::updateBuffers()
             }
         }
 
-        if (m_audioFile->decode((const unsigned char *)m_rawFileBuffer,
+        // Nothing to decode at the very end of the file.
+        if (obtained > 0 &&
+            m_audioFile->decode(source,
                                 obtained * getBytesPerFrame(),
                                 m_targetSampleRate,
                                 m_targetChannels,
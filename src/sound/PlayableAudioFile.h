@@ -32,6 +32,7 @@ namespace Rosegarden
 
 
 class RingBufferPool;
+class AudioFileMapping;
 
 
 /// Copies data from an AudioFile to a buffer.
@@ -175,6 +176,10 @@ private:
     PlayableAudioFile &operator=(const PlayableAudioFile &);
 
     void initialise(size_t bufferSize, size_t smallFileSize);
+    /// Try to map the file instead of opening m_file.
+    void mapFile();
+    /// Go back to reading through m_file, after the file has shrunk.
+    void unmapFile();
     void checkSmallFileCache(size_t smallFileSize);
     bool scanTo(const RealTime &time);
     void returnRingBuffers();
@@ -189,6 +194,12 @@ private:
     //
     std::ifstream        *m_file;
 
+    // Memory mapping of PCM (WAV and BWF) files, used instead of
+    // m_file when available.  See AudioFileMapping.
+    //
+    AudioFileMapping     *m_mapping;
+    size_t                m_mappedFrame;
+
     // AudioFile handle
     //
     AudioFile            *m_audioFile;
@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include "Scavenger.h"
+#include "MixKernels.h"
 
 //#define DEBUG_RINGBUFFER 1
 //#define DEBUG_RINGBUFFER_CREATE_DESTROY 1
@@ -39,6 +40,21 @@ static int extant_ringbuffers = 0;
 
 namespace Rosegarden {
 
+/// destination[i] += source[i], for RingBuffer::readAdding().
+template <typename T>
+inline void ringBufferAdd(T *destination, const T *source, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        destination[i] += source[i];
+    }
+}
+
+/// Audio samples go through the vectorized mixing kernel.
+inline void ringBufferAdd(float *destination, const float *source, size_t n)
+{
+    MixKernels::mixAdd(destination, source, n);
+}
+
 /**
  * RingBuffer implements a lock-free ring buffer for one writer and N
  * readers, that is to be used to store a sample type T.
@@ -439,16 +455,10 @@ RingBuffer<T, N>::readAdding(T *destination, size_t n, int R)
     size_t here = m_size - m_readers[R];
 
     if (here >= n) {
-        for (size_t i = 0; i < n; ++i) {
-            destination[i] += (m_buffer + m_readers[R])[i];
-        }
+        ringBufferAdd(destination, m_buffer + m_readers[R], n);
     } else {
-        for (size_t i = 0; i < here; ++i) {
-            destination[i] += (m_buffer + m_readers[R])[i];
-        }
-        for (size_t i = 0; i < (n - here); ++i) {
-            destination[i + here] += m_buffer[i];
-        }
+        ringBufferAdd(destination, m_buffer + m_readers[R], here);
+        ringBufferAdd(destination + here, m_buffer, n - here);
     }
 
     m_readers[R] = (m_readers[R] + n) % m_size;
@@ -89,6 +89,13 @@ public:
     virtual void discardEvents() { }
     virtual void setIdealChannelCount(size_t channels) = 0; // must also silence(); may also re-instantiate
 
+    /**
+     * Grouped instances share state and are run together by whichever
+     * of them is run first, so they must not be run concurrently with
+     * each other.  See AudioInstrumentMixer::processBlocks().
+     */
+    virtual bool isInGroup() const { return false; }
+
     void setFactory(PluginFactory *f) { m_factory = f; } // ew
 
 protected:
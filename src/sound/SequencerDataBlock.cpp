@@ -20,9 +20,6 @@
 
 #include "misc/Debug.h"
 
-//#include <QThread>
-#include <QMutexLocker>
-
 namespace Rosegarden
 {
 
@@ -35,8 +32,30 @@ SequencerDataBlock::getInstance()
 }
 
 // cppcheck-suppress uninitMemberVar
-SequencerDataBlock::SequencerDataBlock()
+SequencerDataBlock::SequencerDataBlock() :
+    m_recordBuffer(SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE),
+    m_recordWriteCount(0),
+    m_recordReadCount(0),
+    m_recordDiscardCount(0),
+    m_recordDroppedCount(0),
+    m_recordOverflowing(false),
+    m_lastMasterLevelUpdate(0)
 {
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS; ++i) {
+        m_knownInstruments[i] = NoInstrument;
+        m_levels[i].updateIndex = 0;
+        m_recordLevels[i].updateIndex = 0;
+        m_lastLevelUpdate[i] = 0;
+        m_lastLevelUpdateForMixer[i] = 0;
+        m_lastRecordLevelUpdate[i] = 0;
+        m_lastRecordLevelUpdateForMixer[i] = 0;
+    }
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS; ++i) {
+        m_submasterLevels[i].updateIndex = 0;
+        m_lastSubmasterLevelUpdate[i] = 0;
+    }
+    m_masterLevel.updateIndex = 0;
+
     clearTemporaries();
 }
 
@@ -91,58 +110,80 @@ SequencerDataBlock::setVisual(const MappedEvent *ev)
 int
 SequencerDataBlock::getRecordedEvents(MappedEventList &mC)
 {
-    // Grab a copy of the stopping point in case the other thread
-    // changes it while we are working.
-    int stopIndex = m_recordEventIndex;
-
-    MappedEvent *recordBuffer = reinterpret_cast<MappedEvent *>(m_recordBuffer);
-
-    // While there are events in the record buffer, copy each event to
-    // the user's list.
-    while (m_readIndex != stopIndex) {
-        mC.insert(new MappedEvent(recordBuffer[m_readIndex]));
-
-        // Increment and wrap around to the beginning if needed.
-        if (++m_readIndex == SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE)
-            m_readIndex = 0;
+    unsigned readCount = m_recordReadCount.load(std::memory_order_relaxed);
+    // Acquire, so that the events up to here are visible.
+    const unsigned writeCount =
+            m_recordWriteCount.load(std::memory_order_acquire);
+
+    // Skip anything clearTemporaries() wants gone.  The counts wrap, so
+    // compare the difference.
+    const unsigned discardCount =
+            m_recordDiscardCount.load(std::memory_order_relaxed);
+    if (int(discardCount - readCount) > 0)
+        readCount = discardCount;
+
+    // Take everything that is there in one go.
+    while (readCount != writeCount) {
+        mC.insert(new MappedEvent(m_recordBuffer[
+                readCount % SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE]));
+        ++readCount;
     }
 
+    // Release, so that the sequencer doesn't overwrite the events until
+    // we've copied them.
+    m_recordReadCount.store(readCount, std::memory_order_release);
+
     return mC.size();
 }
 
 void
 SequencerDataBlock::addRecordedEvents(MappedEventList *mC)
 {
-    // Grab a copy of the record position so we don't update it
-    // while the other thread is using it.
-    int index = m_recordEventIndex;
+    unsigned writeCount = m_recordWriteCount.load(std::memory_order_relaxed);
+    const unsigned readCount =
+            m_recordReadCount.load(std::memory_order_acquire);
 
-    MappedEvent *recordBuffer = reinterpret_cast<MappedEvent *>(m_recordBuffer);
+    unsigned space =
+            SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE - (writeCount - readCount);
+    unsigned dropped = 0;
 
     // Copy each incoming event into the ring buffer.
     for (MappedEventList::iterator i = mC->begin(); i != mC->end(); ++i) {
-        recordBuffer[index] = **i;
-
-        // Increment and wrap around to the beginning if needed.
-        if (++index == SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE)
-            index = 0;
+        if (space == 0) {
+            ++dropped;
+            continue;
+        }
+
+        m_recordBuffer[writeCount % SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE] =
+                **i;
+        ++writeCount;
+        --space;
     }
 
-    // Once the buffer is in a consistent state, move the record index
-    // so that the other thread will read the new events.
-    // ??? Is this guaranteed to be atomic and therefore thread safe?
-    //     I believe so, and that's why this has always worked.
-    m_recordEventIndex = index;
+    // Publish the new events all at once.
+    m_recordWriteCount.store(writeCount, std::memory_order_release);
+
+    // Warn once per overflow, not on every call while it lasts.
+    if (dropped && !m_recordOverflowing) {
+        RG_WARNING << "addRecordedEvents(): record buffer full, dropping"
+                   << "events (" << m_recordDroppedCount
+                   << "dropped before this)";
+    }
+    m_recordDroppedCount += dropped;
+    m_recordOverflowing = (dropped != 0);
 }
 
 int
 SequencerDataBlock::instrumentToIndex(InstrumentId id) const
 {
-    int i;
-
-    for (i = 0; i < m_knownInstrumentCount; ++i) {
-        if (m_knownInstruments[i] == id)
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS; ++i) {
+        const InstrumentId known =
+                m_knownInstruments[i].load(std::memory_order_acquire);
+        if (known == id)
             return i;
+        // Entries are claimed in order, so that's all of them.
+        if (known == NoInstrument)
+            break;
     }
 
     return -1;
@@ -151,78 +192,80 @@ SequencerDataBlock::instrumentToIndex(InstrumentId id) const
 int
 SequencerDataBlock::instrumentToIndexCreating(InstrumentId id)
 {
-    int i;
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS; ++i) {
+        InstrumentId known =
+                m_knownInstruments[i].load(std::memory_order_acquire);
+        if (known == id)
+            return i;
+        if (known != NoInstrument)
+            continue;
 
-    for (i = 0; i < m_knownInstrumentCount; ++i) {
-        if (m_knownInstruments[i] == id)
+        // Claim this entry, unless another thread beats us to it.
+        if (m_knownInstruments[i].compare_exchange_strong(
+                    known, id, std::memory_order_acq_rel))
+            return i;
+        // Lost.  known now holds the winner's instrument.
+        if (known == id)
             return i;
     }
 
-    if (i == SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS) {
-        RG_WARNING << "ERROR: SequencerDataBlock::instrumentToIndexCreating("
-        << id << "): out of instrument index space";
-        return -1;
-    }
+    RG_WARNING << "ERROR: SequencerDataBlock::instrumentToIndexCreating("
+    << id << "): out of instrument index space";
+    return -1;
+}
+
+void
+SequencerDataBlock::setLevel(LevelSlot &slot, const LevelInfo &info)
+{
+    const uint64_t level = (uint64_t(uint32_t(info.level)) << 32) |
+                           uint64_t(uint32_t(info.levelRight));
+    slot.level.store(level, std::memory_order_relaxed);
+    // Release, so that whoever sees the new index sees the new level.
+    slot.updateIndex.fetch_add(1, std::memory_order_release);
+}
+
+bool
+SequencerDataBlock::getLevel(const LevelSlot &slot, LevelInfo &info,
+                             unsigned &lastUpdateIndex)
+{
+    const unsigned updateIndex =
+            slot.updateIndex.load(std::memory_order_acquire);
+    const uint64_t level = slot.level.load(std::memory_order_relaxed);
 
-    m_knownInstruments[i] = id;
-    ++m_knownInstrumentCount;
-    return i;
+    info.level = int(int32_t(uint32_t(level >> 32)));
+    info.levelRight = int(int32_t(uint32_t(level & 0xFFFFFFFF)));
+
+    if (lastUpdateIndex == updateIndex)
+        return false; // no change
+
+    lastUpdateIndex = updateIndex;
+    return true;
 }
 
 bool
 SequencerDataBlock::getInstrumentLevel(InstrumentId id,
                                        LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
     int index = instrumentToIndex(id);
     if (index < 0) {
         info.level = info.levelRight = 0;
         return false;
     }
 
-    int currentUpdateIndex = m_levelUpdateIndices[index];
-    info = m_levels[index];
-
-    /*
-    std::cout << "SequencerDataBlock::getInstrumentLevel - "
-              << "id = " << id
-              << ", level = " << info.level << std::endl;
-              */
-
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+    return getLevel(m_levels[index], info, m_lastLevelUpdate[index]);
 }
 
 bool
 SequencerDataBlock::getInstrumentLevelForMixer(InstrumentId id,
         LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
     int index = instrumentToIndex(id);
     if (index < 0) {
         info.level = info.levelRight = 0;
         return false;
     }
 
-    int currentUpdateIndex = m_levelUpdateIndices[index];
-    info = m_levels[index];
-
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+    return getLevel(m_levels[index], info, m_lastLevelUpdateForMixer[index]);
 }
 
 void
@@ -232,56 +275,33 @@ SequencerDataBlock::setInstrumentLevel(InstrumentId id, const LevelInfo &info)
     if (index < 0)
         return ;
 
-    m_levels[index] = info;
-    ++m_levelUpdateIndices[index];
+    setLevel(m_levels[index], info);
 }
 
 bool
 SequencerDataBlock::getInstrumentRecordLevel(InstrumentId id, LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
     int index = instrumentToIndex(id);
     if (index < 0) {
         info.level = info.levelRight = 0;
         return false;
     }
 
-    int currentUpdateIndex = m_recordLevelUpdateIndices[index];
-    info = m_recordLevels[index];
-
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+    return getLevel(m_recordLevels[index], info,
+                    m_lastRecordLevelUpdate[index]);
 }
 
 bool
 SequencerDataBlock::getInstrumentRecordLevelForMixer(InstrumentId id, LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
     int index = instrumentToIndex(id);
     if (index < 0) {
         info.level = info.levelRight = 0;
         return false;
     }
 
-    int currentUpdateIndex = m_recordLevelUpdateIndices[index];
-    info = m_recordLevels[index];
-
-    if (lastUpdateIndex[index] != currentUpdateIndex) {
-        lastUpdateIndex[index] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+    return getLevel(m_recordLevels[index], info,
+                    m_lastRecordLevelUpdateForMixer[index]);
 }
 
 void
@@ -291,8 +311,7 @@ SequencerDataBlock::setInstrumentRecordLevel(InstrumentId id, const LevelInfo &i
     if (index < 0)
         return ;
 
-    m_recordLevels[index] = info;
-    ++m_recordLevelUpdateIndices[index];
+    setLevel(m_recordLevels[index], info);
 }
 
 /* unused
@@ -318,24 +337,13 @@ SequencerDataBlock::getTrackLevel(TrackId track, LevelInfo &info) const
 bool
 SequencerDataBlock::getSubmasterLevel(int submaster, LevelInfo &info) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
-
     if (submaster < 0 || submaster >= SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS) {
         info.level = info.levelRight = 0;
         return false;
     }
 
-    int currentUpdateIndex = m_submasterLevelUpdateIndices[submaster];
-    info = m_submasterLevels[submaster];
-
-    if (lastUpdateIndex[submaster] != currentUpdateIndex) {
-        lastUpdateIndex[submaster] = currentUpdateIndex;
-        return true;
-    } else {
-        return false; // no change
-    }
+    return getLevel(m_submasterLevels[submaster], info,
+                    m_lastSubmasterLevelUpdate[submaster]);
 }
 
 void
@@ -345,33 +353,19 @@ SequencerDataBlock::setSubmasterLevel(int submaster, const LevelInfo &info)
         return ;
     }
 
-    m_submasterLevels[submaster] = info;
-    ++m_submasterLevelUpdateIndices[submaster];
+    setLevel(m_submasterLevels[submaster], info);
 }
 
 bool
 SequencerDataBlock::getMasterLevel(LevelInfo &level) const
 {
-    // ??? Move statics to class scope non-static and clear them appropriately
-    //     in clearTemporaries().
-    static int lastUpdateIndex = 0;
-
-    int currentIndex = m_masterLevelUpdateIndex;
-    level = m_masterLevel;
-
-    if (lastUpdateIndex != currentIndex) {
-        lastUpdateIndex = currentIndex;
-        return true;
-    } else {
-        return false;
-    }
+    return getLevel(m_masterLevel, level, m_lastMasterLevelUpdate);
 }
 
 void
 SequencerDataBlock::setMasterLevel(const LevelInfo &info)
 {
-    m_masterLevel = info;
-    ++m_masterLevelUpdateIndex;
+    setLevel(m_masterLevel, info);
 }
 
 void
@@ -385,26 +379,24 @@ SequencerDataBlock::clearTemporaries()
     m_haveVisualEvent = false;
     *((MappedEvent *)&m_visualEvent) = MappedEvent();
 
-    m_recordEventIndex = 0;
-    m_readIndex = 0;
-    memset(m_recordBuffer, 0, sizeof(m_recordBuffer));
-
-    memset(m_knownInstruments, 0, sizeof(m_knownInstruments));
-    m_knownInstrumentCount = 0;
-
-    memset(m_levelUpdateIndices, 0, sizeof(m_levelUpdateIndices));
-    memset(m_levels, 0, sizeof(m_levels));
+    // Have getRecordedEvents() skip everything added so far.  We can't
+    // touch the read count ourselves, as that belongs to the reader.
+    m_recordDiscardCount.store(
+            m_recordWriteCount.load(std::memory_order_acquire),
+            std::memory_order_relaxed);
 
-    memset(m_recordLevelUpdateIndices, 0, sizeof(m_recordLevelUpdateIndices));
-    memset(m_recordLevels, 0, sizeof(m_recordLevels));
+    // Zero the levels.  The update indices keep counting, so that the
+    // getters report the change.
+    const LevelInfo zero = { 0, 0 };
 
-    memset(m_submasterLevelUpdateIndices, 0,
-            sizeof(m_submasterLevelUpdateIndices));
-    memset(m_submasterLevels, 0, sizeof(m_submasterLevels));
-
-    m_masterLevelUpdateIndex = 0;
-    m_masterLevel.level = 0;
-    m_masterLevel.levelRight = 0;
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS; ++i) {
+        setLevel(m_levels[i], zero);
+        setLevel(m_recordLevels[i], zero);
+    }
+    for (int i = 0; i < SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS; ++i) {
+        setLevel(m_submasterLevels[i], zero);
+    }
+    setLevel(m_masterLevel, zero);
 }
 
 }
@@ -20,7 +20,10 @@
 #include "base/RealTime.h"
 #include "MappedEvent.h"
 
-#include <QMutex>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
 
 namespace Rosegarden
 {
@@ -43,7 +46,7 @@ class MappedEventList;
 
 #define SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS 512 // can't be a symbol
 #define SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS   64 // can't be a symbol
-#define SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE 1024 // MIDI events
+#define SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE 1024 // MIDI events, power of 2
 
 /// Holds MIDI data going from RosegardenSequencer to RosegardenMainWindow
 /**
@@ -53,8 +56,16 @@ class MappedEventList;
  * link in the chain from AlsaDriver::getMappedEventList() to
  * RosegardenDocument::insertRecordedMidi().
  *
- * This class needs to be reviewed for thread safety.  See the comments
- * in addRecordedEvents().
+ * Recorded events go through a single-producer, single-consumer ring
+ * buffer (m_recordBuffer).  The sequencer thread adds and the GUI thread
+ * takes, and neither ever waits for the other.  If the GUI falls a whole
+ * buffer behind, new events are dropped (with a warning) rather than
+ * overwriting ones it hasn't read yet.
+ *
+ * Levels are published a whole LevelInfo at a time, in a single atomic
+ * word, along with an update counter that the getters use to tell the
+ * caller whether anything has changed since it last asked.  So a meter
+ * never sees the left level from one update and the right from another.
  *
  * This used to be mapped into a shared memory
  * backed file, which had to be of fixed size and layout.  The design
@@ -108,12 +119,14 @@ public:
 
     /// Add events to the record ring buffer (m_recordBuffer).
     /**
-     * Called by RosegardenSequencer::processRecordedMidi().
+     * Called by RosegardenSequencer::processRecordedMidi().  Only one
+     * thread may call this.  Never blocks.
      */
     void addRecordedEvents(MappedEventList *);
-    /// Get events from the record ring buffer (m_recordBuffer).
+    /// Get all events waiting in the record ring buffer (m_recordBuffer).
     /**
-     * Called by RosegardenMainWindow::processRecordedEvents().
+     * Called by RosegardenMainWindow::processRecordedEvents().  Only one
+     * thread may call this.  Never blocks.
      */
     int getRecordedEvents(MappedEventList &);
 
@@ -142,14 +155,36 @@ public:
 
     // Reset this class on (for example) GUI restart
     // rename: reset()
+    /**
+     * Safe to call from any thread.  Recorded events not yet taken are
+     * discarded and all levels are set to zero.
+     */
     void clearTemporaries();
 
 protected:
     SequencerDataBlock();
 
     int instrumentToIndex(InstrumentId id) const;
+    /**
+     * Safe to call from more than one thread, as JackDriver and
+     * AlsaDriver both set instrument levels.
+     */
     int instrumentToIndexCreating(InstrumentId id);
 
+    /// A LevelInfo that one thread sets and others poll.
+    struct LevelSlot
+    {
+        /// LevelInfo::level in the high 32 bits, levelRight in the low.
+        std::atomic<uint64_t> level;
+        /// Incremented after each change to level.
+        std::atomic<unsigned> updateIndex;
+    };
+
+    static void setLevel(LevelSlot &slot, const LevelInfo &info);
+    /// Returns true if the level has been set since lastUpdateIndex.
+    static bool getLevel(const LevelSlot &slot, LevelInfo &info,
+                         unsigned &lastUpdateIndex);
+
     // ??? Thread-safe?  Probably not.  Seems like the worst-case is that
     //     the pointer might jump forward about one second momentarily.
     int m_positionSec;
@@ -161,49 +196,43 @@ protected:
     /// MIDI OUT event for display on the transport during playback.
     char m_visualEvent[sizeof(MappedEvent)];
 
-    /// Index of the next available position in m_recordBuffer.
-    /**
-     * volatile is needed here (and probably other places) since this is used
-     * across threads.  volatile prevents compiler optimizations (caching)
-     * that might render the data useless.  The chances that the compiler
-     * might optimize in this fashion are very slim given the code that uses
-     * this variable.  However, better safe than sorry.
-     */
-    volatile int m_recordEventIndex;
-    /// Read position in m_recordBuffer.
+    /// Ring buffer of recorded MIDI events.
     /**
-     * It's iffy as to whether "volatile" is actually needed here.  The two
-     * functions that use this may or may not be on different threads.
+     * Indexed by the event counts below, modulo the buffer size.
      */
-    int m_readIndex;
-    /// Ring buffer of recorded MIDI events.
+    std::vector<MappedEvent> m_recordBuffer;
+    /// Number of events ever added.  Set by addRecordedEvents() only.
+    std::atomic<unsigned> m_recordWriteCount;
+    /// Number of events ever taken.  Set by getRecordedEvents() only.
+    std::atomic<unsigned> m_recordReadCount;
+    /// getRecordedEvents() skips forward to here (see clearTemporaries()).
+    std::atomic<unsigned> m_recordDiscardCount;
+    /// Events dropped because the ring buffer was full.
+    unsigned m_recordDroppedCount;
+    /// Whether the last addRecordedEvents() call dropped events.
+    bool m_recordOverflowing;
+
+    /// Maps instruments to level slots.  NoInstrument means unused.
     /**
-     * This should probably be volatile for thread-safety, but that means
-     * the memset() call would need to be rewritten as a loop.  Or the
-     * volatile could be cast away.
+     * Entries are claimed, in order, by instrumentToIndexCreating() and
+     * never released.  InstrumentIds are stable, so the mapping stays
+     * valid across clearTemporaries().
      */
-    char m_recordBuffer[sizeof(MappedEvent) *
-                        SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE];
-
-    // ??? Thread-safe?
-    InstrumentId m_knownInstruments[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-    int m_knownInstrumentCount;
-
-    // ??? Thread-safe?
-    int m_levelUpdateIndices[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-    LevelInfo m_levels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
-    // ??? Thread-safe?
-    int m_recordLevelUpdateIndices[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-    LevelInfo m_recordLevels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
-
-    // ??? Thread-safe?
-    int m_submasterLevelUpdateIndices[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
-    LevelInfo m_submasterLevels[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
-
-    // ??? Thread-safe?
-    int m_masterLevelUpdateIndex;
-    LevelInfo m_masterLevel;
+    std::atomic<InstrumentId> m_knownInstruments[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+
+    LevelSlot m_levels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    LevelSlot m_recordLevels[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    LevelSlot m_submasterLevels[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
+    LevelSlot m_masterLevel;
+
+    // The update indices last seen by each of the getters.  These belong
+    // to the (GUI) threads that call the getters.
+    mutable unsigned m_lastLevelUpdate[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    mutable unsigned m_lastLevelUpdateForMixer[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    mutable unsigned m_lastRecordLevelUpdate[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    mutable unsigned m_lastRecordLevelUpdateForMixer[SEQUENCER_DATABLOCK_MAX_NB_INSTRUMENTS];
+    mutable unsigned m_lastSubmasterLevelUpdate[SEQUENCER_DATABLOCK_MAX_NB_SUBMASTERS];
+    mutable unsigned m_lastMasterLevelUpdate;
 };
 
 }
@@ -24,10 +24,15 @@
 #include "AudioPlayQueue.h"
 #include "PlayableAudioFile.h"
 
-#include <unistd.h>  // for usleep()
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
 #include <sys/time.h>
 #include <pthread.h> // for mutex
 
+#include <algorithm>
+
 //#define DEBUG_SOUND_DRIVER 1
 
 namespace Rosegarden
@@ -37,6 +42,7 @@ namespace Rosegarden
 SoundDriver::SoundDriver(MappedStudio *studio, const QString &name) :
         m_name(name),
         m_driverStatus(NO_DRIVER),
+        m_wakeFd(-1),
         m_playStartPosition(0, 0),
         m_playing(false),
         m_recordStatus(RECORD_OFF),
@@ -47,6 +53,10 @@ SoundDriver::SoundDriver(MappedStudio *studio, const QString &name) :
         m_studio(studio)
 {
     m_audioQueue = new AudioPlayQueue();
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0)
+        RG_WARNING << "ctor: eventfd() failed.  Sequencer will poll.";
 }
 
 SoundDriver::~SoundDriver()
@@ -55,6 +65,9 @@ SoundDriver::~SoundDriver()
 
     delete m_audioQueue;
     clearAudioFiles();
+
+    if (m_wakeFd >= 0)
+        close(m_wakeFd);
 }
 
 void
@@ -294,12 +307,49 @@ SoundDriver::clearAudioFiles()
 void
 SoundDriver::sleep(const RealTime &rt)
 {
-    // The usleep man page says it's deprecated and we should use
-    // nanosleep.  And that's what we did.  But it seems quite a few
-    // people don't have nanosleep, so we're reverting to usleep.
+    if (m_wakeFd < 0) {
+        unsigned long usec = rt.sec * 1000000 + rt.usec();
+        usleep(usec);
+        return;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = m_wakeFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    struct timespec timeout;
+    timeout.tv_sec = std::max(rt.sec, 0);
+    timeout.tv_nsec = (rt.sec < 0) ? 0 : std::max(rt.nsec, 0);
+
+    ppoll(&pfd, 1, &timeout, nullptr);
+
+    clearWake();
+}
+
+void
+SoundDriver::wake()
+{
+    if (m_wakeFd < 0)
+        return;
+
+    const uint64_t one = 1;
+    // Only fails if the counter would overflow, in which case
+    // we are well and truly awake.
+    ssize_t rc = write(m_wakeFd, &one, sizeof(one));
+    Q_UNUSED(rc);
+}
+
+void
+SoundDriver::clearWake()
+{
+    if (m_wakeFd < 0)
+        return;
 
-    unsigned long usec = rt.sec * 1000000 + rt.usec();
-    usleep(usec);
+    uint64_t count;
+    // Non-blocking.  Fails with EAGAIN if there was no wake().
+    ssize_t rc = read(m_wakeFd, &count, sizeof(count));
+    Q_UNUSED(rc);
 }
 
 
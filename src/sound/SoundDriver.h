@@ -171,8 +171,27 @@ public:
     virtual void setLoop(const RealTime & /*start*/,
                          const RealTime & /*end*/)  { }
 
+    /// Wait for up to rt, returning early if wake() is called.
+    /**
+     * Drivers that can also wait on their MIDI input (AlsaDriver) return
+     * early when MIDI arrives.
+     */
     virtual void sleep(const RealTime &rt);
 
+    /// Make a sleep() in progress (or the next one) return immediately.
+    /**
+     * Thread-safe.  Called by RosegardenSequencer when the GUI changes
+     * something the sequencer thread needs to act on.
+     */
+    void wake();
+
+    /// Whether there is scheduled output (e.g. note-offs) pending.
+    /**
+     * While this is true the sequencer thread keeps ticking even when
+     * stopped so that the output goes out on time.
+     */
+    virtual bool hasPendingEvents() const  { return false; }
+
     // Set MIDI clock interval - allow redefinition above to ensure
     // we handle this reset correctly.
     virtual void setMIDIClockInterval(RealTime interval)
@@ -331,6 +350,11 @@ protected:
 
     SoundDriverStatus m_driverStatus;
 
+    /// eventfd signalled by wake().  Subclasses must poll it in sleep().
+    int m_wakeFd;
+    /// Reset the eventfd after a sleep() that it may have woken.
+    void clearWake();
+
 
     // *** Sequencer ***
 
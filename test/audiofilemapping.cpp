@@ -0,0 +1,211 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "sound/AudioFileMapping.h"
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <fstream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+using namespace Rosegarden;
+
+// AudioFileMapping should find the sample data in WAV files whatever
+// chunks surround it, and notice when the file shrinks under it.
+// Reading speed is in test/benchmark.
+class TestAudioFileMapping : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testPlainWav();
+    void testChunksAroundData();
+    void testUnfinishedFile();
+    void testNotRiff();
+    void testReadAhead();
+    void testTruncated();
+
+private:
+    QString path(const char *name) const
+        { return m_dir.filePath(name); }
+
+    QTemporaryDir m_dir;
+};
+
+namespace
+{
+    // 16-bit stereo.
+    const size_t bytesPerFrame = 4;
+
+    void put32(std::string &s, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i) {
+            s += char((value >> (8 * i)) & 0xff);
+        }
+    }
+
+    void putChunk(std::string &s, const char *name, const std::string &data,
+                  uint32_t length)
+    {
+        s += name;
+        put32(s, length);
+        s += data;
+        if (data.size() % 2)
+            s += '\0';
+    }
+
+    /// Frame i has samples i and -i.
+    std::string frames(size_t count)
+    {
+        std::string data;
+        for (size_t i = 0; i < count; ++i) {
+            const int16_t left = int16_t(i);
+            const int16_t right = int16_t(-int(i));
+            data.append(reinterpret_cast<const char *>(&left), 2);
+            data.append(reinterpret_cast<const char *>(&right), 2);
+        }
+        return data;
+    }
+
+    std::string format()
+    {
+        std::string fmt;
+        fmt += char(1); fmt += char(0);          // PCM
+        fmt += char(2); fmt += char(0);          // channels
+        put32(fmt, 44100);
+        put32(fmt, 44100 * bytesPerFrame);
+        fmt += char(bytesPerFrame); fmt += char(0);
+        fmt += char(16); fmt += char(0);         // bits per sample
+        return fmt;
+    }
+
+    /// Write a WAV file with the given chunks after "fmt ".
+    void writeWav(const QString &path, const std::string &chunks)
+    {
+        std::string body = "WAVE";
+        putChunk(body, "fmt ", format(), 16);
+        body += chunks;
+
+        std::string file = "RIFF";
+        put32(file, uint32_t(body.size()));
+        file += body;
+
+        std::ofstream out(path.toLocal8Bit().constData(),
+                          std::ios::out | std::ios::binary);
+        out.write(file.data(), file.size());
+    }
+
+    int16_t sample(const AudioFileMapping &mapping, size_t frame, int channel)
+    {
+        int16_t value;
+        memcpy(&value, mapping.getFrames(frame) + 2 * channel, 2);
+        return value;
+    }
+}
+
+void TestAudioFileMapping::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+void TestAudioFileMapping::testPlainWav()
+{
+    std::string chunks;
+    putChunk(chunks, "data", frames(1000), 1000 * bytesPerFrame);
+    writeWav(path("plain.wav"), chunks);
+
+    AudioFileMapping mapping(path("plain.wav"), bytesPerFrame);
+    QVERIFY(mapping.isValid());
+    QCOMPARE(mapping.getFrameCount(), size_t(1000));
+    QCOMPARE(sample(mapping, 0, 0), int16_t(0));
+    QCOMPARE(sample(mapping, 999, 0), int16_t(999));
+    QCOMPARE(sample(mapping, 999, 1), int16_t(-999));
+}
+
+void TestAudioFileMapping::testChunksAroundData()
+{
+    // An odd-length chunk before the data (so there's a pad byte) and
+    // a chunk after it that mustn't be played.
+    std::string chunks;
+    putChunk(chunks, "LIST", "abc", 3);
+    putChunk(chunks, "data", frames(100), 100 * bytesPerFrame);
+    putChunk(chunks, "LIST", std::string(64, 'x'), 64);
+    writeWav(path("chunks.wav"), chunks);
+
+    AudioFileMapping mapping(path("chunks.wav"), bytesPerFrame);
+    QVERIFY(mapping.isValid());
+    QCOMPARE(mapping.getFrameCount(), size_t(100));
+    QCOMPARE(sample(mapping, 42, 0), int16_t(42));
+    QCOMPARE(sample(mapping, 99, 1), int16_t(-99));
+}
+
+void TestAudioFileMapping::testUnfinishedFile()
+{
+    // A recording that never had its header fixed up: take all the
+    // whole frames there are.
+    std::string chunks;
+    putChunk(chunks, "data", frames(50) + "xy", 0);
+    writeWav(path("unfinished.wav"), chunks);
+
+    AudioFileMapping mapping(path("unfinished.wav"), bytesPerFrame);
+    QVERIFY(mapping.isValid());
+    QCOMPARE(mapping.getFrameCount(), size_t(50));
+}
+
+void TestAudioFileMapping::testNotRiff()
+{
+    std::ofstream out(path("junk.wav").toLocal8Bit().constData());
+    out << "This is not a WAV file at all";
+    out.close();
+
+    QVERIFY(!AudioFileMapping(path("junk.wav"), bytesPerFrame).isValid());
+    QVERIFY(!AudioFileMapping(path("missing.wav"), bytesPerFrame).isValid());
+}
+
+void TestAudioFileMapping::testReadAhead()
+{
+    std::string chunks;
+    putChunk(chunks, "data", frames(10000), 10000 * bytesPerFrame);
+    writeWav(path("readahead.wav"), chunks);
+
+    AudioFileMapping mapping(path("readahead.wav"), bytesPerFrame);
+    QVERIFY(mapping.isValid());
+
+    // Past the end, after seeks, and so on: none of this should fail
+    // or touch anything outside the mapping.
+    for (size_t frame = 0; frame < 12000; frame += 700) {
+        mapping.readAhead(frame, 4096);
+    }
+    mapping.resetReadAhead();
+    mapping.readAhead(500, 1000000);
+    mapping.readAhead(9999, 1);
+}
+
+void TestAudioFileMapping::testTruncated()
+{
+    std::string chunks;
+    putChunk(chunks, "data", frames(1000), 1000 * bytesPerFrame);
+    writeWav(path("truncated.wav"), chunks);
+
+    AudioFileMapping mapping(path("truncated.wav"), bytesPerFrame);
+    QVERIFY(mapping.isValid());
+    QVERIFY(mapping.isIntact());
+
+    // Growing is fine; only the mapped part is read.
+    QFile file(path("truncated.wav"));
+    const qint64 size = file.size();
+    QVERIFY(file.resize(size + 100));
+    QVERIFY(mapping.isIntact());
+
+    // Shrinking isn't.  Nothing is read here, as that would be SIGBUS.
+    QVERIFY(file.resize(size - 100));
+    QVERIFY(!mapping.isIntact());
+}
+
+QTEST_MAIN(TestAudioFileMapping)
+
+#include "audiofilemapping.moc"
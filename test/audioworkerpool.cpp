@@ -0,0 +1,159 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "sound/AudioWorkerPool.h"
+#include <QTest>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+using namespace Rosegarden;
+
+// Every task of every AudioWorkerPool job must run exactly once, with a
+// worker number in range, even when jobs follow each other closely.
+class TestAudioWorkerPool : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testNoWorkers();
+    void testEachTaskOnce_data();
+    void testEachTaskOnce();
+    void testBackToBackJobs();
+};
+
+namespace
+{
+    struct Counts
+    {
+        std::vector<int> runs;
+        std::vector<int> workers;
+        int maxWorker;
+        std::atomic<int> badWorker;
+        std::atomic<int> badTask;
+    };
+
+    void countTask(void *context, size_t task, int worker)
+    {
+        Counts *counts = static_cast<Counts *>(context);
+        if (task >= counts->runs.size()) {
+            ++counts->badTask;
+            return;
+        }
+        // No lock needed: each task is run by one thread only.
+        ++counts->runs[task];
+        counts->workers[task] = worker;
+        if (worker < 0 || worker > counts->maxWorker)
+            ++counts->badWorker;
+    }
+}
+
+void TestAudioWorkerPool::testNoWorkers()
+{
+    AudioWorkerPool pool("test", 0, 0);
+    QCOMPARE(pool.getWorkerCount(), 0);
+
+    Counts counts;
+    counts.runs.resize(10);
+    counts.workers.resize(10);
+    counts.maxWorker = 0;
+    counts.badWorker = 0;
+    counts.badTask = 0;
+
+    pool.run(countTask, &counts, 10);
+
+    for (size_t task = 0; task < 10; ++task) {
+        QCOMPARE(counts.runs[task], 1);
+        QCOMPARE(counts.workers[task], 0);
+    }
+}
+
+void TestAudioWorkerPool::testEachTaskOnce_data()
+{
+    QTest::addColumn<int>("workers");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("3") << 3;
+    QTest::newRow("7") << 7;
+}
+
+void TestAudioWorkerPool::testEachTaskOnce()
+{
+    QFETCH(int, workers);
+
+    AudioWorkerPool pool("test", workers, 0);
+    QCOMPARE(pool.getWorkerCount(), workers);
+
+    // Many short jobs of varying size, so that slow workers are often
+    // still looking at one job when the next starts.
+    for (int job = 0; job < 5000; ++job) {
+        const size_t count = job % 40;
+
+        Counts counts;
+        counts.runs.resize(count);
+        counts.workers.resize(count);
+        counts.maxWorker = workers;
+        counts.badWorker = 0;
+        counts.badTask = 0;
+
+        pool.run(countTask, &counts, count);
+
+        for (size_t task = 0; task < count; ++task) {
+            QCOMPARE(counts.runs[task], 1);
+        }
+        QCOMPARE(counts.badWorker.load(), 0);
+        QCOMPARE(counts.badTask.load(), 0);
+    }
+}
+
+namespace
+{
+    /// countTask(), but slow enough on some tasks that the other
+    /// threads are often between jobs when the next one starts.
+    void slowCountTask(void *context, size_t task, int worker)
+    {
+        if (task % 3 == 0) {
+            volatile float sample = 0.0f;
+            for (int i = 0; i < 200; ++i) {
+                sample = sinf(sample + 0.01f);
+            }
+        }
+        countTask(context, task, worker);
+    }
+}
+
+void TestAudioWorkerPool::testBackToBackJobs()
+{
+    // A short job straight after a long one and the other way round,
+    // each with its own context.  A thread that claimed a task from
+    // one job must never run it with the next job's function, context
+    // or count.
+    const size_t sizes[] = { 2, 64, 1, 33, 3, 17 };
+    const int workers = 4;
+
+    AudioWorkerPool pool("test", workers, 0);
+
+    for (int job = 0; job < 20000; ++job) {
+        const size_t count = sizes[job % 6];
+
+        Counts counts;
+        counts.runs.resize(count);
+        counts.workers.resize(count);
+        counts.maxWorker = workers;
+        counts.badWorker = 0;
+        counts.badTask = 0;
+
+        pool.run(slowCountTask, &counts, count);
+
+        // run() has returned, so every task must have finished.
+        for (size_t task = 0; task < count; ++task) {
+            QCOMPARE(counts.runs[task], 1);
+        }
+        QCOMPARE(counts.badTask.load(), 0);
+        QCOMPARE(counts.badWorker.load(), 0);
+    }
+}
+
+QTEST_MAIN(TestAudioWorkerPool)
+
+#include "audioworkerpool.moc"
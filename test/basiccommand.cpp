@@ -0,0 +1,160 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/BaseProperties.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "document/BasicCommand.h"
+#include "document/Command.h"
+#include <QTest>
+
+using namespace Rosegarden;
+
+// BasicCommand should keep only what it needs for undo and redo, and
+// still undo and redo correctly.
+class TestBasicCommand : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testUndoRedo_data();
+    void testUndoRedo();
+    void testMemoryUsage();
+    void testMacroCommand();
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+
+    /// Transposes the notes in [from, to) up an octave, in place.
+    class OctaveCommand : public BasicCommand
+    {
+    public:
+        OctaveCommand(Segment &segment, timeT from, timeT to,
+                      bool bruteForceRedo) :
+            BasicCommand("Octave", segment, from, to, bruteForceRedo),
+            m_from(from),
+            m_to(to)
+        { }
+
+    protected:
+        void modifySegment() override
+        {
+            Segment &segment = getSegment();
+            for (Segment::iterator i = segment.findTime(m_from);
+                 i != segment.findTime(m_to); ++i) {
+                const long pitch = (*i)->get<Int>(BaseProperties::PITCH);
+                (*i)->set<Int>(BaseProperties::PITCH, pitch + 12);
+            }
+        }
+
+    private:
+        timeT m_from;
+        timeT m_to;
+    };
+
+    Segment *makeSegment(int count)
+    {
+        Segment *segment = new Segment;
+        for (int i = 0; i < count; ++i) {
+            Event *e = new Event(Note::EventType, i * crotchet, crotchet);
+            e->set<Int>(BaseProperties::PITCH, 36 + i % 48);
+            segment->insert(e);
+        }
+        return segment;
+    }
+
+    long pitchAt(const Segment &segment, timeT time)
+    {
+        return (*segment.findTime(time))->get<Int>(BaseProperties::PITCH);
+    }
+
+    long pitchSum(const Segment &segment)
+    {
+        long sum = 0;
+        for (const Event *e : segment) {
+            sum += e->get<Int>(BaseProperties::PITCH);
+        }
+        return sum;
+    }
+}
+
+void TestBasicCommand::testUndoRedo_data()
+{
+    QTest::addColumn<bool>("bruteForceRedo");
+
+    QTest::newRow("modifySegment") << false;
+    QTest::newRow("brute force") << true;
+}
+
+void TestBasicCommand::testUndoRedo()
+{
+    QFETCH(bool, bruteForceRedo);
+
+    Segment *segment = makeSegment(100);
+    const long before = pitchSum(*segment);
+    const long pitch = pitchAt(*segment, 40 * crotchet);
+
+    OctaveCommand command(*segment, 40 * crotchet, 50 * crotchet,
+                          bruteForceRedo);
+
+    for (int pass = 0; pass < 3; ++pass) {
+        command.execute();
+        QCOMPARE(pitchAt(*segment, 40 * crotchet), pitch + 12);
+        QCOMPARE(pitchSum(*segment), before + 10 * 12);
+        QCOMPARE(segment->size(), size_t(100));
+
+        command.unexecute();
+        QCOMPARE(pitchAt(*segment, 40 * crotchet), pitch);
+        QCOMPARE(pitchSum(*segment), before);
+        QCOMPARE(segment->size(), size_t(100));
+    }
+
+    delete segment;
+}
+
+void TestBasicCommand::testMemoryUsage()
+{
+    Segment *segment = makeSegment(10000);
+
+    OctaveCommand small(*segment, 5000 * crotchet, 5001 * crotchet, true);
+    small.execute();
+    const size_t smallUsage = small.getMemoryUsage();
+    small.unexecute();
+    QCOMPARE(small.getMemoryUsage(), smallUsage);
+
+    OctaveCommand large(*segment, 0, 10000 * crotchet, true);
+    large.execute();
+    const size_t largeUsage = large.getMemoryUsage();
+    large.unexecute();
+
+    // One note's worth rather than a copy of the whole segment.
+    QVERIFY(smallUsage * 100 < largeUsage);
+
+    delete segment;
+}
+
+void TestBasicCommand::testMacroCommand()
+{
+    Segment *segment = makeSegment(1000);
+
+    MacroCommand macro("Both");
+    OctaveCommand *first = new OctaveCommand(*segment, 0, 10 * crotchet, false);
+    OctaveCommand *second =
+            new OctaveCommand(*segment, 500 * crotchet, 600 * crotchet, false);
+    macro.addCommand(first);
+    macro.addCommand(second);
+    macro.execute();
+
+    QCOMPARE(macro.getMemoryUsage(),
+             first->getMemoryUsage() + second->getMemoryUsage());
+    QVERIFY(second->getMemoryUsage() > first->getMemoryUsage());
+
+    delete segment;
+}
+
+QTEST_MAIN(TestBasicCommand)
+
+#include "basiccommand.moc"
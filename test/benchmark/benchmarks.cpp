@@ -0,0 +1,1157 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/BaseProperties.h"
+#include "base/BasicQuantizer.h"
+#include "base/Composition.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "base/SegmentLinker.h"
+#include "base/Selection.h"
+#include "base/TempoMap.h"
+#include "base/Trace.h"
+#include "base/Track.h"
+#include "commands/edit/TransposeCommand.h"
+#include "document/BasicCommand.h"
+#include "document/CommandHistory.h"
+#include "document/GzipFile.h"
+#include "document/GzipReader.h"
+#include "document/RosegardenDocument.h"
+#include "document/io/XMLHandler.h"
+#include "document/io/XMLReader.h"
+#include "gui/editors/notation/NotationScene.h"
+#include "gui/editors/notation/NotationWidget.h"
+#include "gui/editors/notation/NotePixmapCache.h"
+#include "gui/editors/segment/compositionview/SegmentIndex.h"
+#include "gui/seqmanager/SegmentMapper.h"
+#include "misc/ConfigGroups.h"
+#include "sound/AudioFileMapping.h"
+#include "sound/AudioWorkerPool.h"
+#include "sound/MidiFile.h"
+#include "sound/MixKernels.h"
+#include "sound/NoteOffQueue.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QSettings>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace Rosegarden;
+
+// Times core operations on a synthetic composition and writes the
+// results as JSON, so that runs can be compared.  See README for the
+// environment variables that set the scale and the output file.
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+public:
+    Benchmarks();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkSave();
+    void benchmarkLoad();
+    void benchmarkMidiExport();
+    void benchmarkMidiImport();
+    void benchmarkMidiFolder();
+    void benchmarkSegmentMapper();
+    void benchmarkNotationLayout();
+    void benchmarkNotationLayoutStaves();
+    void benchmarkQuantize();
+    void benchmarkTranspose();
+    void benchmarkParse();
+    void benchmarkSegmentMapperRefresh();
+    void benchmarkSegmentIndex();
+    void benchmarkTempoMap();
+    void benchmarkEdit();
+    void benchmarkEventSelection();
+    void benchmarkEventPool();
+    void benchmarkNoteOffQueue();
+    void benchmarkMixKernels();
+    void benchmarkAudioWorkerPool();
+    void benchmarkAudioFileRead();
+    void benchmarkTraceScope();
+
+private:
+    /// Fill m_doc according to the scale settings.
+    void generate();
+
+    /// Time run m_iterations times, calling setup (untimed) before
+    /// each, and record the result under name.  Returns the median in
+    /// milliseconds.
+    double measure(const QString &name,
+                   const std::function<void()> &setup,
+                   const std::function<void()> &run);
+    double measure(const QString &name, const std::function<void()> &run)
+        { return measure(name, std::function<void()>(), run); }
+
+    QString path(const char *name) const
+        { return m_dir.filePath(name); }
+
+    /// The segments generated for each track, without the links.
+    std::vector<Segment *> m_sources;
+
+    int m_tracks;
+    int m_events;
+    int m_tempoChanges;
+    int m_links;
+    int m_staves;
+    int m_audioSeconds;
+    int m_iterations;
+    QString m_midiDir;
+    QString m_output;
+
+    QTemporaryDir m_dir;
+    RosegardenDocument m_doc;
+    QJsonArray m_results;
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+
+    int setting(const char *name, int defaultValue)
+    {
+        bool ok = false;
+        const int value = qEnvironmentVariableIntValue(name, &ok);
+        return (ok && value >= 0) ? value : defaultValue;
+    }
+
+    Event *makeNote(timeT time, timeT duration, int pitch, int velocity)
+    {
+        Event *event = new Event(Note::EventType, time, duration);
+        event->set<Int>(BaseProperties::PITCH, pitch);
+        event->set<Int>(BaseProperties::VELOCITY, velocity);
+        return event;
+    }
+
+    /// Fill segment with events notes, in four notes a bar with a held
+    /// chord under every other bar.  t varies the pitches.
+    void addNotes(Segment *segment, int t, int events)
+    {
+        int count = 0;
+        for (int bar = 0; count < events; ++bar) {
+            const timeT barStart = bar * 4 * crotchet;
+            for (int beat = 0; beat < 4 && count < events; ++beat) {
+                segment->insert(makeNote(barStart + beat * crotchet, crotchet,
+                                         60 + (t * 5 + bar + beat) % 24,
+                                         64 + beat * 16));
+                ++count;
+            }
+            for (int note = 0; bar % 2 == 0 && note < 3 && count < events;
+                 ++note) {
+                segment->insert(makeNote(barStart, 8 * crotchet,
+                                         36 + t % 12 + note * 4, 80));
+                ++count;
+            }
+        }
+    }
+
+    /// Add a track with a segment filled by addNotes().
+    Segment *addNoteTrack(Composition &composition, int t, int events)
+    {
+        const TrackId trackId = composition.getNewTrackId();
+        composition.addTrack(new Track(trackId));
+
+        Segment *segment = new Segment;
+        segment->setTrack(trackId);
+        segment->setLabel(QString("Track %1").arg(t).toStdString());
+        composition.addSegment(segment);
+
+        addNotes(segment, t, events);
+
+        return segment;
+    }
+
+    /// Counts the elements in an XML file.
+    class ElementCounter : public XMLHandler
+    {
+    public:
+        ElementCounter() : m_count(0) { }
+
+        bool startElement(const QString & /* namespaceURI */,
+                          const QString & /* localName */,
+                          const QString & /* qName */,
+                          const QXmlStreamAttributes & /* atts */) override
+        {
+            ++m_count;
+            return true;
+        }
+
+        int m_count;
+    };
+
+    /// Sets the velocity of the note at a time, in place.
+    class VelocityCommand : public BasicCommand
+    {
+    public:
+        VelocityCommand(Segment &segment, timeT time, int velocity) :
+            BasicCommand("Set Velocity", segment, time, time + crotchet),
+            m_time(time),
+            m_velocity(velocity)
+        { }
+
+    protected:
+        void modifySegment() override
+        {
+            Event *event = *getSegment().findTime(m_time);
+            event->set<Int>(BaseProperties::VELOCITY, m_velocity);
+        }
+
+    private:
+        timeT m_time;
+        int m_velocity;
+    };
+
+    /// Roughly the cost of a plugin chain on one instrument.
+    void pluginTask(void *context, size_t task, int /* worker */)
+    {
+        std::vector<std::vector<float> > *buffers =
+                static_cast<std::vector<std::vector<float> > *>(context);
+        for (int pass = 0; pass < 20; ++pass) {
+            for (float &sample : (*buffers)[task]) {
+                sample = sinf(sample + 0.01f);
+            }
+        }
+    }
+
+    void put16(QByteArray &bytes, uint16_t value)
+    {
+        bytes.append(char(value & 0xff));
+        bytes.append(char(value >> 8));
+    }
+
+    void put32(QByteArray &bytes, uint32_t value)
+    {
+        put16(bytes, uint16_t(value & 0xffff));
+        put16(bytes, uint16_t(value >> 16));
+    }
+
+    /// A WAV file of frames of 16-bit stereo at 44.1kHz.
+    QByteArray makeWav(size_t frames)
+    {
+        const uint32_t dataSize = uint32_t(frames * 4);
+
+        QByteArray wav("RIFF");
+        put32(wav, 36 + dataSize);
+        wav += "WAVEfmt ";
+        put32(wav, 16);
+        put16(wav, 1);  // PCM
+        put16(wav, 2);  // channels
+        put32(wav, 44100);
+        put32(wav, 44100 * 4);
+        put16(wav, 4);  // bytes per frame
+        put16(wav, 16);  // bits per sample
+        wav += "data";
+        put32(wav, dataSize);
+
+        for (size_t i = 0; i < frames; ++i) {
+            put16(wav, uint16_t(i));
+            put16(wav, uint16_t(-int(i)));
+        }
+
+        return wav;
+    }
+
+    void tracedScope()
+    {
+        RG_TRACE_SCOPE("Benchmarks traced scope");
+    }
+}
+
+Benchmarks::Benchmarks() :
+    m_tracks(setting("RG_BENCH_TRACKS", 8)),
+    m_events(setting("RG_BENCH_EVENTS", 2000)),
+    m_tempoChanges(setting("RG_BENCH_TEMPOS", 50)),
+    m_links(setting("RG_BENCH_LINKS", 8)),
+    m_staves(setting("RG_BENCH_STAVES", 40)),
+    m_audioSeconds(std::max(1, setting("RG_BENCH_AUDIO_SECONDS", 5))),
+    m_iterations(std::max(1, setting("RG_BENCH_ITERATIONS", 5))),
+    m_midiDir(qEnvironmentVariable("RG_BENCH_MIDI_DIR")),
+    m_output(qEnvironmentVariable("RG_BENCH_JSON", "benchmarks.json")),
+    m_doc(nullptr, {}, true /*skip autoload*/, true, false /*no sound*/)
+{
+}
+
+void Benchmarks::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    // Make sure settings end up in the right place.
+    QCoreApplication::setOrganizationName("rosegardenmusic");
+
+    QSettings settings;
+    settings.beginGroup("Sequencer_Options");
+    // MidiFile: Don't start JACK.
+    settings.setValue("autostartjack", false);
+    settings.endGroup();
+
+    RosegardenDocument::currentDocument = &m_doc;
+    generate();
+}
+
+void Benchmarks::generate()
+{
+    Composition &composition = m_doc.getComposition();
+
+    timeT end = 0;
+    for (int t = 0; t < m_tracks; ++t) {
+        Segment *segment = addNoteTrack(composition, t, m_events);
+        m_sources.push_back(segment);
+        end = std::max(end, segment->getEndTime());
+    }
+
+    // Links to the generated segments, on tracks of their own, after
+    // the originals.
+    for (int l = 0; l < m_links && !m_sources.empty(); ++l) {
+        Segment *source = m_sources[l % m_sources.size()];
+        const TrackId trackId = composition.getNewTrackId();
+        composition.addTrack(new Track(trackId));
+
+        Segment *link = SegmentLinker::createLinkedSegment(source);
+        link->setTrack(trackId);
+        link->setStartTime(end);
+        composition.addSegment(link);
+    }
+
+    // Tempo changes spread evenly over the originals, every third one
+    // a ramp.
+    for (int c = 0; c < m_tempoChanges && end > 0; ++c) {
+        composition.addTempoAtTime(
+                end / m_tempoChanges * c,
+                Composition::getTempoForQpm(90 + (c * 7) % 60),
+                c % 3 ? -1 : 0);
+    }
+}
+
+double Benchmarks::measure(const QString &name,
+                           const std::function<void()> &setup,
+                           const std::function<void()> &run)
+{
+    std::vector<double> times;
+
+    for (int i = 0; i < m_iterations; ++i) {
+        if (setup)
+            setup();
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        times.push_back(timer.nsecsElapsed() / 1.0e6);
+    }
+
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (double t : times) {
+        total += t;
+    }
+
+    QJsonObject result;
+    result["name"] = name;
+    result["iterations"] = m_iterations;
+    result["min_ms"] = times.front();
+    result["median_ms"] = times[times.size() / 2];
+    result["mean_ms"] = total / times.size();
+    result["max_ms"] = times.back();
+    m_results.append(result);
+
+    qInfo("%-20s median %10.3f ms  min %10.3f ms",
+          qPrintable(name), times[times.size() / 2], times.front());
+
+    return times[times.size() / 2];
+}
+
+void Benchmarks::cleanupTestCase()
+{
+    RosegardenDocument::currentDocument = nullptr;
+
+    QJsonObject scale;
+    scale["tracks"] = m_tracks;
+    scale["events_per_segment"] = m_events;
+    scale["tempo_changes"] = m_tempoChanges;
+    scale["linked_segments"] = m_links;
+    scale["staves"] = m_staves;
+    scale["audio_seconds"] = m_audioSeconds;
+    if (!m_midiDir.isEmpty())
+        scale["midi_dir"] = m_midiDir;
+
+    QJsonObject root;
+    root["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["qt_version"] = QString(qVersion());
+    root["scale"] = scale;
+    root["results"] = m_results;
+
+    QFile file(m_output);
+    QVERIFY2(file.open(QIODevice::WriteOnly | QIODevice::Truncate),
+             qPrintable(m_output));
+    file.write(QJsonDocument(root).toJson());
+}
+
+void Benchmarks::benchmarkSave()
+{
+    measure("rg_save", [this]() {
+        QString errMsg;
+        QVERIFY2(m_doc.saveDocument(path("save.rg"), errMsg),
+                 qPrintable(errMsg));
+    });
+}
+
+void Benchmarks::benchmarkLoad()
+{
+    QString errMsg;
+    QVERIFY2(m_doc.saveDocument(path("load.rg"), errMsg), qPrintable(errMsg));
+
+    std::unique_ptr<RosegardenDocument> loaded;
+
+    measure("rg_load",
+            [&loaded]() {
+                loaded.reset(new RosegardenDocument(nullptr, {}, true, true,
+                                                    false));
+            },
+            [this, &loaded]() {
+                QVERIFY(loaded->openDocument(path("load.rg"),
+                                             false /*permanent*/,
+                                             true /*no progress*/,
+                                             false /*no lock*/));
+            });
+
+    QCOMPARE(loaded->getComposition().getNbSegments(),
+             m_doc.getComposition().getNbSegments());
+
+    loaded.reset();
+    RosegardenDocument::currentDocument = &m_doc;
+}
+
+void Benchmarks::benchmarkMidiExport()
+{
+    measure("midi_export", [this]() {
+        MidiFile midiFile;
+        QVERIFY(midiFile.convertToMidi(&m_doc, path("export.mid")));
+    });
+}
+
+void Benchmarks::benchmarkMidiImport()
+{
+    {
+        MidiFile midiFile;
+        QVERIFY(midiFile.convertToMidi(&m_doc, path("import.mid")));
+    }
+
+    std::unique_ptr<RosegardenDocument> imported;
+
+    measure("midi_import",
+            [&imported]() {
+                imported.reset(new RosegardenDocument(nullptr, {}, true, true,
+                                                      false));
+            },
+            [this, &imported]() {
+                MidiFile midiFile;
+                QVERIFY2(midiFile.convertToRosegarden(path("import.mid"),
+                                                      imported.get()),
+                         midiFile.getError().c_str());
+            });
+
+    QVERIFY(imported->getComposition().getNbSegments() > 0);
+
+    imported.reset();
+    RosegardenDocument::currentDocument = &m_doc;
+}
+
+void Benchmarks::benchmarkMidiFolder()
+{
+    QDir dir(m_midiDir);
+
+    // Without a folder of real files, use copies of the composition.
+    if (m_midiDir.isEmpty()) {
+        QVERIFY(QDir(m_dir.path()).mkpath("midi"));
+        dir.setPath(path("midi"));
+        for (int i = 0; i < 4; ++i) {
+            MidiFile midiFile;
+            QVERIFY(midiFile.convertToMidi(
+                    &m_doc, dir.filePath(QString("%1.mid").arg(i))));
+        }
+    }
+
+    const QFileInfoList files = dir.entryInfoList(
+            QStringList() << "*.mid" << "*.midi" << "*.MID" << "*.MIDI",
+            QDir::Files);
+    QVERIFY2(!files.isEmpty(), qPrintable(dir.path()));
+
+    qint64 bytes = 0;
+    for (const QFileInfo &file : files) {
+        bytes += file.size();
+    }
+
+    // Files that fail to import are counted, not fatal, as a folder of
+    // real-world files is bound to have a few.
+    int failed = 0;
+
+    // convertToRosegarden() clears the composition first, so one
+    // document will do for all of them.
+    std::unique_ptr<RosegardenDocument> doc(
+            new RosegardenDocument(nullptr, {}, true, true, false));
+
+    const double ms = measure("midi_folder_import",
+                              [&files, &failed, &doc]() {
+        failed = 0;
+        for (const QFileInfo &file : files) {
+            MidiFile midiFile;
+            if (!midiFile.convertToRosegarden(file.filePath(), doc.get()))
+                ++failed;
+        }
+    });
+
+    doc.reset();
+    RosegardenDocument::currentDocument = &m_doc;
+
+    QJsonObject result = m_results.last().toObject();
+    result["files"] = files.size();
+    result["failed"] = failed;
+    result["bytes"] = bytes;
+    result["mb_per_s"] = ms > 0 ? bytes / 1.0e6 / (ms / 1000.0) : 0.0;
+    m_results.replace(m_results.size() - 1, result);
+
+    qInfo("%-20s %d files, %.1f MB/s", "", int(files.size()),
+          result["mb_per_s"].toDouble());
+}
+
+void Benchmarks::benchmarkSegmentMapper()
+{
+    Composition &composition = m_doc.getComposition();
+
+    measure("segment_mapper_fill", [this, &composition]() {
+        for (Segment *segment : composition) {
+            QSharedPointer<SegmentMapper> mapper =
+                    SegmentMapper::makeMapperForSegment(&m_doc, segment);
+            mapper->init();
+        }
+    });
+}
+
+void Benchmarks::benchmarkNotationLayout()
+{
+    NotationWidget widget;
+    widget.setSegments(&m_doc, m_sources);
+    QVERIFY(widget.getScene());
+
+    measure("notation_layout", [&widget]() {
+        widget.getScene()->layoutAll();
+    });
+}
+
+void Benchmarks::benchmarkNotationLayoutStaves()
+{
+    // A score of m_staves staffs in a document of its own, laid out
+    // with the staffs scanned at once, then one at a time.
+    RosegardenDocument doc(nullptr, {}, true, true, false);
+    RosegardenDocument::currentDocument = &doc;
+
+    std::vector<Segment *> segments;
+    for (int t = 0; t < m_staves; ++t) {
+        segments.push_back(addNoteTrack(doc.getComposition(), t,
+                                        std::max(1, m_events / 4)));
+    }
+
+    {
+        NotationWidget widget;
+        widget.setSegments(&doc, segments);
+        QVERIFY(widget.getScene());
+
+        measure("notation_layout_staves", [&widget]() {
+            widget.getScene()->layoutAll();
+        });
+
+        // NotationScene scans serially when the pool has one thread.
+        QThreadPool *pool = QThreadPool::globalInstance();
+        const int threads = pool->maxThreadCount();
+        pool->setMaxThreadCount(1);
+        measure("notation_layout_staves_serial", [&widget]() {
+            widget.getScene()->layoutAll();
+        });
+        pool->setMaxThreadCount(threads);
+
+        // A single note added to, then removed from, the middle of
+        // the first staff, as an edit would, so only its bars need
+        // laying out again.
+        Segment *segment = segments.front();
+        const timeT middle = segment->getBarStartForTime(
+                (segment->getStartTime() + segment->getEndMarkerTime()) / 2);
+        Segment::iterator added = segment->end();
+        measure("notation_relayout_edit",
+                [segment, middle, &added]() {
+                    if (added == segment->end()) {
+                        added = segment->insert(
+                                makeNote(middle + crotchet / 2, crotchet / 2,
+                                         61, 100));
+                    } else {
+                        segment->erase(added);
+                        added = segment->end();
+                    }
+                },
+                [&widget]() {
+                    widget.getScene()->slotCommandExecuted();
+                });
+        if (added != segment->end())
+            segment->erase(added);
+
+        // Painting the top left of the score at 1:1.  After the first
+        // time the notes come from the shared pixmap cache.
+        QImage image(1600, 1000, QImage::Format_ARGB32_Premultiplied);
+        NotePixmapCache::resetStatistics();
+        measure("notation_paint", [&widget, &image]() {
+            QPainter painter(&image);
+            widget.getScene()->render(&painter, image.rect(), image.rect());
+        });
+
+        const NotePixmapCache::Statistics statistics =
+                NotePixmapCache::getStatistics();
+        qInfo("%-20s %d hits, %d misses", "note pixmaps",
+              int(statistics.hits), int(statistics.misses));
+    }
+
+    // And with items made only near the viewport.  The viewport is
+    // rendered from the event loop, so run that too.
+    {
+        QSettings settings;
+        settings.beginGroup(NotationViewConfigGroup);
+        const QVariant lazyRendering = settings.value("lazyrendering");
+        settings.setValue("lazyrendering", true);
+
+        NotationWidget widget;
+        widget.setSegments(&doc, segments);
+        QVERIFY(widget.getScene());
+
+        measure("notation_layout_staves_lazy", [&widget]() {
+            widget.getScene()->layoutAll();
+            QCoreApplication::processEvents();
+        });
+
+        qInfo("%-20s %d items", "lazy", widget.getScene()->items().size());
+
+        if (lazyRendering.isValid())
+            settings.setValue("lazyrendering", lazyRendering);
+        else
+            settings.remove("lazyrendering");
+        settings.endGroup();
+    }
+
+    RosegardenDocument::currentDocument = &m_doc;
+}
+
+void Benchmarks::benchmarkQuantize()
+{
+    QVERIFY(!m_sources.empty());
+
+    const BasicQuantizer quantizer(crotchet / 2, true);
+    std::unique_ptr<Segment> segment;
+
+    measure("quantize",
+            [this, &segment]() { segment.reset(m_sources[0]->clone()); },
+            [&quantizer, &segment]() { quantizer.quantize(segment.get()); });
+}
+
+void Benchmarks::benchmarkTranspose()
+{
+    QVERIFY(!m_sources.empty());
+    Segment &segment = *m_sources[0];
+
+    std::unique_ptr<EventSelection> selection;
+    std::unique_ptr<TransposeCommand> command;
+    bool executed = false;
+
+    auto execute = [&command, &executed]() {
+        command->execute();
+        executed = true;
+    };
+    auto unexecute = [&command, &executed]() {
+        command->unexecute();
+        executed = false;
+    };
+
+    // Put the segment back as it was, and start over with a new
+    // selection, as the old one loses events when a command replaces
+    // them.
+    auto newCommand = [&segment, &selection, &command, &executed,
+                       &unexecute]() {
+        if (executed)
+            unexecute();
+        command.reset();
+        selection.reset(new EventSelection(segment, segment.getStartTime(),
+                                           segment.getEndMarkerTime()));
+        command.reset(new TransposeCommand(2, *selection));
+    };
+
+    measure("transpose", newCommand, execute);
+
+    measure("undo",
+            [&newCommand, &execute]() {
+                newCommand();
+                execute();
+            },
+            unexecute);
+
+    measure("redo",
+            [&newCommand, &execute, &unexecute]() {
+                newCommand();
+                execute();
+                unexecute();
+            },
+            execute);
+
+    if (executed)
+        unexecute();
+    command.reset();
+    selection.reset();
+}
+
+void Benchmarks::benchmarkParse()
+{
+    QString errMsg;
+    QVERIFY2(m_doc.saveDocument(path("parse.rg"), errMsg), qPrintable(errMsg));
+
+    int count = 0;
+
+    // Streaming, as RosegardenDocument::openDocument() does, then
+    // reading the whole file into a QString first, as it used to.
+    measure("rg_parse", [this, &count]() {
+        ElementCounter counter;
+        XMLReader reader;
+        reader.setHandler(&counter);
+        GzipReader file(path("parse.rg"));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QVERIFY(reader.parse(file));
+        count = counter.m_count;
+    });
+
+    measure("rg_parse_read_first", [this, &count]() {
+        ElementCounter counter;
+        XMLReader reader;
+        reader.setHandler(&counter);
+        QString text;
+        QVERIFY(GzipFile::readFromFile(path("parse.rg"), text));
+        QVERIFY(reader.parse(text));
+        count = counter.m_count;
+    });
+
+    QVERIFY(count > 0);
+}
+
+void Benchmarks::benchmarkSegmentMapperRefresh()
+{
+    QVERIFY(!m_sources.empty());
+    Segment *segment = m_sources[0];
+
+    QSharedPointer<SegmentMapper> mapper =
+            SegmentMapper::makeMapperForSegment(&m_doc, segment);
+    mapper->init();
+
+    // A note changed in the middle of the segment, which is what
+    // SequenceManager::refresh() sees after most edits.
+    const timeT time = segment->getBarStartForTime(
+            (segment->getStartTime() + segment->getEndMarkerTime()) / 2) +
+            crotchet;
+    QVERIFY(segment->findTime(time) != segment->end());
+
+    auto edit = [segment, time]() {
+        Segment::iterator i = segment->findTime(time);
+        Event *event = new Event(**i, (*i)->getAbsoluteTime(),
+                                 (*i)->getDuration());
+        event->set<Int>(BaseProperties::PITCH,
+                        (event->get<Int>(BaseProperties::PITCH) + 1) % 128);
+        segment->erase(i);
+        segment->insert(event);
+    };
+
+    measure("segment_mapper_refresh", edit, [&mapper]() {
+        mapper->refresh();
+    });
+    measure("segment_mapper_refresh_range", edit, [&mapper, time]() {
+        mapper->refreshRange(time, time + crotchet);
+    });
+}
+
+void Benchmarks::benchmarkSegmentIndex()
+{
+    // A composition of its own with 200 tracks of 20 segments, queried
+    // a thousand times for a viewport's worth of 20 tracks by 20 bars.
+    Composition composition;
+    const timeT bar = 4 * crotchet;
+
+    std::vector<TrackId> tracks;
+    for (int t = 0; t < 200; ++t) {
+        const TrackId trackId = composition.getNewTrackId();
+        composition.addTrack(new Track(trackId));
+        tracks.push_back(trackId);
+        for (int s = 0; s < 20; ++s) {
+            Segment *segment = new Segment;
+            segment->setTrack(trackId);
+            segment->setStartTime(bar * s * 8);
+            composition.addSegment(segment);
+            segment->setEndMarkerTime(bar * (s * 8 + 6));
+        }
+    }
+
+    SegmentIndex index(composition);
+    std::vector<Segment *> segments;
+
+    measure("segment_index_query", [&index, &tracks, &segments, bar]() {
+        for (int i = 0; i < 1000; ++i) {
+            segments.clear();
+            for (int t = 80; t < 100; ++t) {
+                index.getSegments(tracks[t], bar * 50, bar * 70, segments);
+            }
+        }
+    });
+
+    QVERIFY(!segments.empty());
+}
+
+void Benchmarks::benchmarkTempoMap()
+{
+    // Every MIDI clock through the generated composition and its tempo
+    // changes, converted one at a time, then in one batch.
+    Composition &composition = m_doc.getComposition();
+
+    std::vector<timeT> in;
+    for (timeT t = 0; t < composition.getEndMarker(); t += crotchet / 24) {
+        in.push_back(t);
+    }
+    QVERIFY(!in.empty());
+    std::vector<RealTime> out(in.size());
+
+    measure("tempo_convert", [&composition, &in, &out]() {
+        for (size_t i = 0; i < in.size(); ++i) {
+            out[i] = composition.getElapsedRealTime(in[i]);
+        }
+    });
+
+    measure("tempo_convert_batch", [&composition, &in, &out]() {
+        composition.getTempoMap()->getElapsedRealTimes(
+                in.data(), out.data(), in.size());
+    });
+
+    QVERIFY(out.back() > RealTime::zero());
+}
+
+void Benchmarks::benchmarkEdit()
+{
+    // A segment of its own, so that only the links made here are
+    // updated.
+    std::unique_ptr<Segment> segment(new Segment);
+    addNotes(segment.get(), 0, std::max(1, m_events));
+
+    Segment::iterator middle = segment->begin();
+    std::advance(middle, segment->size() / 2);
+    const timeT time = (*middle)->getAbsoluteTime();
+
+    int velocity = 0;
+
+    // A hundred one-note edits, each undone, as CommandHistory would.
+    auto edit = [&segment, time, &velocity]() {
+        for (int i = 0; i < 100; ++i) {
+            // Anything but the velocities it starts with.
+            velocity = velocity % 63 + 1;
+            VelocityCommand command(*segment, time, velocity);
+            command.execute();
+            emit CommandHistory::getInstance()->updateLinkedSegments(
+                    &command);
+            command.unexecute();
+            emit CommandHistory::getInstance()->updateLinkedSegments(
+                    &command);
+        }
+    };
+
+    measure("edit", edit);
+
+    // Again, with linked copies to keep up to date.
+    std::vector<std::unique_ptr<Segment> > links;
+    for (int l = 0; l < m_links; ++l) {
+        links.emplace_back(SegmentLinker::createLinkedSegment(segment.get()));
+        links.back()->setStartTime((l + 1) * segment->getEndMarkerTime());
+    }
+    if (!links.empty())
+        segment->getLinker()->clearRefreshStatuses();
+
+    measure("linked_edit", edit);
+
+    // Links go first.
+    links.clear();
+}
+
+void Benchmarks::benchmarkEventSelection()
+{
+    QVERIFY(!m_sources.empty());
+    Segment &segment = *m_sources[0];
+    const std::vector<Event *> all(segment.begin(), segment.end());
+
+    size_t found = 0;
+
+    // Select every event in the first segment, then invert the
+    // selection twice and check every event is in it.
+    auto select = [&segment, &all, &found](bool bulk) {
+        EventSelection selection(segment);
+        if (bulk) {
+            selection.addEvents(all, false);
+        } else {
+            for (Event *event : all) {
+                selection.addEvent(event, false);
+            }
+        }
+        selection.invert();
+        selection.invert();
+
+        found = 0;
+        for (Event *event : all) {
+            if (selection.contains(event))
+                ++found;
+        }
+    };
+
+    measure("select_all", [&select]() { select(false); });
+    QCOMPARE(found, all.size());
+
+    measure("select_all_bulk", [&select]() { select(true); });
+    QCOMPARE(found, all.size());
+}
+
+void Benchmarks::benchmarkEventPool()
+{
+    // Segments like the generated ones, which is mostly allocating
+    // events, then freeing them again.
+    std::vector<std::unique_ptr<Segment> > segments;
+
+    auto fill = [this, &segments]() {
+        for (int t = 0; t < m_tracks; ++t) {
+            segments.emplace_back(new Segment);
+            addNotes(segments.back().get(), t, m_events);
+        }
+    };
+    auto clear = [&segments]() { segments.clear(); };
+
+    measure("event_pool_fill", clear, fill);
+    clear();
+    measure("event_pool_free", fill, clear);
+}
+
+void Benchmarks::benchmarkNoteOffQueue()
+{
+    // 64 channels of four-note chords in 32nd notes at 240bpm, with
+    // each note held for a beat so that a few thousand note-offs are
+    // pending at once.  This mirrors what AlsaDriver::processMidiOut()
+    // and processNotesOff() do: insert as notes go out, and pop
+    // everything due at the end of each slice.
+    const int channels = 64;
+    const int chordSize = 4;
+    const RealTime step(0, 31250000);  // 32nd note at 240bpm
+    const RealTime duration(0, 250000000);  // a beat
+    const int steps = 2000;
+
+    NoteOffQueue queue;
+    size_t maxPending = 0;
+
+    measure("note_off_queue", [&]() {
+        RealTime now = RealTime::zero();
+        for (int i = 0; i < steps; ++i) {
+            for (int channel = 0; channel < channels; ++channel) {
+                for (int note = 0; note < chordSize; ++note) {
+                    const MidiByte pitch = MidiByte(36 + (i + note * 4) % 60);
+                    // Retriggering a note cancels its pending note-off.
+                    queue.remove(pitch, MidiByte(channel % 16),
+                                 1000 + channel / 16);
+                    queue.insert(NoteOffEvent(now + duration,
+                                              pitch,
+                                              MidiByte(channel % 16),
+                                              1000 + channel / 16));
+                }
+            }
+            if (queue.size() > maxPending)
+                maxPending = queue.size();
+
+            now = now + step;
+            while (!queue.empty()  &&  queue.top().realTime <= now) {
+                queue.pop();
+            }
+        }
+        queue.clear();
+    });
+
+    qInfo("%-20s %d pending at most, capacity %d", "",
+          int(maxPending), int(queue.getCapacity()));
+}
+
+void Benchmarks::benchmarkMixKernels()
+{
+    // 96 stereo tracks into a stereo mix at 64-frame buffers, with gain
+    // and metering on each track, a thousand times over: roughly what
+    // the mixer threads and jackProcess() do in a thousand JACK cycles.
+    const size_t frames = 64;
+    const int tracks = 96;
+
+    std::vector<std::vector<float> > trackBuffers(
+            tracks * 2, std::vector<float>(frames));
+    for (std::vector<float> &buffer : trackBuffers) {
+        for (float &sample : buffer) {
+            sample = float(rand()) / float(RAND_MAX) * 2.0f - 1.0f;
+        }
+    }
+    std::vector<float> master[2] = {
+        std::vector<float>(frames), std::vector<float>(frames)
+    };
+    float peak = 0.0f;
+
+    const MixKernels::Implementation original =
+            MixKernels::getImplementation();
+
+    for (int i = MixKernels::Scalar; i <= MixKernels::AVX2; ++i) {
+        const MixKernels::Implementation implementation =
+                static_cast<MixKernels::Implementation>(i);
+        if (!MixKernels::setImplementation(implementation))
+            continue;
+
+        measure(QString("mix_%1").arg(
+                        MixKernels::getImplementationName(implementation)),
+                [&]() {
+            for (int cycle = 0; cycle < 1000; ++cycle) {
+                for (int ch = 0; ch < 2; ++ch) {
+                    std::fill(master[ch].begin(), master[ch].end(), 0.0f);
+                }
+                for (int track = 0; track < tracks; ++track) {
+                    for (int ch = 0; ch < 2; ++ch) {
+                        float *buffer = trackBuffers[track * 2 + ch].data();
+                        MixKernels::flushDenormals(buffer, frames);
+                        MixKernels::gain(buffer, frames, 1.0f);
+                        peak += MixKernels::peak(buffer, frames);
+                        MixKernels::mixAdd(master[ch].data(), buffer, frames);
+                    }
+                }
+            }
+        });
+    }
+
+    MixKernels::setImplementation(original);
+
+    QVERIFY(peak > 0.0f);
+}
+
+void Benchmarks::benchmarkAudioWorkerPool()
+{
+    // 32 instruments at 256-frame blocks, which is about what
+    // AudioInstrumentMixer::processBlocks() hands to the pool in a busy
+    // composition, a hundred times over.  First on this thread alone.
+    const size_t instruments = 32;
+    std::vector<std::vector<float> > buffers(
+            instruments, std::vector<float>(256, 0.0f));
+
+    {
+        AudioWorkerPool pool("benchmark", 0, 0);
+        measure("audio_worker_pool_serial", [&pool, &buffers]() {
+            for (int i = 0; i < 100; ++i) {
+                pool.run(pluginTask, &buffers, instruments);
+            }
+        });
+    }
+
+    AudioWorkerPool pool("benchmark",
+                         AudioWorkerPool::getDefaultWorkerCount(), 0);
+    measure("audio_worker_pool", [&pool, &buffers]() {
+        for (int i = 0; i < 100; ++i) {
+            pool.run(pluginTask, &buffers, instruments);
+        }
+    });
+}
+
+void Benchmarks::benchmarkAudioFileRead()
+{
+    const size_t bytesPerFrame = 4;
+    const size_t block = 4096;
+    const size_t frameCount = size_t(m_audioSeconds) * 44100;
+
+    {
+        QFile file(path("take.wav"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(makeWav(frameCount));
+    }
+
+    std::vector<char> buffer(block * bytesPerFrame);
+    int64_t sum = 0;
+
+    // Read the take in 4096 frame blocks (a ring buffer's worth),
+    // summing the samples as a stand-in for decoding.  First through an
+    // ifstream, as PlayableAudioFile does when it can't map the file.
+    measure("audio_read_stream", [&]() {
+        std::ifstream file(path("take.wav").toLocal8Bit().constData(),
+                           std::ios::in | std::ios::binary);
+        file.seekg(44);
+        while (file.read(buffer.data(), buffer.size())  ||
+               file.gcount() > 0) {
+            const size_t n = size_t(file.gcount());
+            for (size_t i = 0; i < n; i += 64) {
+                sum += (unsigned char)buffer[i];
+            }
+        }
+    });
+
+    measure("audio_read_mapped", [&]() {
+        AudioFileMapping mapping(path("take.wav"), bytesPerFrame);
+        for (size_t frame = 0; frame < mapping.getFrameCount();
+             frame += block) {
+            mapping.readAhead(frame, 44100 * 4);
+            const unsigned char *data = mapping.getFrames(frame);
+            const size_t n = std::min(block, mapping.getFrameCount() - frame);
+            for (size_t i = 0; i < n * bytesPerFrame; i += 64) {
+                sum += data[i];
+            }
+        }
+    });
+
+    QVERIFY(sum > 0);
+}
+
+void Benchmarks::benchmarkTraceScope()
+{
+    // A hundred thousand traced scopes with tracing off, which should
+    // cost next to nothing, then on.
+    Trace::setThreadName("benchmarks");
+
+    auto run = []() {
+        for (int i = 0; i < 100000; ++i) {
+            tracedScope();
+        }
+    };
+
+    Trace::setEnabled(false);
+    measure("trace_scope_off", run);
+
+    Trace::setEnabled(true);
+    measure("trace_scope_on", run);
+
+    Trace::setEnabled(false);
+}
+
+QTEST_MAIN(Benchmarks)
+
+#include "benchmarks.moc"
@@ -2,9 +2,14 @@
 
 #include "sound/MidiFile.h"
 #include "document/RosegardenDocument.h"
+#include "document/io/DocumentConverter.h"
+#include "misc/Headless.h"
 
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
 #include <QSettings>
+#include <QTemporaryDir>
 #include <QTest>
 
 using namespace Rosegarden;
@@ -18,6 +23,9 @@ class TestConvert : public QObject
 private Q_SLOTS:
 
     void test1();
+    void testDocumentConverter_data();
+    void testDocumentConverter();
+    void testLilyPondFilename();
 };
 
 void TestConvert::test1()
@@ -69,7 +77,96 @@ void TestConvert::test1()
     QFile::remove(outFilename);
 }
 
-QTEST_MAIN(TestConvert)
+void TestConvert::testDocumentConverter_data()
+{
+    QTest::addColumn<QString>("format");
+
+    QTest::newRow("rg") << "rg";
+    QTest::newRow("midi") << "midi";
+    QTest::newRow("lilypond") << "lilypond";
+    QTest::newRow("musicxml") << "musicxml";
+    QTest::newRow("mup") << "mup";
+    QTest::newRow("csound") << "csound";
+}
+
+// What rosegarden-convert does for each file.
+void TestConvert::testDocumentConverter()
+{
+    QFETCH(QString, format);
+
+    QCoreApplication::setOrganizationName("rosegardenmusic");
+
+    QSettings settings;
+    settings.beginGroup("Sequencer_Options");
+    settings.setValue("autostartjack", false);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const DocumentConverter::Format outFormat =
+            DocumentConverter::formatFromName(format);
+    QVERIFY(outFormat != DocumentConverter::Unknown);
+
+    DocumentConverter converter;
+    QVERIFY2(converter.load(
+                     QFINDTESTDATA("../data/examples/aylindaamiga.rg")),
+             qPrintable(converter.getError()));
+    QVERIFY(converter.getDocument()->getComposition().getNbSegments() > 0);
+
+    const QString output = dir.filePath(
+            "out." + DocumentConverter::extension(outFormat));
+    QVERIFY2(converter.save(output, outFormat),
+             qPrintable(converter.getError()));
+    QVERIFY(QFileInfo(output).size() > 0);
+
+    // The formats we can read back should survive the trip.
+    if (DocumentConverter::canLoad(outFormat)) {
+        QVERIFY2(converter.load(output), qPrintable(converter.getError()));
+        QVERIFY(converter.getDocument()->getComposition().getNbSegments() > 0);
+    }
+}
+
+// LilyPond can't take a space in the name.  With no one to ask, the
+// export must fail rather than quietly write to some other file, and
+// outputBaseName() must give a name that works.
+void TestConvert::testLilyPondFilename()
+{
+    QVERIFY(isHeadless());
+
+    QCoreApplication::setOrganizationName("rosegardenmusic");
+
+    QSettings settings;
+    settings.beginGroup("Sequencer_Options");
+    settings.setValue("autostartjack", false);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    DocumentConverter converter;
+    QVERIFY2(converter.load(
+                     QFINDTESTDATA("../data/examples/aylindaamiga.rg")),
+             qPrintable(converter.getError()));
+
+    QVERIFY(!converter.save(dir.filePath("my song.ly"),
+                            DocumentConverter::LilyPond));
+    QVERIFY(!converter.getError().isEmpty());
+    QVERIFY(QDir(dir.path()).entryList(QDir::Files).isEmpty());
+
+    const QString baseName = DocumentConverter::outputBaseName(
+            "my song", DocumentConverter::LilyPond);
+    QCOMPARE(baseName, QString("mysong"));
+    QCOMPARE(DocumentConverter::outputBaseName(
+                     "my song", DocumentConverter::Midi),
+             QString("my song"));
+
+    const QString output = dir.filePath(baseName + ".ly");
+    QVERIFY2(converter.save(output, DocumentConverter::LilyPond),
+             qPrintable(converter.getError()));
+    QVERIFY(QFileInfo(output).size() > 0);
+}
+
+// rosegarden-convert only has a QCoreApplication.
+QTEST_GUILESS_MAIN(TestConvert)
 
 #include "convert.moc"
 
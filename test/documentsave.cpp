@@ -0,0 +1,171 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/BaseProperties.h"
+#include "base/Composition.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "base/Track.h"
+#include "base/TriggerSegment.h"
+#include "document/AutoSaveThread.h"
+#include "document/GzipReader.h"
+#include "document/RosegardenDocument.h"
+#include <QTemporaryDir>
+#include <QTest>
+#include <vector>
+
+using namespace Rosegarden;
+
+// A document saved with its segments serialised in parallel has to
+// load back the same, and the auto-save thread must write what it was
+// given.  See rg_save in test/benchmark for the time taken.
+class TestDocumentSave : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testRoundTrip();
+    void testAutoSaveThread();
+
+private:
+    /// Add segments segments of bars bars each, on their own tracks.
+    static void fill(RosegardenDocument &doc, int segments, int bars);
+
+    QString path(const char *name) const
+        { return m_dir.filePath(name); }
+
+    QTemporaryDir m_dir;
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+
+    Event *makeNote(timeT time, timeT duration, int pitch)
+    {
+        Event *event = new Event(Note::EventType, time, duration);
+        event->set<Int>(BaseProperties::PITCH, pitch);
+        event->set<Int>(BaseProperties::VELOCITY, 100);
+        return event;
+    }
+
+    void compareSegments(const Segment &expected, const Segment &actual)
+    {
+        QCOMPARE(actual.getTrack(), expected.getTrack());
+        QCOMPARE(actual.getStartTime(), expected.getStartTime());
+        QCOMPARE(actual.getLabel(), expected.getLabel());
+        QCOMPARE(actual.size(), expected.size());
+
+        Segment::const_iterator a = actual.begin();
+        for (Segment::const_iterator e = expected.begin();
+             e != expected.end(); ++e, ++a) {
+            QCOMPARE((*a)->getType(), (*e)->getType());
+            QCOMPARE((*a)->getAbsoluteTime(), (*e)->getAbsoluteTime());
+            QCOMPARE((*a)->getDuration(), (*e)->getDuration());
+            if ((*e)->has(BaseProperties::PITCH)) {
+                QCOMPARE((*a)->get<Int>(BaseProperties::PITCH),
+                         (*e)->get<Int>(BaseProperties::PITCH));
+            }
+        }
+    }
+}
+
+void TestDocumentSave::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+void TestDocumentSave::fill(RosegardenDocument &doc, int segments, int bars)
+{
+    Composition &composition = doc.getComposition();
+
+    for (int s = 0; s < segments; ++s) {
+        const TrackId trackId = composition.getNewTrackId();
+        composition.addTrack(new Track(trackId));
+
+        Segment *segment = new Segment;
+        segment->setTrack(trackId);
+        segment->setLabel(QString("Segment %1 <&>").arg(s).toStdString());
+        composition.addSegment(segment);
+
+        // Crotchets, with a chord on the first beat of every bar.
+        for (int bar = 0; bar < bars; ++bar) {
+            const timeT barStart = bar * 4 * crotchet;
+            for (int beat = 0; beat < 4; ++beat) {
+                segment->insert(makeNote(barStart + beat * crotchet, crotchet,
+                                         60 + (s + beat) % 12));
+            }
+            segment->insert(makeNote(barStart, 2 * crotchet, 48 + s % 12));
+        }
+    }
+}
+
+void TestDocumentSave::testRoundTrip()
+{
+    RosegardenDocument doc(nullptr, {}, true /*skip autoload*/, true,
+                           false /*no sound*/);
+    RosegardenDocument::currentDocument = &doc;
+    fill(doc, 40, 20);
+
+    // And an ornament, which goes in a separate section of the file.
+    Segment *trigger = new Segment;
+    trigger->insert(makeNote(0, crotchet / 4, 72));
+    trigger->insert(makeNote(crotchet / 4, crotchet / 4, 74));
+    doc.getComposition().addTriggerSegment(trigger, 72, 100);
+
+    QString errMsg;
+    QVERIFY2(doc.saveDocument(path("roundtrip.rg"), errMsg),
+             qPrintable(errMsg));
+
+    RosegardenDocument loaded(nullptr, {}, true, true, false);
+    RosegardenDocument::currentDocument = &loaded;
+    QVERIFY(loaded.openDocument(path("roundtrip.rg"),
+                                false /*permanent*/, true /*no progress*/,
+                                false /*no lock*/));
+
+    const Composition &expected = doc.getComposition();
+    const Composition &actual = loaded.getComposition();
+    QCOMPARE(actual.getNbSegments(), expected.getNbSegments());
+
+    Composition::const_iterator a = actual.begin();
+    for (Composition::const_iterator e = expected.begin();
+         e != expected.end(); ++e, ++a) {
+        compareSegments(**e, **a);
+        if (QTest::currentTestFailed())
+            return;
+    }
+
+    QCOMPARE(actual.getTriggerSegments().size(), size_t(1));
+    compareSegments(*trigger,
+                    *(*actual.getTriggerSegments().begin())->getSegment());
+
+    RosegardenDocument::currentDocument = nullptr;
+}
+
+void TestDocumentSave::testAutoSaveThread()
+{
+    std::vector<QByteArray> xml;
+    xml.push_back("<a>");
+    xml.push_back(QByteArray(100000, 'x'));
+    xml.push_back("</a>");
+
+    AutoSaveThread thread;
+    QVERIFY(thread.save(path("autosave.rg"), xml));
+    // It takes the snapshot.
+    QVERIFY(xml.empty());
+    thread.wait();
+
+    GzipReader reader(path("autosave.rg"));
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    const QByteArray data = reader.readAll();
+    QCOMPARE(data.size(), 100007);
+    QVERIFY(data.startsWith("<a>xxx"));
+    QVERIFY(reader.isComplete());
+}
+
+QTEST_MAIN(TestDocumentSave)
+
+#include "documentsave.moc"
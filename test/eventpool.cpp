@@ -0,0 +1,82 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/Segment.h"
+#include "base/NotationTypes.h"
+#include "base/BaseProperties.h"
+#include "base/FixedSizePool.h"
+#include <QTest>
+#include <sstream>
+
+using namespace Rosegarden;
+
+// Tests for the FixedSizePool that backs Event, EventData and Segment's
+// tree nodes.  The event_pool benchmarks are in test/benchmark.
+class TestEventPool : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testReuse();
+    void testSegmentTeardown();
+
+private:
+    static const int eventCount = 20000;
+
+    static void fill(Segment &segment);
+};
+
+void TestEventPool::fill(Segment &segment)
+{
+    for (int i = 0; i < eventCount; ++i) {
+        Event *e = new Event(Note::EventType, i * 240, 240);
+        e->set<Int>(BaseProperties::PITCH, 60 + i % 24);
+        e->set<Int>(BaseProperties::VELOCITY, 100);
+        segment.insert(e);
+    }
+}
+
+/**
+ * Freed blocks should be handed out again before a new slab is needed.
+ */
+void TestEventPool::testReuse()
+{
+    if (!FixedSizePool::isEnabled())
+        QSKIP("ROSEGARDEN_NO_POOL is set");
+
+    FixedSizePool &pool = FixedSizePool::get(sizeof(Event));
+
+    Event *e1 = new Event(Note::EventType, 0, 240);
+    delete e1;
+    const size_t slabs = pool.getStats().slabs;
+
+    Event *e2 = new Event(Note::EventType, 0, 240);
+    QCOMPARE(static_cast<void *>(e2), static_cast<void *>(e1));
+    QCOMPARE(pool.getStats().slabs, slabs);
+    delete e2;
+}
+
+/**
+ * Everything a Segment allocates should go back to the pools when it
+ * is destroyed.
+ */
+void TestEventPool::testSegmentTeardown()
+{
+    FixedSizePool &eventPool = FixedSizePool::get(sizeof(Event));
+    const size_t liveBefore = eventPool.getStats().live();
+
+    Segment *segment = new Segment;
+    fill(*segment);
+    QCOMPARE(eventPool.getStats().live(), liveBefore + eventCount);
+
+    delete segment;
+    QCOMPARE(eventPool.getStats().live(), liveBefore);
+
+    std::stringstream stats;
+    FixedSizePool::dumpStats(stats);
+    qDebug() << stats.str().c_str();
+}
+
+QTEST_MAIN(TestEventPool)
+
+#include "eventpool.moc"
@@ -0,0 +1,198 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/BaseProperties.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "base/Selection.h"
+#include <QTest>
+#include <vector>
+
+using namespace Rosegarden;
+
+// EventSelection's bulk operations: what ends up selected, and that
+// observers hear about each change once.
+class TestEventSelection : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testAddEvents();
+    void testSelectRange();
+    void testInvert();
+    void testFilter();
+    void testEventRemoved();
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+
+    /// count crotchets, with pitches rising by a semitone.
+    Segment *makeSegment(int count)
+    {
+        Segment *segment = new Segment;
+        for (int i = 0; i < count; ++i) {
+            Event *e = new Event(Note::EventType, i * crotchet, crotchet);
+            e->set<Int>(BaseProperties::PITCH, i % 128);
+            segment->insert(e);
+        }
+        return segment;
+    }
+
+    std::vector<Event *> events(Segment &segment)
+    {
+        return std::vector<Event *>(segment.begin(), segment.end());
+    }
+
+    /// Counts the calls it gets, and the events in them.
+    class Observer : public EventSelectionObserver
+    {
+    public:
+        void eventSelected(EventSelection *, Event *) override
+            { ++selected; }
+        void eventDeselected(EventSelection *, Event *) override
+            { ++deselected; }
+        void eventSelectionDestroyed(EventSelection *) override { }
+
+        void eventsSelected(EventSelection *,
+                            const std::vector<Event *> &events) override
+        {
+            ++calls;
+            selected += events.size();
+        }
+        void eventsDeselected(EventSelection *,
+                              const std::vector<Event *> &events) override
+        {
+            ++calls;
+            deselected += events.size();
+        }
+
+        int calls = 0;
+        size_t selected = 0;
+        size_t deselected = 0;
+    };
+}
+
+void TestEventSelection::testAddEvents()
+{
+    Segment *segment = makeSegment(100);
+    std::vector<Event *> all = events(*segment);
+
+    // Tie the last two notes together.
+    all[98]->set<Bool>(BaseProperties::TIED_FORWARD, true);
+    all[99]->set<Int>(BaseProperties::PITCH, 98);
+    all[99]->set<Bool>(BaseProperties::TIED_BACKWARD, true);
+
+    {
+        EventSelection selection(*segment);
+        Observer observer;
+        selection.addObserver(&observer);
+
+        // Duplicates are dropped and the tie is followed.
+        std::vector<Event *> some(all.begin(), all.begin() + 10);
+        some.push_back(all[5]);
+        some.push_back(all[98]);
+        selection.addEvents(some);
+
+        QCOMPARE(selection.getAddedEvents(), 12u);
+        QVERIFY(selection.contains(all[99]));
+        QVERIFY(!selection.contains(all[10]));
+        QCOMPARE(observer.calls, 1);
+        QCOMPARE(observer.selected, size_t(12));
+        QCOMPARE(selection.getStartTime(), timeT(0));
+        QCOMPARE(selection.getEndTime(), 100 * crotchet);
+
+        selection.removeObserver(&observer);
+    }
+
+    delete segment;
+}
+
+void TestEventSelection::testSelectRange()
+{
+    Segment *segment = makeSegment(100);
+
+    EventSelection selection(*segment);
+    selection.selectRange(10 * crotchet, 20 * crotchet);
+
+    // The same as the range constructor.
+    EventSelection expected(*segment, 10 * crotchet, 20 * crotchet);
+    QVERIFY(selection == expected);
+    QCOMPARE(selection.getAddedEvents(), 10u);
+
+    delete segment;
+}
+
+void TestEventSelection::testInvert()
+{
+    Segment *segment = makeSegment(100);
+    std::vector<Event *> all = events(*segment);
+
+    {
+        EventSelection selection(*segment, 0, 50 * crotchet);
+        Observer observer;
+        selection.addObserver(&observer);
+
+        selection.invert();
+
+        QCOMPARE(selection.getAddedEvents(), 50u);
+        QVERIFY(!selection.contains(all[0]));
+        QVERIFY(selection.contains(all[50]));
+        QCOMPARE(selection.getStartTime(), 50 * crotchet);
+        QCOMPARE(observer.calls, 2);
+        QCOMPARE(observer.selected, size_t(50));
+        QCOMPARE(observer.deselected, size_t(50));
+
+        // And back.
+        selection.invert();
+        QVERIFY(selection == EventSelection(*segment, 0, 50 * crotchet));
+
+        selection.removeObserver(&observer);
+    }
+
+    delete segment;
+}
+
+void TestEventSelection::testFilter()
+{
+    Segment *segment = makeSegment(100);
+
+    EventSelection selection(*segment, 0, 100 * crotchet);
+    selection.filter([](const Event *e) {
+        return e->get<Int>(BaseProperties::PITCH) % 2 == 0;
+    });
+    QCOMPARE(selection.getAddedEvents(), 50u);
+
+    long sum = 0;
+    selection.forEach([&sum](Event *e) {
+        sum += e->get<Int>(BaseProperties::PITCH);
+    });
+    QCOMPARE(sum, 2450l);
+
+    delete segment;
+}
+
+void TestEventSelection::testEventRemoved()
+{
+    Segment *segment = makeSegment(100);
+    std::vector<Event *> all = events(*segment);
+
+    EventSelection selection(*segment, 0, 10 * crotchet);
+
+    // One selected, one not.
+    segment->eraseSingle(all[5]);
+    segment->eraseSingle(all[50]);
+
+    QCOMPARE(selection.getAddedEvents(), 9u);
+    for (Event *e : selection.getSegmentEvents()) {
+        QVERIFY(segment->findSingle(e) != segment->end());
+    }
+
+    delete segment;
+}
+
+QTEST_MAIN(TestEventSelection)
+
+#include "eventselection.moc"
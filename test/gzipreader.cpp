@@ -0,0 +1,203 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "document/GzipFile.h"
+#include "document/GzipReader.h"
+#include "document/io/XMLHandler.h"
+#include "document/io/XMLReader.h"
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <vector>
+
+using namespace Rosegarden;
+
+// Checks that GzipReader gives back what GzipFile wrote, in blocks of
+// any size, and copes with plain, truncated and missing files.  The
+// file is large so that the decompressing thread is still busy when
+// the tests close it early.
+class TestGzipReader : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testReadAll_data();
+    void testReadAll();
+    void testUncompressed();
+    void testTruncated();
+    void testMissing();
+    void testCloseEarly();
+    void testParse();
+
+private:
+    QString path(const char *name) const
+        { return m_dir.filePath(name); }
+
+    QTemporaryDir m_dir;
+    QString m_text;
+};
+
+namespace
+{
+    /// Counts elements and checks that their "n" attributes run 0, 1, 2...
+    class CountingHandler : public XMLHandler
+    {
+    public:
+        CountingHandler() : m_count(0), m_inOrder(true) { }
+
+        bool startElement(const QString & /* namespaceURI */,
+                          const QString &localName,
+                          const QString & /* qName */,
+                          const QXmlStreamAttributes &atts) override
+        {
+            if (localName == "event") {
+                if (atts.value("n").toString().toInt() != m_count)
+                    m_inOrder = false;
+                ++m_count;
+            }
+            return true;
+        }
+
+        int m_count;
+        bool m_inOrder;
+    };
+
+    const int eventCount = 200000;
+
+    QString makeDocument(int events)
+    {
+        QString text = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<events>\n";
+        for (int i = 0; i < events; ++i) {
+            text += QString("<event n=\"%1\" type=\"note\" pitch=\"%2\""
+                            " text=\"é♯\"/>\n").arg(i).arg(i % 128);
+        }
+        text += "</events>\n";
+        return text;
+    }
+
+    QByteArray readAll(GzipReader &reader, int blockSize)
+    {
+        QByteArray result;
+        std::vector<char> block(blockSize);
+        while (!reader.atEnd()) {
+            const qint64 got = reader.read(block.data(), blockSize);
+            if (got < 0)
+                break;
+            result.append(block.data(), int(got));
+        }
+        return result;
+    }
+}
+
+void TestGzipReader::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    m_text = makeDocument(eventCount);
+    QVERIFY(GzipFile::writeToFile(path("events.rg"), m_text));
+}
+
+void TestGzipReader::testReadAll_data()
+{
+    QTest::addColumn<int>("blockSize");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("7") << 7;
+    QTest::newRow("16k") << 16384;
+    QTest::newRow("4M") << 4 * 1024 * 1024;
+}
+
+void TestGzipReader::testReadAll()
+{
+    QFETCH(int, blockSize);
+
+    GzipReader reader(path("events.rg"));
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+
+    // Reading a byte at a time is slow, so just do the start.
+    if (blockSize == 1) {
+        QByteArray start;
+        char c;
+        for (int i = 0; i < 100000 && reader.read(&c, 1) == 1; ++i) {
+            start.append(c);
+        }
+        QCOMPARE(start, m_text.toUtf8().left(100000));
+        return;
+    }
+
+    QCOMPARE(readAll(reader, blockSize), m_text.toUtf8());
+    QVERIFY(reader.isComplete());
+    QCOMPARE(reader.percentRead(), 100);
+}
+
+void TestGzipReader::testUncompressed()
+{
+    // Like gzopen(), we read plain files too.
+    QFile file(path("plain.xml"));
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write(makeDocument(100).toUtf8());
+    file.close();
+
+    GzipReader reader(path("plain.xml"));
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    QCOMPARE(readAll(reader, 4096), makeDocument(100).toUtf8());
+    QVERIFY(reader.isComplete());
+}
+
+void TestGzipReader::testTruncated()
+{
+    QFile whole(path("events.rg"));
+    QVERIFY(whole.open(QFile::ReadOnly));
+    const QByteArray compressed = whole.readAll();
+
+    QFile file(path("truncated.rg"));
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write(compressed.left(compressed.size() / 2));
+    file.close();
+
+    GzipReader reader(path("truncated.rg"));
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    const QByteArray data = readAll(reader, 16384);
+    QVERIFY(data.size() > 0);
+    QVERIFY(data.size() < m_text.toUtf8().size());
+    QVERIFY(reader.atEnd());
+    QVERIFY(!reader.isComplete());
+}
+
+void TestGzipReader::testMissing()
+{
+    GzipReader reader(path("missing.rg"));
+    QVERIFY(!reader.open(QIODevice::ReadOnly));
+}
+
+void TestGzipReader::testCloseEarly()
+{
+    // The decompressing thread must not be left waiting for us.
+    GzipReader reader(path("events.rg"));
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    char buffer[100];
+    QCOMPARE(reader.read(buffer, sizeof(buffer)), qint64(sizeof(buffer)));
+    reader.close();
+    QVERIFY(!reader.isOpen());
+}
+
+void TestGzipReader::testParse()
+{
+    GzipReader reader(path("events.rg"));
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+
+    CountingHandler handler;
+    XMLReader xmlReader;
+    xmlReader.setHandler(&handler);
+    QVERIFY(xmlReader.parse(reader));
+
+    QCOMPARE(handler.m_count, eventCount);
+    QVERIFY(handler.m_inOrder);
+    QVERIFY(reader.isComplete());
+}
+
+QTEST_MAIN(TestGzipReader)
+
+#include "gzipreader.moc"
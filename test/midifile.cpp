@@ -0,0 +1,343 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+
+#include "base/Exception.h"
+#include "sound/Midi.h"
+#include "sound/MidiEvent.h"
+#include "sound/MidiFile.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace Rosegarden;
+
+// Feeds MidiFile's reader small hand-made track chunks and files, and
+// checks the events and note durations that come out.
+class TestMidiFile : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testReadNumber_data();
+    void testReadNumber();
+    void testReadNumberAtEnd();
+    void testTruncated_data();
+    void testTruncated();
+    void testRunningStatus();
+    void testRunningStatusFirst();
+    void testTwoChannels();
+    void testRead();
+
+    void testOverlappingNotes();
+    void testStrayNoteOff();
+    void testUnmatchedNoteOn();
+    void testChannels();
+    void testZeroDuration();
+
+private:
+    /// Parse chunk, given in hex, as a whole track chunk.
+    static void parse(const char *hex, MidiFile::ParsedTrack &parsed);
+};
+
+void
+TestMidiFile::parse(const char *hex, MidiFile::ParsedTrack &parsed)
+{
+    const QByteArray chunk = QByteArray::fromHex(hex);
+    MidiFile::parseTrack(
+            reinterpret_cast<const MidiByte *>(chunk.constData()),
+            chunk.size(), chunk.size(), parsed);
+}
+
+void TestMidiFile::testReadNumber_data()
+{
+    QTest::addColumn<QByteArray>("delta");
+    QTest::addColumn<long>("expected");
+
+    QTest::newRow("zero") << QByteArray("00") << 0L;
+    QTest::newRow("one byte") << QByteArray("7f") << 0x7FL;
+    QTest::newRow("two bytes") << QByteArray("8100") << 0x80L;
+    QTest::newRow("two bytes max") << QByteArray("ff7f") << 0x3FFFL;
+    QTest::newRow("three bytes") << QByteArray("818000") << 0x4000L;
+    QTest::newRow("three bytes max") << QByteArray("ffff7f") << 0x1FFFFFL;
+    QTest::newRow("four bytes") << QByteArray("81808000") << 0x200000L;
+    QTest::newRow("four bytes max") << QByteArray("ffffff7f") << 0xFFFFFFFL;
+}
+
+// A delta time in front of a single note-on.
+void TestMidiFile::testReadNumber()
+{
+    QFETCH(QByteArray, delta);
+    QFETCH(long, expected);
+
+    MidiFile::ParsedTrack parsed;
+    parse((delta + "903c40").constData(), parsed);
+
+    QCOMPARE(parsed.tracks.size(), size_t(1));
+    QCOMPARE(parsed.tracks[0].size(), size_t(1));
+
+    const MidiEvent &event = parsed.tracks[0][0];
+    QCOMPARE(event.getTime(), timeT(expected));
+    QCOMPARE(event.getMessageType(), MIDI_NOTE_ON);
+    QCOMPARE(event.getPitch(), MidiByte(0x3C));
+    QCOMPARE(event.getVelocity(), MidiByte(0x40));
+}
+
+// The last number in a chunk is read a byte at a time rather than
+// three at once.  Here it is a padded zero length for a text event.
+void TestMidiFile::testReadNumberAtEnd()
+{
+    MidiFile::ParsedTrack parsed;
+    parse("00ff018000", parsed);
+
+    QCOMPARE(parsed.tracks[0].size(), size_t(1));
+
+    const MidiEvent &event = parsed.tracks[0][0];
+    QVERIFY(event.isMeta());
+    QCOMPARE(event.getMetaEventCode(), MIDI_TEXT_EVENT);
+    QCOMPARE(event.getMetaMessage(), std::string());
+}
+
+void TestMidiFile::testTruncated_data()
+{
+    QTest::addColumn<QByteArray>("chunk");
+    QTest::addColumn<int>("size");
+
+    // A note-on, then the start of a delta time that never finishes.
+    QTest::newRow("past end of file") << QByteArray("00903c4081") << 6;
+    QTest::newRow("past end of chunk") << QByteArray("00903c408180") << 6;
+    QTest::newRow("three bytes") << QByteArray("00903c40ffff") << 8;
+    // The chunk ends in the middle of a note-on.
+    QTest::newRow("event") << QByteArray("00903c") << 3;
+}
+
+void TestMidiFile::testTruncated()
+{
+    QFETCH(QByteArray, chunk);
+    QFETCH(int, size);
+
+    const QByteArray bytes = QByteArray::fromHex(chunk);
+    MidiFile::ParsedTrack parsed;
+
+    QVERIFY_EXCEPTION_THROWN(
+            MidiFile::parseTrack(
+                    reinterpret_cast<const MidiByte *>(bytes.constData()),
+                    size, bytes.size(), parsed),
+            Exception);
+}
+
+void TestMidiFile::testRunningStatus()
+{
+    MidiFile::ParsedTrack parsed;
+    // On 60, on 62 (running), off 60, off 62 (running).
+    parse("00903c40"
+          "103e40"
+          "10803c00"
+          "003e00", parsed);
+
+    QCOMPARE(parsed.tracks.size(), size_t(1));
+    QCOMPARE(parsed.channels[0], 0);
+
+    const MidiFile::MidiTrack &track = parsed.tracks[0];
+    QCOMPARE(track.size(), size_t(4));
+
+    QCOMPARE(track[0].getEventCode(), MidiByte(0x90));
+    QCOMPARE(track[0].getPitch(), MidiByte(0x3C));
+    QCOMPARE(track[0].getTime(), timeT(0));
+
+    QCOMPARE(track[1].getEventCode(), MidiByte(0x90));
+    QCOMPARE(track[1].getPitch(), MidiByte(0x3E));
+    QCOMPARE(track[1].getVelocity(), MidiByte(0x40));
+    QCOMPARE(track[1].getTime(), timeT(0x10));
+
+    QCOMPARE(track[2].getEventCode(), MidiByte(0x80));
+    QCOMPARE(track[2].getPitch(), MidiByte(0x3C));
+    QCOMPARE(track[2].getTime(), timeT(0x10));
+
+    QCOMPARE(track[3].getEventCode(), MidiByte(0x80));
+    QCOMPARE(track[3].getPitch(), MidiByte(0x3E));
+    QCOMPARE(track[3].getTime(), timeT(0));
+}
+
+void TestMidiFile::testRunningStatusFirst()
+{
+    MidiFile::ParsedTrack parsed;
+    QVERIFY_EXCEPTION_THROWN(parse("003c40", parsed), Exception);
+}
+
+// Each channel gets its own track, with its own delta times.  Meta
+// events go with the first.
+void TestMidiFile::testTwoChannels()
+{
+    MidiFile::ParsedTrack parsed;
+    // Name "abc", on 60 on 1, on 64 on 2, off 60 at 32, off 64 at 48.
+    parse("00ff0303616263"
+          "00903c40"
+          "00914040"
+          "20803c00"
+          "10814000", parsed);
+
+    QCOMPARE(parsed.name, std::string("abc"));
+    QCOMPARE(parsed.tracks.size(), size_t(2));
+    QCOMPARE(parsed.channels[0], 0);
+    QCOMPARE(parsed.channels[1], 1);
+
+    const MidiFile::MidiTrack &first = parsed.tracks[0];
+    QCOMPARE(first.size(), size_t(3));
+    QVERIFY(first[0].isMeta());
+    QCOMPARE(first[1].getMessageType(), MIDI_NOTE_ON);
+    QCOMPARE(first[1].getTime(), timeT(0));
+    QCOMPARE(first[2].getMessageType(), MIDI_NOTE_OFF);
+    QCOMPARE(first[2].getTime(), timeT(0x20));
+
+    const MidiFile::MidiTrack &second = parsed.tracks[1];
+    QCOMPARE(second.size(), size_t(2));
+    QCOMPARE(second[0].getChannelNumber(), MidiByte(1));
+    QCOMPARE(second[0].getPitch(), MidiByte(0x40));
+    QCOMPARE(second[0].getTime(), timeT(0));
+    QCOMPARE(second[1].getMessageType(), MIDI_NOTE_OFF);
+    QCOMPARE(second[1].getTime(), timeT(0x30));
+}
+
+// A whole file with a header longer than 6 bytes and an alien chunk
+// before the track, both of which should be skipped.
+void TestMidiFile::testRead()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("test.mid");
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QByteArray("MThd") + QByteArray::fromHex("00000008"
+                                                         "000100010060"
+                                                         "abcd"));
+    file.write(QByteArray("XFIH") + QByteArray::fromHex("00000004"
+                                                         "deadbeef"));
+    file.write(QByteArray("MTrk") + QByteArray::fromHex("0000000c"
+                                                         "00903c40"
+                                                         "60803c00"
+                                                         "00ff2f00"));
+    file.close();
+
+    MidiFile midiFile;
+    QVERIFY2(midiFile.read(filename), midiFile.getError().c_str());
+
+    QCOMPARE(midiFile.m_timingDivision, 0x60);
+    QCOMPARE(midiFile.m_midiComposition.size(), size_t(1));
+
+    const MidiFile::MidiTrack &track = midiFile.m_midiComposition[0];
+    QCOMPARE(track.size(), size_t(3));
+    QCOMPARE(track[0].getMessageType(), MIDI_NOTE_ON);
+    QCOMPARE(track[1].getMessageType(), MIDI_NOTE_OFF);
+    QCOMPARE(track[1].getTime(), timeT(0x60));
+    QVERIFY(track[2].isMeta());
+    QCOMPARE(track[2].getMetaEventCode(), MIDI_END_OF_TRACK);
+}
+
+// consolidateNoteEvents() works on absolute times, as
+// convertToRosegarden() leaves them.
+
+// Same-pitch notes that overlap are paired first in, first out.  A
+// note-on with no velocity is a note-off.
+void TestMidiFile::testOverlappingNotes()
+{
+    MidiFile midiFile;
+    MidiFile::MidiTrack &track = midiFile.m_midiComposition[0];
+    track.push_back(MidiEvent(0, MIDI_NOTE_ON, 60, 100));
+    track.push_back(MidiEvent(10, MIDI_NOTE_ON, 60, 100));
+    track.push_back(MidiEvent(20, MIDI_NOTE_OFF, 60, 0));
+    track.push_back(MidiEvent(35, MIDI_NOTE_ON, 60, 0));
+
+    midiFile.consolidateNoteEvents(0);
+
+    QCOMPARE(track.size(), size_t(2));
+    QCOMPARE(track[0].getTime(), timeT(0));
+    QCOMPARE(track[0].getDuration(), timeT(20));
+    QCOMPARE(track[1].getTime(), timeT(10));
+    QCOMPARE(track[1].getDuration(), timeT(25));
+}
+
+void TestMidiFile::testStrayNoteOff()
+{
+    MidiFile midiFile;
+    MidiFile::MidiTrack &track = midiFile.m_midiComposition[0];
+    track.push_back(MidiEvent(0, MIDI_NOTE_OFF, 62, 0));
+    track.push_back(MidiEvent(10, MIDI_NOTE_ON, 60, 100));
+    track.push_back(MidiEvent(20, MIDI_NOTE_OFF, 60, 0));
+
+    midiFile.consolidateNoteEvents(0);
+
+    // The stray one stays.
+    QCOMPARE(track.size(), size_t(2));
+    QCOMPARE(track[0].getMessageType(), MIDI_NOTE_OFF);
+    QCOMPARE(track[0].getPitch(), MidiByte(62));
+    QCOMPARE(track[1].getMessageType(), MIDI_NOTE_ON);
+    QCOMPARE(track[1].getDuration(), timeT(10));
+}
+
+// A note-on with no note-off lasts until the last event that stays on
+// the track.
+void TestMidiFile::testUnmatchedNoteOn()
+{
+    MidiFile midiFile;
+
+    MidiFile::MidiTrack &track = midiFile.m_midiComposition[0];
+    track.push_back(MidiEvent(0, MIDI_NOTE_ON, 60, 100));
+    track.push_back(MidiEvent(10, MIDI_NOTE_ON, 64, 100));
+    track.push_back(MidiEvent(20, MIDI_NOTE_OFF, 64, 0));
+    track.push_back(MidiEvent(40, MIDI_CTRL_CHANGE, 7, 100));
+
+    midiFile.consolidateNoteEvents(0);
+
+    QCOMPARE(track.size(), size_t(3));
+    QCOMPARE(track[0].getDuration(), timeT(40));
+    QCOMPARE(track[1].getDuration(), timeT(10));
+
+    // Here the last event is a note-off that goes, so the last one
+    // staying is the note-on before it.  The note-on left waiting on
+    // the first track mustn't be paired with anything here either.
+    MidiFile::MidiTrack &track2 = midiFile.m_midiComposition[1];
+    track2.push_back(MidiEvent(0, MIDI_NOTE_ON, 60, 100));
+    track2.push_back(MidiEvent(10, MIDI_NOTE_ON, 64, 100));
+    track2.push_back(MidiEvent(30, MIDI_NOTE_OFF, 64, 0));
+
+    midiFile.consolidateNoteEvents(1);
+
+    QCOMPARE(track2.size(), size_t(2));
+    QCOMPARE(track2[0].getDuration(), timeT(10));
+    QCOMPARE(track2[1].getDuration(), timeT(20));
+}
+
+// A note-off only ends a note on its own channel.
+void TestMidiFile::testChannels()
+{
+    MidiFile midiFile;
+    MidiFile::MidiTrack &track = midiFile.m_midiComposition[0];
+    track.push_back(MidiEvent(0, MIDI_NOTE_ON, 60, 100));
+    track.push_back(MidiEvent(5, MIDI_NOTE_OFF | 1, 60, 0));
+    track.push_back(MidiEvent(10, MIDI_NOTE_OFF, 60, 0));
+
+    midiFile.consolidateNoteEvents(0);
+
+    QCOMPARE(track.size(), size_t(2));
+    QCOMPARE(track[0].getDuration(), timeT(10));
+    QCOMPARE(track[1].getChannelNumber(), MidiByte(1));
+}
+
+void TestMidiFile::testZeroDuration()
+{
+    MidiFile midiFile;
+    MidiFile::MidiTrack &track = midiFile.m_midiComposition[0];
+    track.push_back(MidiEvent(0, MIDI_NOTE_ON, 60, 100));
+    track.push_back(MidiEvent(0, MIDI_NOTE_OFF, 60, 0));
+
+    midiFile.consolidateNoteEvents(0);
+
+    QCOMPARE(track.size(), size_t(1));
+    QCOMPARE(track[0].getDuration(), timeT(1));
+}
+
+QTEST_GUILESS_MAIN(TestMidiFile)
+
+#include "midifile.moc"
@@ -0,0 +1,218 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "sound/MixKernels.h"
+#include <QTest>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace Rosegarden;
+
+Q_DECLARE_METATYPE(MixKernels::Implementation)
+
+// Compares each MixKernels implementation the CPU supports with plain
+// loops, at lengths that leave odd tails after the vector part.
+class TestMixKernels : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanupTestCase();
+
+    void testMixAdd_data()  { implementations(); }
+    void testMixAdd();
+    void testGain_data()  { implementations(); }
+    void testGain();
+    void testGainRamp_data()  { implementations(); }
+    void testGainRamp();
+    void testPan_data()  { implementations(); }
+    void testPan();
+    void testPeak_data()  { implementations(); }
+    void testPeak();
+    void testRms_data()  { implementations(); }
+    void testRms();
+    void testFlushDenormals_data()  { implementations(); }
+    void testFlushDenormals();
+
+private:
+    /// Rows for each implementation.
+    static void implementations();
+
+    /// Odd and even lengths, to cover the non-vector tails.
+    static std::vector<size_t> lengths()
+        { return { 0, 1, 3, 4, 7, 8, 9, 17, 64, 1001 }; }
+
+    static std::vector<float> noise(size_t n);
+};
+
+void TestMixKernels::implementations()
+{
+    QTest::addColumn<MixKernels::Implementation>("implementation");
+
+    for (int i = MixKernels::Scalar; i <= MixKernels::AVX2; ++i) {
+        const MixKernels::Implementation implementation =
+                static_cast<MixKernels::Implementation>(i);
+        QTest::newRow(MixKernels::getImplementationName(implementation)) <<
+                implementation;
+    }
+}
+
+void TestMixKernels::cleanupTestCase()
+{
+    MixKernels::setImplementation(MixKernels::Scalar);
+}
+
+std::vector<float> TestMixKernels::noise(size_t n)
+{
+    std::vector<float> samples(n);
+    for (float &sample : samples) {
+        sample = float(rand()) / float(RAND_MAX) * 2.0f - 1.0f;
+    }
+    return samples;
+}
+
+// Switch to the implementation in the current data row.
+#define USE_IMPLEMENTATION() \
+    QFETCH(MixKernels::Implementation, implementation); \
+    if (!MixKernels::setImplementation(implementation)) \
+        QSKIP("Not supported by this CPU")
+
+void TestMixKernels::testMixAdd()
+{
+    USE_IMPLEMENTATION();
+
+    for (size_t n : lengths()) {
+        std::vector<float> dest = noise(n);
+        const std::vector<float> src = noise(n);
+        const std::vector<float> expected = dest;
+
+        MixKernels::mixAdd(dest.data(), src.data(), n);
+
+        for (size_t i = 0; i < n; ++i) {
+            QCOMPARE(dest[i], expected[i] + src[i]);
+        }
+    }
+}
+
+void TestMixKernels::testGain()
+{
+    USE_IMPLEMENTATION();
+
+    for (size_t n : lengths()) {
+        std::vector<float> buffer = noise(n);
+        const std::vector<float> expected = buffer;
+
+        MixKernels::gain(buffer.data(), n, 0.7f);
+
+        for (size_t i = 0; i < n; ++i) {
+            QCOMPARE(buffer[i], expected[i] * 0.7f);
+        }
+    }
+}
+
+void TestMixKernels::testGainRamp()
+{
+    USE_IMPLEMENTATION();
+
+    for (size_t n : lengths()) {
+        std::vector<float> buffer(n, 1.0f);
+
+        MixKernels::gainRamp(buffer.data(), n, 0.2f, 1.0f);
+
+        for (size_t i = 0; i < n; ++i) {
+            const float expected = 0.2f + 0.8f * float(i) / float(n);
+            QVERIFY(fabsf(buffer[i] - expected) < 1e-6f);
+        }
+    }
+}
+
+void TestMixKernels::testPan()
+{
+    USE_IMPLEMENTATION();
+
+    for (size_t n : lengths()) {
+        const std::vector<float> src = noise(n);
+        std::vector<float> left(n);
+        std::vector<float> right(n);
+
+        MixKernels::pan(src.data(), left.data(), right.data(), n, 0.3f, 0.9f);
+
+        for (size_t i = 0; i < n; ++i) {
+            QCOMPARE(left[i], src[i] * 0.3f);
+            QCOMPARE(right[i], src[i] * 0.9f);
+        }
+
+        // In place, as AudioInstrumentMixer does it.
+        std::vector<float> inPlace = src;
+        MixKernels::pan(inPlace.data(), inPlace.data(), right.data(), n,
+                        0.3f, 0.9f);
+        QVERIFY(inPlace == left);
+    }
+}
+
+void TestMixKernels::testPeak()
+{
+    USE_IMPLEMENTATION();
+
+    for (size_t n : lengths()) {
+        std::vector<float> src = noise(n);
+        if (n == 0) {
+            QCOMPARE(MixKernels::peak(src.data(), n), 0.0f);
+            continue;
+        }
+
+        // Negative peaks count, and NaNs are ignored.
+        src[n - 1] = -2.0f;
+        if (n > 2)
+            src[n / 2] = NAN;
+
+        QCOMPARE(MixKernels::peak(src.data(), n), 2.0f);
+    }
+}
+
+void TestMixKernels::testRms()
+{
+    USE_IMPLEMENTATION();
+
+    for (size_t n : lengths()) {
+        const std::vector<float> src = noise(n);
+
+        double sum = 0.0;
+        for (float sample : src) {
+            sum += sample * sample;
+        }
+        const double expected = (n == 0) ? 0.0 : sqrt(sum / n);
+
+        QVERIFY(fabs(MixKernels::rms(src.data(), n) - expected) < 1e-5);
+    }
+}
+
+void TestMixKernels::testFlushDenormals()
+{
+    USE_IMPLEMENTATION();
+
+    for (size_t n : lengths()) {
+        std::vector<float> buffer = noise(n);
+        for (size_t i = 0; i < n; i += 3) {
+            buffer[i] = (i % 2) ? -1e-40f : 1e-39f;
+        }
+        if (n > 1)
+            buffer[1] = NAN;
+        const std::vector<float> before = buffer;
+
+        MixKernels::flushDenormals(buffer.data(), n);
+
+        for (size_t i = 0; i < n; ++i) {
+            if (fabsf(before[i]) >= FLT_MIN)
+                QCOMPARE(buffer[i], before[i]);
+            else
+                QCOMPARE(buffer[i], 0.0f);
+        }
+    }
+}
+
+QTEST_MAIN(TestMixKernels)
+
+#include "mixkernels.moc"
@@ -0,0 +1,480 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/BaseProperties.h"
+#include "base/Composition.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "base/Track.h"
+#include "base/ViewElement.h"
+#include "document/RosegardenDocument.h"
+#include "gui/editors/notation/NotationElement.h"
+#include "gui/editors/notation/NotationHLayout.h"
+#include "gui/editors/notation/NotationScene.h"
+#include "gui/editors/notation/NotationStaff.h"
+#include "gui/editors/notation/NotationWidget.h"
+#include "gui/editors/notation/StaffLayout.h"
+#include "misc/ConfigGroups.h"
+
+#include <QRegularExpression>
+#include <QSettings>
+#include <QTest>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Rosegarden;
+
+// Checks that laying out a score gives the same result whichever way
+// it is done: with the staffs scanned at once or one at a time, and
+// after an edit, by relaying out only the changed bars or everything.
+// Also checks that lazy rendering makes items only near the viewport.
+class TestNotationLayout : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestNotationLayout() :
+        m_doc(nullptr, {}, true /*skip autoload*/, true, false /*no sound*/)
+    { }
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testParallelScan();
+    void testIncrementalRelayout_data();
+    void testIncrementalRelayout();
+    void testLazyRendering();
+
+private:
+    RosegardenDocument m_doc;
+    std::vector<Segment *> m_segments;
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+    const timeT bar = 4 * crotchet;
+
+    Event *makeNote(timeT time, timeT duration, int pitch)
+    {
+        Event *event = new Event(Note::EventType, time, duration);
+        event->set<Int>(BaseProperties::PITCH, pitch);
+        event->set<Int>(BaseProperties::VELOCITY, 100);
+        return event;
+    }
+
+    /// Add a track with bars bars of quavers and crotchets, with marks
+    /// on some of the notes, a slur over the start of every bar and a
+    /// hairpin every fourth bar.  t varies the pitches and the marks.
+    Segment *addTrack(Composition &composition, int t, int bars)
+    {
+        const TrackId trackId = composition.getNewTrackId();
+        composition.addTrack(new Track(trackId));
+
+        Segment *segment = new Segment;
+        segment->setTrack(trackId);
+        segment->setLabel(QString("Track %1").arg(t).toStdString());
+        composition.addSegment(segment);
+
+        const Mark marks[] = {
+            Marks::Accent, Marks::Staccato, Marks::Tenuto, Marks::Sforzando
+        };
+
+        int n = 0;
+        for (int b = 0; b < bars; ++b) {
+            const timeT barStart = b * bar;
+
+            // Four quavers, then two crotchets.
+            for (int i = 0; i < 6; ++i, ++n) {
+                const timeT duration = i < 4 ? crotchet / 2 : crotchet;
+                const timeT time = i < 4 ?
+                        barStart + i * crotchet / 2 :
+                        barStart + (i - 2) * crotchet;
+                Event *note = makeNote(time, duration,
+                                       55 + (t * 7 + b * 3 + i * 5) % 30);
+                if ((n + t) % 3 == 0)
+                    Marks::addMark(*note, marks[(n + t) % 4], true);
+                if ((n + t) % 7 == 0)
+                    Marks::addMark(*note, Marks::Pause, true);
+                segment->insert(note);
+            }
+
+            segment->insert(
+                    Indication(Indication::Slur, crotchet * 3 / 2)
+                            .getAsEvent(barStart));
+
+            if (b % 4 == t % 4) {
+                segment->insert(
+                        Indication(b % 8 < 4 ? Indication::Crescendo :
+                                               Indication::Decrescendo,
+                                   bar)
+                                .getAsEvent(barStart + crotchet));
+            }
+        }
+
+        segment->insert(Key("Eb major").getAsEvent(bars / 2 * bar));
+
+        return segment;
+    }
+
+    /// Everything the layout found for each staff: its bar data, and
+    /// the position and layout properties of each of its elements.
+    std::vector<QString> snapshot(NotationScene &scene)
+    {
+        std::vector<QString> staffs;
+
+        for (NotationStaff *staff : *scene.getStaffs()) {
+            std::ostringstream out;
+            out.precision(17);
+
+            scene.getHLayout()->writeBarData(*staff, out);
+
+            ViewElementList *elements = staff->getViewElementList();
+            for (const ViewElement *element : *elements) {
+                const Event *event = element->event();
+                out << event->getType() << " "
+                    << event->getAbsoluteTime() << ": "
+                    << element->getLayoutX() << ", "
+                    << element->getLayoutY();
+
+                for (const PropertyName &name :
+                         event->getNonPersistentPropertyNames()) {
+                    out << " " << name.getName()
+                        << "=" << event->getAsString(name);
+                }
+                out << "\n";
+            }
+
+            staffs.push_back(QString::fromStdString(out.str()));
+        }
+
+        return staffs;
+    }
+
+    /// The bar positions, and each staff's reconciled and clef and key
+    /// widths: what the reconcile step decides.
+    std::vector<QString> barSnapshot(NotationScene &scene)
+    {
+        std::vector<QString> result;
+        NotationHLayout *hlayout = scene.getHLayout();
+
+        std::ostringstream positions;
+        positions.precision(17);
+        for (int b = hlayout->getFirstVisibleBar();
+             b <= hlayout->getLastVisibleBar() + 1; ++b) {
+            positions << "bar " << b << ": " << hlayout->getBarPosition(b)
+                      << "\n";
+        }
+        result.push_back(QString::fromStdString(positions.str()));
+
+        // Pick the widths out of writeBarData()'s lines, e.g.
+        // "bar 3: ... reconciled 123.5 ... clefKey 0 ...".
+        static const QRegularExpression widths(
+                "^(bar -?\\d+):.* (reconciled \\S+) .* (clefKey \\S+) ");
+
+        for (NotationStaff *staff : *scene.getStaffs()) {
+            std::ostringstream out;
+            hlayout->writeBarData(*staff, out);
+
+            QString staffWidths;
+            const QStringList lines =
+                    QString::fromStdString(out.str()).split('\n');
+            for (const QString &line : lines) {
+                const QRegularExpressionMatch match = widths.match(line);
+                if (!match.hasMatch())
+                    continue;
+                staffWidths += match.captured(1) + " " + match.captured(2) +
+                               " " + match.captured(3) + "\n";
+            }
+            result.push_back(staffWidths);
+        }
+
+        return result;
+    }
+}
+
+void TestNotationLayout::initTestCase()
+{
+    // Make sure settings end up in the right place.
+    QCoreApplication::setOrganizationName("rosegardenmusic");
+
+    RosegardenDocument::currentDocument = &m_doc;
+
+    Composition &composition = m_doc.getComposition();
+    composition.addTimeSignature(8 * bar, TimeSignature(3, 4));
+
+    for (int t = 0; t < 6; ++t) {
+        m_segments.push_back(addTrack(composition, t, 24));
+    }
+}
+
+void TestNotationLayout::cleanupTestCase()
+{
+    RosegardenDocument::currentDocument = nullptr;
+}
+
+void TestNotationLayout::testParallelScan()
+{
+    NotationWidget widget;
+    widget.setSegments(&m_doc, m_segments);
+    NotationScene *scene = widget.getScene();
+    QVERIFY(scene);
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int threads = pool->maxThreadCount();
+
+    // NotationScene scans serially when the pool has one thread, so
+    // make sure it has several, even on a single core.
+    pool->setMaxThreadCount(std::max(threads, 4));
+    scene->layoutAll();
+    const std::vector<QString> parallel = snapshot(*scene);
+
+    pool->setMaxThreadCount(1);
+    scene->layoutAll();
+    const std::vector<QString> serial = snapshot(*scene);
+
+    pool->setMaxThreadCount(threads);
+
+    QCOMPARE(parallel.size(), m_segments.size());
+    QCOMPARE(serial.size(), parallel.size());
+    for (size_t i = 0; i < parallel.size(); ++i) {
+        QVERIFY(!parallel[i].isEmpty());
+        QCOMPARE(parallel[i], serial[i]);
+    }
+}
+
+void TestNotationLayout::testIncrementalRelayout_data()
+{
+    QTest::addColumn<bool>("pageMode");
+    QTest::addColumn<int>("where");
+
+    // where: 0 at the start of a row, 1 in the middle of one, 2 in the
+    // last bar.
+    QTest::newRow("linear, row start") << false << 0;
+    QTest::newRow("linear, middle") << false << 1;
+    QTest::newRow("linear, last bar") << false << 2;
+    QTest::newRow("page, row start") << true << 0;
+    QTest::newRow("page, middle") << true << 1;
+    QTest::newRow("page, last bar") << true << 2;
+}
+
+void TestNotationLayout::testIncrementalRelayout()
+{
+    QFETCH(bool, pageMode);
+    QFETCH(int, where);
+
+    Composition &composition = m_doc.getComposition();
+    Segment *segment = m_segments[0];
+
+    // Wide enough for several bars a row, narrow enough for several
+    // rows.
+    NotationWidget widget;
+    widget.resize(1000, 800);
+    widget.setSegments(&m_doc, m_segments);
+    NotationScene *scene = widget.getScene();
+    QVERIFY(scene);
+
+    if (pageMode)
+        scene->setPageMode(StaffLayout::ContinuousPageMode);
+    scene->layoutAll();
+
+    NotationHLayout *hlayout = scene->getHLayout();
+    const int lastBar = std::min(
+            hlayout->getLastVisibleBar(),
+            composition.getBarNumber(segment->getEndMarkerTime() - 1));
+
+    int editBar = 0;
+    if (pageMode) {
+        const std::vector<int> &rowStarts = hlayout->getRowStartBars();
+        QVERIFY(rowStarts.size() >= 3);
+        switch (where) {
+        case 0: editBar = rowStarts[2]; break;
+        case 1: editBar = (rowStarts[1] + rowStarts[2]) / 2; break;
+        default: editBar = lastBar; break;
+        }
+        if (where == 1)
+            QVERIFY(editBar > rowStarts[1]  &&  editBar < rowStarts[2]);
+    } else {
+        QVERIFY(hlayout->getRowStartBars().empty());
+        switch (where) {
+        case 0: editBar = hlayout->getFirstVisibleBar(); break;
+        case 1: editBar = lastBar / 2; break;
+        default: editBar = lastBar; break;
+        }
+    }
+
+    // A new clef, and an accidental in a chord, so that both the clef
+    // and key width and the bar's own width change.
+    const timeT barStart = composition.getBarStart(editBar);
+    Event *clef = Clef(Clef::Bass).getAsEvent(barStart);
+    Event *note = makeNote(barStart, crotchet / 2, 61);
+    segment->insert(clef);
+    segment->insert(note);
+
+    // Only this segment changed, so this relayouts from its bar on.
+    scene->slotCommandExecuted();
+
+    // Check the partial reconcile ran, rather than falling back to a
+    // full one.
+    if (editBar > hlayout->getFirstVisibleBar() + 1) {
+        QVERIFY(hlayout->getFirstChangedBar() >
+                hlayout->getFirstVisibleBar());
+    }
+
+    const std::vector<QString> incremental = barSnapshot(*scene);
+
+    scene->layoutAll();
+    const std::vector<QString> full = barSnapshot(*scene);
+
+    segment->eraseSingle(note);
+    segment->eraseSingle(clef);
+    scene->slotCommandExecuted();
+
+    QCOMPARE(incremental.size(), m_segments.size() + 1);
+    QCOMPARE(full.size(), incremental.size());
+    for (size_t i = 0; i < full.size(); ++i) {
+        QVERIFY(!full[i].isEmpty());
+        QCOMPARE(incremental[i], full[i]);
+    }
+}
+
+namespace
+{
+    /// Check that the notes on staff well within viewport have items
+    /// and those well outside it don't.  Returns what is wrong, if
+    /// anything.
+    QString checkNoteItems(NotationStaff &staff, const QRectF &viewport)
+    {
+        // A note's beam may reach some way past it, so leave the
+        // ones near the edges alone.
+        const double slack = 300;
+
+        int inside = 0;
+        int outside = 0;
+
+        for (ViewElement *element : *staff.getViewElementList()) {
+            NotationElement *el = static_cast<NotationElement *>(element);
+            if (!el->event()->isa(Note::EventType))
+                continue;
+
+            const double x = staff.getSceneCoordsForLayoutCoords(
+                    el->getLayoutX(), int(el->getLayoutY())).first;
+
+            if (x > viewport.left() + 10  &&  x < viewport.right() - 10) {
+                if (!el->getItem())
+                    return QString("No item for the note at %1").arg(x);
+                ++inside;
+            } else if (x < viewport.left() - slack  ||
+                       x > viewport.right() + slack) {
+                if (el->getItem())
+                    return QString("Item for the note at %1").arg(x);
+                ++outside;
+            }
+        }
+
+        if (inside == 0  ||  outside == 0)
+            return QString("Only %1 notes inside and %2 outside")
+                    .arg(inside).arg(outside);
+
+        return QString();
+    }
+}
+
+void TestNotationLayout::testLazyRendering()
+{
+    // Items only within the viewport itself.
+    QSettings settings;
+    settings.beginGroup(NotationViewConfigGroup);
+    const QVariant oldLazy = settings.value("lazyrendering");
+    const QVariant oldMargin = settings.value("lazyrenderingmargin");
+    settings.setValue("lazyrendering", true);
+    settings.setValue("lazyrenderingmargin", 0);
+
+    NotationWidget widget;
+    widget.setSegments(&m_doc, m_segments);
+    NotationScene *scene = widget.getScene();
+
+    // Put the settings back before anything can fail.
+    if (oldLazy.isValid())
+        settings.setValue("lazyrendering", oldLazy);
+    else
+        settings.remove("lazyrendering");
+    if (oldMargin.isValid())
+        settings.setValue("lazyrenderingmargin", oldMargin);
+    else
+        settings.remove("lazyrenderingmargin");
+    settings.endGroup();
+
+    QVERIFY(scene);
+    QVERIFY(scene->isLazyRendering());
+    scene->layoutAll();
+
+    NotationStaff *staff = scene->getStaffs()->front();
+    const QRectF sceneRect = scene->sceneRect();
+    const double width = 600;
+    QVERIFY(sceneRect.width() > 4 * width);
+
+    auto render = [scene, &sceneRect, width](double left) {
+        const QRectF viewport(left, sceneRect.top(),
+                              width, sceneRect.height());
+        scene->slotViewportChanged(viewport);
+        scene->slotRenderViewport();
+        return viewport;
+    };
+
+    // At the start.
+    QRectF viewport = render(sceneRect.left());
+    QString problem = checkNoteItems(*staff, viewport);
+    QVERIFY2(problem.isEmpty(), qPrintable(problem));
+
+    // Scrolled to the end, the notes at the start lose their items and
+    // those at the end get theirs.
+    viewport = render(sceneRect.right() - width);
+    problem = checkNoteItems(*staff, viewport);
+    QVERIFY2(problem.isEmpty(), qPrintable(problem));
+
+    // And back again.
+    viewport = render(sceneRect.left());
+    problem = checkNoteItems(*staff, viewport);
+    QVERIFY2(problem.isEmpty(), qPrintable(problem));
+
+    // A hairpin whose start has scrolled out of view keeps its item
+    // while its end is still in view.
+    NotationElement *hairpin = nullptr;
+    for (ViewElement *element : *staff->getViewElementList()) {
+        const Event *event = element->event();
+        if (event->isa(Indication::EventType)  &&
+            Indication(*event).getIndicationType() != Indication::Slur) {
+            hairpin = static_cast<NotationElement *>(element);
+            break;
+        }
+    }
+    QVERIFY(hairpin);
+
+    const int y = int(hairpin->getLayoutY());
+    const double startX = staff->getSceneCoordsForLayoutCoords(
+            hairpin->getLayoutX(), y).first;
+    const double endX = staff->getSceneCoordsForLayoutCoords(
+            scene->getHLayout()->getXForTime(
+                    hairpin->getViewAbsoluteTime() +
+                    Indication(*hairpin->event()).getIndicationDuration()),
+            y).first;
+    QVERIFY(endX - startX > 20);
+
+    // Well to the right first, so that it has no item.
+    render(sceneRect.right() - width);
+    QVERIFY(!hairpin->getItem());
+
+    render(startX + 10);
+    QVERIFY(hairpin->getItem());
+}
+
+QTEST_MAIN(TestNotationLayout)
+
+#include "notationlayout.moc"
@@ -0,0 +1,120 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "sound/NoteOffQueue.h"
+#include <QTest>
+
+using namespace Rosegarden;
+
+// Tests for the NoteOffQueue that AlsaDriver uses to schedule MIDI
+// note-offs.
+class TestNoteOffQueue : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testOrder();
+    void testEqualTimes();
+    void testRemove();
+    void testAdjustTimes();
+    void testSlotReuse();
+};
+
+void TestNoteOffQueue::testOrder()
+{
+    NoteOffQueue queue;
+
+    const int secs[] = { 5, 1, 4, 2, 3, 0 };
+    for (int sec : secs) {
+        queue.insert(NoteOffEvent(RealTime(sec, 0), 60, 0, 1000));
+    }
+    QCOMPARE(queue.size(), size_t(6));
+
+    for (int sec = 0; sec < 6; ++sec) {
+        QCOMPARE(queue.top().realTime, RealTime(sec, 0));
+        queue.pop();
+    }
+    QVERIFY(queue.empty());
+}
+
+void TestNoteOffQueue::testEqualTimes()
+{
+    // Note-offs with the same time come out in insertion order.
+    NoteOffQueue queue;
+
+    for (MidiByte pitch = 0; pitch < 100; ++pitch) {
+        queue.insert(NoteOffEvent(RealTime(1, 0), pitch, 0, 1000));
+    }
+
+    for (MidiByte pitch = 0; pitch < 100; ++pitch) {
+        QCOMPARE(int(queue.top().pitch), int(pitch));
+        queue.pop();
+    }
+}
+
+void TestNoteOffQueue::testRemove()
+{
+    NoteOffQueue queue;
+
+    queue.insert(NoteOffEvent(RealTime(3, 0), 60, 0, 1000));
+    queue.insert(NoteOffEvent(RealTime(1, 0), 60, 0, 1000));
+    queue.insert(NoteOffEvent(RealTime(2, 0), 64, 0, 1000));
+    queue.insert(NoteOffEvent(RealTime(2, 0), 60, 1, 1000));
+
+    QVERIFY(queue.contains(60, 0, 1000));
+    QVERIFY(!queue.contains(60, 0, 1001));
+    QVERIFY(!queue.remove(67, 0, 1000));
+
+    // The earliest of the two matching note-offs goes.
+    QVERIFY(queue.remove(60, 0, 1000));
+    QCOMPARE(queue.size(), size_t(3));
+    QVERIFY(queue.contains(60, 0, 1000));
+
+    QCOMPARE(queue.top().realTime, RealTime(2, 0));
+    QCOMPARE(int(queue.top().pitch), 64);
+    queue.pop();
+    QCOMPARE(int(queue.top().channel), 1);
+    queue.pop();
+    QCOMPARE(queue.top().realTime, RealTime(3, 0));
+
+    QVERIFY(queue.remove(60, 0, 1000));
+    QVERIFY(queue.empty());
+    QVERIFY(!queue.contains(60, 0, 1000));
+}
+
+void TestNoteOffQueue::testAdjustTimes()
+{
+    NoteOffQueue queue;
+
+    for (int sec = 0; sec < 10; ++sec) {
+        queue.insert(NoteOffEvent(RealTime(sec, 0), sec, 0, 1000));
+    }
+
+    // Reverse the order.
+    queue.adjustTimes([](RealTime &realTime) {
+        realTime = RealTime(10, 0) - realTime;
+    });
+
+    for (int pitch = 9; pitch >= 0; --pitch) {
+        QCOMPARE(int(queue.top().pitch), pitch);
+        queue.pop();
+    }
+}
+
+void TestNoteOffQueue::testSlotReuse()
+{
+    NoteOffQueue queue(16);
+
+    for (int pass = 0; pass < 100; ++pass) {
+        for (MidiByte pitch = 0; pitch < 16; ++pitch) {
+            queue.insert(NoteOffEvent(RealTime(pass, 0), pitch, 0, 1000));
+        }
+        queue.clear();
+    }
+
+    QCOMPARE(queue.getCapacity(), size_t(16));
+}
+
+QTEST_MAIN(TestNoteOffQueue)
+
+#include "noteoffqueue.moc"
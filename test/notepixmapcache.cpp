@@ -0,0 +1,170 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "gui/editors/notation/NotePixmapCache.h"
+#include "gui/editors/notation/NotePixmapParameters.h"
+
+#include <QPixmap>
+#include <QTest>
+
+using namespace Rosegarden;
+
+// Checks that the shared note pixmap cache counts hits and misses,
+// drops the least recently used pixmaps to stay within its limit, and
+// that equal NotePixmapParameters make equal keys.
+class TestNotePixmapCache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanupTestCase();
+
+    void testFind();
+    void testEviction();
+    void testTooBig();
+    void testKeys();
+};
+
+namespace
+{
+    QPixmap makePixmap(int width)
+    {
+        QPixmap pixmap(width, 10);
+        pixmap.fill(Qt::transparent);
+        return pixmap;
+    }
+
+    size_t pixmapBytes(const QPixmap &pixmap)
+    {
+        return size_t(pixmap.width()) * size_t(pixmap.height()) *
+               size_t(pixmap.depth() / 8);
+    }
+
+    QByteArray keyFor(const NotePixmapParameters &params)
+    {
+        QByteArray key;
+        params.appendToKey(key);
+        return key;
+    }
+}
+
+void TestNotePixmapCache::init()
+{
+    NotePixmapCache::clear();
+    NotePixmapCache::setLimit(16 * 1024 * 1024);
+    NotePixmapCache::resetStatistics();
+}
+
+void TestNotePixmapCache::cleanupTestCase()
+{
+    NotePixmapCache::clear();
+}
+
+void TestNotePixmapCache::testFind()
+{
+    QPixmap pixmap;
+    QVERIFY(!NotePixmapCache::find("a", pixmap));
+
+    NotePixmapCache::insert("a", makePixmap(10));
+    QVERIFY(NotePixmapCache::find("a", pixmap));
+    QCOMPARE(pixmap.width(), 10);
+
+    // Replacing doesn't count the old one twice.
+    NotePixmapCache::insert("a", makePixmap(20));
+    QVERIFY(NotePixmapCache::find("a", pixmap));
+    QCOMPARE(pixmap.width(), 20);
+
+    const NotePixmapCache::Statistics statistics =
+            NotePixmapCache::getStatistics();
+    QCOMPARE(statistics.hits, size_t(2));
+    QCOMPARE(statistics.misses, size_t(1));
+    QCOMPARE(statistics.pixmaps, size_t(1));
+    QCOMPARE(statistics.bytes, pixmapBytes(pixmap));
+}
+
+void TestNotePixmapCache::testEviction()
+{
+    const size_t size = pixmapBytes(makePixmap(10));
+    NotePixmapCache::setLimit(3 * size);
+
+    NotePixmapCache::insert("a", makePixmap(10));
+    NotePixmapCache::insert("b", makePixmap(10));
+    NotePixmapCache::insert("c", makePixmap(10));
+
+    // Using "a" makes "b" the least recently used.
+    QPixmap pixmap;
+    QVERIFY(NotePixmapCache::find("a", pixmap));
+    NotePixmapCache::insert("d", makePixmap(10));
+
+    QVERIFY(NotePixmapCache::find("a", pixmap));
+    QVERIFY(!NotePixmapCache::find("b", pixmap));
+    QVERIFY(NotePixmapCache::find("c", pixmap));
+    QVERIFY(NotePixmapCache::find("d", pixmap));
+
+    NotePixmapCache::Statistics statistics = NotePixmapCache::getStatistics();
+    QCOMPARE(statistics.evictions, size_t(1));
+    QCOMPARE(statistics.bytes, 3 * size);
+
+    // Lowering the limit evicts at once.
+    NotePixmapCache::setLimit(size);
+    statistics = NotePixmapCache::getStatistics();
+    QCOMPARE(statistics.pixmaps, size_t(1));
+    QVERIFY(NotePixmapCache::find("d", pixmap));
+}
+
+void TestNotePixmapCache::testTooBig()
+{
+    NotePixmapCache::insert("a", makePixmap(10));
+    NotePixmapCache::setLimit(pixmapBytes(makePixmap(10)));
+
+    // Bigger than the whole cache: not kept, and nothing evicted.
+    NotePixmapCache::insert("b", makePixmap(100));
+
+    QPixmap pixmap;
+    QVERIFY(!NotePixmapCache::find("b", pixmap));
+    QVERIFY(NotePixmapCache::find("a", pixmap));
+}
+
+void TestNotePixmapCache::testKeys()
+{
+    NotePixmapParameters a(Note::Crotchet, 0);
+    NotePixmapParameters b(Note::Crotchet, 0);
+    QVERIFY(a == b);
+    QCOMPARE(keyFor(a), keyFor(b));
+
+    b.setDots(1);
+    QVERIFY(keyFor(a) != keyFor(b));
+
+    b = a;
+    b.setAccidental(Accidentals::Sharp);
+    QVERIFY(keyFor(a) != keyFor(b));
+
+    b = a;
+    b.setStemGoesUp(false);
+    QVERIFY(keyFor(a) != keyFor(b));
+
+    b = a;
+    std::vector<Mark> marks;
+    marks.push_back(Marks::Accent);
+    b.setMarks(marks);
+    QVERIFY(keyFor(a) != keyFor(b));
+
+    // The forced colour only matters when it is forced.
+    b = a;
+    b.setForcedColor(Qt::red);
+    QVERIFY(keyFor(a) != keyFor(b));
+    b.clearForcedColour();
+    QVERIFY(a == b);
+    QCOMPARE(keyFor(a), keyFor(b));
+
+    // Gradients within operator=='s tolerance.
+    a.setGradient(0.5);
+    b.setGradient(0.50000001);
+    QVERIFY(a == b);
+    QCOMPARE(keyFor(a), keyFor(b));
+}
+
+QTEST_MAIN(TestNotePixmapCache)
+
+#include "notepixmapcache.moc"
@@ -0,0 +1,157 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/Composition.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "base/Track.h"
+#include "gui/editors/segment/compositionview/SegmentIndex.h"
+
+#include <QTest>
+
+#include <vector>
+
+using namespace Rosegarden;
+
+// Checks that SegmentIndex finds the segments overlapping a time range
+// on a track, repeats included, and that it picks up changes once
+// invalidated.
+class TestSegmentIndex : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testRange();
+    void testLongSegment();
+    void testRepeating();
+    void testInvalidate();
+};
+
+namespace
+{
+    const timeT bar = Note(Note::Semibreve).getDuration();
+
+    TrackId addTrack(Composition &composition)
+    {
+        const TrackId trackId = composition.getNewTrackId();
+        composition.addTrack(new Track(trackId));
+        return trackId;
+    }
+
+    Segment *addSegment(Composition &composition, TrackId trackId,
+                        timeT start, timeT end)
+    {
+        Segment *segment = new Segment;
+        segment->setTrack(trackId);
+        segment->setStartTime(start);
+        composition.addSegment(segment);
+        segment->setEndMarkerTime(end);
+        return segment;
+    }
+
+    std::vector<Segment *> query(SegmentIndex &index, TrackId trackId,
+                                 timeT start, timeT end)
+    {
+        std::vector<Segment *> segments;
+        index.getSegments(trackId, start, end, segments);
+        return segments;
+    }
+}
+
+void TestSegmentIndex::testRange()
+{
+    Composition composition;
+    const TrackId track0 = addTrack(composition);
+    const TrackId track1 = addTrack(composition);
+
+    Segment *a = addSegment(composition, track0, 0, bar * 2);
+    Segment *b = addSegment(composition, track0, bar * 4, bar * 6);
+    Segment *c = addSegment(composition, track1, 0, bar * 8);
+
+    SegmentIndex index(composition);
+
+    QVERIFY(query(index, track0, bar, bar) ==
+            std::vector<Segment *>({a}));
+    QVERIFY(query(index, track0, bar * 3, bar * 3) ==
+            std::vector<Segment *>());
+    QVERIFY(query(index, track0, bar, bar * 5) ==
+            std::vector<Segment *>({a, b}));
+    QVERIFY(query(index, track1, bar * 3, bar * 3) ==
+            std::vector<Segment *>({c}));
+
+    // The ends are inclusive.
+    QVERIFY(query(index, track0, bar * 2, bar * 2) ==
+            std::vector<Segment *>({a}));
+    QVERIFY(query(index, track0, bar * 3, bar * 4) ==
+            std::vector<Segment *>({b}));
+
+    // No such track.
+    QVERIFY(query(index, track1 + 1, 0, bar * 8) ==
+            std::vector<Segment *>());
+}
+
+void TestSegmentIndex::testLongSegment()
+{
+    // A long segment that starts well before the range, among short
+    // ones, is still found.
+    Composition composition;
+    const TrackId track = addTrack(composition);
+
+    Segment *longSegment = addSegment(composition, track, 0, bar * 100);
+    for (int i = 0; i < 50; ++i) {
+        addSegment(composition, track, bar * i * 2, bar * (i * 2 + 1));
+    }
+
+    SegmentIndex index(composition);
+
+    const std::vector<Segment *> segments =
+            query(index, track, bar * 90 + 1, bar * 90 + 2);
+    QCOMPARE(segments.size(), size_t(2));
+    QVERIFY(segments[0] == longSegment  ||  segments[1] == longSegment);
+}
+
+void TestSegmentIndex::testRepeating()
+{
+    Composition composition;
+    const TrackId track = addTrack(composition);
+
+    Segment *a = addSegment(composition, track, 0, bar);
+    addSegment(composition, track, bar * 10, bar * 11);
+    a->setRepeating(true);
+
+    // a repeats up to the next segment on its track.
+    SegmentIndex index(composition);
+    QVERIFY(query(index, track, bar * 5, bar * 5) ==
+            std::vector<Segment *>({a}));
+}
+
+void TestSegmentIndex::testInvalidate()
+{
+    Composition composition;
+    const TrackId track = addTrack(composition);
+
+    Segment *a = addSegment(composition, track, 0, bar);
+
+    SegmentIndex index(composition);
+    QVERIFY(query(index, track, bar * 5, bar * 5) ==
+            std::vector<Segment *>());
+
+    // Stale until invalidated.
+    a->setEndMarkerTime(bar * 8);
+    QVERIFY(query(index, track, bar * 5, bar * 5) ==
+            std::vector<Segment *>());
+
+    index.invalidate();
+    QVERIFY(query(index, track, bar * 5, bar * 5) ==
+            std::vector<Segment *>({a}));
+
+    composition.detachSegment(a);
+    index.invalidate();
+    QVERIFY(query(index, track, bar * 5, bar * 5) ==
+            std::vector<Segment *>());
+    delete a;
+}
+
+QTEST_MAIN(TestSegmentIndex)
+
+#include "segmentindex.moc"
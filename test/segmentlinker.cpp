@@ -0,0 +1,173 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/BaseProperties.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "base/SegmentLinker.h"
+#include "document/BasicCommand.h"
+#include "document/CommandHistory.h"
+#include <QTest>
+#include <vector>
+
+using namespace Rosegarden;
+
+// An edit to one linked segment has to reach the others, and undo with
+// it, without replacing the events that didn't change.
+class TestSegmentLinker : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEdit();
+    void testIgnored();
+    void testUndo();
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+
+    /// Sets the velocity of the note at a time, in place.
+    class SetVelocityCommand : public BasicCommand
+    {
+    public:
+        SetVelocityCommand(Segment &segment, timeT time, int velocity) :
+            BasicCommand("Set Velocity", segment, time, time + crotchet),
+            m_time(time),
+            m_velocity(velocity)
+        { }
+
+    protected:
+        void modifySegment() override
+        {
+            Event *e = *getSegment().findTime(m_time);
+            e->set<Int>(BaseProperties::VELOCITY, m_velocity);
+        }
+
+    private:
+        timeT m_time;
+        int m_velocity;
+    };
+
+    /// A segment of count crotchets with rising pitches.
+    Segment *makeSegment(int count)
+    {
+        Segment *segment = new Segment;
+        for (int i = 0; i < count; ++i) {
+            Event *e = new Event(Note::EventType, i * crotchet, crotchet);
+            e->set<Int>(BaseProperties::PITCH, 36 + i % 60);
+            e->set<Int>(BaseProperties::VELOCITY, 100);
+            segment->insert(e);
+        }
+        return segment;
+    }
+
+    /// Run a command as CommandHistory does.
+    void execute(Command &command)
+    {
+        command.execute();
+        emit CommandHistory::getInstance()->updateLinkedSegments(&command);
+    }
+
+    void unexecute(Command &command)
+    {
+        command.unexecute();
+        emit CommandHistory::getInstance()->updateLinkedSegments(&command);
+    }
+
+    long velocityAt(const Segment &segment, timeT time)
+    {
+        return (*segment.findTime(time))->get<Int>(BaseProperties::VELOCITY);
+    }
+
+    long pitchAt(const Segment &segment, timeT time)
+    {
+        return (*segment.findTime(time))->get<Int>(BaseProperties::PITCH);
+    }
+
+    std::vector<const Event *> events(const Segment &segment)
+    {
+        return std::vector<const Event *>(segment.begin(), segment.end());
+    }
+}
+
+void TestSegmentLinker::testEdit()
+{
+    Segment *source = makeSegment(100);
+    Segment *link = SegmentLinker::createLinkedSegment(source);
+    link->setStartTime(400 * crotchet);
+    Segment *transposed = SegmentLinker::createLinkedSegment(source);
+    transposed->setLinkTransposeParams(
+            Segment::LinkTransposeParams(false, 1, 2, false));
+    source->getLinker()->clearRefreshStatuses();
+
+    const std::vector<const Event *> before = events(*link);
+
+    SetVelocityCommand command(*source, 50 * crotchet, 64);
+    execute(command);
+
+    QCOMPARE(velocityAt(*link, 450 * crotchet), 64l);
+    QCOMPARE(velocityAt(*transposed, 50 * crotchet), 64l);
+    QCOMPARE(pitchAt(*transposed, 50 * crotchet),
+             pitchAt(*source, 50 * crotchet) + 2);
+
+    // Only the edited note has been replaced.
+    const std::vector<const Event *> after = events(*link);
+    QCOMPARE(after.size(), before.size());
+    int replaced = 0;
+    for (size_t i = 0; i < before.size(); ++i) {
+        if (after[i] != before[i])
+            ++replaced;
+    }
+    QCOMPARE(replaced, 1);
+
+    delete transposed;
+    delete link;
+    delete source;
+}
+
+void TestSegmentLinker::testIgnored()
+{
+    Segment *source = makeSegment(10);
+    Segment *link = SegmentLinker::createLinkedSegment(source);
+
+    // An event only in the link, which updates must not remove.
+    Event *text = Text("only here").getAsEvent(3 * crotchet);
+    text->set<Bool>(BaseProperties::LINKED_SEGMENT_IGNORE_UPDATE, true);
+    link->insert(text);
+    source->getLinker()->clearRefreshStatuses();
+
+    SetVelocityCommand command(*source, 3 * crotchet, 10);
+    execute(command);
+
+    QCOMPARE(velocityAt(*link, 3 * crotchet), 10l);
+    QVERIFY(link->findSingle(text) != link->end());
+    QCOMPARE(link->size(), source->size() + 1);
+
+    delete link;
+    delete source;
+}
+
+void TestSegmentLinker::testUndo()
+{
+    Segment *source = makeSegment(20);
+    Segment *link = SegmentLinker::createLinkedSegment(source);
+    source->getLinker()->clearRefreshStatuses();
+
+    SetVelocityCommand command(*source, 7 * crotchet, 1);
+    execute(command);
+    QCOMPARE(velocityAt(*link, 7 * crotchet), 1l);
+
+    unexecute(command);
+    QCOMPARE(velocityAt(*link, 7 * crotchet), 100l);
+    QCOMPARE(link->size(), source->size());
+
+    delete link;
+    delete source;
+}
+
+QTEST_MAIN(TestSegmentLinker)
+
+#include "segmentlinker.moc"
@@ -0,0 +1,191 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/BaseProperties.h"
+#include "base/Composition.h"
+#include "base/Event.h"
+#include "base/NotationTypes.h"
+#include "base/Segment.h"
+#include "base/Track.h"
+#include "document/RosegardenDocument.h"
+#include "gui/seqmanager/SegmentMapper.h"
+#include "sound/MappedEvent.h"
+#include <QTest>
+
+using namespace Rosegarden;
+
+// Remapping only the edited part of a segment must give the same buffer
+// as mapping the whole segment again.
+class TestSegmentMapper : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestSegmentMapper() :
+        m_doc(nullptr, {}, true /*skip autoload*/, true, false /*no sound*/),
+        m_trackId(0)
+    {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testRefreshRange_data();
+    void testRefreshRange();
+
+private:
+    /// A segment of bars notes bars long, some overlapping.
+    Segment *makeSegment(int bars);
+
+    RosegardenDocument m_doc;
+    TrackId m_trackId;
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+
+    Event *makeNote(timeT time, timeT duration, int pitch)
+    {
+        Event *event = new Event(Note::EventType, time, duration);
+        event->set<Int>(BaseProperties::PITCH, pitch);
+        event->set<Int>(BaseProperties::VELOCITY, 100);
+        return event;
+    }
+
+    Segment::iterator findNote(Segment *segment, timeT time)
+    {
+        Segment::iterator i = segment->findTime(time);
+        while (!(*i)->isa(Note::EventType))
+            ++i;
+        return i;
+    }
+
+    enum Edit { InsertNote, EraseNote, Lengthen, Shorten, InsertAtEnd,
+                InsertChord, EraseLast };
+}
+
+Q_DECLARE_METATYPE(Edit)
+
+void TestSegmentMapper::initTestCase()
+{
+    RosegardenDocument::currentDocument = &m_doc;
+
+    Composition &composition = m_doc.getComposition();
+    m_trackId = composition.getNewTrackId();
+    composition.addTrack(new Track(m_trackId));
+}
+
+Segment *TestSegmentMapper::makeSegment(int bars)
+{
+    Segment *segment = new Segment;
+    segment->setTrack(m_trackId);
+    m_doc.getComposition().addSegment(segment);
+
+    // Four crotchets a bar, with a held note across every other bar.
+    for (int bar = 0; bar < bars; ++bar) {
+        const timeT barStart = bar * 4 * crotchet;
+        for (int beat = 0; beat < 4; ++beat) {
+            segment->insert(makeNote(barStart + beat * crotchet, crotchet,
+                                     60 + beat));
+        }
+        if (bar % 2 == 0)
+            segment->insert(makeNote(barStart, 6 * crotchet, 48));
+    }
+
+    return segment;
+}
+
+void TestSegmentMapper::testRefreshRange_data()
+{
+    QTest::addColumn<Edit>("edit");
+    QTest::addColumn<int>("bar");
+    // Whether refreshRange() should remap only part of the segment.
+    // In the first bar there is nothing before the edit to keep, and
+    // edits that move the end of the segment need a full remap.
+    QTest::addColumn<bool>("partial");
+
+    QTest::newRow("insert") << InsertNote << 5 << true;
+    QTest::newRow("insert in held note") << InsertNote << 6 << true;
+    QTest::newRow("erase") << EraseNote << 5 << true;
+    QTest::newRow("erase held") << EraseNote << 6 << true;
+    QTest::newRow("lengthen") << Lengthen << 5 << true;
+    QTest::newRow("lengthen held") << Lengthen << 6 << true;
+    QTest::newRow("shorten") << Shorten << 5 << true;
+    QTest::newRow("chord") << InsertChord << 9 << true;
+    QTest::newRow("first bar") << InsertNote << 0 << false;
+    QTest::newRow("at end") << InsertAtEnd << 15 << false;
+    QTest::newRow("erase last") << EraseLast << 15 << false;
+}
+
+void TestSegmentMapper::testRefreshRange()
+{
+    QFETCH(Edit, edit);
+    QFETCH(int, bar);
+    QFETCH(bool, partial);
+
+    Segment *segment = makeSegment(16);
+    QSharedPointer<SegmentMapper> mapper =
+            SegmentMapper::makeMapperForSegment(&m_doc, segment);
+    mapper->init();
+
+    const unsigned statusId = segment->getNewRefreshStatusId();
+    const timeT barStart = bar * 4 * crotchet;
+
+    switch (edit) {
+    case InsertNote:
+        segment->insert(makeNote(barStart + crotchet / 2, crotchet, 72));
+        break;
+    case EraseNote:
+        segment->erase(findNote(segment, barStart + crotchet));
+        break;
+    case Lengthen:
+    case Shorten: {
+        Segment::iterator i = findNote(segment, barStart + crotchet);
+        const timeT duration =
+                (edit == Lengthen) ? 5 * crotchet : crotchet / 4;
+        Event *event = new Event(**i, (*i)->getAbsoluteTime(), duration);
+        segment->erase(i);
+        segment->insert(event);
+        break;
+    }
+    case InsertChord:
+        for (int pitch = 70; pitch < 74; ++pitch) {
+            segment->insert(makeNote(barStart + 2 * crotchet, crotchet,
+                                     pitch));
+        }
+        break;
+    case InsertAtEnd:
+        segment->insert(makeNote(barStart + 3 * crotchet, 2 * crotchet, 80));
+        break;
+    case EraseLast:
+        segment->erase(findNote(segment, barStart + 3 * crotchet));
+        break;
+    }
+
+    SegmentRefreshStatus &status = segment->getRefreshStatus(statusId);
+    QVERIFY(status.needsRefresh());
+    mapper->refreshRange(status.from(), status.to());
+    QCOMPARE(mapper->getRangeFallbackCount(), partial ? 0 : 1);
+
+    // Compare with mapping from scratch.
+    QSharedPointer<SegmentMapper> expected =
+            SegmentMapper::makeMapperForSegment(&m_doc, segment);
+    expected->init();
+
+    QCOMPARE(mapper->size(), expected->size());
+    for (int i = 0; i < expected->size(); ++i) {
+        const MappedEvent &actualEvent = mapper->getBuffer()[i];
+        const MappedEvent &expectedEvent = expected->getBuffer()[i];
+        QCOMPARE(actualEvent.getEventTime(), expectedEvent.getEventTime());
+        QCOMPARE(actualEvent.getType(), expectedEvent.getType());
+        QCOMPARE(actualEvent.getPitch(), expectedEvent.getPitch());
+        QCOMPARE(actualEvent.getVelocity(), expectedEvent.getVelocity());
+        QCOMPARE(actualEvent.getDuration(), expectedEvent.getDuration());
+    }
+
+    m_doc.getComposition().deleteSegment(segment);
+}
+
+QTEST_MAIN(TestSegmentMapper)
+
+#include "segmentmapper.moc"
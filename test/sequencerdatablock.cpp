@@ -0,0 +1,177 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "sound/SequencerDataBlock.h"
+#include "sound/MappedEventList.h"
+#include <QTest>
+#include <atomic>
+#include <thread>
+
+using namespace Rosegarden;
+
+// Checks SequencerDataBlock's recorded event ring and level publishing,
+// including a sequencer thread recording while the GUI thread drains.
+class TestSequencerDataBlock : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+
+    void testRecordedEventsInOrder();
+    void testOverflowDropsNewest();
+    void testClearDiscardsEvents();
+    void testLevels();
+    void testConcurrentRecording();
+};
+
+namespace
+{
+    /// Events at 0, 1, 2... ns, so that order can be checked.
+    void addEvents(int first, int count)
+    {
+        MappedEventList list;
+        for (int i = first; i < first + count; ++i) {
+            MappedEvent *event = new MappedEvent;
+            event->setType(MappedEvent::MidiController);
+            event->setEventTime(RealTime(0, i));
+            list.insert(event);
+        }
+        SequencerDataBlock::getInstance()->addRecordedEvents(&list);
+    }
+
+    int takeEvents(std::vector<int> &times)
+    {
+        MappedEventList list;
+        const int count =
+                SequencerDataBlock::getInstance()->getRecordedEvents(list);
+        for (const MappedEvent *event : list) {
+            times.push_back(event->getEventTime().nsec);
+        }
+        return count;
+    }
+}
+
+void TestSequencerDataBlock::init()
+{
+    SequencerDataBlock::getInstance()->clearTemporaries();
+}
+
+void TestSequencerDataBlock::testRecordedEventsInOrder()
+{
+    addEvents(0, 10);
+    addEvents(10, 5);
+
+    std::vector<int> times;
+    QCOMPARE(takeEvents(times), 15);
+    for (int i = 0; i < 15; ++i) {
+        QCOMPARE(times[i], i);
+    }
+
+    times.clear();
+    QCOMPARE(takeEvents(times), 0);
+}
+
+void TestSequencerDataBlock::testOverflowDropsNewest()
+{
+    const int size = SEQUENCER_DATABLOCK_RECORD_BUFFER_SIZE;
+
+    addEvents(0, size - 10);
+    addEvents(size - 10, 20);
+
+    // The events the GUI hadn't read yet survive.
+    std::vector<int> times;
+    QCOMPARE(takeEvents(times), size);
+    QCOMPARE(times.front(), 0);
+    QCOMPARE(times.back(), size - 1);
+
+    // And there's room again.
+    addEvents(0, 3);
+    times.clear();
+    QCOMPARE(takeEvents(times), 3);
+}
+
+void TestSequencerDataBlock::testClearDiscardsEvents()
+{
+    addEvents(0, 10);
+    SequencerDataBlock::getInstance()->clearTemporaries();
+    addEvents(10, 2);
+
+    std::vector<int> times;
+    QCOMPARE(takeEvents(times), 2);
+    QCOMPARE(times[0], 10);
+}
+
+void TestSequencerDataBlock::testLevels()
+{
+    SequencerDataBlock *block = SequencerDataBlock::getInstance();
+    LevelInfo info;
+
+    // Unknown instrument.
+    QVERIFY(!block->getInstrumentLevel(2000, info));
+    QCOMPARE(info.level, 0);
+
+    const LevelInfo set = { 100, -5 };
+    block->setInstrumentLevel(2000, set);
+
+    // Each getter sees the change once.
+    QVERIFY(block->getInstrumentLevel(2000, info));
+    QCOMPARE(info.level, 100);
+    QCOMPARE(info.levelRight, -5);
+    QVERIFY(!block->getInstrumentLevel(2000, info));
+    QCOMPARE(info.level, 100);
+    QVERIFY(block->getInstrumentLevelForMixer(2000, info));
+
+    block->setMasterLevel(set);
+    QVERIFY(block->getMasterLevel(info));
+    QVERIFY(!block->getMasterLevel(info));
+
+    // Clearing counts as a change.
+    block->clearTemporaries();
+    QVERIFY(block->getInstrumentLevel(2000, info));
+    QCOMPARE(info.level, 0);
+    QVERIFY(block->getMasterLevel(info));
+    QCOMPARE(info.levelRight, 0);
+}
+
+void TestSequencerDataBlock::testConcurrentRecording()
+{
+    const int total = 100000;
+    std::atomic<bool> done(false);
+
+    std::thread sequencer([&done]() {
+        for (int i = 0; i < total; i += 8) {
+            addEvents(i, 8);
+            const LevelInfo info = { i, -i };
+            SequencerDataBlock::getInstance()->setMasterLevel(info);
+            if (i % 1024 == 0)
+                std::this_thread::yield();
+        }
+        done = true;
+    });
+
+    // Events may be dropped if we fall behind, but never reordered or
+    // duplicated, and levels are never torn.
+    std::vector<int> times;
+    bool torn = false;
+    bool finished = false;
+    while (!finished) {
+        finished = done;
+        takeEvents(times);
+        LevelInfo info;
+        if (SequencerDataBlock::getInstance()->getMasterLevel(info) &&
+            info.levelRight != -info.level)
+            torn = true;
+    }
+    sequencer.join();
+
+    QVERIFY(!torn);
+    QVERIFY(!times.empty());
+    for (size_t i = 1; i < times.size(); ++i) {
+        QVERIFY(times[i] > times[i - 1]);
+    }
+}
+
+QTEST_MAIN(TestSequencerDataBlock)
+
+#include "sequencerdatablock.moc"
@@ -0,0 +1,155 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/Composition.h"
+#include "base/NotationTypes.h"
+#include "base/TempoMap.h"
+#include <QTest>
+#include <vector>
+
+using namespace Rosegarden;
+
+// TempoMap's conversions, one at a time and in batches, compared with
+// known values and with Composition's own.
+class TestTempoMap : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testConstantTempo();
+    void testTempoChanges();
+    void testRamp();
+    void testRoundTrip();
+    void testBatch();
+    void testComposition();
+};
+
+namespace
+{
+    const timeT crotchet = Note(Note::Crotchet).getDuration();
+
+    const tempoT qpm60 = Composition::getTempoForQpm(60);
+    const tempoT qpm120 = Composition::getTempoForQpm(120);
+    const tempoT qpm240 = Composition::getTempoForQpm(240);
+
+    /// 120 qpm, 60 qpm from bar 2, ramping from 60 to 240 over bar 3,
+    /// then 240.
+    void makeChanges(Composition &composition)
+    {
+        composition.setCompositionDefaultTempo(qpm120);
+        composition.addTempoAtTime(4 * crotchet, qpm60);
+        composition.addTempoAtTime(8 * crotchet, qpm60, qpm240);
+        composition.addTempoAtTime(12 * crotchet, qpm240);
+    }
+
+    /// Times every n ticks from -2 bars to 6 bars.
+    std::vector<timeT> times(timeT n)
+    {
+        std::vector<timeT> result;
+        for (timeT t = -8 * crotchet; t < 24 * crotchet; t += n) {
+            result.push_back(t);
+        }
+        return result;
+    }
+}
+
+void TestTempoMap::testConstantTempo()
+{
+    TempoMap map(qpm120);
+    QCOMPARE(map.size(), size_t(0));
+
+    QCOMPARE(map.getElapsedRealTime(crotchet), RealTime(0, 500000000));
+    QCOMPARE(map.getElapsedRealTime(-crotchet), -RealTime(0, 500000000));
+    QCOMPARE(map.getElapsedTimeForRealTime(RealTime(3, 0)), 6 * crotchet);
+}
+
+void TestTempoMap::testTempoChanges()
+{
+    TempoMap map(qpm120);
+    map.addTempoChange(4 * crotchet, qpm60, -1, 0);
+
+    // Two seconds to the change, then a second per crotchet.
+    QCOMPARE(map.getTempoChangeRealTime(0), RealTime(2, 0));
+    QCOMPARE(map.getElapsedRealTime(6 * crotchet), RealTime(4, 0));
+    QCOMPARE(map.getElapsedTimeForRealTime(RealTime(5, 0)), 7 * crotchet);
+}
+
+void TestTempoMap::testRamp()
+{
+    // From 60 to 240 over four crotchets takes less than four seconds
+    // but more than one.
+    TempoMap map(qpm60);
+    map.addTempoChange(0, qpm60, qpm240, 4 * crotchet);
+    map.addTempoChange(4 * crotchet, qpm240, -1, 0);
+
+    const RealTime rampEnd = map.getTempoChangeRealTime(1);
+    QVERIFY(rampEnd < RealTime(4, 0));
+    QVERIFY(rampEnd > RealTime(1, 0));
+    QCOMPARE(map.getElapsedRealTime(4 * crotchet), rampEnd);
+
+    // The first half of the ramp is the slower half.
+    const RealTime half = map.getElapsedRealTime(2 * crotchet);
+    QVERIFY(half > rampEnd - half);
+}
+
+void TestTempoMap::testRoundTrip()
+{
+    Composition composition;
+    makeChanges(composition);
+    QSharedPointer<const TempoMap> map = composition.getTempoMap();
+
+    for (timeT t : times(37)) {
+        const timeT back =
+                map->getElapsedTimeForRealTime(map->getElapsedRealTime(t));
+        QVERIFY2(qAbs(back - t) <= 1, qPrintable(QString::number(t)));
+    }
+}
+
+void TestTempoMap::testBatch()
+{
+    Composition composition;
+    makeChanges(composition);
+    QSharedPointer<const TempoMap> map = composition.getTempoMap();
+
+    const std::vector<timeT> in = times(37);
+    std::vector<RealTime> realTimes(in.size());
+    map->getElapsedRealTimes(in.data(), realTimes.data(), in.size());
+
+    std::vector<timeT> out(in.size());
+    map->getElapsedTimesForRealTimes(realTimes.data(), out.data(), in.size());
+
+    for (size_t i = 0; i < in.size(); ++i) {
+        QCOMPARE(realTimes[i], map->getElapsedRealTime(in[i]));
+        QCOMPARE(out[i], map->getElapsedTimeForRealTime(realTimes[i]));
+    }
+}
+
+void TestTempoMap::testComposition()
+{
+    Composition composition;
+    makeChanges(composition);
+    QSharedPointer<const TempoMap> map = composition.getTempoMap();
+
+    for (timeT t : times(101)) {
+        QCOMPARE(composition.getElapsedRealTime(t),
+                 map->getElapsedRealTime(t));
+    }
+
+    // The map we hold doesn't change, but the Composition's does.
+    composition.addTempoAtTime(16 * crotchet, qpm120);
+    QCOMPARE(map->size(), size_t(3));
+    QCOMPARE(composition.getTempoMap()->size(), size_t(4));
+    QVERIFY(composition.getElapsedRealTime(20 * crotchet) >
+            map->getElapsedRealTime(20 * crotchet));
+
+    // The last ramp runs to the end marker.
+    composition.addTempoAtTime(20 * crotchet, qpm120, qpm240);
+    composition.setEndMarker(24 * crotchet);
+    const RealTime before = composition.getElapsedRealTime(22 * crotchet);
+    composition.setEndMarker(48 * crotchet);
+    QVERIFY(composition.getElapsedRealTime(22 * crotchet) > before);
+}
+
+QTEST_MAIN(TestTempoMap)
+
+#include "tempomap.moc"
@@ -12,6 +12,8 @@
 #include <QTest>
 
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <sys/times.h>
 
@@ -24,7 +26,9 @@ class TestMisc : public QObject
 
 private Q_SLOTS:
     void testEvent();
+    void testEventType();
     void testEventPerformance();
+    void testPropertyName();
     void testNotationTypes();
 };
 
@@ -109,6 +113,30 @@ void TestMisc::testEvent() try
     QVERIFY(false);
 }
 
+void TestMisc::testEventType()
+{
+    // Events made from the type constants share them.
+    Event note(Note::EventType, 0);
+    QCOMPARE(&note.getType(), &Note::EventType);
+    QVERIFY(note.isa(Note::EventType));
+    QVERIFY(!note.isa(Note::EventRestType));
+
+    // As do Events made from any other copy of the same string.
+    Event copy(std::string("note"), 0);
+    QCOMPARE(&copy.getType(), &Note::EventType);
+    QCOMPARE(&Event::internType("note"), &Note::EventType);
+
+    // And isa() still works with strings that aren't interned.
+    QVERIFY(note.isa(std::string("note")));
+    QVERIFY(!note.isa(std::string("rest")));
+
+    Event other(std::string("testEventType"), 0);
+    QCOMPARE(other.getType(), std::string("testEventType"));
+    QVERIFY(other.isa(std::string("testEventType")));
+    QVERIFY(!other.isa(Note::EventType));
+    QVERIFY(!note.isa(other.getType()));
+}
+
 void TestMisc::testEventPerformance()
 {
     // Performance testing probably belongs in the code itself.
@@ -241,6 +269,42 @@ void TestMisc::testEventPerformance()
          << (et-st)*10 << "ms";
 }
 
+void TestMisc::testPropertyName()
+{
+    QCOMPARE(PropertyName().getName(), std::string());
+
+    // Enough names to fill a few blocks of the ID to name table, read
+    // back while another thread keeps adding more.
+    constexpr int NAME_COUNT = 3000;
+
+    std::vector<PropertyName> names;
+    for (int i = 0; i < NAME_COUNT; ++i) {
+        names.push_back(PropertyName("testPropertyName" + std::to_string(i)));
+    }
+
+    std::thread adder([]() {
+        for (int i = 0; i < NAME_COUNT; ++i) {
+            PropertyName("testPropertyNameMore" + std::to_string(i));
+        }
+    });
+
+    bool allFound = true;
+    for (int pass = 0; pass < 10; ++pass) {
+        for (int i = 0; i < NAME_COUNT; ++i) {
+            if (names[i].getName() !=
+                    "testPropertyName" + std::to_string(i))
+                allFound = false;
+        }
+    }
+
+    adder.join();
+
+    QVERIFY(allFound);
+    QCOMPARE(PropertyName("testPropertyName42").getId(), names[42].getId());
+    QCOMPARE(PropertyName("testPropertyNameMore2999").getName(),
+             std::string("testPropertyNameMore2999"));
+}
+
 void TestMisc::testNotationTypes() {
     qDebug() << "Testing duration-list stuff";
 
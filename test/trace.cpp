@@ -0,0 +1,219 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*- vi:set ts=8 sts=4 sw=4: */
+//
+
+#include "base/Profiler.h"
+#include "base/Trace.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace Rosegarden;
+
+// Checks that traced sections and counters are recorded, from any
+// thread, and written as Chrome trace JSON, and that threads which
+// haven't named themselves only add to the totals.
+class TestTrace : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanupTestCase();
+
+    void testScope();
+    void testProfiler();
+    void testCounter();
+    void testThreads();
+    void testChromeTrace();
+    void testUnnamedThread();
+};
+
+namespace
+{
+    TraceCounter testCounter("TestTrace counter");
+
+    const TracePoint *findPoint(const char *name)
+    {
+        for (const TracePoint *point : Trace::getPoints()) {
+            if (!strcmp(point->getName(), name))
+                return point;
+        }
+        return nullptr;
+    }
+
+    void traced()
+    {
+        RG_TRACE_SCOPE("TestTrace traced");
+    }
+
+    void tracedUnnamed()
+    {
+        RG_TRACE_SCOPE("TestTrace unnamed");
+    }
+}
+
+void TestTrace::init()
+{
+    Trace::setEnabled(true);
+}
+
+void TestTrace::cleanupTestCase()
+{
+    Trace::setEnabled(false);
+}
+
+void TestTrace::testScope()
+{
+    for (int i = 0; i < 10; ++i) {
+        traced();
+    }
+
+    const TracePoint *point = findPoint("TestTrace traced");
+    QVERIFY(point);
+    QCOMPARE(point->getCount(), uint64_t(10));
+    QVERIFY(point->getWorstNs() <= point->getTotalNs());
+
+    // Nothing is recorded while tracing is off.
+    Trace::setEnabled(false);
+    traced();
+    QCOMPARE(point->getCount(), uint64_t(10));
+}
+
+void TestTrace::testProfiler()
+{
+    {
+        Profiler profiler("TestTrace profiler");
+    }
+    {
+        Profiler profiler("TestTrace profiler");
+        profiler.end();
+    }
+
+    const TracePoint *point = findPoint("TestTrace profiler");
+    QVERIFY(point);
+    QCOMPARE(point->getCount(), uint64_t(2));
+}
+
+void TestTrace::testCounter()
+{
+    const uint64_t before = testCounter.get();
+    testCounter.increment();
+    testCounter.increment();
+    QCOMPARE(testCounter.get(), before + 2);
+
+    bool found = false;
+    for (const TraceCounter *counter : Trace::getCounters()) {
+        if (counter == &testCounter)
+            found = true;
+    }
+    QVERIFY(found);
+}
+
+void TestTrace::testThreads()
+{
+    const TracePoint *point = findPoint("TestTrace traced");
+    const uint64_t before = point ? point->getCount() : 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([]() {
+            Trace::setThreadName("TestTrace worker");
+            for (int i = 0; i < 1000; ++i) {
+                traced();
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    point = findPoint("TestTrace traced");
+    QVERIFY(point);
+    QCOMPARE(point->getCount(), before + 4000);
+}
+
+void TestTrace::testChromeTrace()
+{
+    Trace::setThreadName("TestTrace main");
+    traced();
+    testCounter.increment();
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("trace.json");
+    QVERIFY(Trace::writeChromeTrace(filename));
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    QVERIFY(document.isObject());
+
+    int sections = 0;
+    bool threadName = false;
+    bool counter = false;
+    for (const QJsonValue &value :
+             document.object()["traceEvents"].toArray()) {
+        const QJsonObject event = value.toObject();
+        const QString phase = event["ph"].toString();
+        if (phase == "X") {
+            if (event["name"].toString() == "TestTrace traced") {
+                QVERIFY(event["dur"].toDouble() >= 0);
+                ++sections;
+            }
+        } else if (phase == "M") {
+            if (event["args"].toObject()["name"].toString() ==
+                    "TestTrace main")
+                threadName = true;
+        } else if (phase == "C") {
+            if (event["name"].toString() == "TestTrace counter")
+                counter = true;
+        }
+    }
+
+    QVERIFY(sections > 0);
+    QVERIFY(threadName);
+    QVERIFY(counter);
+}
+
+void TestTrace::testUnnamedThread()
+{
+    // A thread that hasn't called setThreadName() has no buffer, so
+    // its sections are counted but not written.
+    std::thread thread([]() {
+        for (int i = 0; i < 10; ++i) {
+            tracedUnnamed();
+        }
+    });
+    thread.join();
+
+    const TracePoint *point = findPoint("TestTrace unnamed");
+    QVERIFY(point);
+    QCOMPARE(point->getCount(), uint64_t(10));
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("trace.json");
+    QVERIFY(Trace::writeChromeTrace(filename));
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    QVERIFY(document.isObject());
+
+    for (const QJsonValue &value :
+             document.object()["traceEvents"].toArray()) {
+        QVERIFY(value.toObject()["name"].toString() != "TestTrace unnamed");
+    }
+}
+
+QTEST_MAIN(TestTrace)
+
+#include "trace.moc"